@@ -5,9 +5,11 @@
 #include "klotter/cint.h"
 #include "klotter/imgui.theme.h"
 #include "klotter/im_colors.h"
+#include "klotter/profiler.h"
 
 #include "klotter/render/geom.builder.h"
 #include "klotter/render/geom.h"
+#include "klotter/render/shader.h"
 #include "klotter/render/ui.h"
 #include "klotter/render/postproc.internal.h" // todo(Gustav): only needed for visualizing the shadow depth buffer, improve design and remove
 #include "klotter/render/shadow.h"
@@ -298,6 +300,7 @@ struct LightsSample : klotter::App
 	std::vector<SCurveGuiState> point_light_curves;
 	SCurveGuiState frustum_light_curve = SCurveGuiState::light_curve();
 	ImguiShaderCache imgui_shader_cache;
+	ProfilerGui profiler_gui;
 
 	bool debug_draw_frustum = false;
 	bool debug_draw_shadow_frustum = true;
@@ -597,7 +600,23 @@ struct LightsSample : klotter::App
 		ImGui::Checkbox("Use bloom", &renderer->settings.use_bloom);
 		ImGui::DragFloat("Bloom cutoff", &renderer->settings.bloom_cutoff, FAC_SPEED);
 		ImGui::SliderFloat("Softness", &renderer->settings.bloom_softness, 0.0f, 1.0f);
-		ImGui::DragInt("Bloom blur steps", &renderer->settings.bloom_blur_steps);
+		if (imgui_group_button("Ping-pong blur", true, renderer->settings.bloom_mode == klotter::BloomMode::ping_pong_blur))
+		{
+			renderer->settings.bloom_mode = klotter::BloomMode::ping_pong_blur;
+		}
+		if (imgui_group_button("Mip chain", false, renderer->settings.bloom_mode == klotter::BloomMode::mip_chain))
+		{
+			renderer->settings.bloom_mode = klotter::BloomMode::mip_chain;
+		}
+		if (renderer->settings.bloom_mode == klotter::BloomMode::ping_pong_blur)
+		{
+			ImGui::DragInt("Bloom blur steps", &renderer->settings.bloom_blur_steps);
+		}
+		else
+		{
+			ImGui::SliderInt("Bloom mips", &renderer->settings.bloom_mip_count, 1, 8);
+			ImGui::DragFloat("Bloom filter radius", &renderer->settings.bloom_filter_radius, FAC_SPEED);
+		}
 
 		ImGui::SeparatorText("Effects");
 		gui_effects_factors();
@@ -610,6 +629,47 @@ struct LightsSample : klotter::App
 		imgui_label("window size", Str{} << last_window_size.x << " | " << last_window_size.y);
 		imgui_label("projected target", Str{} << projected_target.x << " | " << projected_target.y);
 
+		ImGui::SeparatorText("Assets");
+		{
+			const auto stats = renderer->assets.manager.get_stats();
+			imgui_label("loaded", Str{} << stats.asset_count << " (" << stats.used_count << " used)");
+			imgui_label("cpu memory", Str{} << stats.memory.cpu_bytes / 1024 << " kb");
+			imgui_label("gpu memory", Str{} << stats.memory.gpu_bytes / 1024 << " kb");
+			imgui_label("hits | misses", Str{} << stats.hits << " | " << stats.misses);
+			imgui_label("evictions | reloads", Str{} << stats.evictions << " | " << stats.reloads);
+			if (ImGui::Button("Evict unused"))
+			{
+				renderer->assets.manager.evict_unused();
+			}
+		}
+
+		ImGui::SeparatorText("Uniforms");
+		{
+			// the gui is drawn once per frame so this is the uniforms of the last frame
+			const auto stats = get_uniform_upload_stats();
+			reset_uniform_upload_stats();
+			imgui_label("set | skipped", Str{} << stats.issued << " | " << stats.skipped);
+		}
+
+		ImGui::SeparatorText("State changes");
+		{
+			// requested | sent to the driver, for the last frame
+			const auto stats = renderer->get_state_stats();
+			renderer->reset_state_stats();
+			const auto counter = [](const char* label, const StateCounter& c)
+			{
+				imgui_label(label, Str{} << c.requested << " | " << c.issued);
+			};
+			counter("capabilities", stats.capabilities);
+			counter("textures", stats.textures);
+			counter("programs", stats.programs);
+			counter("vertex arrays", stats.vertex_arrays);
+			counter("buffers", stats.buffers);
+			counter("framebuffers", stats.framebuffers);
+			counter("viewports", stats.viewports);
+			counter("clear colors", stats.clear_colors);
+		}
+
 		ImGui::SeparatorText("Outline");
 		gui_outline_toggle();
 
@@ -636,6 +696,10 @@ struct LightsSample : klotter::App
 
 		ImGui::End();
 
+		ImGui::Begin("Profiler");
+		imgui_profiler(&profiler_gui);
+		ImGui::End();
+
 		ImGui::ShowDemoWindow(nullptr);
 	}
 };
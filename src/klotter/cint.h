@@ -1,5 +1,11 @@
 #pragma once
 
+/// Rounds the value up to the nearest multiple.
+constexpr int round_up(int value, int multiple)
+{
+	return ((value + multiple - 1) / multiple) * multiple;
+}
+
 constexpr float float_from_int(int i)
 {
 	return static_cast<float>(i);
@@ -2,6 +2,12 @@
 
 #include <algorithm>
 
+// ------------------------------------------------------------------------------------------------
+// preprocessor utils
+
+#define CONCAT_IMPL(x, y) x##y
+#define CONCAT(x, y) CONCAT_IMPL(x, y)
+
 namespace klotter
 {
 
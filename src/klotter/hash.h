@@ -42,6 +42,23 @@ struct HashCombiner
 	}
 };
 
+/// The start value of a \ref hash_fnv1a chain.
+constexpr std::uint64_t fnv1a_offset_basis = 0xcbf2'9ce4'8422'2325;
+
+/// Hashes the bytes with fnv-1a, use this instead of std::hash when the hash needs to be stable between runs and platforms.
+/// Start with \ref fnv1a_offset_basis and pass the result to the next call to hash several values.
+inline std::uint64_t hash_fnv1a(std::uint64_t hash, const void* data, std::size_t size)
+{
+	constexpr std::uint64_t fnv_prime = 0x0000'0100'0000'01b3;
+
+	const auto* bytes = static_cast<const std::uint8_t*>(data);
+	for (std::size_t index = 0; index < size; index += 1)
+	{
+		hash ^= bytes[index];
+		hash *= fnv_prime;
+	}
+	return hash;
+}
 
 /** Begins the definition of a specialization of std::hash for the given TYPE.
  * Should be closed by the \ref HASH_DEF_END macro
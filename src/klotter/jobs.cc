@@ -0,0 +1,320 @@
+#include "klotter/jobs.h"
+
+#include "klotter/assert.h"
+#include "klotter/cint.h"
+#include "klotter/log.h"
+#include "klotter/profiler.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <optional>
+#include <thread>
+
+namespace klotter
+{
+
+namespace
+{
+	/// A queue of jobs, the owner takes the newest job and thieves take the oldest.
+	struct WorkQueue
+	{
+		std::mutex mutex;
+		std::deque<ScheduledJob> jobs;
+	};
+
+	/// the system and queue of the current thread, used to find the queue a job should be pushed to
+	thread_local const JobSystemPimpl* current_system = nullptr;
+	thread_local std::size_t current_queue = 0;
+}  //  namespace
+
+// ------------------------------------------------------------------------------------------------
+// counter
+
+JobCounter::~JobCounter()
+{
+	ASSERT(is_done());
+}
+
+bool JobCounter::is_done() const
+{
+	return pending.load() == 0;
+}
+
+// ------------------------------------------------------------------------------------------------
+// system
+
+struct JobSystemPimpl
+{
+	/// the first queue is shared by all threads outside the system, the rest is a queue per worker
+	std::vector<std::unique_ptr<WorkQueue>> queues;
+	std::vector<std::thread> workers;
+
+	/// the number of jobs in all queues
+	std::atomic<int> queued = 0;
+
+	std::mutex sleep_mutex;
+	std::condition_variable has_jobs;
+	std::atomic<bool> is_stopping = false;
+
+	explicit JobSystemPimpl(int worker_count)
+	{
+		queues.emplace_back(std::make_unique<WorkQueue>());
+		for (int index = 0; index < worker_count; index += 1)
+		{
+			queues.emplace_back(std::make_unique<WorkQueue>());
+		}
+
+		for (int index = 0; index < worker_count; index += 1)
+		{
+			workers.emplace_back([this, index]() { run_worker(sizet_from_int(index) + 1); });
+		}
+		LOG_INFO("Job system started with %d workers", worker_count);
+	}
+
+	~JobSystemPimpl()
+	{
+		// jobs can't be dropped since someone might wait for them
+		while (try_run_one(own_queue(), nullptr))
+		{
+		}
+
+		is_stopping = true;
+		{
+			std::scoped_lock lock{sleep_mutex};
+		}
+		has_jobs.notify_all();
+		for (auto& worker: workers)
+		{
+			worker.join();
+		}
+	}
+
+	JobSystemPimpl(const JobSystemPimpl&) = delete;
+	JobSystemPimpl(JobSystemPimpl&&) = delete;
+	void operator=(const JobSystemPimpl&) = delete;
+	void operator=(JobSystemPimpl&&) = delete;
+
+	[[nodiscard]] std::size_t own_queue() const
+	{
+		return current_system == this ? current_queue : 0;
+	}
+
+	void push(ScheduledJob job)
+	{
+		// count before pushing so the count is never less than the number of queued jobs
+		queued += 1;
+		{
+			auto& queue = *queues[own_queue()];
+			std::scoped_lock lock{queue.mutex};
+			queue.jobs.emplace_back(std::move(job));
+		}
+
+		// lock so a worker that is about to sleep doesn't miss the notification
+		{
+			std::scoped_lock lock{sleep_mutex};
+		}
+		has_jobs.notify_one();
+	}
+
+	/// @param only if not null, only take jobs of this counter
+	std::optional<ScheduledJob> pop(std::size_t own, const JobCounter* only)
+	{
+		const auto matches = [only](const ScheduledJob& job) { return only == nullptr || job.counter == only; };
+
+		{
+			auto& queue = *queues[own];
+			std::scoped_lock lock{queue.mutex};
+			if (const auto found = std::find_if(queue.jobs.rbegin(), queue.jobs.rend(), matches); found != queue.jobs.rend())
+			{
+				auto job = std::move(*found);
+				queue.jobs.erase(std::next(found).base());
+				return job;
+			}
+		}
+
+		// steal the oldest job, starting with the queue after our own so the thieves spread out
+		for (std::size_t offset = 1; offset < queues.size(); offset += 1)
+		{
+			auto& queue = *queues[(own + offset) % queues.size()];
+			std::scoped_lock lock{queue.mutex};
+			if (const auto found = std::find_if(queue.jobs.begin(), queue.jobs.end(), matches); found != queue.jobs.end())
+			{
+				auto job = std::move(*found);
+				queue.jobs.erase(found);
+				return job;
+			}
+		}
+
+		return std::nullopt;
+	}
+
+	/// returns false if there was no job to run
+	/// @param only if not null, only run jobs of this counter
+	bool try_run_one(std::size_t own, const JobCounter* only)
+	{
+		if (queued.load() == 0)
+		{
+			return false;
+		}
+
+		auto job = pop(own, only);
+		if (job.has_value() == false)
+		{
+			return false;
+		}
+		queued -= 1;
+
+		{
+			SCOPED_PROFILE_ZONE("Job"sv);
+			job->function();
+		}
+		complete(job->counter);
+		return true;
+	}
+
+	void complete(JobCounter* counter)
+	{
+		if (counter == nullptr)
+		{
+			return;
+		}
+
+		std::vector<ScheduledJob> ready;
+		{
+			std::scoped_lock lock{counter->mutex};
+			if (counter->pending.fetch_sub(1) != 1)
+			{
+				return;
+			}
+			ready.swap(counter->continuations);
+		}
+
+		for (auto& job: ready)
+		{
+			push(std::move(job));
+		}
+	}
+
+	void run_worker(std::size_t own)
+	{
+		current_system = this;
+		current_queue = own;
+		set_profiler_thread_name("Job worker " + std::to_string(own));
+
+		while (is_stopping == false)
+		{
+			if (try_run_one(own, nullptr))
+			{
+				continue;
+			}
+
+			std::unique_lock lock{sleep_mutex};
+			has_jobs.wait(lock, [this]() { return is_stopping || queued.load() > 0; });
+		}
+	}
+};
+
+JobSystem::JobSystem(int worker_count)
+	: pimpl(std::make_unique<JobSystemPimpl>(
+		  worker_count > 0 ? worker_count : std::max(1, static_cast<int>(std::thread::hardware_concurrency()) - 1)
+	  ))
+{
+}
+
+JobSystem::~JobSystem() = default;
+
+void JobSystem::run(JobFunction function, JobCounter* counter)
+{
+	if (counter != nullptr)
+	{
+		counter->pending += 1;
+	}
+	pimpl->push(ScheduledJob{std::move(function), counter});
+}
+
+void JobSystem::run_after(JobCounter* dependency, JobFunction function, JobCounter* counter)
+{
+	ASSERT(dependency != nullptr);
+	if (counter != nullptr)
+	{
+		counter->pending += 1;
+	}
+
+	{
+		// the last job of the dependency takes the continuations while holding the lock
+		std::scoped_lock lock{dependency->mutex};
+		if (dependency->is_done() == false)
+		{
+			dependency->continuations.emplace_back(ScheduledJob{std::move(function), counter});
+			return;
+		}
+	}
+
+	pimpl->push(ScheduledJob{std::move(function), counter});
+}
+
+void JobSystem::wait(JobCounter* counter)
+{
+	// only help with the awaited jobs, a long unrelated job like a texture decode would stall the waiting thread
+	const auto own = pimpl->own_queue();
+	while (counter->is_done() == false)
+	{
+		if (pimpl->try_run_one(own, counter) == false)
+		{
+			std::this_thread::yield();
+		}
+	}
+
+	// the last job might still hold the lock while taking the continuations
+	std::scoped_lock lock{counter->mutex};
+}
+
+void JobSystem::parallel_for(int begin, int end, int grain_size, const std::function<void(int begin, int end)>& function)
+{
+	const auto count = end - begin;
+	if (count <= 0)
+	{
+		return;
+	}
+
+	// a few ranges per thread so a thread that finishes early can steal the rest
+	constexpr int ranges_per_thread = 4;
+	const auto grain = grain_size > 0 ? grain_size : std::max(1, count / (get_thread_count() * ranges_per_thread));
+	if (count <= grain)
+	{
+		function(begin, end);
+		return;
+	}
+
+	JobCounter counter;
+	for (int first = begin + grain; first < end; first += grain)
+	{
+		const auto last = std::min(end, first + grain);
+		run([&function, first, last]() { function(first, last); }, &counter);
+	}
+	function(begin, begin + grain);
+	wait(&counter);
+}
+
+int JobSystem::get_thread_count() const
+{
+	return int_from_sizet(pimpl->workers.size()) + 1;
+}
+
+int grain_size_from_thread_count(int count, int thread_count)
+{
+	if (thread_count <= 0)
+	{
+		return 0;
+	}
+	return std::max(1, (count + thread_count - 1) / thread_count);
+}
+
+JobSystem& get_job_system()
+{
+	static JobSystem system;
+	return system;
+}
+
+}  //  namespace klotter
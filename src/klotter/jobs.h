@@ -0,0 +1,101 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace klotter
+{
+
+/** \addtogroup jobs Jobs
+ *  @{
+*/
+
+using JobFunction = std::function<void()>;
+
+struct JobCounter;
+struct JobSystemPimpl;
+
+/// internal: A scheduled function and the counter that is decreased when it's done.
+struct ScheduledJob
+{
+	JobFunction function;
+	JobCounter* counter = nullptr;
+};
+
+/** Counts the jobs that aren't done.
+ * Wait for it with \ref JobSystem::wait or use it as the dependency of other jobs.
+ * The counter needs to outlive the jobs that use it.
+ */
+struct JobCounter
+{
+	JobCounter() = default;
+	~JobCounter();
+
+	JobCounter(const JobCounter&) = delete;
+	JobCounter(JobCounter&&) = delete;
+	void operator=(const JobCounter&) = delete;
+	void operator=(JobCounter&&) = delete;
+
+	[[nodiscard]] bool is_done() const;
+
+	std::atomic<int> pending = 0;
+
+	/// guards the continuations and the last decrease of pending
+	std::mutex mutex;
+
+	/// the jobs that are scheduled when pending reaches zero
+	std::vector<ScheduledJob> continuations;
+};
+
+/** A work stealing job scheduler.
+ * Each worker has its own queue and steals from the others when it's empty.
+ * Threads outside the system, like the main thread, share a queue and help run the jobs they wait for.
+ */
+struct JobSystem
+{
+	/// @param worker_count the number of threads to start, 0 means one less than the number of cores
+	explicit JobSystem(int worker_count = 0);
+
+	/// runs the jobs that are left before stopping the workers
+	~JobSystem();
+
+	JobSystem(const JobSystem&) = delete;
+	JobSystem(JobSystem&&) = delete;
+	void operator=(const JobSystem&) = delete;
+	void operator=(JobSystem&&) = delete;
+
+	/// Schedule a function, the counter is increased now and decreased when the function is done.
+	void run(JobFunction function, JobCounter* counter = nullptr);
+
+	/// Schedule a function that starts when all the jobs of the dependency are done.
+	void run_after(JobCounter* dependency, JobFunction function, JobCounter* counter = nullptr);
+
+	/// Run the jobs of the counter on the calling thread until all of them are done, other jobs are left to the workers.
+	void wait(JobCounter* counter);
+
+	/** Split [begin, end) into ranges and call the function for each range, on multiple threads.
+	 * Returns when all ranges are done, the calling thread runs the first range and then helps with the rest.
+	 * @param grain_size the largest range to run as a single job, 0 picks a size that gives a few ranges per thread
+	 */
+	void parallel_for(int begin, int end, int grain_size, const std::function<void(int begin, int end)>& function);
+
+	/// The number of threads that run jobs, the workers and the thread that waits.
+	[[nodiscard]] int get_thread_count() const;
+
+	std::unique_ptr<JobSystemPimpl> pimpl;
+};
+
+/// The grain size that splits count items over a number of threads, 0 means all threads.
+int grain_size_from_thread_count(int count, int thread_count);
+
+/// The scheduler shared by the engine and the apps, started on first use.
+JobSystem& get_job_system();
+
+/**
+ * @}
+*/
+
+}  //  namespace klotter
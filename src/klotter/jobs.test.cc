@@ -0,0 +1,135 @@
+#include "klotter/jobs.h"
+
+#include "catch2/catch_test_macros.hpp"
+
+#include <thread>
+
+using namespace klotter;
+
+TEST_CASE("jobs_run_and_wait", "[jobs]")
+{
+	JobSystem jobs{3};
+	CHECK(jobs.get_thread_count() == 4);
+
+	std::atomic<int> sum = 0;
+	JobCounter counter;
+	for (int index = 1; index <= 100; index += 1)
+	{
+		jobs.run([&sum, index]() { sum += index; }, &counter);
+	}
+	jobs.wait(&counter);
+
+	CHECK(counter.is_done());
+	CHECK(sum == 5050);
+}
+
+TEST_CASE("jobs_parallel_for_covers_all_items_once", "[jobs]")
+{
+	JobSystem jobs{3};
+
+	constexpr int count = 1000;
+	std::vector<std::atomic<int>> hits(count);
+
+	// returns the largest range, catch isn't thread safe so nothing is checked in the jobs
+	const auto run = [&](int grain_size)
+	{
+		std::atomic<int> largest = 0;
+		jobs.parallel_for(0, count, grain_size, [&](int begin, int end)
+			{
+				int current = largest;
+				while (end - begin > current && largest.compare_exchange_weak(current, end - begin) == false)
+				{
+				}
+				for (int index = begin; index < end; index += 1)
+				{
+					hits[static_cast<std::size_t>(index)] += 1;
+				}
+			}
+		);
+		return largest.load();
+	};
+
+	CHECK(run(0) < count);
+	CHECK(run(1) == 1);
+	CHECK(run(7) == 7);
+	CHECK(run(count * 2) == count);
+
+	CHECK(std::ranges::all_of(hits, [](const std::atomic<int>& h) { return h == 4; }));
+}
+
+TEST_CASE("jobs_run_after_waits_for_dependency", "[jobs]")
+{
+	JobSystem jobs{2};
+
+	std::atomic<int> first_done = 0;
+	std::atomic<int> seen_by_second = -1;
+
+	JobCounter first;
+	JobCounter second;
+	for (int index = 0; index < 10; index += 1)
+	{
+		jobs.run([&first_done]() { first_done += 1; }, &first);
+	}
+	jobs.run_after(&first, [&]() { seen_by_second = first_done.load(); }, &second);
+	jobs.wait(&second);
+
+	CHECK(seen_by_second == 10);
+
+	// a done dependency runs the job directly
+	JobCounter third;
+	jobs.run_after(&first, [&]() { seen_by_second = 42; }, &third);
+	jobs.wait(&third);
+	CHECK(seen_by_second == 42);
+}
+
+TEST_CASE("jobs_nested_parallel_for", "[jobs]")
+{
+	JobSystem jobs{2};
+
+	std::atomic<int> sum = 0;
+	jobs.parallel_for(0, 8, 1, [&](int begin, int end)
+		{
+			for (int outer = begin; outer < end; outer += 1)
+			{
+				// waiting inside a job runs other jobs instead of blocking the worker
+				jobs.parallel_for(0, 100, 10, [&](int b, int e) { sum += e - b; });
+			}
+		}
+	);
+
+	CHECK(sum == 800);
+}
+
+TEST_CASE("jobs_wait_only_runs_awaited_jobs", "[jobs]")
+{
+	JobSystem jobs{1};
+
+	// keep the worker busy so only the waiting thread can run jobs
+	std::atomic<bool> is_blocking = true;
+	JobCounter blocker;
+	jobs.run([&is_blocking]() { while (is_blocking) { std::this_thread::yield(); } }, &blocker);
+
+	std::atomic<bool> ran_unrelated = false;
+	std::atomic<bool> ran_awaited = false;
+	JobCounter unrelated;
+	JobCounter awaited;
+	jobs.run([&ran_unrelated]() { ran_unrelated = true; }, &unrelated);
+	jobs.run([&ran_awaited]() { ran_awaited = true; }, &awaited);
+
+	jobs.wait(&awaited);
+	CHECK(ran_awaited);
+	CHECK(ran_unrelated == false);
+
+	is_blocking = false;
+	jobs.wait(&blocker);
+	jobs.wait(&unrelated);
+	CHECK(ran_unrelated);
+}
+
+TEST_CASE("jobs_grain_size_from_thread_count", "[jobs]")
+{
+	CHECK(grain_size_from_thread_count(100, 0) == 0);
+	CHECK(grain_size_from_thread_count(100, 1) == 100);
+	CHECK(grain_size_from_thread_count(100, 3) == 34);
+	CHECK(grain_size_from_thread_count(0, 4) == 1);
+}
@@ -1,8 +1,11 @@
 ﻿#include "klotter/klotter.h"
 
 #include "klotter/log.h"
+#include "klotter/profiler.h"
+#include "klotter/update_thread.h"
 
 #include "klotter/render/opengl_utils.h"
+#include "klotter/render/shader.cache.h"
 
 #include "klotter/dependency_glad.h"
 
@@ -20,14 +23,38 @@ int app_main(const RenderSettings& rs, MakeAppFunction make_app, SDL_Window* sdl
 {
 	////////////////////////////////////////////////////////////////
 	// create actual app
-	Renderer renderer{rs};
+	std::string base_path;
+	if (auto* sdl_base_path = SDL_GetBasePath(); sdl_base_path != nullptr)
+	{
+		base_path = sdl_base_path;
+		SDL_free(sdl_base_path);
+	}
+
+	// the used permutations depend on the app, so each executable gets its own manifest
+	auto settings = rs;
+	if (settings.shader_manifest_path.empty())
+	{
+		settings.shader_manifest_path = default_shader_manifest_path(base_path);
+	}
+
+	Renderer renderer{settings};
 	if (renderer.is_loaded() == false)
 	{
 		return -1;
 	}
 
-	auto app = make_app(&renderer);
+	// use the packed assets next to the executable if they were built, otherwise the embedded assets are used
+	if (base_path.empty() == false)
+	{
+		renderer.assets.open_archive(std::filesystem::path{base_path} / "assets.klar");
+	}
 
+	auto app = make_app(&renderer);
+	auto update = app->update_mode == UpdateMode::pipelined ? std::make_unique<UpdateThread>(app.get()) : nullptr;
+	if (update)
+	{
+		LOG_INFO("Updating %f times per second on a separate thread", static_cast<double>(app->updates_per_second));
+	}
 
 	////////////////////////////////////////////////////////////////
 	// run app
@@ -48,9 +75,12 @@ int app_main(const RenderSettings& rs, MakeAppFunction make_app, SDL_Window* sdl
 	bool space = false;
 	bool lctrl = false;
 
+	set_profiler_thread_name("Main");
 	auto last = SDL_GetPerformanceCounter();
 	while (running)
 	{
+		mark_profiler_frame();
+		auto app_lock = lock_app(update.get());
 		app->on_frame(&renderer);
 		const auto now = SDL_GetPerformanceCounter();
 		const auto diff = static_cast<float>(now - last);
@@ -174,11 +204,31 @@ int app_main(const RenderSettings& rs, MakeAppFunction make_app, SDL_Window* sdl
 			}
 		}
 
+		// let the update thread run while rendering
+		app_lock = {};
+
+		// upload textures that finished loading
+		{
+			SCOPED_DEBUG_GROUP("Upload textures"sv);
+			renderer.assets.update();
+		}
 
 		// render
 		{
 			SCOPED_DEBUG_GROUP("Render App"sv);
-			app->on_render({window_width, window_height}, &renderer, dt);
+			if (update)
+			{
+				// before the first update there is nothing to render
+				if (const auto* snapshot = update->snapshots.acquire(); snapshot != nullptr)
+				{
+					app->on_render_snapshot({window_width, window_height}, &renderer, *snapshot, dt);
+					update->snapshots.release();
+				}
+			}
+			else
+			{
+				app->on_render({window_width, window_height}, &renderer, dt);
+			}
 		}
 
 		// imgui windows
@@ -187,7 +237,10 @@ int app_main(const RenderSettings& rs, MakeAppFunction make_app, SDL_Window* sdl
 		ImGui_ImplSDL2_NewFrame();
 		ImGui::NewFrame();
 
-		app->on_gui(&renderer);
+		{
+			const auto gui_lock = lock_app(update.get());
+			app->on_gui(&renderer);
+		}
 
 		ImGui::Render();
 
@@ -195,7 +248,11 @@ int app_main(const RenderSettings& rs, MakeAppFunction make_app, SDL_Window* sdl
 			SCOPED_DEBUG_GROUP("DearImGui rendering"sv);
 			ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 		}
-		SDL_GL_SwapWindow(sdl_window);
+		{
+			// waiting for vsync or the driver shows up here
+			SCOPED_PROFILE_ZONE("Swap"sv);
+			SDL_GL_SwapWindow(sdl_window);
+		}
 	}
 
 	return 0;
@@ -3,6 +3,7 @@
 #include "klotter/render/camera.h"
 #include "klotter/render/enable_high_performance_graphics.h"
 #include "klotter/render/renderer.h"
+#include "klotter/render/world.snapshot.h"
 
 #include "klotter/dependency_sdl.h"
 
@@ -13,14 +14,43 @@
 namespace klotter
 {
 
+/// How \ref run_main updates and renders an \ref App.
+enum class UpdateMode
+{
+	/// the app updates in \ref App::on_render, one update per rendered frame
+	in_render,
+
+	/// \ref App::on_update runs with a fixed time step on its own thread and hands snapshots to \ref App::on_render_snapshot.
+	/// The next update runs while the current frame is rendered, and the update rate doesn't depend on the display rate.
+	pipelined
+};
+
 struct App
 {
 	Camera camera;
 
+	/// set in the constructor, changing it later has no effect
+	UpdateMode update_mode = UpdateMode::in_render;
+
+	/// the number of times per second \ref on_update is called in pipelined mode
+	float updates_per_second = 60.0f;
+
 	virtual void on_frame(Renderer*) = 0;
 	virtual void on_gui(Renderer*) = 0;
 	virtual void on_render(const glm::ivec2&, Renderer*, float) = 0;
 
+	/** Pipelined mode: advance the simulation a fixed time step, called on the update thread.
+	 * Must not use the renderer or the gl, and only change transforms and lights since geoms and materials are shared with the snapshots.
+	 * The camera and \ref on_gui are safe to use since they are locked out while this runs.
+	 */
+	virtual void on_update(float) {}
+
+	/// Pipelined mode: copy the state to render, usually with \ref copy_to_snapshot. The camera is already written.
+	virtual void on_write_snapshot(WorldSnapshot*) {}
+
+	/// Pipelined mode: render the latest snapshot, called on the gl thread instead of \ref on_render.
+	virtual void on_render_snapshot(const glm::ivec2&, Renderer*, const WorldSnapshot&, float) {}
+
 	virtual ~App() = default;
 };
 
@@ -0,0 +1,97 @@
+#include "klotter/mapped_file.h"
+
+#ifdef _WIN32
+	#define WIN32_LEAN_AND_MEAN
+	#define NOMINMAX
+	#include <windows.h>
+	#include "klotter/undef_windows.h"
+#else
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
+namespace klotter
+{
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(const std::filesystem::path& path)
+{
+	auto* file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		return;
+	}
+	file_handle = file;
+
+	LARGE_INTEGER file_size;
+	if (GetFileSizeEx(file, &file_size) == FALSE || file_size.QuadPart == 0)
+	{
+		return;
+	}
+
+	mapping_handle = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mapping_handle == nullptr)
+	{
+		return;
+	}
+
+	data = static_cast<const std::uint8_t*>(MapViewOfFile(mapping_handle, FILE_MAP_READ, 0, 0, 0));
+	size = data ? static_cast<std::size_t>(file_size.QuadPart) : 0;
+}
+
+MappedFile::~MappedFile()
+{
+	if (data)
+	{
+		UnmapViewOfFile(data);
+	}
+	if (mapping_handle)
+	{
+		CloseHandle(mapping_handle);
+	}
+	if (file_handle)
+	{
+		CloseHandle(file_handle);
+	}
+}
+
+#else
+
+MappedFile::MappedFile(const std::filesystem::path& path)
+{
+	const auto fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+	{
+		return;
+	}
+
+	struct stat file_stat;
+	if (fstat(fd, &file_stat) == 0 && file_stat.st_size > 0)
+	{
+		const auto file_size = static_cast<std::size_t>(file_stat.st_size);
+		auto* mapped = mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (mapped != MAP_FAILED)
+		{
+			data = static_cast<const std::uint8_t*>(mapped);
+			size = file_size;
+		}
+	}
+
+	// the mapping keeps the file alive
+	close(fd);
+}
+
+MappedFile::~MappedFile()
+{
+	if (data)
+	{
+		munmap(const_cast<std::uint8_t*>(data), size);
+	}
+}
+
+#endif
+
+}  //  namespace klotter
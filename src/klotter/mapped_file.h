@@ -0,0 +1,29 @@
+#pragma once
+
+#include <filesystem>
+
+namespace klotter
+{
+
+/// A read only file mapped into memory.
+struct MappedFile
+{
+	/// null if the file couldn't be mapped
+	const std::uint8_t* data = nullptr;
+	std::size_t size = 0;
+
+	explicit MappedFile(const std::filesystem::path& path);
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile(MappedFile&&) = delete;
+	void operator=(const MappedFile&) = delete;
+	void operator=(MappedFile&&) = delete;
+
+   private:
+
+	void* file_handle = nullptr;
+	void* mapping_handle = nullptr;
+};
+
+}  //  namespace klotter
@@ -0,0 +1,324 @@
+#include "klotter/profiler.h"
+
+#include "klotter/im_colors.h"
+#include "klotter/log.h"
+
+#include "imgui.h"
+
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+
+namespace klotter
+{
+
+namespace
+{
+	void append_json_string(std::string* json, std::string_view str)
+	{
+		json->push_back('"');
+		for (const char c: str)
+		{
+			switch (c)
+			{
+			case '"': *json += "\\\""; break;
+			case '\\': *json += "\\\\"; break;
+			default:
+				// control characters are not allowed in json strings and are useless in a zone name
+				json->push_back(static_cast<unsigned char>(c) < 0x20 ? ' ' : c);
+				break;
+			}
+		}
+		json->push_back('"');
+	}
+
+	/// the trace format uses microseconds, keep the nanoseconds as decimals
+	std::string microseconds_from_nanoseconds(u64 ns)
+	{
+		const auto decimals = std::to_string(ns % 1000);
+		return std::to_string(ns / 1000) + "." + std::string(3 - decimals.size(), '0') + decimals;
+	}
+}  //  namespace
+
+std::string chrome_trace_from_zones(const std::vector<ProfileThreadZones>& threads)
+{
+	std::string json = "{\"traceEvents\":[";
+	bool is_first = true;
+	const auto begin_event = [&]()
+	{
+		if (is_first == false)
+		{
+			json += ",";
+		}
+		is_first = false;
+		json += "\n";
+	};
+
+	for (std::size_t thread_index = 0; thread_index < threads.size(); thread_index += 1)
+	{
+		const auto& thread = threads[thread_index];
+		const auto tid = std::to_string(thread_index + 1);
+
+		// a metadata event names the thread
+		begin_event();
+		json += R"({"ph":"M","pid":1,"tid":)" + tid + R"(,"name":"thread_name","args":{"name":)";
+		append_json_string(&json, thread.name);
+		json += "}}";
+
+		// zones are complete events, the viewer nests them by time
+		for (const auto& zone: thread.zones)
+		{
+			begin_event();
+			json += R"({"ph":"X","pid":1,"tid":)" + tid + R"(,"name":)";
+			append_json_string(&json, zone.name);
+			json += ",\"ts\":" + microseconds_from_nanoseconds(zone.begin);
+			json += ",\"dur\":" + microseconds_from_nanoseconds(zone.end - zone.begin) + "}";
+		}
+	}
+
+	json += "\n]}\n";
+	return json;
+}
+
+#if FF_HAS(ENABLE_CPU_PROFILER)
+
+namespace
+{
+	struct Profiler
+	{
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+		/// guards the list of threads, their names and the frame marks but not the zones
+		std::mutex mutex;
+		std::vector<std::unique_ptr<ProfileThread>> threads;
+
+		u64 frame_begin = 0;
+		u64 last_frame_begin = 0;
+		u64 last_frame_end = 0;
+	};
+
+	Profiler& get_profiler()
+	{
+		// never destroyed, threads might record zones while the statics are destroyed
+		static auto* profiler = new Profiler();
+		return *profiler;
+	}
+
+	thread_local ProfileThread* current_thread = nullptr;
+
+	ProfileThread* get_current_thread()
+	{
+		if (current_thread == nullptr)
+		{
+			auto& profiler = get_profiler();
+			std::scoped_lock lock{profiler.mutex};
+
+			auto thread = std::make_unique<ProfileThread>();
+			thread->name = "Thread " + std::to_string(profiler.threads.size() + 1);
+			current_thread = profiler.threads.emplace_back(std::move(thread)).get();
+		}
+		return current_thread;
+	}
+
+	void set_zone_name(ProfileZone* zone, std::string_view name)
+	{
+		const auto size = std::min(name.size(), sizeof(zone->name) - 1);
+		std::memcpy(zone->name, name.data(), size);
+		zone->name[size] = 0;
+	}
+
+	ImU32 color_from_name(const char* name)
+	{
+		constexpr std::array<const std::array<ImU32, 10>*, 6> palettes
+			= {&imgui::blue, &imgui::teal, &imgui::green, &imgui::yellow, &imgui::orange, &imgui::violet};
+		const auto hash = std::hash<std::string_view>{}(name);
+		return (*palettes[hash % palettes.size()])[4 + (hash / palettes.size()) % 3];
+	}
+}  //  namespace
+
+ScopedProfileZone::ScopedProfileZone(const std::string& name)
+	: ScopedProfileZone(std::string_view{name})
+{
+}
+
+ScopedProfileZone::ScopedProfileZone(std::string_view name)
+{
+	auto* thread = get_current_thread();
+	zone.depth = thread->depth;
+	thread->depth += 1;
+	set_zone_name(&zone, name);
+	zone.begin = get_profiler_time();
+}
+
+ScopedProfileZone::~ScopedProfileZone()
+{
+	zone.end = get_profiler_time();
+
+	auto* thread = current_thread;
+	thread->depth -= 1;
+
+	// only this thread writes, publish the zone after it has been written
+	const auto index = thread->written.load(std::memory_order_relaxed);
+	thread->zones[index % PROFILE_ZONES_PER_THREAD] = zone;
+	thread->written.store(index + 1, std::memory_order_release);
+}
+
+u64 get_profiler_time()
+{
+	const auto since_start = std::chrono::steady_clock::now() - get_profiler().start;
+	return static_cast<u64>(std::chrono::duration_cast<std::chrono::nanoseconds>(since_start).count());
+}
+
+void set_profiler_thread_name(std::string_view name)
+{
+	auto* thread = get_current_thread();
+	auto& profiler = get_profiler();
+	std::scoped_lock lock{profiler.mutex};
+	thread->name = name;
+}
+
+void mark_profiler_frame()
+{
+	const auto now = get_profiler_time();
+	auto& profiler = get_profiler();
+	std::scoped_lock lock{profiler.mutex};
+	profiler.last_frame_begin = profiler.frame_begin;
+	profiler.last_frame_end = now;
+	profiler.frame_begin = now;
+}
+
+std::vector<ProfileThreadZones> collect_profile_zones()
+{
+	auto& profiler = get_profiler();
+	std::scoped_lock lock{profiler.mutex};
+
+	std::vector<ProfileThreadZones> threads;
+	for (const auto& thread: profiler.threads)
+	{
+		auto& copy = threads.emplace_back(ProfileThreadZones{thread->name, {}});
+
+		// the slot after the newest zone is skipped since the owner might be writing to it
+		const auto end = thread->written.load(std::memory_order_acquire);
+		const auto begin = end + 1 > PROFILE_ZONES_PER_THREAD ? end + 1 - PROFILE_ZONES_PER_THREAD : 0;
+		copy.zones.reserve(end - begin);
+		for (auto index = begin; index < end; index += 1)
+		{
+			copy.zones.emplace_back(thread->zones[index % PROFILE_ZONES_PER_THREAD]);
+		}
+
+		// the owner might have written over the oldest zones while they were copied
+		const auto written_after = thread->written.load(std::memory_order_acquire);
+		const auto first_valid = written_after + 1 > PROFILE_ZONES_PER_THREAD ? written_after + 1 - PROFILE_ZONES_PER_THREAD : 0;
+		if (first_valid > begin)
+		{
+			const auto overwritten = std::min(first_valid - begin, end - begin);
+			copy.zones.erase(copy.zones.begin(), copy.zones.begin() + static_cast<std::ptrdiff_t>(overwritten));
+		}
+	}
+	return threads;
+}
+
+bool save_chrome_trace(const std::string& path)
+{
+	std::ofstream file{path};
+	if (file.good() == false)
+	{
+		LOG_ERROR("Failed to open %s for writing the trace", path.c_str());
+		return false;
+	}
+
+	file << chrome_trace_from_zones(collect_profile_zones());
+	LOG_INFO("Saved trace to %s", path.c_str());
+	return true;
+}
+
+void imgui_profiler(ProfilerGui* gui)
+{
+	ImGui::Checkbox("Pause", &gui->is_paused);
+	ImGui::SameLine();
+	if (ImGui::Button("Save trace"))
+	{
+		save_chrome_trace("trace.json");
+	}
+
+	if (gui->is_paused == false)
+	{
+		{
+			auto& profiler = get_profiler();
+			std::scoped_lock lock{profiler.mutex};
+			gui->frame_begin = profiler.last_frame_begin;
+			gui->frame_end = profiler.last_frame_end;
+		}
+
+		gui->threads = collect_profile_zones();
+		for (auto& thread: gui->threads)
+		{
+			std::erase_if(thread.zones, [gui](const ProfileZone& zone) { return zone.end <= gui->frame_begin || zone.begin >= gui->frame_end; });
+		}
+	}
+
+	if (gui->frame_end <= gui->frame_begin)
+	{
+		ImGui::TextUnformatted("No frame has been marked yet");
+		return;
+	}
+
+	const auto frame_length = gui->frame_end - gui->frame_begin;
+	ImGui::Text("Frame: %.2f ms", static_cast<double>(frame_length) / 1'000'000.0);
+
+	const auto row_height = ImGui::GetTextLineHeightWithSpacing();
+	for (const auto& thread: gui->threads)
+	{
+		if (thread.zones.empty())
+		{
+			continue;
+		}
+
+		ImGui::SeparatorText(thread.name.c_str());
+
+		const auto origin = ImGui::GetCursorScreenPos();
+		const auto width = ImGui::GetContentRegionAvail().x;
+		const auto x_from_time = [&](u64 time)
+		{
+			const auto clamped = std::clamp(time, gui->frame_begin, gui->frame_end);
+			return origin.x + width * static_cast<float>(clamped - gui->frame_begin) / static_cast<float>(frame_length);
+		};
+
+		auto* draw_list = ImGui::GetWindowDrawList();
+		i32 max_depth = 0;
+		for (const auto& zone: thread.zones)
+		{
+			max_depth = std::max(max_depth, zone.depth);
+
+			const auto y = origin.y + row_height * static_cast<float>(zone.depth);
+			const ImVec2 min{x_from_time(zone.begin), y};
+			const ImVec2 max{std::max(x_from_time(zone.end), min.x + 1.0f), y + row_height};
+			draw_list->AddRectFilled(min, max, color_from_name(zone.name));
+			draw_list->AddRect(min, max, imgui::gray[8]);
+
+			// only label the zones that fit the name
+			if (ImGui::CalcTextSize(zone.name).x < max.x - min.x)
+			{
+				draw_list->AddText(min, imgui::black, zone.name);
+			}
+
+			if (ImGui::IsMouseHoveringRect(min, max))
+			{
+				ImGui::SetTooltip("%s: %.3f ms", zone.name, static_cast<double>(zone.end - zone.begin) / 1'000'000.0);
+			}
+		}
+		ImGui::Dummy({width, row_height * static_cast<float>(max_depth + 1)});
+	}
+}
+
+#else
+
+void imgui_profiler(ProfilerGui*)
+{
+	ImGui::TextUnformatted("Compiled without ENABLE_CPU_PROFILER");
+}
+
+#endif
+
+}  //  namespace klotter
@@ -0,0 +1,127 @@
+#pragma once
+
+#include "klotter/cpp.h"
+#include "klotter/feature_flags.h"
+
+#include <atomic>
+
+namespace klotter
+{
+
+/** \addtogroup profiler CPU profiler
+ *  @{
+*/
+
+/// A finished zone, times are in nanoseconds since the profiler started.
+struct ProfileZone
+{
+	u64 begin = 0;
+	u64 end = 0;
+
+	/// the number of zones this is inside of
+	i32 depth = 0;
+
+	/// zero terminated, longer names are cut
+	char name[44] = {};
+};
+
+/// The zones recorded by a single thread, oldest first.
+struct ProfileThreadZones
+{
+	std::string name;
+	std::vector<ProfileZone> zones;
+};
+
+/// Converts the zones to the chrome trace event format, that can be opened in chrome://tracing or https://ui.perfetto.dev
+std::string chrome_trace_from_zones(const std::vector<ProfileThreadZones>& threads);
+
+/// The state of \ref imgui_profiler
+struct ProfilerGui
+{
+	bool is_paused = false;
+
+	/// the zones of the last frame that was shown
+	std::vector<ProfileThreadZones> threads;
+	u64 frame_begin = 0;
+	u64 frame_end = 0;
+};
+
+/// Shows the zones of the last frame as a flame graph, one per thread, and a button to save a chrome trace.
+void imgui_profiler(ProfilerGui* gui);
+
+#if FF_HAS(ENABLE_CPU_PROFILER)
+
+	/// the size of the ring buffer of each thread, older zones are overwritten
+	constexpr std::size_t PROFILE_ZONES_PER_THREAD = 16 * 1024;
+
+	/** The ring buffer of a single thread.
+	 * Only the owning thread writes, and it doesn't lock, readers copy the zones and skip the ones that were overwritten while copying.
+	 */
+	struct ProfileThread
+	{
+		std::string name;
+
+		/// the total number of zones written, the ring index is this modulo the size
+		std::atomic<u64> written = 0;
+
+		/// only used by the owning thread
+		i32 depth = 0;
+
+		std::array<ProfileZone, PROFILE_ZONES_PER_THREAD> zones;
+	};
+
+	/// Records a zone from construction to destruction on the current thread.
+	struct ScopedProfileZone
+	{
+		explicit ScopedProfileZone(const std::string& name);
+		explicit ScopedProfileZone(std::string_view name);
+		~ScopedProfileZone();
+
+		ScopedProfileZone(ScopedProfileZone&&) = delete;
+		ScopedProfileZone(const ScopedProfileZone&) = delete;
+		void operator=(ScopedProfileZone&&) = delete;
+		void operator=(const ScopedProfileZone&) = delete;
+
+		ProfileZone zone;
+	};
+
+	/// Nanoseconds since the profiler started.
+	u64 get_profiler_time();
+
+	/// Name the current thread in the exported traces and the gui.
+	void set_profiler_thread_name(std::string_view name);
+
+	/// Call at the start of each frame, the gui shows the zones between the last two marks.
+	void mark_profiler_frame();
+
+	/// Copy the zones that are still in the ring buffers of all threads.
+	std::vector<ProfileThreadZones> collect_profile_zones();
+
+	/// Write the zones of all threads as a chrome trace, returns false if the file couldn't be written.
+	bool save_chrome_trace(const std::string& path);
+
+	#define SCOPED_PROFILE_ZONE(TEXT) [[maybe_unused]] const ScopedProfileZone CONCAT(profile_zone, __LINE__){TEXT}
+
+#else
+
+	constexpr void set_profiler_thread_name(std::string_view)
+	{
+	}
+
+	constexpr void mark_profiler_frame()
+	{
+	}
+
+	constexpr void profiler_nop()
+	{
+	}
+
+	#define SCOPED_PROFILE_ZONE(TEXT) profiler_nop()
+
+#endif
+
+/**
+ * @}
+*/
+
+}  //  namespace klotter
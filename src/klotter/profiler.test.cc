@@ -0,0 +1,104 @@
+#include "klotter/profiler.h"
+
+#include "catch2/catch_test_macros.hpp"
+
+#include <cstdio>
+#include <thread>
+
+using namespace klotter;
+
+namespace
+{
+	ProfileZone make_zone(const char* name, u64 begin, u64 end, i32 depth)
+	{
+		ProfileZone zone;
+		zone.begin = begin;
+		zone.end = end;
+		zone.depth = depth;
+		std::snprintf(zone.name, sizeof(zone.name), "%s", name);
+		return zone;
+	}
+}  //  namespace
+
+TEST_CASE("profiler_chrome_trace", "[profiler]")
+{
+	const std::vector<ProfileThreadZones> threads = {
+		{"Main", {make_zone("inner", 1500, 2250, 1), make_zone("outer", 1000, 3000, 0)}},
+		{"Worker \"1\"", {}}
+	};
+
+	const auto json = chrome_trace_from_zones(threads);
+	CHECK(json == R"({"traceEvents":[
+{"ph":"M","pid":1,"tid":1,"name":"thread_name","args":{"name":"Main"}},
+{"ph":"X","pid":1,"tid":1,"name":"inner","ts":1.500,"dur":0.750},
+{"ph":"X","pid":1,"tid":1,"name":"outer","ts":1.000,"dur":2.000},
+{"ph":"M","pid":1,"tid":2,"name":"thread_name","args":{"name":"Worker \"1\""}}
+]}
+)");
+}
+
+#if FF_HAS(ENABLE_CPU_PROFILER)
+
+namespace
+{
+	/// the zones of this thread, found by the thread name
+	std::vector<ProfileZone> zones_from_thread(const std::string& name)
+	{
+		for (const auto& thread: collect_profile_zones())
+		{
+			if (thread.name == name)
+			{
+				return thread.zones;
+			}
+		}
+		return {};
+	}
+}  //  namespace
+
+TEST_CASE("profiler_nested_zones", "[profiler]")
+{
+	std::thread thread{[]()
+		{
+			set_profiler_thread_name("profiler_nested_zones");
+			SCOPED_PROFILE_ZONE("outer"sv);
+			{
+				SCOPED_PROFILE_ZONE(std::string{"a name that is longer than a zone can store, so it is cut"});
+			}
+		}
+	};
+	thread.join();
+
+	const auto zones = zones_from_thread("profiler_nested_zones");
+	REQUIRE(zones.size() == 2);
+
+	// zones are stored when they end, so the inner zone is first
+	CHECK(std::string_view{zones[0].name} == "a name that is longer than a zone can store");
+	CHECK(zones[0].depth == 1);
+	CHECK(std::string_view{zones[1].name} == "outer");
+	CHECK(zones[1].depth == 0);
+	CHECK(zones[1].begin <= zones[0].begin);
+	CHECK(zones[0].end <= zones[1].end);
+}
+
+TEST_CASE("profiler_ring_buffer_keeps_the_newest_zones", "[profiler]")
+{
+	constexpr std::size_t extra = 10;
+	std::thread thread{[]()
+		{
+			set_profiler_thread_name("profiler_ring_buffer");
+			for (std::size_t index = 0; index < PROFILE_ZONES_PER_THREAD + extra; index += 1)
+			{
+				SCOPED_PROFILE_ZONE(std::to_string(index));
+			}
+		}
+	};
+	thread.join();
+
+	const auto zones = zones_from_thread("profiler_ring_buffer");
+	// the slot the owner writes next is never read
+	REQUIRE(zones.size() == PROFILE_ZONES_PER_THREAD - 1);
+	CHECK(std::string_view{zones.front().name} == std::to_string(extra + 1));
+	CHECK(std::string_view{zones.back().name} == std::to_string(PROFILE_ZONES_PER_THREAD + extra - 1));
+}
+
+#endif
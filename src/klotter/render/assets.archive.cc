@@ -0,0 +1,515 @@
+#include "klotter/render/assets.archive.h"
+
+#include "klotter/assert.h"
+#include "klotter/cint.h"
+#include "klotter/hash.h"
+#include "klotter/log.h"
+
+#include <cstring>
+
+namespace klotter
+{
+
+namespace
+{
+	/// the smallest match, shorter matches are stored as literals
+	constexpr std::size_t min_match = 4;
+
+	/// the last bytes of a block are always literals
+	constexpr std::size_t last_literals = 5;
+
+	/// a match can't start in the last bytes of a block
+	constexpr std::size_t match_search_limit = 12;
+
+	constexpr std::size_t max_offset = 0xFFFF;
+
+	/// the lengths in the token are 4 bits, larger lengths continue in extra bytes
+	constexpr std::size_t token_length_limit = 15;
+
+	constexpr int hash_bits = 12;
+
+	constexpr std::array<char, 4> archive_magic = {'K', 'L', 'A', 'R'};
+	constexpr std::uint32_t archive_version = 1;
+
+	/// file data is aligned so it can be read directly from the mapped archive
+	constexpr std::size_t data_alignment = 16;
+
+	constexpr std::size_t prefetch_page_size = 4096;
+
+	enum class StoredCompression : std::uint32_t
+	{
+		none = 0,
+		lz = 1
+	};
+
+	struct ArchiveHeader
+	{
+		std::array<char, 4> magic;
+		std::uint32_t version;
+		std::uint32_t entry_count;
+		std::uint32_t padding;
+	};
+
+	std::uint32_t read_u32(std::span<const std::uint8_t> src, std::size_t pos)
+	{
+		std::uint32_t value;
+		std::memcpy(&value, &src[pos], sizeof(value));
+		return value;
+	}
+
+	std::size_t hash_from_bytes(std::span<const std::uint8_t> src, std::size_t pos)
+	{
+		// knuth's multiplicative hash of the next 4 bytes
+		return (read_u32(src, pos) * 2654435761u) >> (32 - hash_bits);
+	}
+
+	void write_length(std::vector<std::uint8_t>* dst, std::size_t length)
+	{
+		length -= token_length_limit;
+		while (length >= 0xFF)
+		{
+			dst->emplace_back(std::uint8_t{0xFF});
+			length -= 0xFF;
+		}
+		dst->emplace_back(static_cast<std::uint8_t>(length));
+	}
+
+	/// writes the literals from the anchor to the position and a optional match
+	void write_sequence(
+		std::vector<std::uint8_t>* dst, std::span<const std::uint8_t> src, std::size_t anchor, std::size_t pos, std::size_t offset, std::size_t match_length
+	)
+	{
+		const auto literal_count = pos - anchor;
+		const auto has_match = match_length > 0;
+		const auto match_code = has_match ? match_length - min_match : 0;
+
+		dst->emplace_back(static_cast<std::uint8_t>(
+			(std::min(literal_count, token_length_limit) << 4) | std::min(match_code, token_length_limit)
+		));
+		if (literal_count >= token_length_limit)
+		{
+			write_length(dst, literal_count);
+		}
+		dst->insert(dst->end(), src.begin() + static_cast<std::ptrdiff_t>(anchor), src.begin() + static_cast<std::ptrdiff_t>(pos));
+
+		if (has_match == false)
+		{
+			return;
+		}
+
+		dst->emplace_back(static_cast<std::uint8_t>(offset & 0xFF));
+		dst->emplace_back(static_cast<std::uint8_t>(offset >> 8));
+		if (match_code >= token_length_limit)
+		{
+			write_length(dst, match_code);
+		}
+	}
+
+	/// reads the extra bytes of a length that didn't fit in the token
+	bool read_length(std::span<const std::uint8_t> src, std::size_t* pos, std::size_t* length)
+	{
+		std::uint8_t byte = 0;
+		do
+		{
+			if (*pos >= src.size())
+			{
+				return false;
+			}
+			byte = src[*pos];
+			*pos += 1;
+			*length += byte;
+		} while (byte == 0xFF);
+		return true;
+	}
+
+	std::size_t align_up(std::size_t value, std::size_t alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+
+	template<typename T>
+	void append_pod(std::vector<std::uint8_t>* dst, const T& value)
+	{
+		const auto* bytes = reinterpret_cast<const std::uint8_t*>(&value);
+		dst->insert(dst->end(), bytes, bytes + sizeof(T));
+	}
+}  //  namespace
+
+std::vector<std::uint8_t> compress_lz_block(std::span<const std::uint8_t> src)
+{
+	std::vector<std::uint8_t> dst;
+	dst.reserve(src.size() + src.size() / 0xFF + 16);
+
+	// the last position + 1 that had the hash, 0 means no position
+	std::vector<std::size_t> table(std::size_t{1} << hash_bits, 0);
+
+	std::size_t anchor = 0;
+	std::size_t pos = 0;
+	if (src.size() > match_search_limit)
+	{
+		const auto search_end = src.size() - match_search_limit;
+		const auto match_end = src.size() - last_literals;
+		while (pos < search_end)
+		{
+			const auto hash = hash_from_bytes(src, pos);
+			const auto candidate = table[hash];
+			table[hash] = pos + 1;
+
+			if (candidate == 0 || pos - (candidate - 1) > max_offset || read_u32(src, candidate - 1) != read_u32(src, pos))
+			{
+				pos += 1;
+				continue;
+			}
+
+			const auto match = candidate - 1;
+			auto length = min_match;
+			while (pos + length < match_end && src[match + length] == src[pos + length])
+			{
+				length += 1;
+			}
+
+			write_sequence(&dst, src, anchor, pos, pos - match, length);
+			pos += length;
+			anchor = pos;
+		}
+	}
+
+	write_sequence(&dst, src, anchor, src.size(), 0, 0);
+	return dst;
+}
+
+bool decompress_lz_block(std::span<const std::uint8_t> src, std::span<std::uint8_t> dst)
+{
+	std::size_t in = 0;
+	std::size_t out = 0;
+	while (in < src.size())
+	{
+		const auto token = src[in];
+		in += 1;
+
+		std::size_t literal_count = token >> 4;
+		if (literal_count == token_length_limit && read_length(src, &in, &literal_count) == false)
+		{
+			return false;
+		}
+		if (literal_count > src.size() - in || literal_count > dst.size() - out)
+		{
+			return false;
+		}
+		std::memcpy(dst.data() + out, src.data() + in, literal_count);
+		in += literal_count;
+		out += literal_count;
+
+		// the last sequence only has literals
+		if (in == src.size())
+		{
+			break;
+		}
+
+		if (src.size() - in < 2)
+		{
+			return false;
+		}
+		const auto offset = std::size_t{src[in]} | (std::size_t{src[in + 1]} << 8);
+		in += 2;
+		if (offset == 0 || offset > out)
+		{
+			return false;
+		}
+
+		std::size_t match_length = token & 0x0F;
+		if (match_length == token_length_limit && read_length(src, &in, &match_length) == false)
+		{
+			return false;
+		}
+		match_length += min_match;
+		if (match_length > dst.size() - out)
+		{
+			return false;
+		}
+
+		// the match may overlap the output so copy byte by byte
+		for (std::size_t index = 0; index < match_length; index += 1)
+		{
+			dst[out + index] = dst[out - offset + index];
+		}
+		out += match_length;
+	}
+
+	return out == dst.size();
+}
+
+// ------------------------------------------------------------------------------------------------
+// building
+
+ArchiveNameHash hash_from_archive_name(std::string_view name)
+{
+	return hash_fnv1a(fnv1a_offset_basis, name.data(), name.size());
+}
+
+std::optional<std::vector<std::uint8_t>> build_asset_archive(const std::vector<ArchiveSource>& sources, ArchiveCompression compression)
+{
+	struct Stored
+	{
+		ArchiveNameHash hash;
+		const ArchiveSource* source;
+		std::vector<std::uint8_t> compressed;
+	};
+
+	std::vector<Stored> stored;
+	for (const auto& source: sources)
+	{
+		Stored s{hash_from_archive_name(source.name), &source, {}};
+		if (compression == ArchiveCompression::lz)
+		{
+			auto compressed = compress_lz_block(source.data);
+			if (compressed.size() < source.data.size())
+			{
+				s.compressed = std::move(compressed);
+			}
+		}
+		stored.emplace_back(std::move(s));
+	}
+
+	std::sort(stored.begin(), stored.end(), [](const Stored& lhs, const Stored& rhs) { return lhs.hash < rhs.hash; });
+	for (std::size_t index = 1; index < stored.size(); index += 1)
+	{
+		if (stored[index - 1].hash == stored[index].hash)
+		{
+			LOG_ERROR("Archive names %s and %s have the same hash", stored[index - 1].source->name.c_str(), stored[index].source->name.c_str());
+			return std::nullopt;
+		}
+	}
+
+	std::vector<std::uint8_t> archive;
+	append_pod(&archive, ArchiveHeader{archive_magic, archive_version, u32_from_sizet(stored.size()), 0});
+
+	// the index is written first so the data offsets are known
+	const auto index_start = archive.size();
+	auto offset = align_up(index_start + stored.size() * sizeof(ArchiveIndexEntry), data_alignment);
+	for (const auto& s: stored)
+	{
+		const auto is_compressed = s.compressed.empty() == false;
+		const auto stored_size = is_compressed ? s.compressed.size() : s.source->data.size();
+		append_pod(
+			&archive,
+			ArchiveIndexEntry{
+				s.hash,
+				offset,
+				stored_size,
+				s.source->data.size(),
+				static_cast<std::uint32_t>(is_compressed ? StoredCompression::lz : StoredCompression::none),
+				0
+			}
+		);
+		offset = align_up(offset + stored_size, data_alignment);
+	}
+
+	for (const auto& s: stored)
+	{
+		archive.resize(align_up(archive.size(), data_alignment), 0);
+		const auto& data = s.compressed.empty() ? s.source->data : s.compressed;
+		archive.insert(archive.end(), data.begin(), data.end());
+	}
+
+	return archive;
+}
+
+// ------------------------------------------------------------------------------------------------
+// reading
+
+std::span<const std::uint8_t> ArchiveFile::bytes() const
+{
+	if (decompressed.empty() == false)
+	{
+		return decompressed;
+	}
+	return mapped;
+}
+
+embedded_binary ArchiveFile::as_binary() const
+{
+	const auto b = bytes();
+	return {reinterpret_cast<const char*>(b.data()), static_cast<unsigned int>(b.size())};
+}
+
+AssetArchive::AssetArchive(const std::filesystem::path& path)
+	: file(path)
+{
+	if (file.data == nullptr || file.size < sizeof(ArchiveHeader))
+	{
+		return;
+	}
+
+	ArchiveHeader header;
+	std::memcpy(&header, file.data, sizeof(header));
+	if (header.magic != archive_magic || header.version != archive_version)
+	{
+		LOG_ERROR("%s isn't a asset archive or from a other version", path.string().c_str());
+		return;
+	}
+
+	const auto index_size = std::size_t{header.entry_count} * sizeof(ArchiveIndexEntry);
+	if (file.size - sizeof(ArchiveHeader) < index_size)
+	{
+		LOG_ERROR("%s has a broken index", path.string().c_str());
+		return;
+	}
+
+	std::vector<ArchiveIndexEntry> entries(header.entry_count);
+	std::memcpy(entries.data(), file.data + sizeof(ArchiveHeader), index_size);
+	for (const auto& entry: entries)
+	{
+		if (entry.offset > file.size || entry.stored_size > file.size - entry.offset)
+		{
+			LOG_ERROR("%s has a file outside of the archive", path.string().c_str());
+			return;
+		}
+	}
+
+	index = std::move(entries);
+	is_loaded = true;
+}
+
+AssetArchive::~AssetArchive()
+{
+	{
+		std::scoped_lock lock{prefetch_mutex};
+		stop_prefetch = true;
+	}
+	prefetch_condition.notify_all();
+	if (prefetch_thread.joinable())
+	{
+		prefetch_thread.join();
+	}
+}
+
+bool AssetArchive::is_valid() const
+{
+	return is_loaded;
+}
+
+std::size_t AssetArchive::get_file_count() const
+{
+	return index.size();
+}
+
+std::size_t AssetArchive::get_mapped_size() const
+{
+	return file.size;
+}
+
+const ArchiveIndexEntry* AssetArchive::find(std::string_view name) const
+{
+	const auto hash = hash_from_archive_name(name);
+	const auto found = std::lower_bound(
+		index.begin(), index.end(), hash, [](const ArchiveIndexEntry& entry, ArchiveNameHash h) { return entry.name_hash < h; }
+	);
+	if (found == index.end() || found->name_hash != hash)
+	{
+		return nullptr;
+	}
+	return &*found;
+}
+
+bool AssetArchive::contains(std::string_view name) const
+{
+	return find(name) != nullptr;
+}
+
+std::optional<ArchiveFile> AssetArchive::read(std::string_view name) const
+{
+	const auto* entry = find(name);
+	if (entry == nullptr)
+	{
+		return std::nullopt;
+	}
+
+	const auto stored = std::span<const std::uint8_t>{file.data + entry->offset, entry->stored_size};
+	switch (static_cast<StoredCompression>(entry->compression))
+	{
+	case StoredCompression::none: return ArchiveFile{stored, {}};
+	case StoredCompression::lz:
+		{
+			ArchiveFile result{{}, std::vector<std::uint8_t>(entry->size)};
+			if (decompress_lz_block(stored, result.decompressed) == false)
+			{
+				LOG_ERROR("Failed to decompress %s from the archive", std::string{name}.c_str());
+				return std::nullopt;
+			}
+			return result;
+		}
+	default:
+		LOG_ERROR("Unknown compression of %s in the archive", std::string{name}.c_str());
+		return std::nullopt;
+	}
+}
+
+void AssetArchive::prefetch(std::string_view name)
+{
+	if (const auto* entry = find(name); entry != nullptr)
+	{
+		add_prefetch(*entry);
+	}
+}
+
+void AssetArchive::prefetch_all()
+{
+	for (const auto& entry: index)
+	{
+		add_prefetch(entry);
+	}
+}
+
+void AssetArchive::add_prefetch(const ArchiveIndexEntry& entry)
+{
+	{
+		std::scoped_lock lock{prefetch_mutex};
+		prefetch_queue.emplace_back(PrefetchRange{entry.offset, entry.stored_size});
+
+		// the thread is only started when needed since most archives are never prefetched
+		if (prefetch_thread.joinable() == false)
+		{
+			prefetch_thread = std::thread{[this]() { run_prefetch(); }};
+		}
+	}
+	prefetch_condition.notify_all();
+}
+
+void AssetArchive::wait_for_prefetch()
+{
+	std::unique_lock lock{prefetch_mutex};
+	prefetch_condition.wait(lock, [this]() { return prefetch_queue.empty() && is_prefetching == false; });
+}
+
+void AssetArchive::run_prefetch()
+{
+	std::unique_lock lock{prefetch_mutex};
+	while (true)
+	{
+		prefetch_condition.wait(lock, [this]() { return stop_prefetch || prefetch_queue.empty() == false; });
+		if (stop_prefetch)
+		{
+			return;
+		}
+
+		const auto range = prefetch_queue.front();
+		prefetch_queue.pop_front();
+		is_prefetching = true;
+		lock.unlock();
+
+		// touching a byte on each page makes the os read it from disk
+		std::uint8_t sum = 0;
+		for (std::uint64_t page = 0; page < range.size; page += prefetch_page_size)
+		{
+			sum ^= file.data[range.offset + page];
+		}
+		[[maybe_unused]] volatile std::uint8_t sink = sum;
+
+		lock.lock();
+		is_prefetching = false;
+		prefetch_condition.notify_all();
+	}
+}
+
+}  //  namespace klotter
@@ -0,0 +1,133 @@
+#pragma once
+
+#include "klotter/mapped_file.h"
+
+#include "embed/types.h"
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <span>
+#include <thread>
+
+namespace klotter
+{
+
+/// Compresses bytes to a single block in the lz4 block format, a fast byte oriented lz77 variant.
+std::vector<std::uint8_t> compress_lz_block(std::span<const std::uint8_t> src);
+
+/// Decompresses a block created by \ref compress_lz_block
+/// @param dst must be the size of the uncompressed data
+/// @return false if the block is broken or doesn't decompress to exactly the size of dst
+[[nodiscard]] bool decompress_lz_block(std::span<const std::uint8_t> src, std::span<std::uint8_t> dst);
+
+enum class ArchiveCompression
+{
+	/// store all files as is
+	none,
+
+	/// compress files that get smaller, already compressed files like png and jpg are stored as is
+	lz
+};
+
+/// A file to add to a archive.
+struct ArchiveSource
+{
+	/// the name used to find the file, usually the relative path like `textures/grass.png`
+	std::string name;
+	std::vector<std::uint8_t> data;
+};
+
+/// The hash of a name in a archive.
+using ArchiveNameHash = std::uint64_t;
+
+ArchiveNameHash hash_from_archive_name(std::string_view name);
+
+/// "internal" a file in the index of a archive, the layout matches the archive.
+struct ArchiveIndexEntry
+{
+	ArchiveNameHash name_hash;
+	std::uint64_t offset;
+
+	/// the size in the archive, smaller than the size if compressed
+	std::uint64_t stored_size;
+	std::uint64_t size;
+	std::uint32_t compression;
+	std::uint32_t padding;
+};
+
+/// Packs the files to a archive, with a index sorted on the hash of the name.
+/// @return the archive or nullopt if two names have the same hash
+std::optional<std::vector<std::uint8_t>> build_asset_archive(const std::vector<ArchiveSource>& sources, ArchiveCompression compression);
+
+/// A file read from a \ref AssetArchive
+struct ArchiveFile
+{
+	/// the bytes in the mapped archive, empty if the file was compressed
+	std::span<const std::uint8_t> mapped;
+
+	std::vector<std::uint8_t> decompressed;
+
+	[[nodiscard]] std::span<const std::uint8_t> bytes() const;
+
+	/// a view that can be passed to the image loaders, only valid while the file and the archive are
+	[[nodiscard]] embedded_binary as_binary() const;
+};
+
+/// A archive that is mapped into memory, files are only paged in when they are read or prefetched.
+struct AssetArchive
+{
+	explicit AssetArchive(const std::filesystem::path& path);
+	~AssetArchive();
+
+	AssetArchive(const AssetArchive&) = delete;
+	AssetArchive(AssetArchive&&) = delete;
+	void operator=(const AssetArchive&) = delete;
+	void operator=(AssetArchive&&) = delete;
+
+	/// false if the file is missing, broken or from a other version
+	[[nodiscard]] bool is_valid() const;
+
+	[[nodiscard]] std::size_t get_file_count() const;
+
+	/// The size of the mapped file, the pages that have been read or prefetched stay resident.
+	[[nodiscard]] std::size_t get_mapped_size() const;
+
+	[[nodiscard]] bool contains(std::string_view name) const;
+
+	/// Uncompressed files point directly into the mapped archive, compressed files are decompressed on each read.
+	[[nodiscard]] std::optional<ArchiveFile> read(std::string_view name) const;
+
+	/// Reads the file on a background thread so it's paged in when it's needed.
+	void prefetch(std::string_view name);
+
+	void prefetch_all();
+
+	/// Blocks until all requested prefetches are done.
+	void wait_for_prefetch();
+
+   private:
+
+	struct PrefetchRange
+	{
+		std::uint64_t offset;
+		std::uint64_t size;
+	};
+
+	[[nodiscard]] const ArchiveIndexEntry* find(std::string_view name) const;
+	void add_prefetch(const ArchiveIndexEntry& entry);
+	void run_prefetch();
+
+	MappedFile file;
+	std::vector<ArchiveIndexEntry> index;
+	bool is_loaded = false;
+
+	std::mutex prefetch_mutex;
+	std::condition_variable prefetch_condition;
+	std::deque<PrefetchRange> prefetch_queue;
+	bool is_prefetching = false;
+	bool stop_prefetch = false;
+	std::thread prefetch_thread;
+};
+
+}  //  namespace klotter
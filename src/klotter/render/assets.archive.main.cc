@@ -0,0 +1,95 @@
+// offline tool that packs files into a asset archive
+
+#include "klotter/render/assets.archive.h"
+
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+
+using namespace klotter;
+
+namespace
+{
+
+void print_usage()
+{
+	std::cerr << "usage: tool_pack_assets <output archive> <root folder> [options] <files...>\n"
+			  << "  the files are relative to the root and are found in the archive by that relative path\n"
+			  << "  --no-compression  store all files as is\n";
+}
+
+std::optional<std::vector<std::uint8_t>> read_file(const std::filesystem::path& path)
+{
+	std::ifstream file{path, std::ios::binary};
+	if (file.good() == false)
+	{
+		return std::nullopt;
+	}
+	return std::vector<std::uint8_t>{std::istreambuf_iterator<char>{file}, std::istreambuf_iterator<char>{}};
+}
+
+}  //  namespace
+
+int main(int argc, char** argv)
+{
+	if (argc < 3)
+	{
+		print_usage();
+		return -1;
+	}
+
+	const std::string output = argv[1];
+	const std::filesystem::path root = argv[2];
+
+	auto compression = ArchiveCompression::lz;
+	std::vector<ArchiveSource> sources;
+
+	for (int index = 3; index < argc; index += 1)
+	{
+		const std::string arg = argv[index];
+		if (arg == "--no-compression")
+		{
+			compression = ArchiveCompression::none;
+		}
+		else if (arg.starts_with("--"))
+		{
+			std::cerr << "Unknown argument " << arg << "\n";
+			print_usage();
+			return -1;
+		}
+		else
+		{
+			auto data = read_file(root / arg);
+			if (data.has_value() == false)
+			{
+				std::cerr << "Failed to read " << (root / arg).string() << "\n";
+				return -1;
+			}
+			sources.emplace_back(ArchiveSource{arg, std::move(*data)});
+		}
+	}
+
+	const auto archive = build_asset_archive(sources, compression);
+	if (archive.has_value() == false)
+	{
+		std::cerr << "Failed to build " << output << "\n";
+		return -1;
+	}
+
+	std::ofstream file{output, std::ios::binary};
+	if (file.good() == false)
+	{
+		std::cerr << "Failed to open " << output << "\n";
+		return -1;
+	}
+	file.write(reinterpret_cast<const char*>(archive->data()), static_cast<std::streamsize>(archive->size()));
+
+	std::size_t source_size = 0;
+	for (const auto& source: sources)
+	{
+		source_size += source.data.size();
+	}
+	std::cout << "Wrote " << output << ": " << sources.size() << " files, " << source_size << " bytes packed to " << archive->size() << " bytes\n";
+	return 0;
+}
@@ -0,0 +1,175 @@
+#include "klotter/render/assets.archive.h"
+
+#include "catch2/catch_test_macros.hpp"
+
+#include <fstream>
+
+using namespace klotter;
+
+namespace
+{
+	std::vector<std::uint8_t> bytes_from_string(std::string_view str)
+	{
+		return {str.begin(), str.end()};
+	}
+
+	/// bytes that don't repeat and can't be compressed
+	std::vector<std::uint8_t> make_noise(std::size_t size)
+	{
+		std::vector<std::uint8_t> noise(size);
+		std::uint32_t state = 0x1234'5678;
+		for (auto& b: noise)
+		{
+			state = state * 1664525u + 1013904223u;
+			b = static_cast<std::uint8_t>(state >> 24);
+		}
+		return noise;
+	}
+
+	std::vector<std::uint8_t> roundtrip(const std::vector<std::uint8_t>& src)
+	{
+		const auto compressed = compress_lz_block(src);
+		std::vector<std::uint8_t> dst(src.size());
+		REQUIRE(decompress_lz_block(compressed, dst));
+		return dst;
+	}
+
+	std::filesystem::path write_archive(const std::string& name, const std::vector<std::uint8_t>& archive)
+	{
+		const auto dir = std::filesystem::temp_directory_path() / "klotter-archive-test";
+		std::filesystem::create_directories(dir);
+		const auto path = dir / name;
+		std::ofstream file{path, std::ios::binary | std::ios::trunc};
+		file.write(reinterpret_cast<const char*>(archive.data()), static_cast<std::streamsize>(archive.size()));
+		return path;
+	}
+}  //  namespace
+
+TEST_CASE("lz_block_roundtrip", "[assets]")
+{
+	SECTION("empty")
+	{
+		CHECK(roundtrip({}).empty());
+	}
+
+	SECTION("short")
+	{
+		const auto src = bytes_from_string("abc");
+		CHECK(roundtrip(src) == src);
+	}
+
+	SECTION("repeating")
+	{
+		std::vector<std::uint8_t> src;
+		for (int index = 0; index < 1000; index += 1)
+		{
+			const auto line = bytes_from_string("uniform vec3 light_color;\n");
+			src.insert(src.end(), line.begin(), line.end());
+		}
+		CHECK(compress_lz_block(src).size() < src.size() / 10);
+		CHECK(roundtrip(src) == src);
+	}
+
+	SECTION("long run")
+	{
+		const auto src = std::vector<std::uint8_t>(100'000, 0x42);
+		CHECK(roundtrip(src) == src);
+	}
+
+	SECTION("noise")
+	{
+		const auto src = make_noise(5000);
+		CHECK(roundtrip(src) == src);
+	}
+}
+
+TEST_CASE("lz_block_rejects_broken_data", "[assets]")
+{
+	const auto src = std::vector<std::uint8_t>(1000, 0x42);
+	const auto compressed = compress_lz_block(src);
+
+	std::vector<std::uint8_t> dst(src.size());
+
+	SECTION("truncated")
+	{
+		const auto truncated = std::vector<std::uint8_t>(compressed.begin(), compressed.end() - 3);
+		CHECK(decompress_lz_block(truncated, dst) == false);
+	}
+
+	SECTION("wrong size")
+	{
+		std::vector<std::uint8_t> small(src.size() - 1);
+		CHECK(decompress_lz_block(compressed, small) == false);
+	}
+
+	SECTION("offset before the start")
+	{
+		// a literal followed by a match 2 bytes back
+		const auto broken = std::vector<std::uint8_t>{0x10, 'a', 0x02, 0x00};
+		CHECK(decompress_lz_block(broken, dst) == false);
+	}
+}
+
+TEST_CASE("asset_archive_read", "[assets]")
+{
+	const auto shader = bytes_from_string(std::string(2000, 'x') + "void main() {}");
+	const auto image = make_noise(3000);
+
+	const auto archive = build_asset_archive(
+		{ArchiveSource{"shaders/default.glsl", shader}, ArchiveSource{"textures/noise.png", image}, ArchiveSource{"empty.txt", {}}},
+		ArchiveCompression::lz
+	);
+	REQUIRE(archive.has_value());
+
+	AssetArchive reader{write_archive("read.klar", *archive)};
+	REQUIRE(reader.is_valid());
+	CHECK(reader.get_file_count() == 3);
+
+	CHECK(reader.contains("textures/noise.png"));
+	CHECK(reader.contains("textures/missing.png") == false);
+	CHECK(reader.read("textures/missing.png").has_value() == false);
+
+	const auto read_shader = reader.read("shaders/default.glsl");
+	REQUIRE(read_shader.has_value());
+	CHECK(read_shader->decompressed.empty() == false);
+	CHECK(std::vector<std::uint8_t>(read_shader->bytes().begin(), read_shader->bytes().end()) == shader);
+
+	// the noise doesn't compress so it's read directly from the mapped archive
+	const auto read_image = reader.read("textures/noise.png");
+	REQUIRE(read_image.has_value());
+	CHECK(read_image->decompressed.empty());
+	CHECK(std::vector<std::uint8_t>(read_image->bytes().begin(), read_image->bytes().end()) == image);
+	CHECK(read_image->as_binary().size == image.size());
+
+	const auto read_empty = reader.read("empty.txt");
+	REQUIRE(read_empty.has_value());
+	CHECK(read_empty->bytes().empty());
+
+	reader.prefetch("textures/noise.png");
+	reader.prefetch_all();
+	reader.wait_for_prefetch();
+}
+
+TEST_CASE("asset_archive_rejects_broken_files", "[assets]")
+{
+	SECTION("missing")
+	{
+		const AssetArchive reader{std::filesystem::temp_directory_path() / "klotter-archive-test" / "missing.klar"};
+		CHECK(reader.is_valid() == false);
+	}
+
+	SECTION("not a archive")
+	{
+		const AssetArchive reader{write_archive("text.klar", bytes_from_string("this is not a archive at all"))};
+		CHECK(reader.is_valid() == false);
+	}
+
+	SECTION("truncated")
+	{
+		auto archive = build_asset_archive({ArchiveSource{"a.txt", make_noise(100)}}, ArchiveCompression::none);
+		REQUIRE(archive.has_value());
+		archive->resize(archive->size() - 10);
+		const AssetArchive reader{write_archive("truncated.klar", *archive)};
+		CHECK(reader.is_valid() == false);
+	}
+}
@@ -1,6 +1,11 @@
 #include "klotter/render/assets.h"
 
+#include "klotter/hash.h"
+#include "klotter/log.h"
+
+#include "klotter/render/geom.h"
 #include "klotter/render/texture.io.h"
+#include "klotter/render/world.h"
 
 
 // assets
@@ -23,108 +28,299 @@
 namespace klotter
 {
 
-std::shared_ptr<Texture2d> get_or_load(
-	DEBUG_LABEL_ARG_MANY
-	std::shared_ptr<Texture2d>* texture,
-	const embedded_binary& bin,
-	ColorData cd,
-	TextureEdge texture_edge = TextureEdge::repeat,
-	Transparency transparency = Transparency::exclude
-)
+/// the color of a image that is still loading, a neutral gray
+constexpr SingleColor image_loading_color = color_from_rgba(0x80, 0x80, 0x80, 0xFF);
+
+namespace
+{
+	template<typename T>
+	AssetKey hash_value(AssetKey hash, const T& value)
+	{
+		return hash_fnv1a(hash, &value, sizeof(T));
+	}
+
+	/// a different start for each kind of asset so they never share a key
+	AssetKey key_seed(std::string_view kind)
+	{
+		return hash_fnv1a(fnv1a_offset_basis, kind.data(), kind.size());
+	}
+
+	AssetKey key_from_loaded_texture(AssetKey content, TextureEdge te, TextureRenderStyle trs, Transparency t, ColorData cd)
+	{
+		auto key = hash_value(key_seed("texture"), content);
+		key = hash_value(key, te);
+		key = hash_value(key, trs);
+		key = hash_value(key, t);
+		return hash_value(key, cd);
+	}
+
+	AssetKey key_from_color(SingleColor color, ColorData cd)
+	{
+		return hash_value(hash_value(key_seed("color"), color), cd);
+	}
+
+	AssetKey key_from_geom(const Geom& geom, const CompiledGeomVertexAttributes& layout)
+	{
+		auto key = key_seed("geom");
+		for (const auto& v: geom.vertices)
+		{
+			key = hash_value(key, v.position);
+			key = hash_value(key, v.normal);
+			key = hash_value(key, v.uv);
+			key = hash_value(key, v.color);
+		}
+		for (const auto& f: geom.faces)
+		{
+			key = hash_value(key, f.a);
+			key = hash_value(key, f.b);
+			key = hash_value(key, f.c);
+		}
+		for (const auto& e: layout.elements)
+		{
+			key = hash_value(key, e.type);
+			key = hash_value(key, e.index);
+		}
+		return key;
+	}
+
+	std::shared_ptr<Texture2d> load_texture(
+		DEBUG_LABEL_ARG_MANY
+		AsyncTextureLoader* loader,
+		const TextureCache* cache,
+		const embedded_binary& bin,
+		TextureEdge texture_edge,
+		TextureRenderStyle trs,
+		Transparency transparency,
+		ColorData cd
+	)
+	{
+		// a cached image is just a upload so there is no need to load it async
+		const auto is_cached = cache && cache->contains(key_from_texture(bin, transparency, cd));
+		if (loader && is_cached == false)
+		{
+			return loader->load_texture(
+				SEND_DEBUG_LABEL_MANY(debug_label) bin, texture_edge, trs, transparency, cd, image_loading_color, cache
+			);
+		}
+		else if (cache)
+		{
+			return std::make_shared<Texture2d>(
+				load_image_from_cache(SEND_DEBUG_LABEL_MANY(debug_label) *cache, bin, texture_edge, trs, transparency, cd)
+			);
+		}
+		else
+		{
+			return std::make_shared<Texture2d>(
+				load_image_from_embedded(SEND_DEBUG_LABEL_MANY(debug_label) bin, texture_edge, trs, transparency, cd)
+			);
+		}
+	}
+}  //  namespace
+
+// ----------------------------------------------------------------------------
+
+bool Assets::open_archive(const std::filesystem::path& path)
+{
+	auto opened = std::make_unique<AssetArchive>(path);
+	if (opened->is_valid() == false)
+	{
+		return false;
+	}
+
+	LOG_INFO("Using %d packed assets from %s", static_cast<int>(opened->get_file_count()), path.string().c_str());
+
+	// the archive only contains the sample assets so page in all of them while the app starts
+	opened->prefetch_all();
+
+	archive = std::move(opened);
+	archive_files.clear();
+	content_keys.clear();
+	return true;
+}
+
+embedded_binary Assets::get_binary(const std::string& name, const embedded_binary& fallback)
+{
+	if (archive == nullptr)
+	{
+		return fallback;
+	}
+
+	if (const auto found = archive_files.find(name); found != archive_files.end())
+	{
+		return found->second.as_binary();
+	}
+
+	auto file = archive->read(name);
+	if (file.has_value() == false)
+	{
+		return fallback;
+	}
+
+	const auto inserted = archive_files.emplace(name, std::move(*file));
+	return inserted.first->second.as_binary();
+}
+
+void Assets::update()
 {
-	if (*texture == nullptr)
+	loader.update();
+
+	// mapped cache files are only held while a texture is created from them so they are never resident between frames
+	std::size_t loading_cpu_bytes = loader.get_decoded_bytes();
+	if (archive)
+	{
+		loading_cpu_bytes += archive->get_mapped_size();
+	}
+	for (const auto& [name, file]: archive_files)
 	{
-		*texture = std::make_shared<Texture2d>(
-			load_image_from_embedded(SEND_DEBUG_LABEL_MANY(debug_label) bin, texture_edge, TextureRenderStyle::mipmap, transparency, cd)
-		);
+		loading_cpu_bytes += file.decompressed.size();
 	}
-	return *texture;
+	manager.loading_cpu_bytes = loading_cpu_bytes;
+
+	manager.update();
 }
 
-std::shared_ptr<Texture2d> get_or_create(DEBUG_LABEL_ARG_MANY std::shared_ptr<Texture2d>* texture, SingleColor pixel_color, ColorData cd)
+std::shared_ptr<CompiledGeom> Assets::get_geom(DEBUG_LABEL_ARG_MANY const Geom& geom, const CompiledGeomVertexAttributes& layout)
 {
-	if (*texture == nullptr)
+	return manager.get_or_load<CompiledGeom>(
+		key_from_geom(geom, layout), [&]() { return compile_geom(SEND_DEBUG_LABEL_MANY(debug_label) geom, layout); }
+	);
+}
+
+AsyncTextureLoader* Assets::get_loader()
+{
+	return use_async_loading ? &loader : nullptr;
+}
+
+const TextureCache* Assets::get_cache() const
+{
+	return use_texture_cache ? &texture_cache : nullptr;
+}
+
+AssetKey Assets::key_from_content(const embedded_binary& bin)
+{
+	if (const auto found = content_keys.find(bin.data); found != content_keys.end())
 	{
-		*texture = std::make_shared<Texture2d>(
-			load_image_from_color(SEND_DEBUG_LABEL_MANY(debug_label) pixel_color, TextureEdge::repeat, TextureRenderStyle::pixel, Transparency::exclude, cd)
-		);
+		return found->second;
 	}
 
-	return *texture;
+	const auto key = hash_fnv1a(fnv1a_offset_basis, bin.data, bin.size);
+	content_keys.emplace(bin.data, key);
+	return key;
+}
+
+std::shared_ptr<Texture2d> Assets::get_or_load(
+	DEBUG_LABEL_ARG_MANY const embedded_binary& bin, ColorData cd, TextureEdge texture_edge, Transparency transparency
+)
+{
+	constexpr auto trs = TextureRenderStyle::mipmap;
+	return manager.get_or_load<Texture2d>(
+		key_from_loaded_texture(key_from_content(bin), texture_edge, trs, transparency, cd),
+		[&]() { return load_texture(SEND_DEBUG_LABEL_MANY(debug_label) get_loader(), get_cache(), bin, texture_edge, trs, transparency, cd); }
+	);
+}
+
+std::shared_ptr<Texture2d> Assets::get_or_create(DEBUG_LABEL_ARG_MANY SingleColor pixel_color, ColorData cd)
+{
+	return manager.get_or_load<Texture2d>(
+		key_from_color(pixel_color, cd),
+		[&]()
+		{
+			return std::make_shared<Texture2d>(load_image_from_color(
+				SEND_DEBUG_LABEL_MANY(debug_label) pixel_color, TextureEdge::repeat, TextureRenderStyle::pixel, Transparency::exclude, cd
+			));
+		}
+	);
 }
 
 // ----------------------------------------------------------------------------
 
 std::shared_ptr<Texture2d> Assets::get_black()
 {
-	return get_or_create(USE_DEBUG_LABEL_MANY("black from pixel") & black, color_from_rgba(0x00, 0x00, 0x00, 0xFF), ColorData::dont_care);
+	return get_or_create(USE_DEBUG_LABEL_MANY("black from pixel") color_from_rgba(0x00, 0x00, 0x00, 0xFF), ColorData::dont_care);
 }
 
 std::shared_ptr<Texture2d> Assets::get_white()
 {
-	return get_or_create(USE_DEBUG_LABEL_MANY("white from pixel") & white, color_from_rgba(0xFF, 0xFF, 0xFF, 0xFF), ColorData::dont_care);
+	return get_or_create(USE_DEBUG_LABEL_MANY("white from pixel") color_from_rgba(0xFF, 0xFF, 0xFF, 0xFF), ColorData::dont_care);
 }
 
 // ----------------------------------------------------------------------------
 
 std::shared_ptr<Texture2d> Assets::get_cookie()
 {
-	return get_or_load(USE_DEBUG_LABEL_MANY("cookie.png") &cookie, COOKIE_01_PNG, ColorData::color_data);
+	return get_or_load(USE_DEBUG_LABEL_MANY("cookie.png") get_binary("textures/cookie_01.png", COOKIE_01_PNG), ColorData::color_data);
 }
 
 std::shared_ptr<Texture2d> Assets::get_dark_grid()
 {
-	return get_or_load(USE_DEBUG_LABEL_MANY("dark_grid.png") &dark_grid, DARK_01_PNG, ColorData::color_data);
+	return get_or_load(USE_DEBUG_LABEL_MANY("dark_grid.png") get_binary("textures/dark_01.png", DARK_01_PNG), ColorData::color_data);
 }
 
 std::shared_ptr<Texture2d> Assets::get_light_grid()
 {
-	return get_or_load(USE_DEBUG_LABEL_MANY("light_grid.png") &light_grid, LIGHT_01_PNG, ColorData::color_data);
+	return get_or_load(USE_DEBUG_LABEL_MANY("light_grid.png") get_binary("textures/light_01.png", LIGHT_01_PNG), ColorData::color_data);
 }
 
 // ----------------------------------------------------------------------------
 
 std::shared_ptr<Texture2d> Assets::get_container_diffuse()
 {
-	return get_or_load(USE_DEBUG_LABEL_MANY("container-diffuse.png") &container_diffuse, CONTAINER_DIFFUSE_PNG, ColorData::color_data);
+	return get_or_load(USE_DEBUG_LABEL_MANY("container-diffuse.png") get_binary("textures/container_diffuse.png", CONTAINER_DIFFUSE_PNG), ColorData::color_data);
 }
 
 std::shared_ptr<Texture2d> Assets::get_container_specular()
 {
-	return get_or_load(USE_DEBUG_LABEL_MANY("container-specular.png") &container_specular, CONTAINER_SPECULAR_PNG, ColorData::non_color_data);
+	return get_or_load(USE_DEBUG_LABEL_MANY("container-specular.png") get_binary("textures/container_specular.png", CONTAINER_SPECULAR_PNG), ColorData::non_color_data);
 }
 
 std::shared_ptr<Texture2d> Assets::get_matrix()
 {
-	return get_or_load(USE_DEBUG_LABEL_MANY("matrix.jpg") &matrix, MATRIX_JPG, ColorData::color_data);
+	return get_or_load(USE_DEBUG_LABEL_MANY("matrix.jpg") get_binary("textures/matrix.jpg", MATRIX_JPG), ColorData::color_data);
 }
 
 std::shared_ptr<Texture2d> Assets::get_glass()
 {
-	return get_or_load(USE_DEBUG_LABEL_MANY("glass.png") &glass, GLASS_PNG, ColorData::color_data);
+	return get_or_load(USE_DEBUG_LABEL_MANY("glass.png") get_binary("textures/glass.png", GLASS_PNG), ColorData::color_data);
 }
 
 std::shared_ptr<Texture2d> Assets::get_grass()
 {
-	return get_or_load(USE_DEBUG_LABEL_MANY("grass.png") &grass, GRASS_PNG, ColorData::color_data, TextureEdge::clamp, Transparency::include);
+	return get_or_load(USE_DEBUG_LABEL_MANY("grass.png") get_binary("textures/grass.png", GRASS_PNG), ColorData::color_data, TextureEdge::clamp, Transparency::include);
 }
 
 std::shared_ptr<TextureCubemap> Assets::get_skybox()
 {
-	if (skybox == nullptr)
-	{
-		skybox = std::make_shared<TextureCubemap>(load_cubemap_from_embedded(
-			USE_DEBUG_LABEL_MANY("skybox cubemap") 
-			std::array{
-				SKYBOX_RIGHT_JPG, SKYBOX_LEFT_JPG, 
-				SKYBOX_TOP_JPG, SKYBOX_BOTTOM_JPG,
-				SKYBOX_FRONT_JPG, SKYBOX_BACK_JPG
-			},
-			ColorData::color_data
-		));
-	}
+	const auto images = std::array{
+		get_binary("textures/skybox-right.jpg", SKYBOX_RIGHT_JPG), get_binary("textures/skybox-left.jpg", SKYBOX_LEFT_JPG),
+		get_binary("textures/skybox-top.jpg", SKYBOX_TOP_JPG), get_binary("textures/skybox-bottom.jpg", SKYBOX_BOTTOM_JPG),
+		get_binary("textures/skybox-front.jpg", SKYBOX_FRONT_JPG), get_binary("textures/skybox-back.jpg", SKYBOX_BACK_JPG)
+	};
+	const auto cache_key = key_from_cubemap(images, ColorData::color_data);
 
-	return skybox;
+	return manager.get_or_load<TextureCubemap>(
+		hash_value(key_seed("cubemap"), cache_key),
+		[&]() -> std::shared_ptr<TextureCubemap>
+		{
+			const auto* cache = get_cache();
+			const auto is_cached = cache && cache->contains(cache_key);
+			if (use_async_loading && is_cached == false)
+			{
+				return loader.load_cubemap(USE_DEBUG_LABEL_MANY("skybox cubemap") images, ColorData::color_data, image_loading_color, cache);
+			}
+			else if (cache)
+			{
+				return std::make_shared<TextureCubemap>(
+					load_cubemap_from_cache(USE_DEBUG_LABEL_MANY("skybox cubemap") *cache, images, ColorData::color_data)
+				);
+			}
+			else
+			{
+				return std::make_shared<TextureCubemap>(
+					load_cubemap_from_embedded(USE_DEBUG_LABEL_MANY("skybox cubemap") images, ColorData::color_data)
+				);
+			}
+		}
+	);
 }
 
 }  //  namespace klotter
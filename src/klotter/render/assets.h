@@ -1,16 +1,44 @@
 ﻿#pragma once
 
+#include "klotter/render/assets.archive.h"
+#include "klotter/render/assets.manager.h"
 #include "klotter/render/texture.h"
+#include "klotter/render/texture.async.h"
+#include "klotter/render/texture.cache.h"
 
 #include <memory>
 
 namespace klotter
 {
 
+struct Geom;
+struct CompiledGeomVertexAttributes;
+
 /// A temporary collection of assets that can be used in the example.
 /// This should be replaced with something way better that this yolo crap.
 struct Assets
 {
+	/// if true, images are decoded on worker threads and show a placeholder color until uploaded
+	bool use_async_loading = true;
+
+	/// if true, decoded images and their mips are cached on disk so later runs can skip decoding
+	bool use_texture_cache = true;
+
+	TextureCache texture_cache{default_texture_cache_directory()};
+
+	/// all loaded textures and geoms, keyed on their content so the same image or geom is only loaded once
+	AssetManager manager;
+
+	/// Read the images from a packed archive instead of the embedded images, files missing from the archive fall back to the embedded images.
+	/// @return false if the archive couldn't be opened
+	bool open_archive(const std::filesystem::path& path);
+
+	/// upload images that have been decoded and evict unused assets if over the budget, call once per frame
+	void update();
+
+	/// Compiles a geom or returns a already compiled geom with the same content and layout.
+	std::shared_ptr<CompiledGeom> get_geom(DEBUG_LABEL_ARG_MANY const Geom& geom, const CompiledGeomVertexAttributes& layout);
+
 	std::shared_ptr<Texture2d> get_black();
 	std::shared_ptr<Texture2d> get_white();
 
@@ -27,19 +55,37 @@ struct Assets
 
    private:
 
-	std::shared_ptr<Texture2d> black;
-	std::shared_ptr<Texture2d> white;
+	/// the archive is declared before the loader so it outlives the loads that reference it
+	std::unique_ptr<AssetArchive> archive;
+
+	/// the files that were decompressed from the archive, kept since the loaded textures reference them by content
+	std::unordered_map<std::string, ArchiveFile> archive_files;
+
+	AsyncTextureLoader loader;
+
+	/// the loader or null if images should be loaded directly
+	AsyncTextureLoader* get_loader();
+
+	/// the cache or null if it's disabled
+	const TextureCache* get_cache() const;
+
+	/// the file from the archive or the fallback if there is no archive or the file is missing
+	embedded_binary get_binary(const std::string& name, const embedded_binary& fallback);
+
+	/// the hash of each embedded image, large images are slow to hash on each request
+	std::unordered_map<const void*, AssetKey> content_keys;
+
+	AssetKey key_from_content(const embedded_binary& bin);
 
-	std::shared_ptr<Texture2d> cookie;
-	std::shared_ptr<Texture2d> dark_grid;
-	std::shared_ptr<Texture2d> light_grid;
+	std::shared_ptr<Texture2d> get_or_load(
+		DEBUG_LABEL_ARG_MANY
+		const embedded_binary& bin,
+		ColorData cd,
+		TextureEdge texture_edge = TextureEdge::repeat,
+		Transparency transparency = Transparency::exclude
+	);
 
-	std::shared_ptr<Texture2d> container_diffuse;
-	std::shared_ptr<Texture2d> container_specular;
-	std::shared_ptr<Texture2d> matrix;
-	std::shared_ptr<Texture2d> glass;
-	std::shared_ptr<Texture2d> grass;
-	std::shared_ptr<TextureCubemap> skybox;
+	std::shared_ptr<Texture2d> get_or_create(DEBUG_LABEL_ARG_MANY SingleColor pixel_color, ColorData cd);
 };
 
 }  //  namespace klotter
@@ -0,0 +1,159 @@
+#include "klotter/render/assets.manager.h"
+
+#include "klotter/assert.h"
+
+#include "klotter/render/texture.h"
+#include "klotter/render/world.h"
+
+namespace klotter
+{
+
+// the pixels and vertices are released once they are uploaded, the cpu memory used while loading is loading_cpu_bytes
+
+AssetMemory asset_memory(const Texture2d& texture)
+{
+	return {0, texture.gpu_bytes};
+}
+
+AssetMemory asset_memory(const TextureArray& texture)
+{
+	return {0, texture.gpu_bytes};
+}
+
+AssetMemory asset_memory(const TextureCubemap& texture)
+{
+	return {0, texture.gpu_bytes};
+}
+
+AssetMemory asset_memory(const CompiledGeom& geom)
+{
+	return {0, geom.gpu_bytes};
+}
+
+// ------------------------------------------------------------------------------------------------
+
+std::shared_ptr<void> AssetManager::find(AssetKey key, std::type_index type)
+{
+	const auto found = entries.find(key);
+	if (found == entries.end())
+	{
+		return nullptr;
+	}
+
+	ASSERT(found->second.type == type && "the same key was used for assets of different types");
+	found->second.last_used = current_frame;
+	counters.hits += 1;
+	return found->second.asset;
+}
+
+void AssetManager::add(AssetKey key, std::type_index type, std::shared_ptr<void> asset, MeasureFunction measure)
+{
+	ASSERT(asset != nullptr);
+	ASSERT(entries.find(key) == entries.end());
+
+	counters.misses += 1;
+	if (evicted.erase(key) > 0)
+	{
+		counters.reloads += 1;
+	}
+
+	const auto memory = measure(asset.get());
+	entries.emplace(key, Entry{std::move(asset), type, measure, memory, current_frame});
+}
+
+void AssetManager::evict(AssetKey key)
+{
+	entries.erase(key);
+	evicted.emplace(key);
+	counters.evictions += 1;
+}
+
+void AssetManager::update()
+{
+	current_frame += 1;
+
+	// measure every frame since async loads and uploads change the size after the asset was added
+	AssetMemory total;
+	std::vector<std::pair<std::uint64_t, AssetKey>> unused;
+	for (auto& [key, entry]: entries)
+	{
+		entry.memory = entry.measure(entry.asset.get());
+		total.gpu_bytes += entry.memory.gpu_bytes;
+
+		// the manager holds one reference, any other means it's used somewhere
+		if (entry.asset.use_count() > 1)
+		{
+			entry.last_used = current_frame;
+		}
+		else
+		{
+			unused.emplace_back(entry.last_used, key);
+		}
+	}
+
+	const auto is_over_budget = [&]()
+	{
+		return total.gpu_bytes > budget.gpu_bytes;
+	};
+
+	if (is_over_budget() == false)
+	{
+		return;
+	}
+
+	// evict the least recently used first, the key breaks ties so the order is the same on each run
+	std::sort(unused.begin(), unused.end());
+	for (const auto& [last_used, key]: unused)
+	{
+		if (is_over_budget() == false)
+		{
+			break;
+		}
+
+		const auto& memory = entries.at(key).memory;
+		total.gpu_bytes -= memory.gpu_bytes;
+		evict(key);
+	}
+}
+
+void AssetManager::evict_unused()
+{
+	std::vector<AssetKey> unused;
+	for (const auto& [key, entry]: entries)
+	{
+		if (entry.asset.use_count() == 1)
+		{
+			unused.emplace_back(key);
+		}
+	}
+
+	for (const auto key: unused)
+	{
+		evict(key);
+	}
+}
+
+bool AssetManager::is_loaded(AssetKey key) const
+{
+	return entries.find(key) != entries.end();
+}
+
+AssetStats AssetManager::get_stats() const
+{
+	auto stats = counters;
+	stats.asset_count = entries.size();
+	stats.memory.cpu_bytes = loading_cpu_bytes;
+	for (const auto& [key, entry]: entries)
+	{
+		const auto memory = entry.measure(entry.asset.get());
+		stats.memory.cpu_bytes += memory.cpu_bytes;
+		stats.memory.gpu_bytes += memory.gpu_bytes;
+		if (entry.asset.use_count() > 1)
+		{
+			stats.used_count += 1;
+		}
+	}
+	return stats;
+}
+
+}  //  namespace klotter
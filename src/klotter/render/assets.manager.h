@@ -0,0 +1,124 @@
+#pragma once
+
+#include <typeindex>
+#include <unordered_set>
+
+namespace klotter
+{
+
+struct Texture2d;
+struct TextureArray;
+struct TextureCubemap;
+struct CompiledGeom;
+
+/// Identifies a asset by the content it was loaded from, so the same content is only loaded once.
+using AssetKey = std::uint64_t;
+
+/// The memory a asset uses.
+struct AssetMemory
+{
+	std::size_t cpu_bytes = 0;
+	std::size_t gpu_bytes = 0;
+};
+
+AssetMemory asset_memory(const Texture2d& texture);
+AssetMemory asset_memory(const TextureArray& texture);
+AssetMemory asset_memory(const TextureCubemap& texture);
+AssetMemory asset_memory(const CompiledGeom& geom);
+
+/// The memory the loaded assets may use before unused assets are evicted.
+/// Only the gpu memory is budgeted, most of the cpu memory is used for loading and isn't freed by evicting assets.
+struct AssetBudget
+{
+	std::size_t gpu_bytes = 512 * 1024 * 1024;
+};
+
+struct AssetStats
+{
+	/// the number of loaded assets
+	std::size_t asset_count = 0;
+
+	/// the number of loaded assets that are referenced outside of the manager and can't be evicted
+	std::size_t used_count = 0;
+
+	/// the memory of all loaded assets, the cpu memory includes \ref AssetManager::loading_cpu_bytes
+	AssetMemory memory;
+
+	/// the number of requests for a asset that was already loaded
+	std::size_t hits = 0;
+
+	/// the number of requests that needed to load the asset, including reloads
+	std::size_t misses = 0;
+
+	/// the number of assets that were loaded again after they were evicted
+	std::size_t reloads = 0;
+
+	std::size_t evictions = 0;
+};
+
+/// Keeps track of loaded assets by their content and how much memory they use.
+/// When the budget is exceeded, the least recently used assets that are no longer referenced are evicted and
+/// they are loaded again the next time they are requested.
+struct AssetManager
+{
+	AssetBudget budget;
+
+	/// The cpu memory used for loading that isn't owned by a single asset, like mapped archives and decoded images
+	/// waiting to be uploaded. Set by the owner of the loaders each frame, it's only reported in the stats.
+	std::size_t loading_cpu_bytes = 0;
+
+	/// Returns the asset with the key or calls the load function if it isn't loaded.
+	/// The memory of the asset is measured with a `asset_memory(const T&)` overload.
+	template<typename T, typename LoadFunction>
+	std::shared_ptr<T> get_or_load(AssetKey key, LoadFunction&& load)
+	{
+		if (auto found = find(key, typeid(T)); found != nullptr)
+		{
+			return std::static_pointer_cast<T>(found);
+		}
+
+		std::shared_ptr<T> loaded = load();
+		const auto measure = [](const void* asset) { return asset_memory(*static_cast<const T*>(asset)); };
+		add(key, typeid(T), loaded, measure);
+		return loaded;
+	}
+
+	/// Measures the assets and evicts the least recently used unreferenced assets until the budget is met, call once per frame.
+	void update();
+
+	/// Evicts all assets that aren't referenced, regardless of the budget.
+	void evict_unused();
+
+	[[nodiscard]] bool is_loaded(AssetKey key) const;
+
+	[[nodiscard]] AssetStats get_stats() const;
+
+   private:
+
+	using MeasureFunction = AssetMemory (*)(const void*);
+
+	struct Entry
+	{
+		std::shared_ptr<void> asset;
+		std::type_index type;
+		MeasureFunction measure;
+		AssetMemory memory;
+
+		/// the frame the asset was last requested or referenced
+		std::uint64_t last_used;
+	};
+
+	std::shared_ptr<void> find(AssetKey key, std::type_index type);
+	void add(AssetKey key, std::type_index type, std::shared_ptr<void> asset, MeasureFunction measure);
+	void evict(AssetKey key);
+
+	std::unordered_map<AssetKey, Entry> entries;
+
+	/// keys that have been evicted, used to count reloads
+	std::unordered_set<AssetKey> evicted;
+
+	std::uint64_t current_frame = 0;
+	AssetStats counters;
+};
+
+}  //  namespace klotter
@@ -0,0 +1,146 @@
+#include "klotter/render/assets.manager.h"
+
+#include "catch2/catch_test_macros.hpp"
+
+using namespace klotter;
+
+namespace
+{
+	/// a asset that doesn't need open gl
+	struct FakeAsset
+	{
+		int value;
+		std::size_t gpu_bytes;
+	};
+
+	AssetMemory asset_memory(const FakeAsset& asset)
+	{
+		return {16, asset.gpu_bytes};
+	}
+
+	/// loads a fake asset and counts the number of loads
+	struct FakeLoader
+	{
+		int load_count = 0;
+
+		std::shared_ptr<FakeAsset> get(AssetManager* manager, AssetKey key, std::size_t gpu_bytes = 100)
+		{
+			return manager->get_or_load<FakeAsset>(
+				key,
+				[&]()
+				{
+					load_count += 1;
+					return std::make_shared<FakeAsset>(FakeAsset{static_cast<int>(key), gpu_bytes});
+				}
+			);
+		}
+	};
+}  //  namespace
+
+TEST_CASE("asset_manager_same_key_is_loaded_once", "[assets]")
+{
+	AssetManager manager;
+	FakeLoader loader;
+
+	const auto first = loader.get(&manager, 1);
+	const auto second = loader.get(&manager, 1);
+	const auto other = loader.get(&manager, 2);
+
+	CHECK(first == second);
+	CHECK(first != other);
+	CHECK(loader.load_count == 2);
+
+	const auto stats = manager.get_stats();
+	CHECK(stats.asset_count == 2);
+	CHECK(stats.used_count == 2);
+	CHECK(stats.hits == 1);
+	CHECK(stats.misses == 2);
+	CHECK(stats.memory.cpu_bytes == 32);
+	CHECK(stats.memory.gpu_bytes == 200);
+
+	// the memory used for loading is reported with the assets but doesn't evict them
+	manager.loading_cpu_bytes = 1000;
+	manager.update();
+	CHECK(manager.get_stats().memory.cpu_bytes == 1032);
+	CHECK(manager.get_stats().evictions == 0);
+}
+
+TEST_CASE("asset_manager_keeps_assets_within_budget", "[assets]")
+{
+	AssetManager manager;
+	manager.budget.gpu_bytes = 250;
+	FakeLoader loader;
+
+	std::ignore = loader.get(&manager, 1);
+	manager.update();
+	std::ignore = loader.get(&manager, 2);
+	manager.update();
+	std::ignore = loader.get(&manager, 3);
+
+	// 300 bytes are loaded, the least recently used is evicted
+	manager.update();
+	CHECK(manager.is_loaded(1) == false);
+	CHECK(manager.is_loaded(2));
+	CHECK(manager.is_loaded(3));
+	CHECK(manager.get_stats().evictions == 1);
+	CHECK(manager.get_stats().memory.gpu_bytes == 200);
+}
+
+TEST_CASE("asset_manager_never_evicts_referenced_assets", "[assets]")
+{
+	AssetManager manager;
+	manager.budget.gpu_bytes = 50;
+	FakeLoader loader;
+
+	const auto used = loader.get(&manager, 1);
+	std::ignore = loader.get(&manager, 2);
+	manager.update();
+
+	CHECK(manager.is_loaded(1));
+	CHECK(manager.is_loaded(2) == false);
+
+	// still over budget but the used asset can't be evicted
+	CHECK(manager.get_stats().memory.gpu_bytes == 100);
+	CHECK(manager.get_stats().used_count == 1);
+}
+
+TEST_CASE("asset_manager_recently_used_assets_are_kept", "[assets]")
+{
+	AssetManager manager;
+	manager.budget.gpu_bytes = 250;
+	FakeLoader loader;
+
+	std::ignore = loader.get(&manager, 1);
+	manager.update();
+	std::ignore = loader.get(&manager, 2);
+	manager.update();
+
+	// requesting the first asset makes the second the least recently used
+	std::ignore = loader.get(&manager, 1);
+	std::ignore = loader.get(&manager, 3);
+	manager.update();
+
+	CHECK(manager.is_loaded(1));
+	CHECK(manager.is_loaded(2) == false);
+	CHECK(manager.is_loaded(3));
+}
+
+TEST_CASE("asset_manager_reloads_evicted_assets", "[assets]")
+{
+	AssetManager manager;
+	FakeLoader loader;
+
+	std::ignore = loader.get(&manager, 1);
+	manager.evict_unused();
+	CHECK(manager.is_loaded(1) == false);
+
+	const auto reloaded = loader.get(&manager, 1);
+	REQUIRE(reloaded != nullptr);
+	CHECK(reloaded->value == 1);
+	CHECK(loader.load_count == 2);
+
+	const auto stats = manager.get_stats();
+	CHECK(stats.evictions == 1);
+	CHECK(stats.reloads == 1);
+	CHECK(stats.misses == 2);
+}
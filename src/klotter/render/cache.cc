@@ -0,0 +1,73 @@
+#include "klotter/render/cache.h"
+
+#include "klotter/log.h"
+#include "klotter/str.h"
+
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <random>
+
+namespace klotter
+{
+
+namespace
+{
+	/// a thread id can be the same in two processes, so the temp name uses a random token for the process and a counter
+	std::string unique_temp_suffix()
+	{
+		static const auto process_token
+			= std::random_device{}() ^ static_cast<std::size_t>(std::chrono::high_resolution_clock::now().time_since_epoch().count());
+		static std::atomic<u64> counter = 0;
+
+		return Str() << "." << std::hex << process_token << "-" << counter.fetch_add(1) << ".tmp";
+	}
+}  //  namespace
+
+std::filesystem::path default_cache_directory(std::string_view name)
+{
+	std::error_code error;
+	const auto temp = std::filesystem::temp_directory_path(error);
+	return (error ? std::filesystem::current_path(error) : temp) / name;
+}
+
+bool write_file_atomically(const std::filesystem::path& path, const std::vector<std::span<const std::byte>>& parts)
+{
+	std::error_code error;
+	std::filesystem::create_directories(path.parent_path(), error);
+	if (error)
+	{
+		LOG_ERROR("Failed to create directory %s: %s", path.parent_path().string().c_str(), error.message().c_str());
+		return false;
+	}
+
+	auto temp_path = path;
+	temp_path += unique_temp_suffix();
+	{
+		std::ofstream file{temp_path, std::ios::binary};
+		for (const auto& part: parts)
+		{
+			file.write(reinterpret_cast<const char*>(part.data()), static_cast<std::streamsize>(part.size()));
+		}
+
+		if (file.good() == false)
+		{
+			LOG_ERROR("Failed to write %s", temp_path.string().c_str());
+			file.close();
+			std::filesystem::remove(temp_path, error);
+			return false;
+		}
+	}
+
+	std::filesystem::rename(temp_path, path, error);
+	if (error)
+	{
+		LOG_ERROR("Failed to write %s: %s", path.string().c_str(), error.message().c_str());
+		std::filesystem::remove(temp_path, error);
+		return false;
+	}
+
+	return true;
+}
+
+}  //  namespace klotter
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <filesystem>
+#include <span>
+
+namespace klotter
+{
+
+/** \addtogroup render Renderer
+ *  @{
+*/
+
+/// A directory with the name in the temp folder, or in the current folder if there is no temp folder.
+std::filesystem::path default_cache_directory(std::string_view name);
+
+/** Writes the parts, in order, to a file that is unique for the process and thread and renames it to the path.
+ * A reader never sees a half written file, even if several processes share the directory.
+ * The directory is created if needed. Failures are logged and false is returned, the disk caches ignore it since they
+ * are only a optimization.
+ */
+bool write_file_atomically(const std::filesystem::path& path, const std::vector<std::span<const std::byte>>& parts);
+
+/**
+ * @}
+*/
+
+}  //  namespace klotter
@@ -0,0 +1,193 @@
+#include "klotter/render/command_buffer.h"
+
+#include "klotter/assert.h"
+#include "klotter/cint.h"
+#include "klotter/jobs.h"
+
+#include "klotter/render/constants.h"
+#include "klotter/render/draw.block.h"
+#include "klotter/render/material.h"
+#include "klotter/render/material.block.h"
+#include "klotter/render/shader.h"
+#include "klotter/render/state.h"
+#include "klotter/render/world.h"
+
+#include "klotter/dependency_glad.h"
+
+namespace klotter
+{
+
+// ------------------------------------------------------------------------------------------------
+// command list
+
+void CommandList::use_program(const ShaderProgram& program)
+{
+	commands.emplace_back(RenderCommand{RenderCommandType::use_program, program.shader_program, 0, 0});
+}
+
+void CommandList::bind_material(int slot)
+{
+	commands.emplace_back(RenderCommand{RenderCommandType::bind_material, 0, slot, 0});
+}
+
+void CommandList::bind_draw(int slot)
+{
+	commands.emplace_back(RenderCommand{RenderCommandType::bind_draw, 0, slot, 0});
+}
+
+void CommandList::bind_texture_2d(int unit, u32 texture)
+{
+	ASSERT(unit >= 0 && sizet_from_int(unit) < MAX_TEXTURES_SUPPORTED);
+	commands.emplace_back(RenderCommand{RenderCommandType::bind_texture_2d, texture, unit, 0});
+}
+
+void CommandList::bind_texture_2d_array(int unit, u32 texture)
+{
+	ASSERT(unit >= 0 && sizet_from_int(unit) < MAX_TEXTURES_SUPPORTED);
+	commands.emplace_back(RenderCommand{RenderCommandType::bind_texture_2d_array, texture, unit, 0});
+}
+
+void CommandList::write_stencil(bool write)
+{
+	commands.emplace_back(RenderCommand{RenderCommandType::write_stencil, 0, write ? 1 : 0, 0});
+}
+
+void CommandList::draw(const CompiledGeom& geom)
+{
+	commands.emplace_back(RenderCommand{RenderCommandType::draw, geom.vao, 0, geom.number_of_triangles * 3});
+}
+
+void CommandList::use_material(const MaterialBinds& binds)
+{
+	commands.emplace_back(RenderCommand{RenderCommandType::use_program, binds.program, 0, 0});
+	bind_material(binds.block_slot);
+	for (int index = 0; index < binds.texture_count; index += 1)
+	{
+		const auto& texture = binds.textures[sizet_from_int(index)];
+		if (texture.is_array)
+		{
+			bind_texture_2d_array(texture.unit, texture.texture);
+		}
+		else
+		{
+			bind_texture_2d(texture.unit, texture.texture);
+		}
+	}
+}
+
+void CommandList::clear()
+{
+	commands.clear();
+}
+
+// ------------------------------------------------------------------------------------------------
+// gl backend
+
+GlCommandBackend::GlCommandBackend(State* s, MaterialUniformBuffer* m, DrawUniformRing* d)
+	: states(s)
+	, materials(m)
+	, draws(d)
+{
+}
+
+void GlCommandBackend::use_program(u32 program)
+{
+	StateChanger{states}.use_program(program);
+}
+
+void GlCommandBackend::bind_material(int slot)
+{
+	materials->bind(slot);
+}
+
+void GlCommandBackend::bind_draw(int slot)
+{
+	draws->bind(slot);
+}
+
+void GlCommandBackend::bind_texture_2d(int unit, u32 texture)
+{
+	StateChanger{states}.activate_texture(unit).bind_texture_2d(unit, texture);
+}
+
+void GlCommandBackend::bind_texture_2d_array(int unit, u32 texture)
+{
+	StateChanger{states}.activate_texture(unit).bind_texture_2d_array(unit, texture);
+}
+
+void GlCommandBackend::write_stencil(bool write)
+{
+	StateChanger{states}.stencil_mask(write ? 0xFF : 0x0);
+}
+
+void GlCommandBackend::draw(u32 vertex_array, int index_count)
+{
+	StateChanger{states}.bind_vertex_array(vertex_array);
+	glDrawElements(GL_TRIANGLES, index_count, GL_UNSIGNED_INT, nullptr);
+}
+
+// ------------------------------------------------------------------------------------------------
+// replay
+
+void replay(const CommandList& list, CommandBackend* backend)
+{
+	for (const auto& command: list.commands)
+	{
+		switch (command.type)
+		{
+		case RenderCommandType::use_program: backend->use_program(command.object); break;
+		case RenderCommandType::bind_material: backend->bind_material(command.slot); break;
+		case RenderCommandType::bind_draw: backend->bind_draw(command.slot); break;
+		case RenderCommandType::bind_texture_2d: backend->bind_texture_2d(command.slot, command.object); break;
+		case RenderCommandType::bind_texture_2d_array: backend->bind_texture_2d_array(command.slot, command.object); break;
+		case RenderCommandType::write_stencil: backend->write_stencil(command.slot != 0); break;
+		case RenderCommandType::draw: backend->draw(command.object, command.count); break;
+		default: DIE("Invalid render command"); break;
+		}
+	}
+}
+
+void replay(const std::vector<CommandList>& lists, CommandBackend* backend)
+{
+	for (const auto& list: lists)
+	{
+		replay(list, backend);
+	}
+}
+
+// ------------------------------------------------------------------------------------------------
+// recording
+
+int slice_count_from_items(int count)
+{
+	return std::clamp(count / COMMAND_SLICE_MIN_SIZE, 1, get_job_system().get_thread_count());
+}
+
+void for_each_slice(int count, const std::function<void(int slice, int begin, int end)>& f)
+{
+	const auto slices = slice_count_from_items(count);
+	constexpr int slices_per_job = 1;
+	get_job_system().parallel_for(0, slices, slices_per_job,
+		[&](int first_slice, int last_slice)
+		{
+			for (int slice = first_slice; slice < last_slice; slice += 1)
+			{
+				// split evenly, the slices are disjoint and cover all items
+				f(slice, count * slice / slices, count * (slice + 1) / slices);
+			}
+		}
+	);
+}
+
+void record_in_parallel(std::vector<CommandList>* lists, int count, const std::function<void(CommandList* list, int begin, int end)>& record)
+{
+	lists->resize(sizet_from_int(slice_count_from_items(count)));
+	for (auto& list: *lists)
+	{
+		list.clear();
+	}
+
+	for_each_slice(count, [&](int slice, int begin, int end) { record(&(*lists)[sizet_from_int(slice)], begin, end); });
+}
+
+}  //  namespace klotter
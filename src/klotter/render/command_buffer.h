@@ -0,0 +1,125 @@
+#pragma once
+
+#include <functional>
+
+namespace klotter
+{
+
+struct CompiledGeom;
+struct DrawUniformRing;
+struct MaterialBinds;
+struct MaterialUniformBuffer;
+struct ShaderProgram;
+struct State;
+
+/** \addtogroup render Renderer
+ *  @{
+*/
+
+enum class RenderCommandType : u8
+{
+	use_program,
+	bind_material,
+	bind_draw,
+	bind_texture_2d,
+	bind_texture_2d_array,
+	write_stencil,
+	draw
+};
+
+/** A single recorded gl call.
+ * Plain data that doesn't refer to any renderer object, so it can be recorded on any thread and replayed on the gl thread.
+ */
+struct RenderCommand
+{
+	RenderCommandType type;
+	u32 object;  ///< the program, texture or vertex array
+	i32 slot;  ///< the material slot, draw slot or texture unit, or 1 if the stencil is written
+	i32 count;  ///< the number of indices to draw
+};
+
+/// The commands of a part of a frame, a list is only written by a single thread.
+struct CommandList
+{
+	std::vector<RenderCommand> commands;
+
+	void use_program(const ShaderProgram& program);
+	void bind_material(int slot);
+	void bind_draw(int slot);
+	void bind_texture_2d(int unit, u32 texture);
+	void bind_texture_2d_array(int unit, u32 texture);
+
+	/// Write the reference value to the stencil for the following draws, used to mark meshes that are outlined.
+	void write_stencil(bool write);
+
+	void draw(const CompiledGeom& geom);
+
+	/// Use the program, the parameters and the textures of a material that was prepared with \ref Material::prepare
+	void use_material(const MaterialBinds& binds);
+
+	void clear();
+};
+
+/// Where commands are replayed to, the gl or a recording in the tests.
+struct CommandBackend
+{
+	CommandBackend() = default;
+	virtual ~CommandBackend() = default;
+
+	CommandBackend(const CommandBackend&) = delete;
+	CommandBackend(CommandBackend&&) = delete;
+	void operator=(const CommandBackend&) = delete;
+	void operator=(CommandBackend&&) = delete;
+
+	virtual void use_program(u32 program) = 0;
+	virtual void bind_material(int slot) = 0;
+	virtual void bind_draw(int slot) = 0;
+	virtual void bind_texture_2d(int unit, u32 texture) = 0;
+	virtual void bind_texture_2d_array(int unit, u32 texture) = 0;
+	virtual void write_stencil(bool write) = 0;
+	virtual void draw(u32 vertex_array, int index_count) = 0;
+};
+
+/// Replays the commands to the gl, through the state cache, the material buffer and the draw ring.
+struct GlCommandBackend : CommandBackend
+{
+	State* states;
+	MaterialUniformBuffer* materials;
+	DrawUniformRing* draws;
+
+	GlCommandBackend(State* s, MaterialUniformBuffer* m, DrawUniformRing* d);
+
+	void use_program(u32 program) override;
+	void bind_material(int slot) override;
+	void bind_draw(int slot) override;
+	void bind_texture_2d(int unit, u32 texture) override;
+	void bind_texture_2d_array(int unit, u32 texture) override;
+	void write_stencil(bool write) override;
+	void draw(u32 vertex_array, int index_count) override;
+};
+
+void replay(const CommandList& list, CommandBackend* backend);
+
+/// Replays the lists in order.
+void replay(const std::vector<CommandList>& lists, CommandBackend* backend);
+
+/// The number of slices count items are split into, each slice has at least \ref COMMAND_SLICE_MIN_SIZE items.
+int slice_count_from_items(int count);
+
+/** Split count items into disjoint slices and call the function for each slice, on the shared job system.
+ * Returns when all slices are done, the calling thread takes the first slice.
+ * @param f called with the slice index and the items [begin, end)
+ */
+void for_each_slice(int count, const std::function<void(int slice, int begin, int end)>& f);
+
+/** Record the commands for count items, a slice of the items per thread.
+ * The lists are reused between calls and are in item order, so replaying them in order is the same as recording on a single thread.
+ * @param record called with the list of the slice and the items [begin, end)
+ */
+void record_in_parallel(std::vector<CommandList>* lists, int count, const std::function<void(CommandList* list, int begin, int end)>& record);
+
+/**
+ * @}
+*/
+
+}  //  namespace klotter
@@ -0,0 +1,208 @@
+#include "klotter/render/command_buffer.h"
+
+#include "klotter/str.h"
+
+#include "klotter/render/constants.h"
+#include "klotter/render/material.h"
+
+#include "catch2/catch_test_macros.hpp"
+
+using namespace klotter;
+
+namespace
+{
+	/// replays to a list of strings instead of the gl
+	struct RecordingBackend : CommandBackend
+	{
+		std::vector<std::string> calls;
+
+		void use_program(u32 program) override
+		{
+			calls.emplace_back(Str() << "program " << program);
+		}
+
+		void bind_material(int slot) override
+		{
+			calls.emplace_back(Str() << "material " << slot);
+		}
+
+		void bind_draw(int slot) override
+		{
+			calls.emplace_back(Str() << "draw slot " << slot);
+		}
+
+		void bind_texture_2d(int unit, u32 texture) override
+		{
+			calls.emplace_back(Str() << "texture " << unit << " " << texture);
+		}
+
+		void bind_texture_2d_array(int unit, u32 texture) override
+		{
+			calls.emplace_back(Str() << "array " << unit << " " << texture);
+		}
+
+		void write_stencil(bool write) override
+		{
+			calls.emplace_back(Str() << "stencil " << (write ? "write" : "keep"));
+		}
+
+		void draw(u32 vertex_array, int index_count) override
+		{
+			calls.emplace_back(Str() << "draw " << vertex_array << " " << index_count);
+		}
+	};
+
+	std::vector<std::string> draw_slots(int first, int count)
+	{
+		std::vector<std::string> r;
+		for (int index = first; index < first + count; index += 1)
+		{
+			r.emplace_back(Str() << "draw slot " << index);
+		}
+		return r;
+	}
+
+	MaterialBinds make_binds(u32 program, int block_slot, const std::vector<TextureBind>& textures)
+	{
+		MaterialBinds binds;
+		binds.program = program;
+		binds.block_slot = block_slot;
+		for (const auto& texture: textures)
+		{
+			binds.textures[static_cast<std::size_t>(binds.texture_count)] = texture;
+			binds.texture_count += 1;
+		}
+		return binds;
+	}
+
+	/// a mesh in a lit or unlit pass as the renderer sees it after the materials are prepared
+	struct FakeMeshDraw
+	{
+		const MaterialBinds* material;
+		int slot;
+		bool is_outlined;
+		u32 vertex_array;
+		int index_count;
+	};
+}  //  namespace
+
+TEST_CASE("command_buffer_replays_in_order", "[command_buffer]")
+{
+	CommandList list;
+	list.commands.emplace_back(RenderCommand{RenderCommandType::use_program, 3, 0, 0});
+	list.bind_draw(7);
+	list.bind_texture_2d(1, 42);
+	list.commands.emplace_back(RenderCommand{RenderCommandType::draw, 5, 0, 36});
+
+	RecordingBackend backend;
+	replay(list, &backend);
+
+	const auto expected = std::vector<std::string>{"program 3", "draw slot 7", "texture 1 42", "draw 5 36"};
+	CHECK(backend.calls == expected);
+
+	list.clear();
+	CHECK(list.commands.empty());
+}
+
+TEST_CASE("command_buffer_slice_count", "[command_buffer]")
+{
+	CHECK(slice_count_from_items(0) == 1);
+	CHECK(slice_count_from_items(1) == 1);
+	CHECK(slice_count_from_items(COMMAND_SLICE_MIN_SIZE * 2 - 1) == 1);
+	CHECK(slice_count_from_items(COMMAND_SLICE_MIN_SIZE * 1000) >= 1);
+}
+
+TEST_CASE("command_buffer_parallel_recording_matches_single_thread", "[command_buffer]")
+{
+	const auto record = [](CommandList* list, int begin, int end)
+	{
+		for (int index = begin; index < end; index += 1)
+		{
+			list->bind_draw(index);
+		}
+	};
+
+	std::vector<CommandList> lists;
+
+	SECTION("many items")
+	{
+		const auto count = COMMAND_SLICE_MIN_SIZE * 8 + 3;
+		record_in_parallel(&lists, count, record);
+		CHECK(lists.size() == static_cast<std::size_t>(slice_count_from_items(count)));
+
+		RecordingBackend backend;
+		replay(lists, &backend);
+		CHECK(backend.calls == draw_slots(0, count));
+	}
+
+	SECTION("lists are reused")
+	{
+		record_in_parallel(&lists, COMMAND_SLICE_MIN_SIZE * 8, record);
+		record_in_parallel(&lists, 5, record);
+		CHECK(lists.size() == 1);
+
+		RecordingBackend backend;
+		replay(lists, &backend);
+		CHECK(backend.calls == draw_slots(0, 5));
+	}
+
+	SECTION("no items")
+	{
+		record_in_parallel(&lists, 0, record);
+
+		RecordingBackend backend;
+		replay(lists, &backend);
+		CHECK(backend.calls.empty());
+	}
+}
+
+TEST_CASE("command_buffer_records_material_pass", "[command_buffer]")
+{
+	// a unlit material with a single texture and a lit material with texture arrays, light cookies and a shadow map
+	const auto unlit = make_binds(3, 0, {{0, 10, false}});
+	const auto lit = make_binds(4, 1, {{0, 20, true}, {1, 21, true}, {2, 22, true}, {3, 30, false}, {4, 31, false}});
+
+	std::vector<FakeMeshDraw> meshes;
+	const auto count = COMMAND_SLICE_MIN_SIZE * 4 + 1;
+	for (int index = 0; index < count; index += 1)
+	{
+		meshes.emplace_back(FakeMeshDraw{index % 3 == 0 ? &unlit : &lit, index, index % 5 == 0, static_cast<u32>(100 + index % 7), 36});
+	}
+
+	std::vector<CommandList> lists;
+	record_in_parallel(&lists, count,
+		[&](CommandList* list, int begin, int end)
+		{
+			for (int index = begin; index < end; index += 1)
+			{
+				const auto& mesh = meshes[static_cast<std::size_t>(index)];
+				list->write_stencil(mesh.is_outlined);
+				list->use_material(*mesh.material);
+				list->bind_draw(mesh.slot);
+				list->commands.emplace_back(RenderCommand{RenderCommandType::draw, mesh.vertex_array, 0, mesh.index_count});
+			}
+		}
+	);
+
+	std::vector<std::string> expected;
+	for (const auto& mesh: meshes)
+	{
+		expected.emplace_back(mesh.is_outlined ? "stencil write" : "stencil keep");
+		expected.emplace_back(Str() << "program " << mesh.material->program);
+		expected.emplace_back(Str() << "material " << mesh.material->block_slot);
+		if (mesh.material == &unlit)
+		{
+			expected.emplace_back("texture 0 10");
+		}
+		else
+		{
+			expected.insert(expected.end(), {"array 0 20", "array 1 21", "array 2 22", "texture 3 30", "texture 4 31"});
+		}
+		expected.emplace_back(Str() << "draw slot " << mesh.slot);
+		expected.emplace_back(Str() << "draw " << mesh.vertex_array << " " << mesh.index_count);
+	}
+
+	RecordingBackend backend;
+	replay(lists, &backend);
+	CHECK(backend.calls == expected);
+}
@@ -17,5 +17,27 @@ constexpr float OUTLINE_SCALE = 1.1f;
 
 constexpr int BLUR_SAMPLES = 10;
 
+/// the standard deviation of the bloom blur, in texels
+constexpr float BLOOM_BLUR_SIGMA = 1.75f;
+
+/// if the camera is this close to a bounding box, the mesh is considered visible since the near plane might clip the box
+constexpr float OCCLUSION_NEAR_MARGIN = 1.0f;
+
+/// the number of materials the material buffer has room for before it needs to grow
+constexpr int MATERIAL_BUFFER_INITIAL_CAPACITY = 64;
+
+/// the number of draws a segment of the draw buffer has room for before it needs to grow
+constexpr int DRAW_BUFFER_INITIAL_CAPACITY = 256;
+
+/// each render call writes the per draw data to its own segment, a segment is reused when the gpu is done with it.
+/// with a shadow pass there are two render calls per frame so this keeps around two frames in flight.
+constexpr int DRAW_BUFFER_SEGMENTS = 4;
+
+/// the fewest number of items a thread records commands for, starting a thread for fewer is slower than recording them on a single thread
+constexpr int COMMAND_SLICE_MIN_SIZE = 128;
+
+/// the most timer queries that wait for the gpu, if they are all pending the next measurement is skipped instead of waiting
+constexpr std::size_t GPU_TIMER_MAX_PENDING_QUERIES = 4;
+
 }  //  namespace klotter
 
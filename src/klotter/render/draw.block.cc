@@ -0,0 +1,267 @@
+#include "klotter/render/draw.block.h"
+
+#include "klotter/assert.h"
+#include "klotter/cint.h"
+#include "klotter/log.h"
+#include "klotter/str.h"
+
+#include "klotter/render/opengl_utils.h"
+
+#include "klotter/dependency_sdl.h"
+
+#include <cstring>
+
+namespace klotter
+{
+
+namespace
+{
+	/// the camera block is bound to 0 and the material block to 1
+	constexpr int draw_binding_point = 2;
+
+	// from ARB_buffer_storage and core in 4.4, glad is generated without them
+	constexpr GLbitfield gl_map_persistent_bit = 0x0040;
+	constexpr GLbitfield gl_map_coherent_bit = 0x0080;
+	using BufferStorageFunction = void(APIENTRYP)(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags);
+
+	constexpr GLuint64 fence_timeout_ns = 1000 * 1000;
+
+	DrawBlockLayout make_draw_block_layout()
+	{
+		DrawBlockLayout layout;
+
+		UniformBufferCompiler compiler;
+		compiler.add(&layout.world_from_local, UniformType::mat4, "u_world_from_local");
+		compiler.add(&layout.normal_from_local, UniformType::mat4, "u_normal_from_local");
+		compiler.add(&layout.tint, UniformType::vec4, "u_tint");
+		layout.setup = compiler.compile("DrawBlock", draw_binding_point);
+
+		// the draws are written with memcpy so the struct needs to match the layout
+		ASSERT(layout.world_from_local.offset == int_from_sizet(offsetof(DrawBlock, world_from_local)));
+		ASSERT(layout.normal_from_local.offset == int_from_sizet(offsetof(DrawBlock, normal_from_local)));
+		ASSERT(layout.tint.offset == int_from_sizet(offsetof(DrawBlock, tint)));
+		ASSERT(layout.setup.size >= int_from_sizet(sizeof(DrawBlock)));
+
+		return layout;
+	}
+
+	/// null if the driver can't create a buffer that stays mapped
+	BufferStorageFunction get_buffer_storage_function()
+	{
+		static const BufferStorageFunction function = []() -> BufferStorageFunction
+		{
+			GLint major = 0;
+			GLint minor = 0;
+			glGetIntegerv(GL_MAJOR_VERSION, &major);
+			glGetIntegerv(GL_MINOR_VERSION, &minor);
+			const auto is_core = major > 4 || (major == 4 && minor >= 4);
+			if (is_core == false && has_gl_extension("GL_ARB_buffer_storage") == false)
+			{
+				return nullptr;
+			}
+			return reinterpret_cast<BufferStorageFunction>(SDL_GL_GetProcAddress("glBufferStorage"));
+		}();
+		return function;
+	}
+
+	/// returns true if the gpu wasn't done with the fence and the cpu had to wait
+	bool wait_for_fence(GLsync* fence)
+	{
+		if (*fence == nullptr)
+		{
+			return false;
+		}
+
+		auto result = glClientWaitSync(*fence, 0, 0);
+		const auto stalled = result == GL_TIMEOUT_EXPIRED;
+		while (result == GL_TIMEOUT_EXPIRED)
+		{
+			result = glClientWaitSync(*fence, GL_SYNC_FLUSH_COMMANDS_BIT, fence_timeout_ns);
+		}
+
+		if (result == GL_WAIT_FAILED)
+		{
+			LOG_ERROR("Failed to wait for the draw buffer");
+		}
+
+		glDeleteSync(*fence);
+		*fence = nullptr;
+		return stalled;
+	}
+}  //  namespace
+
+const DrawBlockLayout& get_draw_block_layout()
+{
+	static const DrawBlockLayout layout = make_draw_block_layout();
+	return layout;
+}
+
+DrawBlock make_draw_block(const glm::mat4& world_from_local, const glm::vec4& tint)
+{
+	return {world_from_local, glm::mat4{glm::transpose(glm::inverse(glm::mat3{world_from_local}))}, tint};
+}
+
+DrawUniformRing::DrawUniformRing(int initial_capacity)
+	: slot_size(round_up(get_draw_block_layout().setup.size, get_uniform_buffer_offset_alignment()))
+	, capacity(std::max(initial_capacity, 1))
+	, is_persistent(get_buffer_storage_function() != nullptr)
+{
+	LOG_INFO("Draw buffer is %s", is_persistent ? "persistently mapped" : "mapped per segment");
+	create_storage();
+}
+
+DrawUniformRing::~DrawUniformRing()
+{
+	ASSERT(is_writing == false);
+	for (auto& fence: fences)
+	{
+		wait_for_fence(&fence);
+	}
+	destroy_storage();
+}
+
+int DrawUniformRing::segment_offset() const
+{
+	return segment * capacity * slot_size;
+}
+
+void DrawUniformRing::create_storage()
+{
+	buffer = klotter::create_buffer();
+	SET_DEBUG_LABEL_NAMED(buffer, DebugLabelFor::Buffer, Str() << "draw uniforms " << capacity);
+
+	const auto size = glsizeiptr_from_sizet(sizet_from_int(slot_size * capacity * DRAW_BUFFER_SEGMENTS));
+
+	// the copy target is used so the uniform buffer binding is untouched
+	glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+	if (is_persistent)
+	{
+		const GLbitfield flags = GL_MAP_WRITE_BIT | gl_map_persistent_bit | gl_map_coherent_bit;
+		get_buffer_storage_function()(GL_COPY_WRITE_BUFFER, size, nullptr, flags);
+		mapped = static_cast<std::uint8_t*>(glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, size, flags));
+		ASSERT(mapped != nullptr);
+	}
+	else
+	{
+		glBufferData(GL_COPY_WRITE_BUFFER, size, nullptr, GL_STREAM_DRAW);
+	}
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+void DrawUniformRing::destroy_storage()
+{
+	if (is_persistent)
+	{
+		glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+		glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	}
+	mapped = nullptr;
+	klotter::destroy_buffer(buffer);
+	buffer = 0;
+}
+
+void DrawUniformRing::begin_writing(int count)
+{
+	ASSERT(is_writing == false);
+	segment = (segment + 1) % DRAW_BUFFER_SEGMENTS;
+	bound_slot = -1;
+
+	if (count > capacity)
+	{
+		// all segments move, so wait for the gpu to be done with all of them
+		for (auto& fence: fences)
+		{
+			if (wait_for_fence(&fence))
+			{
+				stalls += 1;
+			}
+		}
+		destroy_storage();
+		while (capacity < count)
+		{
+			capacity *= 2;
+		}
+		LOG_INFO("Draw buffer grew to %d draws", capacity);
+		create_storage();
+	}
+	else if (wait_for_fence(&fences[sizet_from_int(segment)]))
+	{
+		stalls += 1;
+	}
+
+	if (is_persistent == false)
+	{
+		// the fence already guards the segment, so the driver doesn't need to synchronize
+		const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT;
+		glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+		mapped = static_cast<std::uint8_t*>(glMapBufferRange(GL_COPY_WRITE_BUFFER, segment_offset(), capacity * slot_size, flags));
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+		ASSERT(mapped != nullptr);
+	}
+
+	written = 0;
+	is_writing = true;
+}
+
+int DrawUniformRing::write(const DrawBlock& block)
+{
+	const auto slot = reserve(1);
+	write_at(slot, block);
+	return slot;
+}
+
+int DrawUniformRing::reserve(int count)
+{
+	ASSERT(is_writing);
+	ASSERT(count >= 0 && written + count <= capacity);
+
+	const auto first = written;
+	written += count;
+	return first;
+}
+
+void DrawUniformRing::write_at(int slot, const DrawBlock& block)
+{
+	ASSERT(is_writing);
+	ASSERT(slot >= 0 && slot < written);
+
+	auto* segment_start = is_persistent ? mapped + segment_offset() : mapped;
+	std::memcpy(segment_start + sizet_from_int(slot * slot_size), &block, sizeof(DrawBlock));
+}
+
+void DrawUniformRing::end_writing()
+{
+	ASSERT(is_writing);
+	is_writing = false;
+
+	if (is_persistent == false)
+	{
+		glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+		glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+		mapped = nullptr;
+	}
+}
+
+void DrawUniformRing::bind(int slot)
+{
+	if (bound_slot == slot)
+	{
+		return;
+	}
+
+	ASSERT(is_writing == false);
+	ASSERT(slot >= 0 && slot < written);
+	bind_uniform_buffer_range(buffer, draw_binding_point, segment_offset() + slot * slot_size, get_draw_block_layout().setup.size);
+	bound_slot = slot;
+}
+
+void DrawUniformRing::end_drawing()
+{
+	ASSERT(is_writing == false);
+	ASSERT(fences[sizet_from_int(segment)] == nullptr);
+	fences[sizet_from_int(segment)] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+}  //  namespace klotter
@@ -0,0 +1,107 @@
+#pragma once
+
+#include "klotter/render/constants.h"
+#include "klotter/render/uniform_buffer.h"
+
+#include "klotter/dependency_glad.h"
+
+namespace klotter
+{
+
+/** \addtogroup render Renderer
+ *  @{
+*/
+
+/// The layout of the per draw data of meshes that aren't instanced, instanced meshes get the transform from a attribute.
+/// Accessed as u_world_from_local, u_normal_from_local and u_tint in the vertex shader.
+struct DrawBlockLayout
+{
+	UniformBufferSetup setup;
+
+	CompiledUniformProp world_from_local;
+	CompiledUniformProp normal_from_local;  ///< a mat3 stored as a mat4 since std140 pads the columns anyway
+	CompiledUniformProp tint;  ///< linear color that is multiplied with the vertex color
+};
+
+/// The layout doesn't depend on any settings so it's compiled once.
+const DrawBlockLayout& get_draw_block_layout();
+
+/// The per draw data as written to the buffer, matches the std140 layout of \ref DrawBlockLayout
+struct DrawBlock
+{
+	glm::mat4 world_from_local;
+	glm::mat4 normal_from_local;
+	glm::vec4 tint;
+};
+
+/// Calculates the normal matrix on the cpu so the shader doesn't need to invert a matrix per vertex.
+DrawBlock make_draw_block(const glm::mat4& world_from_local, const glm::vec4& tint = glm::vec4{1.0f});
+
+/** The per draw data of all draws in a render call, written before drawing and selected with a bound range.
+ * The buffer is split in \ref DRAW_BUFFER_SEGMENTS segments and each render call writes to the next one.
+ * A fence guards each segment so the cpu doesn't overwrite data the gpu is still reading.
+ * If the driver supports it the buffer is mapped once, otherwise the segment is mapped while writing.
+ */
+struct DrawUniformRing
+{
+	explicit DrawUniformRing(int initial_capacity);
+	~DrawUniformRing();
+
+	DrawUniformRing(const DrawUniformRing&) = delete;
+	DrawUniformRing(DrawUniformRing&&) = delete;
+	void operator=(const DrawUniformRing&) = delete;
+	void operator=(DrawUniformRing&&) = delete;
+
+	/// Start writing the next segment, waits if the gpu is still reading it and grows the buffer if count doesn't fit.
+	void begin_writing(int count);
+
+	/// Write the data of a draw and return the slot.
+	int write(const DrawBlock& block);
+
+	/// Reserve count slots and return the first, the slots are written with \ref write_at.
+	int reserve(int count);
+
+	/// Write the data of a reserved slot, different slots can be written from different threads.
+	void write_at(int slot, const DrawBlock& block);
+
+	/// Stop writing, the written slots can be bound after this.
+	void end_writing();
+
+	/// Bind a slot of the current segment to the draw binding point, does nothing if it's already bound.
+	void bind(int slot);
+
+	/// Call when all draws of the segment has been issued, the segment is reused when the gpu is done with them.
+	void end_drawing();
+
+	/// the size of a slot, the size of the block rounded up to the offset alignment of the driver
+	int slot_size;
+
+	/// the number of slots in a segment
+	int capacity;
+
+	/// true if the buffer is mapped once, false if each segment is mapped when writing
+	bool is_persistent;
+
+	unsigned int buffer = 0;
+	std::uint8_t* mapped = nullptr;  ///< the start of the buffer if persistent, the start of the current segment if not
+
+	int segment = DRAW_BUFFER_SEGMENTS - 1;
+	int written = 0;
+	bool is_writing = false;
+	int bound_slot = -1;
+	std::array<GLsync, DRAW_BUFFER_SEGMENTS> fences = {};
+
+	/// number of times the cpu had to wait for the gpu before writing
+	int stalls = 0;
+
+   private:
+	void create_storage();
+	void destroy_storage();
+	[[nodiscard]] int segment_offset() const;
+};
+
+/**
+ * @}
+*/
+
+}  //  namespace klotter
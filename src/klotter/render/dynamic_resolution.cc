@@ -0,0 +1,60 @@
+#include "klotter/render/dynamic_resolution.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace klotter
+{
+
+void DynamicResolution::update(float frame_time)
+{
+	if (enabled == false)
+	{
+		scale = max_scale;
+		frames_over_budget = 0;
+		frames_under_budget = 0;
+		return;
+	}
+
+	// count how long the frame time has been outside of the budget
+	if (frame_time > target_frame_time * (1.0f + headroom))
+	{
+		frames_over_budget += 1;
+		frames_under_budget = 0;
+	}
+	else if (frame_time < target_frame_time * (1.0f - headroom))
+	{
+		frames_under_budget += 1;
+		frames_over_budget = 0;
+	}
+	else
+	{
+		frames_over_budget = 0;
+		frames_under_budget = 0;
+	}
+
+	if (frames_over_budget >= frames_before_lowering)
+	{
+		scale = std::max(min_scale, scale - scale_step);
+		frames_over_budget = 0;
+	}
+	else if (frames_under_budget >= frames_before_raising)
+	{
+		scale = std::min(max_scale, scale + scale_step);
+		frames_under_budget = 0;
+	}
+}
+
+glm::ivec2 DynamicResolution::get_render_size(const glm::ivec2& window_size) const
+{
+	return get_scaled_size(window_size);
+}
+
+glm::ivec2 DynamicResolution::get_scaled_size(const glm::ivec2& size) const
+{
+	const auto s = enabled ? scale : 1.0f;
+	const auto scale_axis = [s](int v) { return std::clamp(static_cast<int>(std::round(static_cast<float>(v) * s)), 1, std::max(1, v)); };
+	return {scale_axis(size.x), scale_axis(size.y)};
+}
+
+}  //  namespace klotter
@@ -0,0 +1,55 @@
+#pragma once
+
+namespace klotter
+{
+
+/** \addtogroup postproc Post Processing
+ *  @{
+*/
+
+/// Scales the resolution the world is rendered at to keep the frame time within a budget.
+/// The frame time has to stay outside of the budget for several frames in a row before the scale is changed,
+/// so a single spike doesn't change the resolution and the scale doesn't flicker between two values.
+struct DynamicResolution
+{
+	bool enabled = false;
+
+	/// the target frame time, in seconds
+	float target_frame_time = 1.0f / 60.0f;
+
+	float min_scale = 0.5f;
+	float max_scale = 1.0f;
+
+	/// how much the scale changes in one step
+	float scale_step = 0.05f;
+
+	/// the frame time needs to be this fraction above or below the target before the scale is changed
+	float headroom = 0.1f;
+
+	/// how many frames the frame time needs to be over or under the budget before the scale is changed.
+	/// lowering the scale is faster than raising it, so a heavy scene is handled quickly but the scale recovers slowly.
+	int frames_before_lowering = 5;
+	int frames_before_raising = 30;
+
+	/// the current scale of the render resolution
+	float scale = 1.0f;
+
+	int frames_over_budget = 0;
+	int frames_under_budget = 0;
+
+	/// update the scale from the time it took to render a frame, in seconds.
+	/// don't include waiting for vsync, a frame would then never be under the budget and the scale would never be raised
+	void update(float frame_time);
+
+	/// the size to render at, the scale is applied to both axis
+	[[nodiscard]] glm::ivec2 get_render_size(const glm::ivec2& window_size) const;
+
+	/// the size of a part of a buffer, like a bloom mip, when it's rendered at the current scale
+	[[nodiscard]] glm::ivec2 get_scaled_size(const glm::ivec2& size) const;
+};
+
+/**
+ * @}
+*/
+
+}  //  namespace klotter
@@ -0,0 +1,78 @@
+#include "klotter/render/dynamic_resolution.h"
+
+#include "catch2/catch_test_macros.hpp"
+
+
+using namespace klotter;
+
+namespace
+{
+	constexpr float budget = 1.0f / 60.0f;
+
+	DynamicResolution make_enabled()
+	{
+		DynamicResolution dr;
+		dr.enabled = true;
+		dr.target_frame_time = budget;
+		return dr;
+	}
+
+	void run_frames(DynamicResolution* dr, int count, float frame_time)
+	{
+		for (int frame = 0; frame < count; frame += 1)
+		{
+			dr->update(frame_time);
+		}
+	}
+}
+
+TEST_CASE("dynamic_resolution_within_budget_keeps_scale", "[dynamic_resolution]")
+{
+	auto dr = make_enabled();
+	run_frames(&dr, 200, budget);
+	CHECK(dr.scale == dr.max_scale);
+}
+
+TEST_CASE("dynamic_resolution_over_budget_lowers_scale_to_min", "[dynamic_resolution]")
+{
+	auto dr = make_enabled();
+
+	run_frames(&dr, 10, budget * 2.0f);
+	CHECK(dr.scale < dr.max_scale);
+
+	run_frames(&dr, 1000, budget * 2.0f);
+	CHECK(dr.scale == dr.min_scale);
+}
+
+TEST_CASE("dynamic_resolution_single_spike_is_ignored", "[dynamic_resolution]")
+{
+	auto dr = make_enabled();
+	run_frames(&dr, 100, budget);
+	dr.update(budget * 4.0f);
+	run_frames(&dr, 100, budget);
+	CHECK(dr.scale == dr.max_scale);
+}
+
+TEST_CASE("dynamic_resolution_under_budget_raises_scale_slowly", "[dynamic_resolution]")
+{
+	auto dr = make_enabled();
+	dr.scale = dr.min_scale;
+
+	// raising needs more frames than lowering
+	run_frames(&dr, dr.frames_before_lowering, budget * 0.5f);
+	CHECK(dr.scale == dr.min_scale);
+
+	run_frames(&dr, 1000, budget * 0.5f);
+	CHECK(dr.scale == dr.max_scale);
+}
+
+TEST_CASE("dynamic_resolution_render_size", "[dynamic_resolution]")
+{
+	auto dr = make_enabled();
+	dr.scale = 0.5f;
+	CHECK(dr.get_render_size({1920, 1080}) == glm::ivec2{960, 540});
+	CHECK(dr.get_scaled_size({1, 1}) == glm::ivec2{1, 1});
+
+	dr.enabled = false;
+	CHECK(dr.get_render_size({1920, 1080}) == glm::ivec2{1920, 1080});
+}
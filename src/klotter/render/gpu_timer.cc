@@ -0,0 +1,76 @@
+#include "klotter/render/gpu_timer.h"
+
+#include "klotter/assert.h"
+#include "klotter/log.h"
+
+#include "klotter/render/constants.h"
+#include "klotter/render/opengl_utils.h"
+
+#include "klotter/dependency_glad.h"
+
+namespace klotter
+{
+
+void GpuTimer::begin()
+{
+	ASSERT(active.has_value() == false);
+
+	if (is_supported.has_value() == false)
+	{
+		is_supported = GLVersion.major > 3 || (GLVersion.major == 3 && GLVersion.minor >= 3) || has_gl_extension("GL_ARB_timer_query");
+		if (*is_supported == false)
+		{
+			LOG_ERROR("Timer queries are not supported, the gpu time is not measured");
+		}
+	}
+
+	// skip this measurement instead of stalling if the gpu is far behind
+	if (*is_supported == false || pending.size() >= GPU_TIMER_MAX_PENDING_QUERIES)
+	{
+		return;
+	}
+
+	active = pool.acquire();
+	glBeginQuery(GL_TIME_ELAPSED, *active);
+}
+
+void GpuTimer::end()
+{
+	if (active.has_value() == false)
+	{
+		return;
+	}
+
+	glEndQuery(GL_TIME_ELAPSED);
+	pending.emplace_back(*active);
+	active.reset();
+}
+
+std::optional<float> GpuTimer::read()
+{
+	std::optional<float> latest;
+
+	// queries complete in order, so stop at the first one that isn't ready
+	while (pending.empty() == false)
+	{
+		const auto query = pending.front();
+
+		GLuint available = GL_FALSE;
+		glGetQueryObjectuiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+		if (available == GL_FALSE)
+		{
+			break;
+		}
+
+		GLuint64 nanoseconds = 0;
+		glGetQueryObjectui64v(query, GL_QUERY_RESULT, &nanoseconds);
+		latest = static_cast<float>(nanoseconds) / 1'000'000'000.0f;
+
+		pool.release(query);
+		pending.pop_front();
+	}
+
+	return latest;
+}
+
+}  //  namespace klotter
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "klotter/render/query_pool.h"
+
+#include <deque>
+
+namespace klotter
+{
+
+/** \addtogroup render Renderer
+ *  @{
+*/
+
+/// Measures how long the gpu spends on the commands between \ref begin and \ref end, with timer queries.
+/// Unlike the frame time this doesn't include waiting for vsync.
+/// The results are read back a few frames later when they are ready, so measuring never waits for the gpu.
+struct GpuTimer
+{
+	QueryPool pool{get_gl_query_backend()};
+
+	/// the queries that have ended but haven't been read back, oldest first
+	std::deque<u32> pending;
+
+	std::optional<u32> active;
+
+	/// checked on the first \ref begin, timer queries needs gl 3.3 or ARB_timer_query
+	std::optional<bool> is_supported;
+
+	void begin();
+	void end();
+
+	/// The newest result that has been read back since the last call, in seconds.
+	[[nodiscard]] std::optional<float> read();
+};
+
+/**
+ * @}
+*/
+
+}  //  namespace klotter
@@ -5,6 +5,7 @@
 #include "klotter/render/opengl_utils.h"
 #include "klotter/render/camera.h"
 #include "klotter/render/color.h"
+#include "klotter/render/state.h"
 
 #include "klotter/dependency_glad.h"
 
@@ -12,10 +13,11 @@ constexpr auto vertices_per_line = 2;
 
 namespace klotter
 {
-LineDrawer::LineDrawer()
+LineDrawer::LineDrawer(State* s)
 	// todo(Gustav): expand shader with stipple pattern https://stackoverflow.com/questions/52928678/dashed-line-in-opengl3/54543267#54543267
 	// todo(Gustav): move `description` and `layout` to a separate setup
-	: description({{VertexType::position3, "a_world_position"}, {VertexType::color3, "a_color"}})
+	: states(s)
+	, description({{VertexType::position3, "a_world_position"}, {VertexType::color3, "a_color"}})
 	, layout(compile_shader_layout(compile_attribute_layouts({description}), description, std::nullopt, std::nullopt))
 	, shader(
 		  USE_DEBUG_LABEL_MANY("debug line")
@@ -82,18 +84,18 @@ LineDrawer::LineDrawer()
 		)glsl",
 		  layout
 	  )
-	, clip_from_view_uni(shader.get_uniform("u_clip_from_view"))
-	, view_from_world_uni(shader.get_uniform("u_view_from_world"))
-	, resolution_uni(shader.get_uniform("u_resolution"))
-	, dash_size_uni(shader.get_uniform("u_dash_size"))
-	, gap_size_uni(shader.get_uniform("u_gap_size"))
+	, clip_from_view_uni(shader.get_uniform("u_clip_from_view", UniformKind::mat4))
+	, view_from_world_uni(shader.get_uniform("u_view_from_world", UniformKind::mat4))
+	, resolution_uni(shader.get_uniform("u_resolution", UniformKind::vec2))
+	, dash_size_uni(shader.get_uniform("u_dash_size", UniformKind::float_type))
+	, gap_size_uni(shader.get_uniform("u_gap_size", UniformKind::float_type))
 	, va(create_vertex_array())
 	, vb(create_buffer())
 	, ib(create_buffer())
 {
-	shader.use();
+	shader.use(states);
 
-	glBindVertexArray(va);
+	StateChanger{states}.bind_vertex_array(va);
 	SET_DEBUG_LABEL_NAMED(va, DebugLabelFor::VertexArray, "VERT line batch"sv);
 
 	constexpr auto attributes_per_vertex = 2;
@@ -104,7 +106,7 @@ LineDrawer::LineDrawer()
 	constexpr auto max_vertices = vertices_per_line * max_lines;
 	constexpr auto max_indices = vertices_per_line * max_lines;
 
-	glBindBuffer(GL_ARRAY_BUFFER, vb);
+	StateChanger{states}.bind_array_buffer(vb);
 	SET_DEBUG_LABEL_NAMED(vb, DebugLabelFor::Buffer, "ARR BUF line batch"sv);
 	glBufferData(GL_ARRAY_BUFFER, vertex_size * max_vertices, nullptr, GL_DYNAMIC_DRAW);
 
@@ -151,6 +153,8 @@ LineDrawer::~LineDrawer()
 
 	glBindVertexArray(0);
 	destroy_vertex_array(va);
+
+	invalidate_state_bindings();
 }
 
 void LineDrawer::set_line_to_dash(const glm::vec2& resolution, float dash_size, float gap_size)
@@ -211,9 +215,7 @@ void LineDrawer::submit()
 
 	// note: this assumes set_camera has been called
 
-	glBindVertexArray(va);
-
-	glBindBuffer(GL_ARRAY_BUFFER, vb);
+	StateChanger{states}.bind_vertex_array(va).bind_array_buffer(vb);
 	glBufferSubData(
 		GL_ARRAY_BUFFER, 0, static_cast<GLsizeiptr>(sizeof(float) * data.size()), static_cast<const void*>(data.data())
 	);
@@ -7,6 +7,7 @@ namespace klotter
 
 struct CompiledCamera;
 struct Lin_rgb;
+struct State;
 
 /// A utility to draw 3d lines.
 /// Helps to batch lines for rendering.
@@ -14,6 +15,7 @@ struct LineDrawer
 {
 	static constexpr int max_lines = 100;
 
+	State* states;
 	ShaderVertexAttributes description;
 	CompiledShaderVertexAttributes layout;
 	ShaderProgram shader;
@@ -29,7 +31,7 @@ struct LineDrawer
 	u32 vb;
 	u32 ib;
 
-	LineDrawer();
+	explicit LineDrawer(State* s);
 	~LineDrawer();
 
 	LineDrawer(const LineDrawer&) = delete;
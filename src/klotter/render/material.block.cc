@@ -0,0 +1,136 @@
+#include "klotter/render/material.block.h"
+
+#include "klotter/assert.h"
+#include "klotter/cint.h"
+#include "klotter/str.h"
+
+#include "klotter/render/opengl_labels.h"
+#include "klotter/render/opengl_utils.h"
+
+namespace klotter
+{
+
+namespace
+{
+	/// the camera block is bound to 0
+	constexpr int material_binding_point = 1;
+
+	MaterialBlockLayout make_material_block_layout()
+	{
+		MaterialBlockLayout layout;
+
+		// ordered so the scalars fill the space after the vec3s
+		UniformBufferCompiler compiler;
+		compiler.add(&layout.diffuse_tint, UniformType::vec4, "diffuse_tint");
+		compiler.add(&layout.diffuse_rect, UniformType::vec4, "diffuse_rect");
+		compiler.add(&layout.specular_rect, UniformType::vec4, "specular_rect");
+		compiler.add(&layout.emissive_rect, UniformType::vec4, "emissive_rect");
+		compiler.add(&layout.ambient_tint, UniformType::vec3, "ambient_tint");
+		compiler.add(&layout.shininess, UniformType::float_type, "shininess");
+		compiler.add(&layout.specular_tint, UniformType::vec3, "specular_tint");
+		compiler.add(&layout.emissive_factor, UniformType::float_type, "emissive_factor");
+		compiler.add(&layout.diffuse_layer, UniformType::float_type, "diffuse_layer");
+		compiler.add(&layout.specular_layer, UniformType::float_type, "specular_layer");
+		compiler.add(&layout.emissive_layer, UniformType::float_type, "emissive_layer");
+		layout.setup = compiler.compile("MaterialBlock", material_binding_point, "u_material");
+
+		return layout;
+	}
+
+	std::unique_ptr<UniformBuffer> make_material_buffer(int slot_size, int capacity)
+	{
+		auto setup = get_material_block_layout().setup;
+		setup.size = slot_size * capacity;
+		return std::make_unique<UniformBuffer>(USE_DEBUG_LABEL_MANY(Str() << "materials " << capacity) setup);
+	}
+}  //  namespace
+
+const MaterialBlockLayout& get_material_block_layout()
+{
+	static const MaterialBlockLayout layout = make_material_block_layout();
+	return layout;
+}
+
+MaterialUniformBuffer::MaterialUniformBuffer(int initial_capacity)
+	: slot_size(round_up(get_material_block_layout().setup.size, get_uniform_buffer_offset_alignment()))
+	, capacity(std::max(initial_capacity, 1))
+	, buffer(make_material_buffer(slot_size, capacity))
+{
+}
+
+int MaterialUniformBuffer::allocate()
+{
+	if (free_slots.empty() == false)
+	{
+		const auto slot = free_slots.back();
+		free_slots.pop_back();
+		return slot;
+	}
+
+	if (next_slot == capacity)
+	{
+		// the ranges keep their offsets so the materials don't need to upload again
+		auto larger = make_material_buffer(slot_size, capacity * 2);
+		copy_uniform_buffer(*buffer, larger.get(), slot_size * capacity);
+		buffer = std::move(larger);
+		capacity *= 2;
+		bound_slot = -1;
+	}
+
+	const auto slot = next_slot;
+	next_slot += 1;
+	return slot;
+}
+
+void MaterialUniformBuffer::release(int slot)
+{
+	ASSERT(slot >= 0 && slot < next_slot);
+	free_slots.emplace_back(slot);
+}
+
+void MaterialUniformBuffer::upload(int slot, const UniformBlockData& data)
+{
+	ASSERT(slot >= 0 && slot < next_slot);
+	buffer->set_data(slot * slot_size, data);
+}
+
+void MaterialUniformBuffer::bind(int slot)
+{
+	if (bound_slot == slot)
+	{
+		return;
+	}
+
+	ASSERT(slot >= 0 && slot < next_slot);
+	buffer->bind_range(material_binding_point, slot * slot_size, get_material_block_layout().setup.size);
+	bound_slot = slot;
+}
+
+MaterialBlock::MaterialBlock(std::shared_ptr<MaterialUniformBuffer> b)
+	: buffer(std::move(b))
+	, slot(buffer->allocate())
+	, data(get_material_block_layout().setup)
+{
+}
+
+MaterialBlock::~MaterialBlock()
+{
+	buffer->release(slot);
+}
+
+void MaterialBlock::update()
+{
+	if (is_dirty)
+	{
+		buffer->upload(slot, data);
+		is_dirty = false;
+	}
+}
+
+void MaterialBlock::bind()
+{
+	update();
+	buffer->bind(slot);
+}
+
+}  //  namespace klotter
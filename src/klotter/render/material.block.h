@@ -0,0 +1,93 @@
+#pragma once
+
+#include "klotter/render/uniform_buffer.h"
+
+namespace klotter
+{
+
+/** \addtogroup render Renderer
+ *  @{
+*/
+
+/// The layout of the material parameters, shared by all materials and the shaders that draw them.
+/// Accessed as u_material.prop in the shaders.
+struct MaterialBlockLayout
+{
+	UniformBufferSetup setup;
+
+	CompiledUniformProp diffuse_tint;  ///< linear diffuse color and alpha
+	CompiledUniformProp diffuse_rect;
+	CompiledUniformProp specular_rect;
+	CompiledUniformProp emissive_rect;
+	CompiledUniformProp ambient_tint;
+	CompiledUniformProp shininess;
+	CompiledUniformProp specular_tint;
+	CompiledUniformProp emissive_factor;
+	CompiledUniformProp diffuse_layer;
+	CompiledUniformProp specular_layer;
+	CompiledUniformProp emissive_layer;
+};
+
+/// The layout doesn't depend on any settings so it's compiled once.
+const MaterialBlockLayout& get_material_block_layout();
+
+/// The parameters of all materials in a single buffer, each material has its own range that is bound when drawing.
+struct MaterialUniformBuffer
+{
+	explicit MaterialUniformBuffer(int initial_capacity);
+
+	MaterialUniformBuffer(const MaterialUniformBuffer&) = delete;
+	MaterialUniformBuffer(MaterialUniformBuffer&&) = delete;
+	void operator=(const MaterialUniformBuffer&) = delete;
+	void operator=(MaterialUniformBuffer&&) = delete;
+
+	/// Get a unused range, grows the buffer if needed.
+	int allocate();
+	void release(int slot);
+
+	void upload(int slot, const UniformBlockData& data);
+
+	/// Bind the range of a slot to the material binding point, does nothing if it's already bound.
+	void bind(int slot);
+
+	/// the size of a range, the size of the block rounded up to the offset alignment of the driver
+	int slot_size;
+	int capacity;
+	int next_slot = 0;
+	std::vector<int> free_slots;
+	int bound_slot = -1;
+
+	std::unique_ptr<UniformBuffer> buffer;
+};
+
+/// The parameters of a single material.
+/// The block is only uploaded when it has changed, drawing with a unchanged material only binds the range.
+struct MaterialBlock
+{
+	explicit MaterialBlock(std::shared_ptr<MaterialUniformBuffer> b);
+	~MaterialBlock();
+
+	MaterialBlock(const MaterialBlock&) = delete;
+	MaterialBlock(MaterialBlock&&) = delete;
+	void operator=(const MaterialBlock&) = delete;
+	void operator=(MaterialBlock&&) = delete;
+
+	/// Upload the block if it's dirty.
+	void update();
+
+	/// Upload the block if it's dirty and bind it.
+	void bind();
+
+	std::shared_ptr<MaterialUniformBuffer> buffer;
+	int slot;
+
+	/// set the values here and mark it as dirty
+	UniformBlockData data;
+	bool is_dirty = true;
+};
+
+/**
+ * @}
+*/
+
+}  //  namespace klotter
@@ -1,4 +1,4 @@
-#include "klotter/render/material.h"
+﻿#include "klotter/render/material.h"
 
 #include "klotter/assert.h"
 #include "klotter/cint.h"
@@ -17,54 +17,45 @@
 namespace klotter
 {
 
-UnlitMaterial::UnlitMaterial(const ShaderResource& resource)
-	: shader_container(&resource.unlit_shader_container)
+void MaterialBinds::add_texture(const Uniform& uniform, u32 texture, bool is_array)
 {
-}
+	if (uniform.is_valid() == false)
+	{
+		return;
+	}
+	ASSERT(uniform.texture >= 0);
+	ASSERT(sizet_from_int(texture_count) < textures.size());
 
-void UnlitMaterial::use_shader(const RenderContext& rc)
-{
-	shader_from_container(*shader_container, rc).program->use();
+	textures[sizet_from_int(texture_count)] = TextureBind{uniform.texture, texture, is_array};
+	texture_count += 1;
 }
 
-void set_optional_mat(
-	ShaderProgram* program, const std::optional<Uniform>& uniform, const std::optional<glm::mat4>& transform
-)
+UnlitMaterial::UnlitMaterial(const ShaderResource& resource)
+	: shader_container(&resource.unlit_shader_container)
+	, block(resource.material_buffer)
 {
-	if (uniform && transform)
-	{
-		program->set_mat(*uniform, *transform);
-	}
-	else
-	{
-		assert(uniform.has_value() == false);
-		assert(transform.has_value() == false);
-	}
 }
 
-void UnlitMaterial::set_uniforms(
-	const RenderContext& rc, const CompiledCamera&, const std::optional<glm::mat4>& world_from_local
-)
+MaterialBinds UnlitMaterial::prepare(const RenderContext& rc, const CompiledCamera&, const Lights&, const RenderSettings&, State* states, Assets* assets)
 {
 	const auto& shader = shader_from_container(*shader_container, rc);
-	shader.program->set_vec4(shader.tint_color_uni, {linear_from_srgb(color, rc.gamma).linear, alpha});
-	set_optional_mat(shader.program.get(), shader.world_from_local_uni, world_from_local);
-}
+	shader.program->use(states);
 
-void UnlitMaterial::bind_textures(const RenderContext& rc, State* states, Assets* assets)
-{
-	std::shared_ptr<Texture2d> t = texture;
-	if (t == nullptr)
+	const auto source = std::array<float, 5>{color.r, color.g, color.b, alpha, rc.gamma};
+	if (block_source != source)
 	{
-		t = assets->get_white();
+		block.data.set_vec4(get_material_block_layout().diffuse_tint, {linear_from_srgb(color, rc.gamma).linear, alpha});
+		block.is_dirty = true;
+		block_source = source;
 	}
+	block.update();
 
-	bind_texture_2d(states, shader_from_container(*shader_container, rc).tex_diffuse_uniform, *t);
-}
-
-void UnlitMaterial::apply_lights(const RenderContext&, const Lights&, const RenderSettings&, State*, Assets*)
-{
 	// no lights for unlit material
+	MaterialBinds binds;
+	binds.program = shader.program->shader_program;
+	binds.block_slot = block.slot;
+	binds.add_texture(shader.tex_diffuse_uniform, (texture != nullptr ? texture : assets->get_white())->id);
+	return binds;
 }
 
 bool UnlitMaterial::is_transparent() const
@@ -73,30 +64,58 @@ bool UnlitMaterial::is_transparent() const
 	return alpha < ALPHA_TRANSPARENCY_LIMIT;
 }
 
+std::uint64_t UnlitMaterial::get_batch_key() const
+{
+	return texture ? texture->id : 0;
+}
+
 DefaultMaterial::DefaultMaterial(const ShaderResource& resource)
 	: shader_container(&resource.default_shader_container)
+	, block(resource.material_buffer)
 {
 }
 
-void DefaultMaterial::use_shader(const RenderContext& rc)
+const LoadedShader_Default& DefaultMaterial::get_shader(const RenderContext& rc) const
 {
-	shader_from_container(*shader_container, rc).program->use();
+	return shader_from_container(*shader_container, rc, array_textures ? UseTextureArrays::yes : UseTextureArrays::no);
 }
 
-void DefaultMaterial::set_uniforms(
-	const RenderContext& rc, const CompiledCamera& cc, const std::optional<glm::mat4>& world_from_local
-)
+void DefaultMaterial::update_block(const RenderContext& rc)
 {
-	const auto& shader = shader_from_container(*shader_container, rc);
-
-	shader.program->set_vec4(shader.tint_color_uni, {linear_from_srgb(color, rc.gamma).linear, alpha});
-	shader.program->set_vec3(shader.ambient_tint_uni, linear_from_srgb(ambient_tint, rc.gamma).linear);
-	shader.program->set_vec3(shader.specular_color_uni, linear_from_srgb(specular_color, rc.gamma).linear);
-	shader.program->set_float(shader.shininess_uni, shininess);
-	shader.program->set_float(shader.emissive_factor_uni, emissive_factor);
+	// the full texture and the first layer if not sampling from texture arrays
+	const auto no_array_texture = MaterialTexture{};
+	const auto& diffuse_array = array_textures ? array_textures->diffuse : no_array_texture;
+	const auto& specular_array = array_textures ? array_textures->specular : no_array_texture;
+	const auto& emissive_array = array_textures ? array_textures->emissive : no_array_texture;
 
-	set_optional_mat(shader.program.get(), shader.world_from_local_uni, world_from_local);
-	shader.program->set_vec3(shader.view_position_uni, cc.position);
+	const auto source = std::array<float, 28>{
+		color.r, color.g, color.b, alpha,
+		ambient_tint.r, ambient_tint.g, ambient_tint.b,
+		specular_color.r, specular_color.g, specular_color.b,
+		shininess, emissive_factor, rc.gamma,
+		diffuse_array.uv_rect.x, diffuse_array.uv_rect.y, diffuse_array.uv_rect.z, diffuse_array.uv_rect.w,
+		specular_array.uv_rect.x, specular_array.uv_rect.y, specular_array.uv_rect.z, specular_array.uv_rect.w,
+		emissive_array.uv_rect.x, emissive_array.uv_rect.y, emissive_array.uv_rect.z, emissive_array.uv_rect.w,
+		float_from_int(diffuse_array.layer), float_from_int(specular_array.layer), float_from_int(emissive_array.layer)
+	};
+	if (block_source != source)
+	{
+		const auto& layout = get_material_block_layout();
+		block.data.set_vec4(layout.diffuse_tint, {linear_from_srgb(color, rc.gamma).linear, alpha});
+		block.data.set_vec3(layout.ambient_tint, linear_from_srgb(ambient_tint, rc.gamma).linear);
+		block.data.set_vec3(layout.specular_tint, linear_from_srgb(specular_color, rc.gamma).linear);
+		block.data.set_float(layout.shininess, shininess);
+		block.data.set_float(layout.emissive_factor, emissive_factor);
+		block.data.set_vec4(layout.diffuse_rect, diffuse_array.uv_rect);
+		block.data.set_float(layout.diffuse_layer, float_from_int(diffuse_array.layer));
+		block.data.set_vec4(layout.specular_rect, specular_array.uv_rect);
+		block.data.set_float(layout.specular_layer, float_from_int(specular_array.layer));
+		block.data.set_vec4(layout.emissive_rect, emissive_array.uv_rect);
+		block.data.set_float(layout.emissive_layer, float_from_int(emissive_array.layer));
+		block.is_dirty = true;
+		block_source = source;
+	}
+	block.update();
 }
 
 std::shared_ptr<Texture2d> get_or_white(Assets* assets, std::shared_ptr<Texture2d> t)
@@ -123,19 +142,33 @@ std::shared_ptr<Texture2d> get_or_black(Assets* assets, std::shared_ptr<Texture2
 	}
 };
 
-void DefaultMaterial::bind_textures(const RenderContext& rc, State* states, Assets* assets)
-{
-	const auto& shader = shader_from_container(*shader_container, rc);
-	bind_texture_2d(states, shader.tex_diffuse_uniform, *get_or_white(assets, diffuse));
-	bind_texture_2d(states, shader.tex_specular_uniform, *get_or_white(assets, specular));
-	bind_texture_2d(states, shader.tex_emissive_uniform, *get_or_black(assets, emissive));
-}
-
-void DefaultMaterial::apply_lights(
-	const RenderContext& rc, const Lights& lights, const RenderSettings& settings, State* states, Assets* assets
+MaterialBinds DefaultMaterial::prepare(
+	const RenderContext& rc, const CompiledCamera& cc, const Lights& lights, const RenderSettings& settings, State* states, Assets* assets
 )
 {
-	const auto& shader = shader_from_container(*shader_container, rc);
+	const auto& shader = get_shader(rc);
+	update_block(rc);
+
+	MaterialBinds binds;
+	binds.program = shader.program->shader_program;
+	binds.block_slot = block.slot;
+
+	if (array_textures)
+	{
+		binds.add_texture(shader.tex_diffuse_uniform, array_textures->diffuse.array->id, true);
+		binds.add_texture(shader.tex_specular_uniform, array_textures->specular.array->id, true);
+		binds.add_texture(shader.tex_emissive_uniform, array_textures->emissive.array->id, true);
+	}
+	else
+	{
+		binds.add_texture(shader.tex_diffuse_uniform, get_or_white(assets, diffuse)->id);
+		binds.add_texture(shader.tex_specular_uniform, get_or_white(assets, specular)->id);
+		binds.add_texture(shader.tex_emissive_uniform, get_or_black(assets, emissive)->id);
+	}
+
+	// the camera and the lights are the same for all meshes, so they are set on the program and not per draw
+	shader.program->use(states);
+	shader.program->set_vec3(shader.view_position_uni, cc.position);
 	shader.program->set_vec3(shader.light_ambient_color_uni, linear_from_srgb(lights.ambient_color, rc.gamma).linear * lights.ambient_strength);
 
 	constexpr auto no_directional_light = ([]() {
@@ -200,24 +233,20 @@ void DefaultMaterial::apply_lights(
 		const auto clip_from_view = glm::perspective(glm::radians(p.fov), p.aspect, 0.1f, p.max_range);
 		shader.program->set_mat(u.clip_from_world_uni, clip_from_view * view_from_world);
 
-		bind_texture_2d(states, u.tex_cookie_uniform, *get_or_white(assets, p.cookie));
+		binds.add_texture(u.tex_cookie_uniform, get_or_white(assets, p.cookie)->id);
 	}
 
 	// directional light shadows
 	ASSERT(rc.shadow_context);
 	auto* shadow_map = rc.shadow_context != nullptr ? rc.shadow_context->directional_shadow_map : nullptr;
-	if (shadow_map != nullptr)
-	{
-		bind_texture_2d(states, shader.tex_directional_light_depth_uni, *shadow_map);
-	}
-	else
-	{
-		bind_texture_2d(states, shader.tex_directional_light_depth_uni, *assets->get_white());
-	}
+	ASSERT(shadow_map == nullptr || shadow_map->debug_is_msaa == false);
+	binds.add_texture(shader.tex_directional_light_depth_uni, shadow_map != nullptr ? shadow_map->id : assets->get_white()->id);
 
 	const auto directional_shadow_clip_from_world
 		= rc.shadow_context != nullptr ? rc.shadow_context->directional_shadow_clip_from_world : glm::mat4{};
 	shader.program->set_mat(shader.directional_shadow_clip_from_world_uni, directional_shadow_clip_from_world);
+
+	return binds;
 }
 
 bool DefaultMaterial::is_transparent() const
@@ -226,4 +255,18 @@ bool DefaultMaterial::is_transparent() const
 	return alpha < ALPHA_TRANSPARENCY_LIMIT;
 }
 
+std::uint64_t DefaultMaterial::get_batch_key() const
+{
+	// only used for sorting so a collision just means a extra bind
+	const auto combine = [](std::uint64_t key, unsigned int id) { return key * 0x1'0000'01b3 ^ id; };
+	if (array_textures)
+	{
+		const auto key = combine(combine(1, array_textures->diffuse.array->id), array_textures->specular.array->id);
+		return combine(key, array_textures->emissive.array->id);
+	}
+
+	const auto id_or_default = [](const std::shared_ptr<Texture2d>& t) { return t ? t->id : 0; };
+	return combine(combine(combine(0, id_or_default(diffuse)), id_or_default(specular)), id_or_default(emissive));
+}
+
 }  //  namespace klotter
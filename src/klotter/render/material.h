@@ -1,8 +1,12 @@
 ﻿#pragma once
 
 #include "klotter/render/color.h"
+#include "klotter/render/constants.h"
+#include "klotter/render/material.block.h"
 #include "klotter/render/texture.h"
+#include "klotter/render/texture.array.h"
 
+#include <array>
 #include <memory>
 #include <optional>
 
@@ -10,6 +14,7 @@ namespace klotter
 {
 struct Assets;
 struct CompiledCamera;
+struct LoadedShader_Default;
 struct LoadedShader_Default_Container;
 struct LoadedShader_Unlit_Container;
 struct RenderSettings;
@@ -23,6 +28,32 @@ struct State;
 /// All loaded/known shaders
 struct ShaderResource;
 struct RenderContext;
+struct Uniform;
+
+/// A texture unit and the texture that is bound to it, see \ref MaterialBinds
+struct TextureBind
+{
+	int unit = 0;
+	u32 texture = 0;
+	bool is_array = false;
+};
+
+/** The gl objects a material draws with.
+ * Plain data that is resolved on the gl thread, so the draws that use it can be recorded on any thread.
+ */
+struct MaterialBinds
+{
+	u32 program = 0;
+
+	/// the range of the material in the \ref MaterialUniformBuffer
+	int block_slot = -1;
+
+	std::array<TextureBind, MAX_TEXTURES_SUPPORTED> textures;
+	int texture_count = 0;
+
+	/// Add the texture if the shader samples it.
+	void add_texture(const Uniform& uniform, u32 texture, bool is_array = false);
+};
 
 /// Base class for all materials
 struct Material
@@ -35,14 +66,18 @@ struct Material
 	void operator=(const Material&) = delete;
 	void operator=(Material&&) = delete;
 
-	virtual void use_shader(const RenderContext&) = 0;
-	virtual void set_uniforms(const RenderContext&, const CompiledCamera&, const std::optional<glm::mat4>&) = 0;
-	virtual void bind_textures(const RenderContext&, State* states, Assets* assets) = 0;
-	virtual void apply_lights(
-		const RenderContext&, const Lights& lights, const RenderSettings& settings, State* states, Assets* assets
+	/** Resolve the shader, upload the parameters and set the uniforms that are the same for all meshes, called on the gl thread.
+	 * Called once per frame and context before the draws with the material are recorded with \ref CommandList::use_material
+	 * The transform is written to the draw block by the renderer.
+	 */
+	virtual MaterialBinds prepare(
+		const RenderContext&, const CompiledCamera&, const Lights& lights, const RenderSettings& settings, State* states, Assets* assets
 	) = 0;
 
 	[[nodiscard]] virtual bool is_transparent() const = 0;
+
+	/// Materials with the same key bind the same textures, solid meshes are sorted on this to share binds.
+	[[nodiscard]] virtual std::uint64_t get_batch_key() const = 0;
 };
 
 /// A unlit (or fully lit) material, not affected by light.
@@ -54,14 +89,27 @@ struct UnlitMaterial : Material
 	std::shared_ptr<Texture2d> texture;
 
 	explicit UnlitMaterial(const ShaderResource& resource);
-	void use_shader(const RenderContext&) override;
-	void set_uniforms(const RenderContext&, const CompiledCamera&, const std::optional<glm::mat4>&) override;
-	void bind_textures(const RenderContext&, State* states, Assets* assets) override;
-	void apply_lights(
-		const RenderContext&, const Lights& lights, const RenderSettings& settings, State* states, Assets* assets
+	MaterialBinds prepare(
+		const RenderContext&, const CompiledCamera&, const Lights& lights, const RenderSettings& settings, State* states, Assets* assets
 	) override;
 
 	[[nodiscard]] bool is_transparent() const override;
+	[[nodiscard]] std::uint64_t get_batch_key() const override;
+
+   private:
+
+	MaterialBlock block;
+
+	/// the values the block was last written from, the color is only converted when they change
+	std::optional<std::array<float, 5>> block_source;
+};
+
+/// The textures of a \ref DefaultMaterial that samples from texture arrays.
+struct MaterialArrayTextures
+{
+	MaterialTexture diffuse;
+	MaterialTexture specular;
+	MaterialTexture emissive;
 };
 
 /// A material affected by light.
@@ -80,15 +128,29 @@ struct DefaultMaterial : Material
 	std::shared_ptr<Texture2d> specular;
 	std::shared_ptr<Texture2d> emissive;
 
+	/// if set, the textures are sampled from texture arrays instead of the 2d textures above.
+	/// Materials that use the same arrays share the binds and can be drawn after each other without rebinding.
+	std::optional<MaterialArrayTextures> array_textures;
+
 	explicit DefaultMaterial(const ShaderResource& resource);
-	void use_shader(const RenderContext&) override;
-	void set_uniforms(const RenderContext&, const CompiledCamera&, const std::optional<glm::mat4>&) override;
-	void bind_textures(const RenderContext&, State* states, Assets* assets) override;
-	void apply_lights(
-		const RenderContext&, const Lights& lights, const RenderSettings& settings, State* states, Assets* assets
+	MaterialBinds prepare(
+		const RenderContext&, const CompiledCamera&, const Lights& lights, const RenderSettings& settings, State* states, Assets* assets
 	) override;
 
 	[[nodiscard]] bool is_transparent() const override;
+	[[nodiscard]] std::uint64_t get_batch_key() const override;
+
+   private:
+
+	[[nodiscard]] const LoadedShader_Default& get_shader(const RenderContext& rc) const;
+
+	/// Write the parameters to the block if they have changed and upload it.
+	void update_block(const RenderContext& rc);
+
+	MaterialBlock block;
+
+	/// the values the block was last written from, the colors are only converted when they change
+	std::optional<std::array<float, 28>> block_source;
 };
 
 /**
@@ -0,0 +1,209 @@
+#include "klotter/render/occlusion.h"
+
+#include "klotter/assert.h"
+#include "klotter/cint.h"
+
+#include "klotter/render/camera.h"
+#include "klotter/render/constants.h"
+#include "klotter/render/draw.block.h"
+#include "klotter/render/geom.builder.h"
+#include "klotter/render/geom.h"
+#include "klotter/render/opengl_utils.h"
+#include "klotter/render/shader.h"
+#include "klotter/render/shader_resource.h"
+#include "klotter/render/state.h"
+
+namespace klotter
+{
+
+unsigned int get_occlusion_query_target()
+{
+	const auto is_version = [](int major, int minor) { return GLVersion.major > major || (GLVersion.major == major && GLVersion.minor >= minor); };
+
+	if (is_version(4, 3) || has_gl_extension("GL_ARB_ES3_compatibility"))
+	{
+		return GL_ANY_SAMPLES_PASSED_CONSERVATIVE;
+	}
+
+	if (is_version(3, 3) || has_gl_extension("GL_ARB_occlusion_query2"))
+	{
+		return GL_ANY_SAMPLES_PASSED;
+	}
+
+	// counts the samples, but any non zero count is visible and conditional rendering works the same
+	return GL_SAMPLES_PASSED;
+}
+
+namespace
+{
+	/// snapshot copies are tested as the mesh they were copied from, so the queries survive between snapshots
+	const MeshInstance* key_from_mesh(const MeshInstance& mesh)
+	{
+		return mesh.snapshot_of != nullptr ? mesh.snapshot_of : &mesh;
+	}
+
+	bool is_inside_expanded(const LocalAabb& aabb, const glm::vec3& p, float margin)
+	{
+		return glm::all(glm::greaterThanEqual(p, aabb.min - margin)) && glm::all(glm::lessThanEqual(p, aabb.max + margin));
+	}
+}  //  namespace
+
+OcclusionQueries::OcclusionQueries(QueryBackend* backend, unsigned int query_target)
+	: pool(backend)
+	, target(query_target)
+{
+}
+
+void OcclusionQueries::begin_frame()
+{
+	current_frame += 1;
+}
+
+std::optional<u32> OcclusionQueries::read_back(const MeshInstance& mesh)
+{
+	auto& occlusion = meshes[key_from_mesh(mesh)];
+	occlusion.last_used_frame = current_frame;
+
+	if (occlusion.pending_query.has_value() == false)
+	{
+		return std::nullopt;
+	}
+
+	if (pool.backend->is_result_available(*occlusion.pending_query) == false)
+	{
+		// the gpu is still working on the last query, use that for conditional rendering until it's done
+		return occlusion.pending_query;
+	}
+
+	occlusion.visible = pool.backend->get_result(*occlusion.pending_query) != 0;
+	pool.release(*occlusion.pending_query);
+	occlusion.pending_query = std::nullopt;
+	return std::nullopt;
+}
+
+void OcclusionQueries::set_visible(const MeshInstance& mesh)
+{
+	meshes[key_from_mesh(mesh)].visible = true;
+}
+
+u32 OcclusionQueries::begin_query(const MeshInstance& mesh)
+{
+	auto& occlusion = meshes[key_from_mesh(mesh)];
+	ASSERT(occlusion.pending_query.has_value() == false);
+
+	const auto query = pool.acquire();
+	pool.backend->begin_query(target, query);
+	occlusion.pending_query = query;
+	return query;
+}
+
+void OcclusionQueries::end_query()
+{
+	pool.backend->end_query(target);
+}
+
+bool OcclusionQueries::is_visible(const MeshInstance& mesh) const
+{
+	const auto found = meshes.find(key_from_mesh(mesh));
+	if (found == meshes.end())
+	{
+		return true;
+	}
+	return found->second.visible;
+}
+
+void OcclusionQueries::end_frame()
+{
+	for (auto it = meshes.begin(); it != meshes.end();)
+	{
+		if (it->second.last_used_frame == current_frame)
+		{
+			++it;
+			continue;
+		}
+
+		// mesh is removed or no longer tested, recycle the query
+		if (it->second.pending_query)
+		{
+			pool.release(*it->second.pending_query);
+		}
+		it = meshes.erase(it);
+	}
+}
+
+OcclusionCulling::OcclusionCulling(const LoadedShader_SingleColor& shader)
+	: queries(get_gl_query_backend(), get_occlusion_query_target())
+	, unit_box(compile_geom(
+		USE_DEBUG_LABEL_MANY("occlusion box")
+		geom::create_box(1.0f, 1.0f, 1.0f, geom::NormalsFacing::Out).to_geom(),
+		shader.geom_layout
+	))
+{
+}
+
+std::optional<u32> OcclusionCulling::test(
+	const MeshInstance& mesh, const glm::mat4& world_from_local, const CompiledCamera& camera,
+	LoadedShader_SingleColor* shader, DrawUniformRing* draws, int box_slot, State* states
+)
+{
+	if (const auto pending = queries.read_back(mesh); pending)
+	{
+		return pending;
+	}
+
+	// the near plane could clip the box, and we could be inside the box
+	const auto local_camera = glm::vec3(glm::inverse(world_from_local) * glm::vec4{camera.position, 1.0f});
+	if (is_inside_expanded(mesh.geom->aabb, local_camera, OCCLUSION_NEAR_MARGIN))
+	{
+		queries.set_visible(mesh);
+		return std::nullopt;
+	}
+
+	SCOPED_DEBUG_GROUP("occlusion query"sv);
+	StateChanger{states}
+		.cull_face(false)
+		.depth_test(true)
+		.depth_mask(false)
+		.depth_func(Compare::less_equal)
+		.color_mask(false)
+		.blending(false)
+		.stencil_mask(0x0);
+
+	shader->program->use(states);
+	draws->bind(box_slot);
+
+	const auto query = queries.begin_query(mesh);
+	render_geom(states, *unit_box);
+	queries.end_query();
+
+	StateChanger{states}.color_mask(true).cull_face(true);
+
+	return query;
+}
+
+glm::mat4 world_from_occlusion_box(const MeshInstance& mesh, const glm::mat4& world_from_local)
+{
+	const auto& aabb = mesh.geom->aabb;
+	const auto local_from_box = glm::scale(glm::translate(glm::mat4(1.0f), (aabb.min + aabb.max) * 0.5f), aabb.max - aabb.min);
+	return world_from_local * local_from_box;
+}
+
+ScopedConditionalRender::ScopedConditionalRender(std::optional<u32> query)
+	: is_active(query.has_value())
+{
+	if (query)
+	{
+		// no wait: if the result isn't ready the mesh is rendered
+		glBeginConditionalRender(*query, GL_QUERY_NO_WAIT);
+	}
+}
+
+ScopedConditionalRender::~ScopedConditionalRender()
+{
+	if (is_active)
+	{
+		glEndConditionalRender();
+	}
+}
+
+}  //  namespace klotter
@@ -0,0 +1,107 @@
+#pragma once
+
+#include "klotter/render/query_pool.h"
+#include "klotter/render/world.h"
+
+#include <unordered_map>
+
+namespace klotter
+{
+
+/** \addtogroup render Renderer
+ *  @{
+*/
+
+struct CompiledCamera;
+struct DrawUniformRing;
+struct LoadedShader_SingleColor;
+struct State;
+
+/// The occlusion status of a single mesh.
+struct MeshOcclusion
+{
+	/// the last issued query, if the result hasn't been read back yet
+	std::optional<u32> pending_query;
+
+	/// the last known visibility
+	bool visible = true;
+
+	u64 last_used_frame = 0;
+};
+
+/// The best occlusion query target the current context supports:
+/// conservative any samples passed (gl 4.3), any samples passed (gl 3.3) or the number of samples passed.
+unsigned int get_occlusion_query_target();
+
+/// The occlusion queries and the visibility of the tested meshes, the bookkeeping of \ref OcclusionCulling without the rendering.
+struct OcclusionQueries
+{
+	QueryPool pool;
+	unsigned int target;
+	std::unordered_map<const MeshInstance*, MeshOcclusion> meshes;
+	u64 current_frame = 0;
+
+	OcclusionQueries(QueryBackend* backend, unsigned int query_target);
+
+	/// Call before any occlusion tests are made in a frame.
+	void begin_frame();
+
+	/// Marks the mesh as tested this frame and reads back the last result, if it has completed.
+	/// @returns the query that the gpu is still working on, if any
+	std::optional<u32> read_back(const MeshInstance& mesh);
+
+	/// Marks the mesh as visible without a query, used when the camera is inside the bounding box.
+	void set_visible(const MeshInstance& mesh);
+
+	/// Begins a query for the mesh, render the bounding box and then call \ref end_query.
+	u32 begin_query(const MeshInstance& mesh);
+	void end_query();
+
+	/// The latest known visibility of a mesh, to use when skipping meshes on the cpu.
+	[[nodiscard]] bool is_visible(const MeshInstance& mesh) const;
+
+	/// Recycles the queries of meshes that weren't tested this frame.
+	void end_frame();
+};
+
+/// Hardware occlusion culling of MeshInstance.
+/// Each frame the bounding box is rendered in a occlusion query, results are read back a frame later.
+struct OcclusionCulling
+{
+	OcclusionQueries queries;
+	std::shared_ptr<CompiledGeom> unit_box;
+
+	explicit OcclusionCulling(const LoadedShader_SingleColor& shader);
+
+	/// Reads back the last result and renders the bounding box in a new query, if the last one has completed.
+	/// Assumes all occluders have already been rendered.
+	/// @param box_slot the draw slot with the transform of the bounding box, see \ref world_from_occlusion_box
+	/// @returns the query to use for conditional rendering, if any
+	std::optional<u32> test(
+		const MeshInstance& mesh, const glm::mat4& world_from_local, const CompiledCamera& camera,
+		LoadedShader_SingleColor* shader, DrawUniformRing* draws, int box_slot, State* states
+	);
+};
+
+/// The transform of the unit box that is rendered when testing a mesh.
+glm::mat4 world_from_occlusion_box(const MeshInstance& mesh, const glm::mat4& world_from_local);
+
+/// Renders a mesh inside a conditional render if there is a query.
+struct ScopedConditionalRender
+{
+	bool is_active;
+
+	explicit ScopedConditionalRender(std::optional<u32> query);
+	~ScopedConditionalRender();
+
+	ScopedConditionalRender(const ScopedConditionalRender&) = delete;
+	ScopedConditionalRender(ScopedConditionalRender&&) = delete;
+	void operator=(const ScopedConditionalRender&) = delete;
+	void operator=(ScopedConditionalRender&&) = delete;
+};
+
+/**
+ * @}
+*/
+
+}  //  namespace klotter
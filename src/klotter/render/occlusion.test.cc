@@ -0,0 +1,210 @@
+#include "klotter/render/occlusion.h"
+
+#include "catch2/catch_test_macros.hpp"
+
+#include <algorithm>
+
+using namespace klotter;
+
+namespace
+{
+	constexpr unsigned int fake_target = 42;
+
+	/// queries that only exist on the cpu, the test decides when a result is available and what it is
+	struct FakeQueryBackend : QueryBackend
+	{
+		u32 next_query = 1;
+		std::vector<u32> destroyed;
+
+		std::optional<u32> active;
+		unsigned int active_target = 0;
+
+		std::unordered_map<u32, u32> results;
+
+		u32 create_query() override
+		{
+			const auto query = next_query;
+			next_query += 1;
+			return query;
+		}
+
+		void destroy_queries(const std::vector<u32>& queries) override
+		{
+			destroyed.insert(destroyed.end(), queries.begin(), queries.end());
+		}
+
+		void begin_query(unsigned int target, u32 query) override
+		{
+			REQUIRE(active.has_value() == false);
+			active = query;
+			active_target = target;
+		}
+
+		void end_query(unsigned int target) override
+		{
+			REQUIRE(active.has_value());
+			CHECK(target == active_target);
+			results.erase(*active);
+			active.reset();
+		}
+
+		bool is_result_available(u32 query) override
+		{
+			return results.find(query) != results.end();
+		}
+
+		u32 get_result(u32 query) override
+		{
+			return results.at(query);
+		}
+
+		/// the gpu has finished the query
+		void finish(u32 query, u32 samples)
+		{
+			results[query] = samples;
+		}
+	};
+}  //  namespace
+
+TEST_CASE("query_pool_recycles_queries", "[occlusion]")
+{
+	FakeQueryBackend backend;
+	{
+		QueryPool pool{&backend};
+
+		const auto first = pool.acquire();
+		const auto second = pool.acquire();
+		CHECK(first != second);
+		CHECK(backend.next_query == 3);
+
+		// a released query is used again instead of creating a new one
+		pool.release(first);
+		CHECK(pool.acquire() == first);
+		CHECK(backend.next_query == 3);
+
+		pool.release(second);
+		pool.release(first);
+		const auto third = pool.acquire();
+		const auto fourth = pool.acquire();
+		CHECK(std::min(third, fourth) == 1);
+		CHECK(std::max(third, fourth) == 2);
+		CHECK(pool.acquire() == 3);
+
+		CHECK(backend.destroyed.empty());
+	}
+
+	// all created queries are destroyed with the pool, even if they are still in use
+	std::sort(backend.destroyed.begin(), backend.destroyed.end());
+	CHECK(backend.destroyed == std::vector<u32>{1, 2, 3});
+}
+
+TEST_CASE("occlusion_result_is_used_a_frame_later", "[occlusion]")
+{
+	FakeQueryBackend backend;
+	OcclusionQueries queries{&backend, fake_target};
+	const MeshInstance mesh;
+
+	// frame 1: untested meshes are visible and a query is started
+	queries.begin_frame();
+	CHECK(queries.read_back(mesh).has_value() == false);
+	const auto first = queries.begin_query(mesh);
+	CHECK(backend.active_target == fake_target);
+	queries.end_query();
+	queries.end_frame();
+	CHECK(queries.is_visible(mesh));
+
+	// frame 2: the gpu isn't done, keep the visibility and conditionally render with the query in flight
+	queries.begin_frame();
+	CHECK(queries.read_back(mesh) == first);
+	queries.end_frame();
+	CHECK(queries.is_visible(mesh));
+
+	// frame 3: no samples passed, the mesh is hidden and a new query reuses the id
+	backend.finish(first, 0);
+	queries.begin_frame();
+	CHECK(queries.read_back(mesh).has_value() == false);
+	CHECK(queries.is_visible(mesh) == false);
+	const auto second = queries.begin_query(mesh);
+	CHECK(second == first);
+	queries.end_query();
+	queries.end_frame();
+
+	// frame 4: samples passed, the mesh is visible again
+	backend.finish(second, 17);
+	queries.begin_frame();
+	CHECK(queries.read_back(mesh).has_value() == false);
+	CHECK(queries.is_visible(mesh));
+	queries.end_frame();
+}
+
+TEST_CASE("occlusion_inside_box_is_visible", "[occlusion]")
+{
+	FakeQueryBackend backend;
+	OcclusionQueries queries{&backend, fake_target};
+	const MeshInstance mesh;
+
+	queries.begin_frame();
+	std::ignore = queries.read_back(mesh);
+	const auto query = queries.begin_query(mesh);
+	queries.end_query();
+	queries.end_frame();
+
+	backend.finish(query, 0);
+	queries.begin_frame();
+	std::ignore = queries.read_back(mesh);
+	CHECK(queries.is_visible(mesh) == false);
+
+	queries.set_visible(mesh);
+	CHECK(queries.is_visible(mesh));
+	queries.end_frame();
+}
+
+TEST_CASE("occlusion_untested_meshes_are_forgotten", "[occlusion]")
+{
+	FakeQueryBackend backend;
+	OcclusionQueries queries{&backend, fake_target};
+	const MeshInstance tested;
+	const MeshInstance removed;
+
+	queries.begin_frame();
+	for (const auto* mesh: {&tested, &removed})
+	{
+		std::ignore = queries.read_back(*mesh);
+		std::ignore = queries.begin_query(*mesh);
+		queries.end_query();
+	}
+	queries.end_frame();
+	CHECK(queries.meshes.size() == 2);
+	CHECK(queries.pool.free_queries.empty());
+
+	// only one mesh is tested, the query of the other is recycled even though it never finished
+	queries.begin_frame();
+	CHECK(queries.read_back(tested).has_value());
+	queries.end_frame();
+
+	CHECK(queries.meshes.size() == 1);
+	CHECK(queries.pool.free_queries.size() == 1);
+	CHECK(queries.is_visible(removed));
+}
+
+TEST_CASE("occlusion_snapshot_copies_share_queries", "[occlusion]")
+{
+	FakeQueryBackend backend;
+	OcclusionQueries queries{&backend, fake_target};
+	const MeshInstance original;
+	MeshInstance copy;
+	copy.snapshot_of = &original;
+
+	queries.begin_frame();
+	std::ignore = queries.read_back(copy);
+	const auto query = queries.begin_query(copy);
+	queries.end_query();
+	queries.end_frame();
+
+	backend.finish(query, 0);
+	queries.begin_frame();
+	std::ignore = queries.read_back(original);
+	CHECK(queries.is_visible(copy) == false);
+	CHECK(queries.is_visible(original) == false);
+	queries.end_frame();
+}
@@ -216,9 +216,26 @@ void destroy_vertex_array(u32 vao)
 	glDeleteVertexArrays(1, &vao);
 }
 
-void set_gl_viewport(const glm::ivec2& sz)
+int get_uniform_buffer_offset_alignment()
 {
-	glViewport(0, 0, sz.x, sz.y);
+	GLint alignment = 0;
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+	return std::max(alignment, 1);
+}
+
+bool has_gl_extension(std::string_view name)
+{
+	GLint count = 0;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+	for (GLint index = 0; index < count; index += 1)
+	{
+		const auto* extension = glGetStringi(GL_EXTENSIONS, gluint_from_int(index));
+		if (extension != nullptr && name == reinterpret_cast<const char*>(extension))
+		{
+			return true;
+		}
+	}
+	return false;
 }
 
 glm::mat4 get_mesh_rotation_matrix(const glm::vec3& rotation)
@@ -277,11 +294,17 @@ void push_debug_group(unsigned int id, std::size_t size, const char* label)
 }
 
 ScopedDebugGroup::ScopedDebugGroup(const std::string& message, unsigned int id)
+#if FF_HAS(ENABLE_CPU_PROFILER)
+	: zone(message)
+#endif
 {
     push_debug_group(id, message.size(), message.data());
 }
 
 ScopedDebugGroup::ScopedDebugGroup(std::string_view message, unsigned int id)
+#if FF_HAS(ENABLE_CPU_PROFILER)
+	: zone(message)
+#endif
 {
     push_debug_group(id, message.size(), message.data());
 }
@@ -2,6 +2,7 @@
 
 #include "klotter/feature_flags.h"
 #include "klotter/dependency_glad.h"
+#include "klotter/profiler.h"
 
 namespace klotter
 {
@@ -20,7 +21,11 @@ void destroy_buffer(u32 vbo);
 u32 create_vertex_array();
 void destroy_vertex_array(u32 vao);
 
-void set_gl_viewport(const glm::ivec2& sz);
+/// The alignment of the offset when binding a range of a uniform buffer, at least 1.
+int get_uniform_buffer_offset_alignment();
+
+/// Returns true if the current context lists the extension.
+bool has_gl_extension(std::string_view name);
 
 // todo(Gustav): move to a better place
 glm::mat4 get_mesh_rotation_matrix(const glm::vec3& rotation);
@@ -50,6 +55,7 @@ glm::mat4 get_mesh_rotation_matrix(const glm::vec3& rotation);
 
 	// See opengl_labels.h for passing the labels/names
 
+	/// A gl debug group, that is also a cpu profiler zone if the profiler is enabled.
 	struct ScopedDebugGroup
 	{
 		explicit ScopedDebugGroup(const std::string& message, unsigned int id=0);
@@ -60,10 +66,12 @@ glm::mat4 get_mesh_rotation_matrix(const glm::vec3& rotation);
 		ScopedDebugGroup(const ScopedDebugGroup&) = delete;
 	    void operator=(ScopedDebugGroup&&) = delete;
 		void operator=(const ScopedDebugGroup&) = delete;
+
+	#if FF_HAS(ENABLE_CPU_PROFILER)
+		ScopedProfileZone zone;
+	#endif
 	};
 
-	#define CONCAT_IMPL(x, y) x##y
-	#define CONCAT(x, y) CONCAT_IMPL(x, y)
 	#define SCOPED_DEBUG_GROUP(TEXT) [[maybe_unused]] const ScopedDebugGroup CONCAT(sc, __LINE__){TEXT}
 
 #else
@@ -74,7 +82,7 @@ glm::mat4 get_mesh_rotation_matrix(const glm::vec3& rotation);
 	#define SET_DEBUG_LABEL(ID, FOR) opengl_nop()
 	#define SET_DEBUG_LABEL_NAMED(ID, FOR, NAME) opengl_nop()
 
-	#define SCOPED_DEBUG_GROUP(TEXT) opengl_nop()
+	#define SCOPED_DEBUG_GROUP(TEXT) SCOPED_PROFILE_ZONE(TEXT)
 #endif
 
 
@@ -1,6 +1,7 @@
 ﻿#include "klotter/render/postproc.h"
 
 #include "klotter/assert.h"
+#include "klotter/cint.h"
 #include "klotter/feature_flags.h"
 #include "klotter/log.h"
 #include "klotter/str.h"
@@ -26,6 +27,11 @@ namespace klotter
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 // Effect
 
+SimpleEffect* Effect::as_per_pixel_effect()
+{
+	return nullptr;
+}
+
 bool Effect::enabled() const
 {
 	return is_enabled;
@@ -52,34 +58,176 @@ void Effect::set_enabled(bool n)
 // todo(Gustav): should this be a user config option? evaluate higher/lower bits, probably 16 or 32 since it needs to be floating point for hdr
 constexpr ColorBitsPerPixel render_world_color_bits_per_pixel = ColorBitsPerPixel::use_16;
 
-std::optional<BloomRender> build_bloom(const glm::ivec2& size, ExtractShader* sh, PingPongBlurShader* ping_sh)
+std::optional<BloomRender> build_bloom(const std::optional<BloomSetup>& setup)
 {
-	if (sh == nullptr) { return std::nullopt; }
+	if (setup.has_value() == false) { return std::nullopt; }
 
-	auto bloom_buffer = build_simple_framebuffer(USE_DEBUG_LABEL_MANY("bloom extraction buffer") size);
+	// buffers are assigned by the render graph
+	auto bloom = BloomRender{
+		setup->mode, setup->extract_shader, nullptr, setup->ping_pong_shader, {}, setup->downsample_shader, setup->upsample_shader, {}, {}
+	};
 
-	auto ping_one = build_simple_framebuffer(USE_DEBUG_LABEL_MANY("ping-pong bloom buffer one") size);
-	auto ping_two = build_simple_framebuffer(USE_DEBUG_LABEL_MANY("ping-pong bloom buffer two") size);
+	switch (setup->mode)
+	{
+	case BloomMode::ping_pong_blur:
+		bloom.blur_buffers.resize(sizet_from_int(std::max(0, setup->blur_steps)));
+		break;
+	case BloomMode::mip_chain:
+	{
+		const auto mip_count = sizet_from_int(std::max(0, setup->mip_count));
+		bloom.down_buffers.resize(mip_count);
+		bloom.up_buffers.resize(mip_count > 0 ? mip_count - 1 : 0);
+		break;
+	}
+	default: DIE("invalid bloom mode"); break;
+	}
 
-	return BloomRender{sh, bloom_buffer, ping_sh, {ping_one, ping_two}};
+	return bloom;
 }
 
-RenderWorld::RenderWorld(const glm::ivec2 size, RealizeShader* re_sh, ExtractShader* ex_sh, PingPongBlurShader* ping_sh, int msaa_samples, bool* h, float* e)
+const std::shared_ptr<FrameBuffer>& BloomRender::get_blurred() const
+{
+	if (up_buffers.empty() == false)
+	{
+		return up_buffers.front();
+	}
+	if (down_buffers.empty() == false)
+	{
+		return down_buffers.back();
+	}
+	if (blur_buffers.empty() == false)
+	{
+		return blur_buffers.back();
+	}
+	return bloom_buffer;
+}
+
+glm::ivec2 size_of_bloom_mip(const glm::ivec2& window_size, std::size_t mip)
+{
+	// mip 0 is half the size of the window
+	const auto scale = 1 << (mip + 1);
+	return {std::max(1, window_size.x / scale), std::max(1, window_size.y / scale)};
+}
+
+RenderWorld::RenderWorld(
+	const glm::ivec2 size, RealizeShader* re_sh, const std::optional<BloomSetup>& bloom, int msaa, bool* h, float* e, const DynamicResolution* dr
+)
 	: window_size(size)
+	, msaa_samples(msaa)
 	, use_hdr(h)
 	, exposure(e)
-	, msaa_buffer(build_msaa_framebuffer(USE_DEBUG_LABEL_MANY("msaa buffer")
-		size, msaa_samples, render_world_color_bits_per_pixel))
-	, realized_buffer(build_hdr_floating_framebuffer(USE_DEBUG_LABEL_MANY("realized msaa buffer") size, render_world_color_bits_per_pixel))
+	, dynamic_resolution(dr)
 	, realize_shader(re_sh)
-	, bloom_render(build_bloom(size, ex_sh, ping_sh))
-	, last_bloom_blur_index(0)
+	, bloom_render(build_bloom(bloom))
 {
 	ASSERT(use_hdr);
 	ASSERT(exposure);
+	ASSERT(dynamic_resolution);
+}
+
+glm::ivec2 RenderWorld::get_render_size() const
+{
+	return dynamic_resolution->get_render_size(window_size);
+}
+
+glm::vec2 RenderWorld::get_uv_scale() const
+{
+	const auto render_size = get_render_size();
+	return {
+		static_cast<float>(render_size.x) / static_cast<float>(window_size.x),
+		static_cast<float>(render_size.y) / static_cast<float>(window_size.y)
+	};
+}
+
+void RenderWorld::set_scaled_viewport(State* states, const FrameBuffer& fbo) const
+{
+	// bloom mips are smaller than the window, so scale the fbo and not the window size
+	const auto size = dynamic_resolution->get_scaled_size(fbo.size);
+	StateChanger{states}.viewport({size.x, size.y});
+}
+
+void RenderWorld::add_passes(RenderGraph* graph, std::vector<RenderGraphResource>* source_inputs)
+{
+	const auto msaa = graph->create_transient(
+		"msaa buffer", msaa_transient(window_size, msaa_samples, render_world_color_bits_per_pixel), &msaa_buffer
+	);
+	const auto realized = graph->create_transient(
+		"realized msaa buffer", hdr_transient(window_size, render_world_color_bits_per_pixel), &realized_buffer
+	);
+
+	graph->add_pass("render shadows and world", {}, {msaa}, [this](const PostProcArg& arg) { render_shadows_and_world(arg); });
+	graph->add_pass("resolve msaa buffer", {msaa}, {realized}, [this](const PostProcArg& arg) { resolve_msaa(arg); });
+
+	*source_inputs = {realized};
+
+	if (bloom_render.has_value() == false)
+	{
+		return;
+	}
+
+	// the mip chain accumulates several mips so it needs to keep the overexposed values
+	const auto bloom_desc = bloom_render->mode == BloomMode::mip_chain
+		? hdr_transient(window_size, render_world_color_bits_per_pixel)
+		: simple_transient(window_size);
+	const auto bloom = graph->create_transient("bloom extraction buffer", bloom_desc, &bloom_render->bloom_buffer);
+	graph->add_pass("extract overexposed pixels", {realized}, {bloom}, [this](const PostProcArg& arg) { extract_bloom(arg); });
+
+	auto last_blurred = bloom;
+	for (std::size_t blur_iteration = 0; blur_iteration < bloom_render->blur_buffers.size(); blur_iteration += 1)
+	{
+		const auto blurred = graph->create_transient(
+			Str{} << "bloom blur buffer " << blur_iteration, simple_transient(window_size), &bloom_render->blur_buffers[blur_iteration]
+		);
+		graph->add_pass(
+			Str{} << "blur pass #" << blur_iteration,
+			{last_blurred},
+			{blurred},
+			[this, blur_iteration](const PostProcArg& arg) { blur_bloom(arg, blur_iteration); }
+		);
+		last_blurred = blurred;
+	}
+
+	// downsample all the way down...
+	std::vector<RenderGraphResource> down_mips;
+	for (std::size_t mip = 0; mip < bloom_render->down_buffers.size(); mip += 1)
+	{
+		const auto downsampled = graph->create_transient(
+			Str{} << "bloom down mip " << mip,
+			hdr_transient(size_of_bloom_mip(window_size, mip), render_world_color_bits_per_pixel),
+			&bloom_render->down_buffers[mip]
+		);
+		graph->add_pass(
+			Str{} << "bloom downsample #" << mip,
+			{last_blurred},
+			{downsampled},
+			[this, mip](const PostProcArg& arg) { downsample_bloom(arg, mip); }
+		);
+		down_mips.emplace_back(downsampled);
+		last_blurred = downsampled;
+	}
+
+	// ...and accumulate on the way back up
+	for (std::size_t mip = bloom_render->up_buffers.size(); mip > 0; mip -= 1)
+	{
+		const auto target_mip = mip - 1;
+		const auto upsampled = graph->create_transient(
+			Str{} << "bloom up mip " << target_mip,
+			hdr_transient(size_of_bloom_mip(window_size, target_mip), render_world_color_bits_per_pixel),
+			&bloom_render->up_buffers[target_mip]
+		);
+		graph->add_pass(
+			Str{} << "bloom upsample #" << target_mip,
+			{last_blurred, down_mips[target_mip]},
+			{upsampled},
+			[this, target_mip](const PostProcArg& arg) { upsample_bloom(arg, target_mip); }
+		);
+		last_blurred = upsampled;
+	}
+
+	source_inputs->emplace_back(last_blurred);
 }
 
-void RenderWorld::update(const PostProcArg& arg)
+void RenderWorld::render_shadows_and_world(const PostProcArg& arg)
 {
 	// render shadow buffer
 	const auto shadow_size = arg.renderer->settings.shadow_map_resolution;
@@ -103,8 +251,8 @@ void RenderWorld::update(const PostProcArg& arg)
 	if (arg.world->lights.directional_lights.empty() == false)
 	{
 		SCOPED_DEBUG_GROUP("render shadow buffer"sv);
-		auto bound = BoundFbo{shadow_buffer};
-		set_gl_viewport({shadow_buffer->size.x, shadow_buffer->size.y});
+		auto bound = BoundFbo{&arg.renderer->pimpl->states, shadow_buffer};
+		StateChanger{&arg.renderer->pimpl->states}.viewport(shadow_buffer->size);
 		arg.renderer->render_shadows(shadow_size, *arg.world, compiled_shadow_camera);
 	}
 
@@ -117,97 +265,142 @@ void RenderWorld::update(const PostProcArg& arg)
 			.directional_shadow_clip_from_world = compiled_shadow_camera.clip_from_view * compiled_shadow_camera.view_from_world
 		};
 
-		auto bound = BoundFbo{msaa_buffer};
-		set_gl_viewport({msaa_buffer->size.x, msaa_buffer->size.y});
-		arg.renderer->render_world(window_size, *arg.world, compile(*arg.camera, window_size), shadow_context);
+		// the buffer is allocated at window size so changing the render scale doesn't recreate it
+		const auto render_size = get_render_size();
+		auto bound = BoundFbo{&arg.renderer->pimpl->states, msaa_buffer};
+		StateChanger{&arg.renderer->pimpl->states}.viewport(render_size);
+		arg.renderer->render_world(render_size, *arg.world, compile(*arg.camera, window_size), shadow_context);
 	}
+}
 
+void RenderWorld::resolve_msaa(const PostProcArg& arg) const
+{
 	// copy msaa buffer to realized
-	{
-		SCOPED_DEBUG_GROUP("resolving msaa buffer"sv);
-		resolve_multisampled_buffer(*msaa_buffer, realized_buffer.get());
-	}
+	resolve_multisampled_buffer(&arg.renderer->pimpl->states, *msaa_buffer, realized_buffer.get(), get_render_size());
+}
 
-	// extract overexposed
-	if (bloom_render.has_value())
-	{
-		// extract overexposed pixels
-		{
-			SCOPED_DEBUG_GROUP("extracting to overexposed buffer"sv);
-			StateChanger{&arg.renderer->pimpl->states}
-				.cull_face(false)
-				.stencil_test(false)
-				.depth_test(false)
-				.depth_mask(false)
-				.blending(false);
+void RenderWorld::extract_bloom(const PostProcArg& arg) const
+{
+	ASSERT(bloom_render.has_value());
 
-			glClearColor(0, 0, 0, 1.0f);
-			glClear(GL_COLOR_BUFFER_BIT);
+	auto bound = BoundFbo{&arg.renderer->pimpl->states, bloom_render->bloom_buffer};
+	set_scaled_viewport(&arg.renderer->pimpl->states, *bloom_render->bloom_buffer);
+	StateChanger{&arg.renderer->pimpl->states}
+		.cull_face(false)
+		.stencil_test(false)
+		.depth_test(false)
+		.depth_mask(false)
+		.blending(false);
 
-			// todo(Gustav): why bind this late... shouldn't this be first???
-			auto bound = BoundFbo{bloom_render->bloom_buffer};
+	StateChanger{&arg.renderer->pimpl->states}.clear_color({0.0f, 0.0f, 0.0f, 1.0f});
+	glClear(GL_COLOR_BUFFER_BIT);
 
-			{
-				const auto& container = bloom_render->extract_shader;
-				const auto& shader = container->shader;
-				const auto& program = shader->program;
-				program->use();
-				program->set_float(container->cutoff_uniform, arg.renderer->settings.bloom_cutoff);
-				program->set_float(container->softness_uniform, arg.renderer->settings.bloom_softness);
-				bind_texture_2d(&arg.renderer->pimpl->states, shader->tex_input_uniform, *realized_buffer);
-
-				render_geom(*arg.renderer->pimpl->full_screen_geom);
-			}
-		}
+	const auto& container = bloom_render->extract_shader;
+	const auto& shader = container->shader;
+	const auto& program = shader->program;
+	program->use(&arg.renderer->pimpl->states);
+	program->set_float(container->cutoff_uniform, arg.renderer->settings.bloom_cutoff);
+	program->set_float(container->softness_uniform, arg.renderer->settings.bloom_softness);
+	program->set_vec2(*shader->uv_scale_uni, get_uv_scale());
+	bind_texture_2d(&arg.renderer->pimpl->states, shader->tex_input_uniform, *realized_buffer);
 
-		// blur the buffers
-		{
-			SCOPED_DEBUG_GROUP("blur extracted pixels for bloom"sv);
-			bool is_horizontal = true;
-			for (int blur_iteration = 0; blur_iteration < arg.renderer->settings.bloom_blur_steps; blur_iteration += 1)
-			{
-				const auto is_first_iteration = blur_iteration == 0;
-
-				const std::size_t source_index = is_horizontal ? 1 : 0;
-				const std::size_t target_index = is_horizontal ? 0 : 1;
-				last_bloom_blur_index = target_index;
-
-				SCOPED_DEBUG_GROUP(
-					Str{} << "blur pass #" << blur_iteration << " ("
-						<< (is_horizontal ? "hori" : "vert") << ", "
-						<< (is_first_iteration ? "first" : "after") << ")"
-				);
-				auto bound = BoundFbo{bloom_render->ping_pong_buffer[target_index]};
-				StateChanger{&arg.renderer->pimpl->states}
-					.cull_face(false)
-					.stencil_test(false)
-					.depth_test(false)
-					.depth_mask(false)
-					.blending(false);
-
-				glClearColor(0, 0, 0, 1.0f);
-				glClear(GL_COLOR_BUFFER_BIT);
+	render_geom(&arg.renderer->pimpl->states, *arg.renderer->pimpl->full_screen_geom);
+}
 
-				{
-					const auto& container = bloom_render->ping_pong_shader;
-					const auto& shader = container->shader;
-					const auto& program = shader->program;
-					program->use();
-					program->set_bool(container->is_horizontal_uniform, is_horizontal);
+void RenderWorld::blur_bloom(const PostProcArg& arg, std::size_t blur_iteration) const
+{
+	ASSERT(bloom_render.has_value());
 
-					auto& src_texture = is_first_iteration ? bloom_render->bloom_buffer
-												  : bloom_render->ping_pong_buffer[source_index];
-					bind_texture_2d(&arg.renderer->pimpl->states, shader->tex_input_uniform, *src_texture);
+	const auto is_first_iteration = blur_iteration == 0;
+	const auto is_horizontal = blur_iteration % 2 == 0;
 
-					render_geom(*arg.renderer->pimpl->full_screen_geom);
-				}
+	const auto& src_texture = is_first_iteration ? bloom_render->bloom_buffer : bloom_render->blur_buffers[blur_iteration - 1];
+	const auto& dst_texture = bloom_render->blur_buffers[blur_iteration];
 
-				is_horizontal = ! is_horizontal;
-			}
-		}
-	}
+	auto bound = BoundFbo{&arg.renderer->pimpl->states, dst_texture};
+	set_scaled_viewport(&arg.renderer->pimpl->states, *dst_texture);
+	StateChanger{&arg.renderer->pimpl->states}
+		.cull_face(false)
+		.stencil_test(false)
+		.depth_test(false)
+		.depth_mask(false)
+		.blending(false);
+
+	StateChanger{&arg.renderer->pimpl->states}.clear_color({0.0f, 0.0f, 0.0f, 1.0f});
+	glClear(GL_COLOR_BUFFER_BIT);
+
+	const auto& container = bloom_render->ping_pong_shader;
+	const auto& shader = is_horizontal ? container->horizontal : container->vertical;
+	const auto& program = shader->program;
+	program->use(&arg.renderer->pimpl->states);
+	program->set_vec2(*shader->uv_scale_uni, get_uv_scale());
+	bind_texture_2d(&arg.renderer->pimpl->states, shader->tex_input_uniform, *src_texture);
+
+	render_geom(&arg.renderer->pimpl->states, *arg.renderer->pimpl->full_screen_geom);
+}
+
+void RenderWorld::downsample_bloom(const PostProcArg& arg, std::size_t mip) const
+{
+	ASSERT(bloom_render.has_value());
+
+	const auto is_first_mip = mip == 0;
+	const auto& src_texture = is_first_mip ? bloom_render->bloom_buffer : bloom_render->down_buffers[mip - 1];
+	const auto& dst_texture = bloom_render->down_buffers[mip];
 
-	// blur overexposed using ping-pong gaussian blur
+	auto bound = BoundFbo{&arg.renderer->pimpl->states, dst_texture};
+	set_scaled_viewport(&arg.renderer->pimpl->states, *dst_texture);
+	StateChanger{&arg.renderer->pimpl->states}
+		.cull_face(false)
+		.stencil_test(false)
+		.depth_test(false)
+		.depth_mask(false)
+		.blending(false);
+
+	const auto& container = bloom_render->downsample_shader;
+	const auto& shader = container->shader;
+	const auto& program = shader->program;
+	program->use(&arg.renderer->pimpl->states);
+	program->set_bool(container->use_karis_average_uniform, is_first_mip);
+	program->set_vec2(*shader->uv_scale_uni, get_uv_scale());
+	bind_texture_2d(&arg.renderer->pimpl->states, shader->tex_input_uniform, *src_texture);
+
+	render_geom(&arg.renderer->pimpl->states, *arg.renderer->pimpl->full_screen_geom);
+}
+
+void RenderWorld::upsample_bloom(const PostProcArg& arg, std::size_t mip) const
+{
+	ASSERT(bloom_render.has_value());
+
+	// the smallest mip doesn't have a up buffer so the first upsample reads from the down chain
+	const auto is_smallest_mip = mip + 1 == bloom_render->up_buffers.size();
+	const auto& src_texture = is_smallest_mip ? bloom_render->down_buffers[mip + 1] : bloom_render->up_buffers[mip + 1];
+	const auto& current_texture = bloom_render->down_buffers[mip];
+	const auto& dst_texture = bloom_render->up_buffers[mip];
+
+	auto bound = BoundFbo{&arg.renderer->pimpl->states, dst_texture};
+	set_scaled_viewport(&arg.renderer->pimpl->states, *dst_texture);
+	StateChanger{&arg.renderer->pimpl->states}
+		.cull_face(false)
+		.stencil_test(false)
+		.depth_test(false)
+		.depth_mask(false)
+		.blending(false);
+
+	// each upsample adds a mip, so the last upsample scales the sum back to the average
+	const auto is_last_upsample = mip == 0;
+	const auto weight = is_last_upsample ? 1.0f / static_cast<float>(bloom_render->down_buffers.size()) : 1.0f;
+
+	const auto& container = bloom_render->upsample_shader;
+	const auto& shader = container->shader;
+	const auto& program = shader->program;
+	program->use(&arg.renderer->pimpl->states);
+	program->set_float(container->filter_radius_uniform, arg.renderer->settings.bloom_filter_radius);
+	program->set_float(container->weight_uniform, weight);
+	program->set_vec2(*shader->uv_scale_uni, get_uv_scale());
+	bind_texture_2d(&arg.renderer->pimpl->states, shader->tex_input_uniform, *src_texture);
+	bind_texture_2d(&arg.renderer->pimpl->states, container->tex_current_uniform, *current_texture);
+
+	render_geom(&arg.renderer->pimpl->states, *arg.renderer->pimpl->full_screen_geom);
 }
 
 void RenderWorld::render(const PostProcArg& arg)
@@ -221,26 +414,31 @@ void RenderWorld::render(const PostProcArg& arg)
 		.depth_mask(false)
 		.blending(false);
 
-	glClearColor(0, 0, 0, 1.0f);
+	StateChanger{&arg.renderer->pimpl->states}.clear_color({0.0f, 0.0f, 0.0f, 1.0f});
 	glClear(GL_COLOR_BUFFER_BIT);
 
+	{
+		const auto& container = realize_shader;
+		const auto& program = container->program;
+		program->use(&arg.renderer->pimpl->states);
+		use_realize(arg, *program, container->tex_input_uniform, container->realize);
+		render_geom(&arg.renderer->pimpl->states, *arg.renderer->pimpl->full_screen_geom);
+	}
+}
+
+void RenderWorld::use_realize(const PostProcArg& arg, ShaderProgram& program, const Uniform& tex_input, const RealizeUniforms& realize) const
+{
 	ASSERT(use_hdr);
 	ASSERT(exposure);
 
+	program.set_float(realize.gamma_uniform, arg.renderer->settings.gamma);
+	program.set_float(realize.exposure_uniform, *use_hdr ? *exposure : -1.0f);
+	program.set_bool(realize.use_blur_uniform, bloom_render.has_value());
+	program.set_vec2(realize.uv_scale_uniform, get_uv_scale());
+	bind_texture_2d(&arg.renderer->pimpl->states, tex_input, *realized_buffer);
+	if (bloom_render.has_value())
 	{
-		const auto& container = realize_shader;
-		const auto& program = container->program;
-		program->use();
-		program->set_float(container->gamma_uniform, arg.renderer->settings.gamma);
-		program->set_float(container->exposure_uniform, *use_hdr ? *exposure : -1.0f);
-		program->set_bool(container->use_blur_uniform, bloom_render.has_value());
-		bind_texture_2d(&arg.renderer->pimpl->states, container->tex_input_uniform, *realized_buffer);
-		if (bloom_render.has_value())
-		{
-			bind_texture_2d(&arg.renderer->pimpl->states, container->tex_blurred_bloom_uniform, *bloom_render->ping_pong_buffer[last_bloom_blur_index]);
-		}
-	
-		render_geom(*arg.renderer->pimpl->full_screen_geom);
+		bind_texture_2d(&arg.renderer->pimpl->states, realize.tex_blurred_bloom_uniform, *bloom_render->get_blurred());
 	}
 }
 
@@ -248,12 +446,10 @@ void RenderWorld::render(const PostProcArg& arg)
 
 void RenderWorld::gui(ImguiShaderCache* cache)
 {
-	if (bloom_render && bloom_render->bloom_buffer)
+	// since the buffers are aliased by the render graph, the bloom buffer may have been overwritten by a later pass
+	if (bloom_render && bloom_render->get_blurred())
 	{
-		imgui_image("bloom buffer", *bloom_render->bloom_buffer, cache, ImageShader::TonemapAndGamma);
-
-		imgui_image("ping-pong A", *bloom_render->ping_pong_buffer[0], cache, ImageShader::TonemapAndGamma);
-		imgui_image("ping-pong B", *bloom_render->ping_pong_buffer[1], cache, ImageShader::TonemapAndGamma);
+		imgui_image("blurred bloom", *bloom_render->get_blurred(), cache, ImageShader::TonemapAndGamma);
 	}
 }
 
@@ -261,10 +457,9 @@ void RenderWorld::gui(ImguiShaderCache* cache)
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 // RenderTextureWithShader
 
-RenderTextureWithShader::RenderTextureWithShader(std::string n, std::shared_ptr<RenderSource> s, std::shared_ptr<FrameBuffer> f, ShaderPropertyProvider* e)
+RenderTextureWithShader::RenderTextureWithShader(std::string n, std::shared_ptr<RenderSource> s, ShaderPropertyProvider* e)
 	: name(std::move(n))
 	, source(std::move(s))
-	, fbo(std::move(f))
 	, effect(e)
 {
 	ASSERT(effect);
@@ -283,27 +478,48 @@ void RenderTextureWithShader::render(const PostProcArg& arg)
 		.depth_mask(false)
 		.blending(false);
 
-	glClearColor(0, 0, 0, 1.0f);
+	StateChanger{&arg.renderer->pimpl->states}.clear_color({0.0f, 0.0f, 0.0f, 1.0f});
 	glClear(GL_COLOR_BUFFER_BIT);
 
 	effect->use_shader(arg, *fbo);
-	render_geom(*arg.renderer->pimpl->full_screen_geom);
+	render_geom(&arg.renderer->pimpl->states, *arg.renderer->pimpl->full_screen_geom);
 }
 
 void RenderTextureWithShader::update(const PostProcArg& arg)
 {
 	SCOPED_DEBUG_GROUP(Str() << "Updating task " << name);
-	auto bound = BoundFbo{fbo};
-	set_gl_viewport({fbo->size.x, fbo->size.y});
+	auto bound = BoundFbo{&arg.renderer->pimpl->states, fbo};
+	StateChanger{&arg.renderer->pimpl->states}.viewport(fbo->size);
 	source->render(arg);
 }
 
 
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// CompiledStack
+
+void CompiledStack::add_target(RenderGraph* graph, const std::string& name, const glm::ivec2& size, ShaderPropertyProvider* effect)
+{
+	auto target = std::make_shared<RenderTextureWithShader>(name, last_source, effect);
+	const auto output = graph->create_transient(Str() << "fbo for " << name, simple_transient(size), &target->fbo);
+	graph->add_pass(Str() << "update " << name, last_source_inputs, {output}, [target](const PostProcArg& arg) { target->update(arg); });
+
+	targets.emplace_back(target);
+	last_source = target;
+	last_source_inputs = {output};
+}
+
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 // EffectStack
 
-void EffectStack::update(float dt) const
+void EffectStack::update(float dt)
 {
+	// with vsync the frame time is never under the budget, so once lowered the scale would never be raised
+	if (const auto render_time = render_timer.read(); render_time)
+	{
+		dynamic_resolution.update(*render_time);
+	}
+
 	for (const auto& e: effects)
 	{
 		if (e->is_enabled == false)
@@ -357,6 +573,33 @@ void EffectStack::render(const PostProcArg& arg)
 		}
 	}
 
+	{
+		const auto latest_bloom_blur_steps = arg.renderer->settings.bloom_blur_steps;
+		if (current_bloom_blur_steps != latest_bloom_blur_steps)
+		{
+			current_bloom_blur_steps = latest_bloom_blur_steps;
+			dirty = true;
+		}
+	}
+
+	{
+		const auto latest_bloom_mode = arg.renderer->settings.bloom_mode;
+		if (current_bloom_mode != latest_bloom_mode)
+		{
+			current_bloom_mode = latest_bloom_mode;
+			dirty = true;
+		}
+	}
+
+	{
+		const auto latest_bloom_mip_count = arg.renderer->settings.bloom_mip_count;
+		if (current_bloom_mip_count != latest_bloom_mip_count)
+		{
+			current_bloom_mip_count = latest_bloom_mip_count;
+			dirty = true;
+		}
+	}
+
 	// if dirty, update the compiled state
 	if (dirty)
 	{
@@ -364,55 +607,134 @@ void EffectStack::render(const PostProcArg& arg)
 		LOG_INFO("Building effects stack");
 
 		compiled.targets.clear();
-
+		compiled.fused_effects.clear();
+		graph.clear();
+
+		auto& shaders = arg.renderer->pimpl->shaders_resources;
+		const auto bloom_setup = should_use_bloom
+			? std::optional<BloomSetup>{BloomSetup{
+				*current_bloom_mode,
+				&shaders.pp_extract,
+				&shaders.pp_ping,
+				&shaders.pp_bloom_downsample,
+				&shaders.pp_bloom_upsample,
+				current_bloom_blur_steps,
+				current_bloom_mip_count
+			}}
+			: std::nullopt;
 		auto created_world = std::make_shared<RenderWorld>(
-			arg.window_size,
-			&arg.renderer->pimpl->shaders_resources.pp_realize,
-			should_use_bloom ? &arg.renderer->pimpl->shaders_resources.pp_extract : nullptr,
-			should_use_bloom ? &arg.renderer->pimpl->shaders_resources.pp_ping : nullptr,
-			current_msaa_setting,
-			&use_hdr,
-			&exposure
+			arg.window_size, &shaders.pp_realize, bloom_setup, current_msaa_setting, &use_hdr, &exposure, &dynamic_resolution
 		);
+		created_world->add_passes(&graph, &compiled.last_source_inputs);
 		compiled.last_source = created_world;
 		render_world = created_world;
 
-		for (auto& e: effects)
+		// collect chains of per-pixel effects and render each chain in a single pass
+		std::vector<SimpleEffect*> chain;
+		const auto build_chain = [&]()
 		{
-			if (e->is_enabled)
+			if (chain.empty())
 			{
-				e->build({&compiled, arg.window_size});
+				return;
 			}
-		}
-	}
 
-	// the stack is now compiled
-	// before rendering, update all targets/fbos and present
-	{
-		SCOPED_DEBUG_GROUP("updating postproc render_world"sv);
-		render_world->update(arg);
-	}
+			std::vector<const LoadedPostProcShader*> chain_shaders;
+			std::string chain_name = "fused";
+			for (auto* effect: chain)
+			{
+				effect->time = 0.0f;
+				chain_shaders.emplace_back(effect->shader.get());
+				chain_name += " " + effect->name;
+			}
 
-	{
-		SCOPED_DEBUG_GROUP("rendering postproc actions"sv);
-		for (const auto& action: compiled.targets)
+			// if nothing has been added after the world, the realize step can be merged into the chain
+			const auto merge_with_realize = compiled.last_source == render_world;
+			auto fused = std::make_shared<FusedEffects>(
+				get_fused_effects_shader(&arg.renderer->pimpl->shaders_resources, merge_with_realize, chain_shaders),
+				chain,
+				merge_with_realize ? render_world.get() : nullptr
+			);
+			compiled.fused_effects.emplace_back(fused);
+
+			if (merge_with_realize)
+			{
+				// reads the same resources as the world, so the inputs are kept
+				compiled.last_source = fused;
+			}
+			else
+			{
+				compiled.add_target(&graph, chain_name, arg.window_size, fused.get());
+			}
+
+			chain.clear();
+		};
+
+		for (auto& e: effects)
 		{
-			action->update(arg);
+			if (e->is_enabled == false)
+			{
+				continue;
+			}
+
+			auto* per_pixel = fuse_effects ? e->as_per_pixel_effect() : nullptr;
+			if (per_pixel != nullptr)
+			{
+				// the helper functions in a effect can't be defined twice in the same shader
+				const auto is_repeated = std::ranges::any_of(chain, [&](const SimpleEffect* c) { return c->shader == per_pixel->shader; });
+				if (is_repeated)
+				{
+					build_chain();
+				}
+				chain.emplace_back(per_pixel);
+				continue;
+			}
+
+			build_chain();
+			e->build({&compiled, &graph, arg.window_size});
 		}
-	}
+		build_chain();
 
-	// render the final image to the screen
-	{
-		SCOPED_DEBUG_GROUP("rendering postproc to screen"sv);
-		set_gl_viewport(arg.window_size);
-		compiled.last_source->render(arg);
+		// render the final image to the screen
+		graph.add_output_pass(
+			"rendering postproc to screen",
+			compiled.last_source_inputs,
+			[this](const PostProcArg& a)
+			{
+				StateChanger{&a.renderer->pimpl->states}.viewport(a.window_size);
+				compiled.last_source->render(a);
+			}
+		);
+
+		compiled_graph = compile_render_graph(graph);
+		framebuffer_pool.realize(graph, compiled_graph);
 	}
+
+	// the stack is now compiled, execute all passes and present
+	render_timer.begin();
+	execute_render_graph(graph, compiled_graph, arg);
+	render_timer.end();
 }
 
 void EffectStack::gui(ImguiShaderCache* cache)
 {
 	ImGui::Checkbox("HDR", &use_hdr);
 	ImGui::SliderFloat("Exposure", &exposure, 0.01f, 20.0f);
+	if (ImGui::Checkbox("Fuse effects", &fuse_effects))
+	{
+		dirty = true;
+	}
+
+	ImGui::Checkbox("Dynamic resolution", &dynamic_resolution.enabled);
+	if (dynamic_resolution.enabled)
+	{
+		float target_ms = dynamic_resolution.target_frame_time * 1000.0f;
+		if (ImGui::SliderFloat("Target frame time (ms)", &target_ms, 4.0f, 50.0f))
+		{
+			dynamic_resolution.target_frame_time = target_ms / 1000.0f;
+		}
+		ImGui::SliderFloat("Min scale", &dynamic_resolution.min_scale, 0.25f, 1.0f);
+		imgui_text(Str{} << "Render scale: " << static_cast<int>(dynamic_resolution.scale * 100.0f) << "%");
+	}
 
 	if (render_world)
 	{
@@ -472,6 +794,16 @@ void FloatDragShaderProp::gui()
 	ImGui::DragFloat(name.c_str(), &value, speed);
 }
 
+const std::string& FloatDragShaderProp::get_uniform_name() const
+{
+	return name;
+}
+
+void FloatDragShaderProp::use_uniform(ShaderProgram& shader, const Uniform& u)
+{
+	shader.set_float(u, value);
+}
+
 
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////
@@ -498,6 +830,16 @@ void FloatSliderShaderProp::gui()
 	ImGui::SliderFloat(name.c_str(), &value, min, max);
 }
 
+const std::string& FloatSliderShaderProp::get_uniform_name() const
+{
+	return name;
+}
+
+void FloatSliderShaderProp::use_uniform(ShaderProgram& shader, const Uniform& u)
+{
+	shader.set_float(u, value);
+}
+
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 // SimpleEffect
@@ -549,26 +891,30 @@ void SimpleEffect::update(float dt)
 	time += dt;
 }
 
-void SimpleEffect::use_shader(const PostProcArg& a, const FrameBuffer& t)
+void SimpleEffect::use_common_uniforms(
+	const PostProcArg& a, ShaderProgram& program, const std::optional<Uniform>& factor_uni,
+	const std::optional<Uniform>& resolution_uni, const std::optional<Uniform>& time_uni
+) const
 {
-	shader->program->use();
-
-	const auto& shader_factor = shader->factor_uni;
-	const auto& shader_resolution = shader->resolution_uni;
-	const auto& shader_time = shader->time_uni;
-
-	if (shader_factor)
+	if (factor_uni)
 	{
-		shader->program->set_float(*shader_factor, get_factor());
+		program.set_float(*factor_uni, get_factor());
 	}
-	if (shader_resolution)
+	if (resolution_uni)
 	{
-		shader->program->set_vec2(*shader_resolution, a.window_size);
+		program.set_vec2(*resolution_uni, a.window_size);
 	}
-	if (shader_time)
+	if (time_uni)
 	{
-		shader->program->set_float(*shader_time, time);
+		program.set_float(*time_uni, time);
 	}
+}
+
+void SimpleEffect::use_shader(const PostProcArg& a, const FrameBuffer& t)
+{
+	shader->program->use(&a.renderer->pimpl->states);
+
+	use_common_uniforms(a, *shader->program, shader->factor_uni, shader->resolution_uni, shader->time_uni);
 	for (auto& p: properties)
 	{
 		p->use(a, *shader->program);
@@ -576,19 +922,92 @@ void SimpleEffect::use_shader(const PostProcArg& a, const FrameBuffer& t)
 	bind_texture_2d(&a.renderer->pimpl->states, shader->tex_input_uniform, t);
 }
 
+SimpleEffect* SimpleEffect::as_per_pixel_effect()
+{
+	if (shader->per_pixel.has_value() == false)
+	{
+		return nullptr;
+	}
+	return this;
+}
+
 void SimpleEffect::build(const BuildArg& arg)
 {
 	time = 0.0f;
+	arg.builder->add_target(arg.graph, name, arg.window_size, this);
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// FusedEffects
 
-	// todo(Gustav): reuse buffers created from an earlier postproc build
-	// todo(Gustav): reuse buffers from earlier in the postproc stack, that aren't in use
-	auto fbo = build_simple_framebuffer(USE_DEBUG_LABEL_MANY(Str() << "fbo for " << name) arg.window_size);
+FusedEffects::FusedEffects(std::shared_ptr<FusedEffectsShader> s, std::vector<SimpleEffect*> e, RenderWorld* w)
+	: shader(std::move(s))
+	, effects(std::move(e))
+	, world(w)
+{
+	ASSERT(shader->effects.size() == effects.size());
+	ASSERT((world != nullptr) == shader->realize.has_value());
 
-	auto src = arg.builder->last_source;
-	auto target = std::make_shared<RenderTextureWithShader>(name, src, fbo, this);
+	for (std::size_t index = 0; index < effects.size(); index += 1)
+	{
+		const auto& prefix = shader->effects[index].prefix;
+		auto& uniforms = property_uniforms.emplace_back();
+		for (const auto& p: effects[index]->properties)
+		{
+			uniforms.emplace_back(shader->program->get_uniform(fused_uniform_name(prefix, p->get_uniform_name())));
+		}
+	}
+}
+
+void FusedEffects::use_effects(const PostProcArg& a)
+{
+	auto& program = *shader->program;
+	for (std::size_t index = 0; index < effects.size(); index += 1)
+	{
+		const auto* effect = effects[index];
+		const auto& uniforms = shader->effects[index];
+		effect->use_common_uniforms(a, program, uniforms.factor_uni, uniforms.resolution_uni, uniforms.time_uni);
 
-	arg.builder->targets.emplace_back(target);
-	arg.builder->last_source = target;
+		const auto& props = effect->properties;
+		for (std::size_t prop_index = 0; prop_index < props.size(); prop_index += 1)
+		{
+			props[prop_index]->use_uniform(program, property_uniforms[index][prop_index]);
+		}
+	}
+}
+
+void FusedEffects::render(const PostProcArg& arg)
+{
+	ASSERT(world);
+	ASSERT(shader->realize);
+
+	SCOPED_DEBUG_GROUP("render realized msaa buffer with fused effects"sv);
+	StateChanger{&arg.renderer->pimpl->states}
+		.cull_face(false)
+		.stencil_test(false)
+		.depth_test(false)
+		.depth_mask(false)
+		.blending(false);
+
+	StateChanger{&arg.renderer->pimpl->states}.clear_color({0.0f, 0.0f, 0.0f, 1.0f});
+	glClear(GL_COLOR_BUFFER_BIT);
+
+	shader->program->use(&arg.renderer->pimpl->states);
+	world->use_realize(arg, *shader->program, shader->tex_input_uniform, *shader->realize);
+	use_effects(arg);
+
+	render_geom(&arg.renderer->pimpl->states, *arg.renderer->pimpl->full_screen_geom);
+}
+
+void FusedEffects::use_shader(const PostProcArg& a, const FrameBuffer& t)
+{
+	ASSERT(world == nullptr);
+
+	shader->program->use(&a.renderer->pimpl->states);
+	use_effects(a);
+	bind_texture_2d(&a.renderer->pimpl->states, shader->tex_input_uniform, t);
 }
 
 
@@ -635,11 +1054,11 @@ BlurEffect::BlurEffect(std::string n, std::shared_ptr<LoadedPostProcShader> v, s
 	, hori_p(this)
 	, vert(std::move(v))
 	, hori(std::move(h))
-	, blur_size_v(vert->program->get_uniform("u_blur_size"))
-	, blur_size_h(hori->program->get_uniform("u_blur_size"))
+	, blur_size_v(vert->program->get_uniform("u_blur_size", UniformKind::float_type))
+	, blur_size_h(hori->program->get_uniform("u_blur_size", UniformKind::float_type))
 #if FF_HAS(BLUR_USE_GAUSS)
-	, std_dev_v(vert->program->get_uniform("u_std_dev"))
-	, std_dev_h(hori->program->get_uniform("u_std_dev"))
+	, std_dev_v(vert->program->get_uniform("u_std_dev", UniformKind::float_type))
+	, std_dev_h(hori->program->get_uniform("u_std_dev", UniformKind::float_type))
 #endif
 {
 	ASSERT(vert->factor_uni.has_value());
@@ -670,7 +1089,7 @@ void BlurEffect::use_vert_shader(const PostProcArg& a, const FrameBuffer& t) con
 {
 	const auto& factor_uniform = vert->factor_uni;
 
-	vert->program->use();
+	vert->program->use(&a.renderer->pimpl->states);
 	ASSERT(factor_uniform);
 	if (factor_uniform)
 	{
@@ -688,7 +1107,7 @@ void BlurEffect::use_hori_shader(const PostProcArg& a, const FrameBuffer& t)
 	const auto& factor_uniform = hori->factor_uni;
 	const auto& resolution_uniform = hori->resolution_uni;
 
-	hori->program->use();
+	hori->program->use(&a.renderer->pimpl->states);
 	ASSERT(factor_uniform);
 	if (factor_uniform)
 	{
@@ -708,22 +1127,13 @@ void BlurEffect::use_hori_shader(const PostProcArg& a, const FrameBuffer& t)
 
 void BlurEffect::build(const BuildArg& arg)
 {
-	auto src = arg.builder->last_source;
-
 	// todo(Gustav): modify resolution to get better blur and at a lower cost!
 
 	// step 1: vertical
-	auto fbo_v = build_simple_framebuffer(USE_DEBUG_LABEL_MANY("blur vertical") arg.window_size);
-	auto target_v = std::make_shared<RenderTextureWithShader>("blur vertical", src, fbo_v, &vert_p);
-	arg.builder->targets.emplace_back(target_v);
+	arg.builder->add_target(arg.graph, "blur vertical", arg.window_size, &vert_p);
 
 	// step 2: horizontal
-	auto fbo_h = build_simple_framebuffer(USE_DEBUG_LABEL_MANY("blur horizontal") arg.window_size);
-	auto target_h = std::make_shared<RenderTextureWithShader>("blur horizontal", target_v, fbo_h, &hori_p);
-	arg.builder->targets.emplace_back(target_h);
-
-	// done
-	arg.builder->last_source = target_h;
+	arg.builder->add_target(arg.graph, "blur horizontal", arg.window_size, &hori_p);
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////
@@ -1,5 +1,9 @@
 #pragma once
 
+#include "klotter/render/dynamic_resolution.h"
+#include "klotter/render/gpu_timer.h"
+#include "klotter/render/render_graph.h"
+#include "klotter/render/render_settings.h"
 #include "klotter/render/texture.h"
 
 namespace klotter
@@ -10,6 +14,8 @@ struct Camera;
 struct World;
 struct RenderWorld;
 struct ImguiShaderCache;
+struct SimpleEffect;
+struct FusedEffects;
 
 /** \addtogroup postproc Post Processing
  * \brief A basic framework for applying post-processing effects and rendering the \ref World.
@@ -61,10 +67,10 @@ struct RenderTextureWithShader : RenderSource
 {
 	std::string name;
 	std::shared_ptr<RenderSource> source;
-	std::shared_ptr<FrameBuffer> fbo;
+	std::shared_ptr<FrameBuffer> fbo; ///< assigned by the render graph
 	ShaderPropertyProvider* effect;
 
-	RenderTextureWithShader(std::string n, std::shared_ptr<RenderSource> s, std::shared_ptr<FrameBuffer> f, ShaderPropertyProvider* e);
+	RenderTextureWithShader(std::string n, std::shared_ptr<RenderSource> s, ShaderPropertyProvider* e);
 
 	/// render internal fbo to a quad with a shader
 	void render(const PostProcArg& arg) override;
@@ -84,7 +90,14 @@ struct CompiledStack
 	/// start with a simple world, but depending on the current effect list, could be more...
 	std::shared_ptr<RenderSource> last_source;
 
+	/// the resources that are read when rendering the last_source
+	std::vector<RenderGraphResource> last_source_inputs;
+
 	std::vector<std::shared_ptr<RenderTextureWithShader>> targets;
+	std::vector<std::shared_ptr<FusedEffects>> fused_effects;
+
+	/// Adds a target that renders the last_source to a new framebuffer and makes it the last_source.
+	void add_target(RenderGraph* graph, const std::string& name, const glm::ivec2& size, ShaderPropertyProvider* effect);
 };
 
 
@@ -93,6 +106,7 @@ struct CompiledStack
 struct BuildArg
 {
 	CompiledStack* builder;
+	RenderGraph* graph;
 	glm::ivec2 window_size;
 };
 
@@ -116,6 +130,9 @@ struct Effect
 	virtual void update(float dt) = 0;
 	virtual void gui() = 0;
 
+	/// If not null, this effect only reads the current pixel and can be fused with other per-pixel effects.
+	[[nodiscard]] virtual SimpleEffect* as_per_pixel_effect();
+
 	bool enabled() const;
 
    protected:
@@ -147,22 +164,38 @@ struct FactorEffect : Effect
 struct EffectStack
 {
 	int current_msaa_setting = -1;
+	int current_bloom_blur_steps = -1;
+	std::optional<BloomMode> current_bloom_mode;
+	int current_bloom_mip_count = -1;
 	bool dirty = true;
 	std::optional<glm::ivec2> window_size;
 	std::vector<std::shared_ptr<Effect>> effects;
 	CompiledStack compiled;
 
+	RenderGraph graph;
+	CompiledRenderGraph compiled_graph;
+	FrameBufferPool framebuffer_pool;
+
 	// render world settings
 	// todo(Gustav): is it useful to disable hdr rendering or should that just be removed?
 	// todo(Gustav): move exposure to a better place?
 	bool use_hdr = true;
 	float exposure = 1.0f;
 
+	/// render chains of per-pixel effects, and the realize step, in a single pass
+	bool fuse_effects = true;
+
+	/// scales the resolution the world is rendered at, effects after the world are rendered at full resolution
+	DynamicResolution dynamic_resolution;
+
+	/// the gpu time of \ref render, the dynamic resolution uses it since the frame time includes waiting for vsync
+	GpuTimer render_timer;
+
 	std::shared_ptr<RenderWorld> render_world;
 
-	/// rebuilds stack if dirty, update all targets, then render the last_source
+	/// rebuilds stack and render graph if dirty, then executes the graph that updates all targets and renders the last_source
 	void render(const PostProcArg& arg);
-	void update(float dt) const;
+	void update(float dt);
 	void gui(ImguiShaderCache* cache);
 };
 
@@ -16,33 +16,85 @@ namespace klotter
 
 struct ImguiShaderCache;
 
+/// The shaders and settings needed to build a \ref BloomRender
+struct BloomSetup
+{
+	BloomMode mode;
+	ExtractShader* extract_shader;
+	PingPongBlurShader* ping_pong_shader;
+	BloomDownsampleShader* downsample_shader;
+	BloomUpsampleShader* upsample_shader;
+	int blur_steps;
+	int mip_count;
+};
+
 struct BloomRender
 {
+	BloomMode mode;
+
 	ExtractShader* extract_shader;
 	std::shared_ptr<FrameBuffer> bloom_buffer;
 
 	PingPongBlurShader* ping_pong_shader;
-	std::array<std::shared_ptr<FrameBuffer>, 2> ping_pong_buffer;
+
+	/// one buffer per blur step, the render graph aliases these to two framebuffers
+	std::vector<std::shared_ptr<FrameBuffer>> blur_buffers;
+
+	BloomDownsampleShader* downsample_shader;
+	BloomUpsampleShader* upsample_shader;
+
+	/// the mip chain, 1/2, 1/4 ... of the screen
+	std::vector<std::shared_ptr<FrameBuffer>> down_buffers;
+
+	/// the accumulated mips, same size as the down buffers except there is none for the smallest mip
+	std::vector<std::shared_ptr<FrameBuffer>> up_buffers;
+
+	/// the final blurred buffer
+	[[nodiscard]] const std::shared_ptr<FrameBuffer>& get_blurred() const;
 };
 
 /// @brief A source that "just" renders the world.
 struct RenderWorld : RenderSource
 {
 	glm::ivec2 window_size;
+	int msaa_samples;
 
 	bool* use_hdr;
 	float* exposure;
+	const DynamicResolution* dynamic_resolution;
 
 	std::shared_ptr<FrameBuffer> msaa_buffer;
 	std::shared_ptr<FrameBuffer> realized_buffer;
 	std::shared_ptr<FrameBuffer> shadow_buffer;
 	RealizeShader* realize_shader;
 	std::optional<BloomRender> bloom_render;
-	std::size_t last_bloom_blur_index;
 
-	RenderWorld(const glm::ivec2 size, RealizeShader* re_sh, ExtractShader* ex_sh, PingPongBlurShader* ping_sh, int msaa_samples, bool* h, float* e);
+	RenderWorld(
+		const glm::ivec2 size, RealizeShader* re_sh, const std::optional<BloomSetup>& bloom, int msaa, bool* h, float* e, const DynamicResolution* dr
+	);
+
+	/// the buffers are allocated at the window size, but only the lower left part of this size is rendered to
+	[[nodiscard]] glm::ivec2 get_render_size() const;
+
+	/// the part of the buffers that is rendered to, in uv space
+	[[nodiscard]] glm::vec2 get_uv_scale() const;
 
-	void update(const PostProcArg& arg);
+	/// bind the fbo and set the viewport to the rendered part of it
+	void set_scaled_viewport(State* states, const FrameBuffer& fbo) const;
+
+	/// declare the world, resolve and bloom passes
+	/// @param source_inputs the resources that are read when this is rendered
+	void add_passes(RenderGraph* graph, std::vector<RenderGraphResource>* source_inputs);
+
+	void render_shadows_and_world(const PostProcArg& arg);
+	void resolve_msaa(const PostProcArg& arg) const;
+	void extract_bloom(const PostProcArg& arg) const;
+	void blur_bloom(const PostProcArg& arg, std::size_t blur_iteration) const;
+	void downsample_bloom(const PostProcArg& arg, std::size_t mip) const;
+	void upsample_bloom(const PostProcArg& arg, std::size_t mip) const;
+
+	/// set the uniforms and textures for the realize step
+	void use_realize(const PostProcArg& arg, ShaderProgram& program, const Uniform& tex_input, const RealizeUniforms& realize) const;
 
 	void render(const PostProcArg& arg) override;
 
@@ -63,6 +115,12 @@ struct ShaderProp
 
 	virtual void use(const PostProcArg& a, ShaderProgram& shader) = 0;
 	virtual void gui() = 0;
+
+	/// the uniform name when the effect is used by itself
+	[[nodiscard]] virtual const std::string& get_uniform_name() const = 0;
+
+	/// set the value on a uniform in a different shader, like a fused shader
+	virtual void use_uniform(ShaderProgram& shader, const Uniform& uniform) = 0;
 };
 
 /// A float shader property that is dragged with the mouse.
@@ -78,6 +136,9 @@ struct FloatDragShaderProp : ShaderProp
 	void use(const PostProcArg&, ShaderProgram& shader) override;
 
 	void gui() override;
+
+	[[nodiscard]] const std::string& get_uniform_name() const override;
+	void use_uniform(ShaderProgram& shader, const Uniform& u) override;
 };
 
 /// A float shader property that is a slider.
@@ -96,6 +157,9 @@ struct FloatSliderShaderProp : ShaderProp
 	void use(const PostProcArg&, ShaderProgram& shader) override;
 
 	void gui() override;
+
+	[[nodiscard]] const std::string& get_uniform_name() const override;
+	void use_uniform(ShaderProgram& shader, const Uniform& u) override;
 };
 
 /// A effect that only performs a single step.
@@ -122,6 +186,41 @@ struct SimpleEffect
 	void use_shader(const PostProcArg& a, const FrameBuffer& t) override;
 
 	void build(const BuildArg& arg) override;
+
+	[[nodiscard]] SimpleEffect* as_per_pixel_effect() override;
+
+	/// set the factor, resolution and time uniforms, if the shader uses them
+	void use_common_uniforms(
+		const PostProcArg& a, ShaderProgram& program, const std::optional<Uniform>& factor_uni,
+		const std::optional<Uniform>& resolution_uni, const std::optional<Uniform>& time_uni
+	) const;
+};
+
+/// A chain of per-pixel effects that are rendered in a single pass.
+/// When the chain directly follows the RenderWorld, the realize step is also merged in and the chain is used as a source.
+/// Otherwise it's used as the shader for a single target.
+struct FusedEffects
+	: RenderSource
+	, ShaderPropertyProvider
+{
+	std::shared_ptr<FusedEffectsShader> shader;
+	std::vector<SimpleEffect*> effects;
+
+	/// one uniform for each property in each effect
+	std::vector<std::vector<Uniform>> property_uniforms;
+
+	/// if not null, the realize step is done in the same pass
+	RenderWorld* world;
+
+	FusedEffects(std::shared_ptr<FusedEffectsShader> s, std::vector<SimpleEffect*> e, RenderWorld* w);
+
+	void use_effects(const PostProcArg& a);
+
+	/// render the world with the realize step and all effects
+	void render(const PostProcArg& arg) override;
+
+	/// apply all effects on a texture
+	void use_shader(const PostProcArg& a, const FrameBuffer& t) override;
 };
 
 struct BlurEffect;
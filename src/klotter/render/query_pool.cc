@@ -0,0 +1,96 @@
+#include "klotter/render/query_pool.h"
+
+#include "klotter/assert.h"
+
+#include "klotter/render/opengl_utils.h"
+
+#include "klotter/dependency_glad.h"
+
+#include <algorithm>
+
+namespace klotter
+{
+
+namespace
+{
+	struct GlQueryBackend : QueryBackend
+	{
+		u32 create_query() override
+		{
+			GLuint query = 0;
+			glGenQueries(1, &query);
+			return query;
+		}
+
+		void destroy_queries(const std::vector<u32>& queries) override
+		{
+			glDeleteQueries(glsizei_from_sizet(queries.size()), queries.data());
+		}
+
+		void begin_query(unsigned int target, u32 query) override
+		{
+			glBeginQuery(target, query);
+		}
+
+		void end_query(unsigned int target) override
+		{
+			glEndQuery(target);
+		}
+
+		bool is_result_available(u32 query) override
+		{
+			GLuint available = GL_FALSE;
+			glGetQueryObjectuiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+			return available != GL_FALSE;
+		}
+
+		u32 get_result(u32 query) override
+		{
+			GLuint result = 0;
+			glGetQueryObjectuiv(query, GL_QUERY_RESULT, &result);
+			return result;
+		}
+	};
+}  //  namespace
+
+QueryBackend* get_gl_query_backend()
+{
+	static GlQueryBackend backend;
+	return &backend;
+}
+
+QueryPool::QueryPool(QueryBackend* b)
+	: backend(b)
+{
+	ASSERT(backend != nullptr);
+}
+
+QueryPool::~QueryPool()
+{
+	if (all_queries.empty() == false)
+	{
+		backend->destroy_queries(all_queries);
+	}
+}
+
+u32 QueryPool::acquire()
+{
+	if (free_queries.empty() == false)
+	{
+		const auto query = free_queries.back();
+		free_queries.pop_back();
+		return query;
+	}
+
+	const auto query = backend->create_query();
+	all_queries.emplace_back(query);
+	return query;
+}
+
+void QueryPool::release(u32 query)
+{
+	ASSERT(std::find(free_queries.begin(), free_queries.end(), query) == free_queries.end());
+	free_queries.emplace_back(query);
+}
+
+}  //  namespace klotter
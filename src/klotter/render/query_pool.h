@@ -0,0 +1,60 @@
+#pragma once
+
+namespace klotter
+{
+
+/** \addtogroup render Renderer
+ *  @{
+*/
+
+/// The gl query calls, replaced with a fake in the tests.
+struct QueryBackend
+{
+	QueryBackend() = default;
+	virtual ~QueryBackend() = default;
+
+	QueryBackend(const QueryBackend&) = delete;
+	QueryBackend(QueryBackend&&) = delete;
+	void operator=(const QueryBackend&) = delete;
+	void operator=(QueryBackend&&) = delete;
+
+	virtual u32 create_query() = 0;
+	virtual void destroy_queries(const std::vector<u32>& queries) = 0;
+
+	virtual void begin_query(unsigned int target, u32 query) = 0;
+	virtual void end_query(unsigned int target) = 0;
+
+	/// Returns false if the gpu hasn't finished the query, doesn't wait.
+	virtual bool is_result_available(u32 query) = 0;
+
+	/// The result of a finished query.
+	virtual u32 get_result(u32 query) = 0;
+};
+
+/// The backend for the current gl context.
+QueryBackend* get_gl_query_backend();
+
+/// Recycles opengl query objects so they aren't created and destroyed every frame.
+struct QueryPool
+{
+	QueryBackend* backend;
+	std::vector<u32> all_queries;
+	std::vector<u32> free_queries;
+
+	explicit QueryPool(QueryBackend* b);
+	~QueryPool();
+
+	QueryPool(const QueryPool&) = delete;
+	QueryPool(QueryPool&&) = delete;
+	void operator=(const QueryPool&) = delete;
+	void operator=(QueryPool&&) = delete;
+
+	u32 acquire();
+	void release(u32 query);
+};
+
+/**
+ * @}
+*/
+
+}  //  namespace klotter
@@ -0,0 +1,272 @@
+#include "klotter/render/render_graph.h"
+
+#include "klotter/assert.h"
+#include "klotter/cint.h"
+#include "klotter/log.h"
+#include "klotter/str.h"
+
+#include "klotter/render/opengl_utils.h"
+
+#include <algorithm>
+
+namespace klotter
+{
+
+TransientDesc simple_transient(const glm::ivec2& size)
+{
+	return {TransientKind::simple, size, ColorBitsPerPixel::use_8, 0};
+}
+
+TransientDesc hdr_transient(const glm::ivec2& size, ColorBitsPerPixel color_bits)
+{
+	return {TransientKind::hdr, size, color_bits, 0};
+}
+
+TransientDesc msaa_transient(const glm::ivec2& size, int msaa_samples, ColorBitsPerPixel color_bits)
+{
+	return {TransientKind::msaa, size, color_bits, msaa_samples};
+}
+
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// RenderGraph
+
+RenderGraphResource RenderGraph::create_transient(std::string name, const TransientDesc& desc, std::shared_ptr<FrameBuffer>* bind_to)
+{
+	const auto id = resources.size();
+	resources.emplace_back(RenderGraphResourceDesc{std::move(name), desc, bind_to});
+	return id;
+}
+
+void RenderGraph::add_pass(
+	std::string name,
+	std::vector<RenderGraphResource> inputs,
+	std::vector<RenderGraphResource> outputs,
+	std::function<void(const PostProcArg&)> execute
+)
+{
+	passes.emplace_back(RenderGraphPass{std::move(name), std::move(inputs), std::move(outputs), false, std::move(execute)});
+}
+
+void RenderGraph::add_output_pass(std::string name, std::vector<RenderGraphResource> inputs, std::function<void(const PostProcArg&)> execute)
+{
+	passes.emplace_back(RenderGraphPass{std::move(name), std::move(inputs), {}, true, std::move(execute)});
+}
+
+void RenderGraph::clear()
+{
+	resources.clear();
+	passes.clear();
+}
+
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Compile
+
+CompiledRenderGraph compile_render_graph(const RenderGraph& graph)
+{
+	const auto pass_count = graph.passes.size();
+	const auto resource_count = graph.resources.size();
+
+	// find the single pass that writes each resource
+	std::vector<std::optional<std::size_t>> producers(resource_count);
+	for (std::size_t pass_index = 0; pass_index < pass_count; pass_index += 1)
+	{
+		for (const auto resource: graph.passes[pass_index].outputs)
+		{
+			ASSERT(resource < resource_count);
+			ASSERT(producers[resource].has_value() == false && "resource written by more than one pass");
+			producers[resource] = pass_index;
+		}
+	}
+
+	// cull: a pass is needed if it has side effects or if any of its outputs are read by a needed pass
+	std::vector<std::size_t> pass_refs(pass_count, 0);
+	std::vector<std::size_t> resource_refs(resource_count, 0);
+	for (std::size_t pass_index = 0; pass_index < pass_count; pass_index += 1)
+	{
+		const auto& pass = graph.passes[pass_index];
+		pass_refs[pass_index] = pass.outputs.size() + (pass.has_side_effects ? 1 : 0);
+		for (const auto resource: pass.inputs)
+		{
+			ASSERT(resource < resource_count);
+			ASSERT(producers[resource].has_value() && *producers[resource] < pass_index && "resource read before it was written");
+			resource_refs[resource] += 1;
+		}
+	}
+
+	std::vector<RenderGraphResource> unreferenced;
+	for (RenderGraphResource resource = 0; resource < resource_count; resource += 1)
+	{
+		if (resource_refs[resource] == 0)
+		{
+			unreferenced.emplace_back(resource);
+		}
+	}
+
+	while (unreferenced.empty() == false)
+	{
+		const auto resource = unreferenced.back();
+		unreferenced.pop_back();
+
+		if (producers[resource].has_value() == false)
+		{
+			continue;
+		}
+
+		const auto producer = *producers[resource];
+		ASSERT(pass_refs[producer] > 0);
+		pass_refs[producer] -= 1;
+		if (pass_refs[producer] != 0)
+		{
+			continue;
+		}
+
+		// the producer is culled, so it no longer references its inputs
+		for (const auto input: graph.passes[producer].inputs)
+		{
+			ASSERT(resource_refs[input] > 0);
+			resource_refs[input] -= 1;
+			if (resource_refs[input] == 0)
+			{
+				unreferenced.emplace_back(input);
+			}
+		}
+	}
+
+	CompiledRenderGraph compiled;
+	compiled.lifetimes.resize(resource_count);
+
+	// compute lifetimes, in the execution order of the surviving passes
+	std::vector<bool> is_used(resource_count, false);
+	for (std::size_t pass_index = 0; pass_index < pass_count; pass_index += 1)
+	{
+		if (pass_refs[pass_index] == 0)
+		{
+			continue;
+		}
+
+		const auto order = compiled.passes.size();
+		compiled.passes.emplace_back(pass_index);
+
+		for (const auto resource: graph.passes[pass_index].outputs)
+		{
+			compiled.lifetimes[resource].first_pass = order;
+			compiled.lifetimes[resource].last_pass = order;
+			is_used[resource] = true;
+		}
+		for (const auto resource: graph.passes[pass_index].inputs)
+		{
+			compiled.lifetimes[resource].last_pass = order;
+		}
+	}
+
+	// alias resources, greedily in the order they are first written
+	std::vector<RenderGraphResource> sorted_resources;
+	for (RenderGraphResource resource = 0; resource < resource_count; resource += 1)
+	{
+		if (is_used[resource])
+		{
+			sorted_resources.emplace_back(resource);
+		}
+	}
+	std::stable_sort(
+		sorted_resources.begin(),
+		sorted_resources.end(),
+		[&](RenderGraphResource lhs, RenderGraphResource rhs)
+		{ return compiled.lifetimes[lhs].first_pass < compiled.lifetimes[rhs].first_pass; }
+	);
+
+	// the last pass index that reads or writes each physical framebuffer
+	std::vector<std::size_t> physical_last_pass;
+	for (const auto resource: sorted_resources)
+	{
+		auto& lifetime = compiled.lifetimes[resource];
+		const auto& desc = graph.resources[resource].desc;
+
+		// a pass can't read and write the same framebuffer so the old lifetime must end before the new starts
+		for (std::size_t physical = 0; physical < compiled.physical.size(); physical += 1)
+		{
+			if (compiled.physical[physical] == desc && physical_last_pass[physical] < lifetime.first_pass)
+			{
+				lifetime.physical = physical;
+				physical_last_pass[physical] = lifetime.last_pass;
+				break;
+			}
+		}
+
+		if (lifetime.physical.has_value() == false)
+		{
+			lifetime.physical = compiled.physical.size();
+			compiled.physical.emplace_back(desc);
+			physical_last_pass.emplace_back(lifetime.last_pass);
+		}
+	}
+
+	return compiled;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// FrameBufferPool
+
+std::shared_ptr<FrameBuffer> build_transient_framebuffer(DEBUG_LABEL_ARG_MANY const TransientDesc& desc)
+{
+	switch (desc.kind)
+	{
+	case TransientKind::simple: return build_simple_framebuffer(USE_DEBUG_LABEL_MANY(debug_label) desc.size);
+	case TransientKind::hdr: return build_hdr_floating_framebuffer(USE_DEBUG_LABEL_MANY(debug_label) desc.size, desc.color_bits);
+	case TransientKind::msaa:
+		return build_msaa_framebuffer(USE_DEBUG_LABEL_MANY(debug_label) desc.size, desc.msaa_samples, desc.color_bits);
+	default: DIE("invalid transient kind"); return nullptr;
+	}
+}
+
+void FrameBufferPool::realize(const RenderGraph& graph, const CompiledRenderGraph& compiled)
+{
+	std::vector<Entry> old_entries = std::move(entries);
+	entries.clear();
+
+	for (std::size_t physical = 0; physical < compiled.physical.size(); physical += 1)
+	{
+		const auto& desc = compiled.physical[physical];
+		const auto found = std::find_if(old_entries.begin(), old_entries.end(), [&](const Entry& e) { return e.desc == desc; });
+		if (found != old_entries.end())
+		{
+			entries.emplace_back(std::move(*found));
+			old_entries.erase(found);
+		}
+		else
+		{
+			entries.emplace_back(Entry{desc, build_transient_framebuffer(USE_DEBUG_LABEL_MANY(Str() << "transient fbo " << physical) desc)});
+		}
+	}
+
+	for (std::size_t resource = 0; resource < graph.resources.size(); resource += 1)
+	{
+		const auto& physical = compiled.lifetimes[resource].physical;
+		auto* bind_to = graph.resources[resource].bind_to;
+		ASSERT(bind_to);
+		*bind_to = physical ? entries[*physical].fbo : nullptr;
+	}
+
+	LOG_INFO(
+		"Render graph: %d of %d passes, %d resources in %d framebuffers",
+		int_from_sizet(compiled.passes.size()),
+		int_from_sizet(graph.passes.size()),
+		int_from_sizet(graph.resources.size()),
+		int_from_sizet(entries.size())
+	);
+}
+
+void execute_render_graph(const RenderGraph& graph, const CompiledRenderGraph& compiled, const PostProcArg& arg)
+{
+	for (const auto pass_index: compiled.passes)
+	{
+		const auto& pass = graph.passes[pass_index];
+		SCOPED_DEBUG_GROUP(pass.name);
+		pass.execute(arg);
+	}
+}
+
+}  //  namespace klotter
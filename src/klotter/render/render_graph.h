@@ -0,0 +1,134 @@
+#pragma once
+
+#include "klotter/render/texture.h"
+
+#include <functional>
+
+namespace klotter
+{
+
+struct PostProcArg;
+
+/** \addtogroup postproc Post Processing
+ *  @{
+*/
+
+/// The kind of framebuffer a transient resource needs.
+enum class TransientKind
+{
+	simple,
+	hdr,
+	msaa
+};
+
+/// Describes a transient framebuffer, resources with equal descriptions can share the same framebuffer.
+struct TransientDesc
+{
+	TransientKind kind = TransientKind::simple;
+	glm::ivec2 size = {0, 0};
+	ColorBitsPerPixel color_bits = ColorBitsPerPixel::use_8;
+	int msaa_samples = 0;
+
+	bool operator==(const TransientDesc&) const = default;
+};
+
+TransientDesc simple_transient(const glm::ivec2& size);
+TransientDesc hdr_transient(const glm::ivec2& size, ColorBitsPerPixel color_bits);
+TransientDesc msaa_transient(const glm::ivec2& size, int msaa_samples, ColorBitsPerPixel color_bits);
+
+/// A handle to a resource in a \ref RenderGraph
+using RenderGraphResource = std::size_t;
+
+/// A virtual framebuffer that is written by a single pass and read by zero or more passes.
+struct RenderGraphResourceDesc
+{
+	std::string name;
+	TransientDesc desc;
+
+	/// the framebuffer is assigned here when the graph is realized, or reset if the resource is unused
+	std::shared_ptr<FrameBuffer>* bind_to;
+};
+
+/// A pass in a \ref RenderGraph.
+struct RenderGraphPass
+{
+	std::string name;
+	std::vector<RenderGraphResource> inputs;
+	std::vector<RenderGraphResource> outputs;
+
+	/// passes with side effects, like rendering to the screen, are never culled
+	bool has_side_effects;
+
+	std::function<void(const PostProcArg&)> execute;
+};
+
+/// Declares the passes of a frame and the transient framebuffers between them.
+/// Passes are executed in the order they are declared.
+struct RenderGraph
+{
+	std::vector<RenderGraphResourceDesc> resources;
+	std::vector<RenderGraphPass> passes;
+
+	RenderGraphResource create_transient(std::string name, const TransientDesc& desc, std::shared_ptr<FrameBuffer>* bind_to);
+
+	void add_pass(
+		std::string name,
+		std::vector<RenderGraphResource> inputs,
+		std::vector<RenderGraphResource> outputs,
+		std::function<void(const PostProcArg&)> execute
+	);
+
+	/// Add a pass that is never culled, like a pass that renders to the screen.
+	void add_output_pass(std::string name, std::vector<RenderGraphResource> inputs, std::function<void(const PostProcArg&)> execute);
+
+	void clear();
+};
+
+/// When a resource is alive, and the framebuffer it is aliased to.
+struct ResourceLifetime
+{
+	/// the index of the physical framebuffer, or none if the resource is unused
+	std::optional<std::size_t> physical;
+
+	std::size_t first_pass = 0;
+	std::size_t last_pass = 0;
+};
+
+/// The result of compiling a \ref RenderGraph.
+struct CompiledRenderGraph
+{
+	/// indices of the passes to execute, in order
+	std::vector<std::size_t> passes;
+
+	/// one entry for each resource in the graph
+	std::vector<ResourceLifetime> lifetimes;
+
+	/// the framebuffers that needs to be created
+	std::vector<TransientDesc> physical;
+};
+
+/// Culls passes whose outputs are never used, then aliases resources whose lifetimes don't overlap.
+CompiledRenderGraph compile_render_graph(const RenderGraph& graph);
+
+/// Keeps the physical framebuffers between rebuilds of the graph so toggling a effect doesn't recreate everything.
+struct FrameBufferPool
+{
+	struct Entry
+	{
+		TransientDesc desc;
+		std::shared_ptr<FrameBuffer> fbo;
+	};
+
+	std::vector<Entry> entries;
+
+	/// Creates or reuses the physical framebuffers and assign them to the resources, unused framebuffers are destroyed.
+	void realize(const RenderGraph& graph, const CompiledRenderGraph& compiled);
+};
+
+void execute_render_graph(const RenderGraph& graph, const CompiledRenderGraph& compiled, const PostProcArg& arg);
+
+/**
+ * @}
+*/
+
+}  //  namespace klotter
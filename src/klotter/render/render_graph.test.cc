@@ -0,0 +1,110 @@
+#include "klotter/render/render_graph.h"
+
+#include "catch2/catch_test_macros.hpp"
+
+
+using namespace klotter;
+
+namespace
+{
+	const auto size = glm::ivec2{1920, 1080};
+
+	void nop(const PostProcArg&)
+	{
+	}
+}
+
+TEST_CASE("render_graph_chain_aliases_to_two_buffers", "[render_graph]")
+{
+	std::array<std::shared_ptr<FrameBuffer>, 4> fbos;
+
+	RenderGraph graph;
+	const auto a = graph.create_transient("a", simple_transient(size), &fbos[0]);
+	const auto b = graph.create_transient("b", simple_transient(size), &fbos[1]);
+	const auto c = graph.create_transient("c", simple_transient(size), &fbos[2]);
+	const auto d = graph.create_transient("d", simple_transient(size), &fbos[3]);
+	graph.add_pass("write a", {}, {a}, nop);
+	graph.add_pass("a to b", {a}, {b}, nop);
+	graph.add_pass("b to c", {b}, {c}, nop);
+	graph.add_pass("c to d", {c}, {d}, nop);
+	graph.add_output_pass("present", {d}, nop);
+
+	const auto compiled = compile_render_graph(graph);
+
+	CHECK(compiled.passes.size() == 5);
+	CHECK(compiled.physical.size() == 2);
+
+	// a pass never reads and writes the same framebuffer
+	CHECK(compiled.lifetimes[a].physical != compiled.lifetimes[b].physical);
+	CHECK(compiled.lifetimes[b].physical != compiled.lifetimes[c].physical);
+	CHECK(compiled.lifetimes[c].physical != compiled.lifetimes[d].physical);
+
+	CHECK(compiled.lifetimes[a].physical == compiled.lifetimes[c].physical);
+	CHECK(compiled.lifetimes[b].physical == compiled.lifetimes[d].physical);
+}
+
+TEST_CASE("render_graph_overlapping_lifetimes_are_not_aliased", "[render_graph]")
+{
+	std::array<std::shared_ptr<FrameBuffer>, 3> fbos;
+
+	RenderGraph graph;
+	const auto a = graph.create_transient("a", simple_transient(size), &fbos[0]);
+	const auto b = graph.create_transient("b", simple_transient(size), &fbos[1]);
+	const auto c = graph.create_transient("c", simple_transient(size), &fbos[2]);
+	graph.add_pass("write a", {}, {a}, nop);
+	graph.add_pass("a to b", {a}, {b}, nop);
+	graph.add_pass("b to c", {b}, {c}, nop);
+	graph.add_output_pass("present", {a, c}, nop);
+
+	const auto compiled = compile_render_graph(graph);
+
+	// a is alive until the end, but b is dead when c is written
+	CHECK(compiled.physical.size() == 3);
+	CHECK(compiled.lifetimes[a].first_pass == 0);
+	CHECK(compiled.lifetimes[a].last_pass == 3);
+}
+
+TEST_CASE("render_graph_different_descriptions_are_not_aliased", "[render_graph]")
+{
+	std::array<std::shared_ptr<FrameBuffer>, 3> fbos;
+
+	RenderGraph graph;
+	const auto a = graph.create_transient("a", simple_transient(size), &fbos[0]);
+	const auto b = graph.create_transient("b", hdr_transient(size, ColorBitsPerPixel::use_16), &fbos[1]);
+	const auto c = graph.create_transient("c", simple_transient(size / 2), &fbos[2]);
+	graph.add_pass("write a", {}, {a}, nop);
+	graph.add_pass("a to b", {a}, {b}, nop);
+	graph.add_pass("b to c", {b}, {c}, nop);
+	graph.add_output_pass("present", {c}, nop);
+
+	const auto compiled = compile_render_graph(graph);
+
+	CHECK(compiled.physical.size() == 3);
+}
+
+TEST_CASE("render_graph_unused_passes_are_culled", "[render_graph]")
+{
+	std::array<std::shared_ptr<FrameBuffer>, 4> fbos;
+
+	RenderGraph graph;
+	const auto a = graph.create_transient("a", simple_transient(size), &fbos[0]);
+	const auto b = graph.create_transient("b", simple_transient(size), &fbos[1]);
+	const auto debug = graph.create_transient("debug", simple_transient(size), &fbos[2]);
+	const auto debug_blurred = graph.create_transient("debug blurred", simple_transient(size), &fbos[3]);
+	graph.add_pass("write a", {}, {a}, nop);
+	graph.add_pass("a to debug", {a}, {debug}, nop);
+	graph.add_pass("debug to blurred", {debug}, {debug_blurred}, nop);
+	graph.add_pass("a to b", {a}, {b}, nop);
+	graph.add_output_pass("present", {b}, nop);
+
+	const auto compiled = compile_render_graph(graph);
+
+	REQUIRE(compiled.passes.size() == 3);
+	CHECK(compiled.passes[0] == 0);
+	CHECK(compiled.passes[1] == 3);
+	CHECK(compiled.passes[2] == 4);
+
+	CHECK(compiled.lifetimes[debug].physical.has_value() == false);
+	CHECK(compiled.lifetimes[debug_blurred].physical.has_value() == false);
+	CHECK(compiled.physical.size() == 2);
+}
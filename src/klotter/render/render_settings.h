@@ -1,5 +1,7 @@
 #pragma once
 
+#include <filesystem>
+
 namespace klotter
 {
 
@@ -7,6 +9,17 @@ namespace klotter
  *  @{
 */
 
+/// How the bloom is blurred.
+enum class BloomMode
+{
+	/// blur the extracted bloom several times at full resolution, the radius depends on the number of steps.
+	ping_pong_blur,
+
+	/// downsample the extracted bloom to smaller and smaller mips and accumulate them when upsampling,
+	/// the radius depends on the number of mips.
+	mip_chain
+};
+
 // todo(Gustav): figure out what values should force the renderer to restart.
 /// Startup settings for the renderer.
 struct RenderSettings
@@ -39,10 +52,25 @@ struct RenderSettings
 	/// The renderer doesn't need to restart when this value has changed.
 	float bloom_softness = 0.25f;
 
-	/// how any steps of bloom blur to perform.
+	/// how any steps of bloom blur to perform, when using \ref BloomMode::ping_pong_blur
 	/// The renderer doesn't need to restart when this value has changed.
+	/// The effect stack needs to be rebuilt, but that should happen automatically.
 	int bloom_blur_steps = 10;
 
+	/// How the bloom is blurred.
+	/// The renderer doesn't need to restart when this value has changed.
+	/// The effect stack needs to be rebuilt, but that should happen automatically.
+	BloomMode bloom_mode = BloomMode::mip_chain;
+
+	/// The number of mips in the bloom mip chain, each mip is half the size of the previous so 6 goes down to 1/64 of the screen.
+	/// The renderer doesn't need to restart when this value has changed.
+	/// The effect stack needs to be rebuilt, but that should happen automatically.
+	int bloom_mip_count = 6;
+
+	/// The radius of the tent filter when upsampling the bloom mip chain, in texels of the smaller mip.
+	/// The renderer doesn't need to restart when this value has changed.
+	float bloom_filter_radius = 1.0f;
+
 	/// The resolution of the shadow map.
 	/// The renderer needs to restart when this value has changed.
 	glm::ivec2 shadow_map_resolution = {2048, 2048};
@@ -50,6 +78,19 @@ struct RenderSettings
 	/// Use a tight fit shadow map.
 	/// The renderer doesn't need to restart when this value has changed.
 	bool use_tight_fit_shadows = false;
+
+	/// Store linked shader programs on disk and load them on the next start instead of compiling.
+	/// The renderer needs to restart when this value has changed.
+	bool use_shader_cache = true;
+
+	/// Save the shader permutations that were used and compile them in the background on the next start.
+	/// The renderer needs to restart when this value has changed.
+	bool prewarm_shaders = true;
+
+	/// The file the permutations are saved to when \ref prewarm_shaders is set, the permutations depend on the app so each app needs its own.
+	/// Empty is filled in by \ref run_main with a file in the shader cache named after the executable directory, other empty paths don't prewarm.
+	/// The renderer needs to restart when this value has changed.
+	std::filesystem::path shader_manifest_path;
 };
 
 /**
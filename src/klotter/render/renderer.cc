@@ -1,8 +1,11 @@
 #include "klotter/render/renderer.h"
 
+#include "klotter/cint.h"
 #include "klotter/log.h"
 
 #include "klotter/render/camera.h"
+#include "klotter/render/command_buffer.h"
+#include "klotter/render/draw.block.h"
 #include "klotter/render/fullscreen.h"
 #include "klotter/render/geom.builder.h"
 #include "klotter/render/geom.h"
@@ -35,9 +38,22 @@ Skybox Renderer::make_skybox(std::shared_ptr<TextureCubemap> texture) const
 	return {geom, std::move(texture)};
 }
 
-struct TransparentMesh
+/// A mesh and where its per draw data was written.
+struct MeshDraw
 {
 	std::shared_ptr<MeshInstance> mesh;
+	glm::mat4 world_from_local;
+	int slot;
+	int occlusion_box_slot = -1;
+	int outline_slot = -1;
+
+	/// index of the prepared material in the frame
+	std::size_t material = 0;
+};
+
+struct TransparentMesh
+{
+	const MeshDraw* draw;
 	float squared_distance_to_camera;
 };
 
@@ -66,6 +82,16 @@ bool Renderer::is_loaded() const
 	return pimpl->shaders_resources.is_loaded() && pimpl->debug_drawer.is_loaded();
 }
 
+StateStats Renderer::get_state_stats() const
+{
+	return pimpl->states.stats;
+}
+
+void Renderer::reset_state_stats()
+{
+	pimpl->states.stats = {};
+}
+
 glm::mat4 rot_from_basis(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c)
 {
 	return glm::mat4{glm::vec4{a, 0}, glm::vec4{b, 0}, glm::vec4{c, 0}, glm::vec4{0, 0, 0, 1}};
@@ -139,7 +165,7 @@ void render_debug_lines(const std::vector<DebugLine>& debug_lines, State* states
 		return;
 	}
 
-	drawer->shader.use();
+	drawer->shader.use(states);
 	drawer->set_camera(compiled_camera);
 
 	StateChanger{states}.depth_func(Compare::less_equal).depth_test(true);
@@ -154,6 +180,10 @@ void render_debug_lines(const std::vector<DebugLine>& debug_lines, State* states
 void Renderer::render_world(const glm::ivec2& window_size, const World& world, const CompiledCamera& compiled_camera, const ShadowContext& shadow_context)
 {
 	SCOPED_DEBUG_GROUP("render world call"sv);
+
+	// pick up permutations that were compiled in the background
+	pimpl->shaders_resources.permutations->update();
+
 	const auto has_outlined_meshes = std::ranges::any_of(world.meshes,
 		[](const auto& mesh) { return mesh->outline.has_value(); }
 	);
@@ -168,82 +198,212 @@ void Renderer::render_world(const glm::ivec2& window_size, const World& world, c
 		.blend_mode(Blend::src_alpha, Blend::one_minus_src_alpha);
 
 	const auto clear_color = linear_from_srgb(world.clear_color, settings.gamma);
-	glClearColor(clear_color.linear.r, clear_color.linear.g, clear_color.linear.b, 1.0f);
+	StateChanger{&pimpl->states}.clear_color({clear_color.linear, 1.0f});
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
 
 	auto bound_camera_buffer = BoundUniformBuffer{pimpl->camera_uniform_buffer.buffer.get()};
 	pimpl->camera_uniform_buffer.set_props(compiled_camera);
 
+	// write the per draw data of all meshes up front so drawing only needs to bind a range
+	auto& draws = pimpl->draw_uniforms;
+	const auto is_occlusion_tested = [](const MeshInstance& mesh)
+	{ return mesh.occlusion != OcclusionTest::none && mesh.material->is_transparent() == false; };
+	std::vector<MeshDraw> mesh_draws;
+	mesh_draws.reserve(world.meshes.size());
+	{
+		int draw_count = 0;
+		for (const auto& mesh: world.meshes)
+		{
+			draw_count += 1 + (is_occlusion_tested(*mesh) ? 1 : 0) + (mesh->outline ? 1 : 0);
+		}
+
+		draws.begin_writing(draw_count);
+
+		// reserve the slots up front so the transforms can be calculated and written on multiple threads
+		for (const auto& mesh: world.meshes)
+		{
+			auto& draw = mesh_draws.emplace_back(MeshDraw{mesh, glm::mat4{1.0f}, draws.reserve(1)});
+			if (is_occlusion_tested(*mesh))
+			{
+				draw.occlusion_box_slot = draws.reserve(1);
+			}
+			if (mesh->outline)
+			{
+				draw.outline_slot = draws.reserve(1);
+			}
+		}
+
+		const auto small_scale_mat = glm::scale(glm::mat4(1.0f), {OUTLINE_SCALE, OUTLINE_SCALE, OUTLINE_SCALE});
+		for_each_slice(int_from_sizet(mesh_draws.size()),
+			[&](int, int begin, int end)
+			{
+				for (int index = begin; index < end; index += 1)
+				{
+					auto& draw = mesh_draws[sizet_from_int(index)];
+					const auto& mesh = draw.mesh;
+					draw.world_from_local = calc_world_from_local(mesh, compiled_camera);
+					draws.write_at(draw.slot, make_draw_block(draw.world_from_local));
+					if (draw.occlusion_box_slot >= 0)
+					{
+						draws.write_at(draw.occlusion_box_slot, make_draw_block(world_from_occlusion_box(*mesh, draw.world_from_local)));
+					}
+					if (draw.outline_slot >= 0)
+					{
+						const auto outline_color = glm::vec4{linear_from_srgb(*mesh->outline, settings.gamma).linear, 1};
+						draws.write_at(draw.outline_slot, make_draw_block(draw.world_from_local * small_scale_mat, outline_color));
+					}
+				}
+			}
+		);
+		draws.end_writing();
+	}
+
+	const auto not_transparent_context = RenderContext{TransformSource::Uniform, UseTransparency::no, settings.gamma, &shadow_context};
+	const auto transparent_context = RenderContext{TransformSource::Uniform, UseTransparency::yes, settings.gamma, &shadow_context};
+
+	// resolve the materials on the gl thread once, so the draws only need plain data and can be recorded on any thread
+	std::vector<MaterialBinds> material_binds;
+	std::unordered_map<const Material*, std::size_t> material_indices;
+	for (auto& draw: mesh_draws)
+	{
+		auto* material = draw.mesh->material.get();
+		const auto [found, is_new] = material_indices.try_emplace(material, material_binds.size());
+		if (is_new)
+		{
+			const auto& rc = material->is_transparent() ? transparent_context : not_transparent_context;
+			material_binds.emplace_back(material->prepare(rc, compiled_camera, world.lights, settings, &pimpl->states, &assets));
+		}
+		draw.material = found->second;
+	}
+
+	const auto record_mesh = [&](CommandList* list, const MeshDraw& draw)
+	{
+		list->write_stencil(draw.mesh->outline.has_value());
+		list->use_material(material_binds[draw.material]);
+		list->bind_draw(draw.slot);
+		list->draw(*draw.mesh->geom);
+	};
+
+	// the states that are the same for all meshes, the stencil is written by the commands
+	const auto set_mesh_states = [&](bool blending)
+	{
+		StateChanger{&pimpl->states}
+			.depth_test(true)
+			.depth_mask(true)
+			.depth_func(Compare::less)
+			.blending(blending)
+			.stencil_func(Compare::always, 1, 0xFF);
+	};
+
+	auto backend = GlCommandBackend{&pimpl->states, pimpl->shaders_resources.material_buffer.get(), &draws};
+
 	std::vector<TransparentMesh> transparent_meshes;
 
 	// render solids
 	{
+		std::vector<const MeshDraw*> occlusion_tested_meshes;
+
 		if (world.meshes.empty() == false)
 		{
 			SCOPED_DEBUG_GROUP("render basic geom"sv);
-			for (const auto& mesh: world.meshes)
+			std::vector<const MeshDraw*> solid_meshes;
+			for (const auto& draw: mesh_draws)
 			{
-				const auto not_transparent_context
-					= RenderContext{TransformSource::Uniform, UseTransparency::no, settings.gamma, &shadow_context};
-
+				const auto& mesh = draw.mesh;
 				if (mesh->material->is_transparent())
 				{
 					transparent_meshes.emplace_back(
-						TransparentMesh{mesh, glm::length2(compiled_camera.position - mesh->world_position)}
+						TransparentMesh{&draw, glm::length2(compiled_camera.position - mesh->world_position)}
 					);
 
 					continue;
 				}
-				StateChanger{&pimpl->states}
-					.depth_test(true)
-					.depth_mask(true)
-					.depth_func(Compare::less)
-					.blending(false)
-					.stencil_mask(0x0)
-					.stencil_func(Compare::always, 1, 0xFF);
-
-				if (mesh->outline)
+
+				// occlusion tested meshes are rendered last, so all other solid meshes can occlude them
+				if (is_occlusion_tested(*mesh))
+				{
+					occlusion_tested_meshes.emplace_back(&draw);
+					continue;
+				}
+
+				solid_meshes.emplace_back(&draw);
+			}
+
+			// draw meshes that share textures after each other so the binds are skipped
+			std::ranges::stable_sort(
+				solid_meshes, [](const auto& lhs, const auto& rhs) { return lhs->mesh->material->get_batch_key() < rhs->mesh->material->get_batch_key(); }
+			);
+			record_in_parallel(&pimpl->solid_commands, int_from_sizet(solid_meshes.size()),
+				[&](CommandList* list, int begin, int end)
 				{
-					StateChanger{&pimpl->states}.stencil_func(Compare::always, 1, 0xFF).stencil_mask(0xFF);
+					for (int index = begin; index < end; index += 1)
+					{
+						record_mesh(list, *solid_meshes[sizet_from_int(index)]);
+					}
 				}
-				mesh->material->use_shader(not_transparent_context);
-				mesh->material->set_uniforms(
-					not_transparent_context, compiled_camera, calc_world_from_local(mesh, compiled_camera)
+			);
+			set_mesh_states(false);
+			replay(pimpl->solid_commands, &backend);
+		}
+
+		// the occlusion tests change the states between the meshes, so each mesh is recorded and replayed on its own
+		const auto render_solid_mesh = [&](const MeshDraw& draw)
+		{
+			pimpl->single_commands.clear();
+			record_mesh(&pimpl->single_commands, draw);
+			set_mesh_states(false);
+			replay(pimpl->single_commands, &backend);
+		};
+
+		pimpl->occlusion.queries.begin_frame();
+		if (occlusion_tested_meshes.empty() == false)
+		{
+			SCOPED_DEBUG_GROUP("render occlusion tested geom"sv);
+			for (const auto* draw: occlusion_tested_meshes)
+			{
+				const auto& mesh = draw->mesh;
+				const auto query = pimpl->occlusion.test(
+					*mesh,
+					draw->world_from_local,
+					compiled_camera,
+					&pimpl->shaders_resources.single_color_shader,
+					&draws,
+					draw->occlusion_box_slot,
+					&pimpl->states
 				);
-				mesh->material->bind_textures(not_transparent_context, &pimpl->states, &assets);
-				mesh->material->apply_lights(not_transparent_context, world.lights, settings, &pimpl->states, &assets);
 
-				render_geom(*mesh->geom);
+				if (mesh->occlusion == OcclusionTest::skip)
+				{
+					if (pimpl->occlusion.queries.is_visible(*mesh))
+					{
+						render_solid_mesh(*draw);
+					}
+				}
+				else
+				{
+					const auto conditional = ScopedConditionalRender{query};
+					render_solid_mesh(*draw);
+				}
 			}
 		}
+		pimpl->occlusion.queries.end_frame();
 
 		if (world.instances.empty() == false)
 		{
 			SCOPED_DEBUG_GROUP("render instances"sv);
+			const auto instanced_context = RenderContext{TransformSource::Instanced_mat4, UseTransparency::no, settings.gamma, &shadow_context};
 			for (const auto& instance: world.instances)
 			{
-				const auto not_transparent_context = RenderContext{TransformSource::Instanced_mat4, UseTransparency::no, settings.gamma, &shadow_context};
+				// prepare uses the program, so the instanced draw is checked against the layout of the right shader
+				const auto binds = instance->material->prepare(instanced_context, compiled_camera, world.lights, settings, &pimpl->states, &assets);
 
-				StateChanger{&pimpl->states}
-					.depth_test(true)
-					.depth_mask(true)
-					.depth_func(Compare::less)
-					.blending(false)
-					.stencil_mask(0x0)
-					.stencil_func(Compare::always, 1, 0xFF);
-				instance->material->use_shader(not_transparent_context);
-				instance->material->set_uniforms(
-					// todo(Gustav): should we really set the model matrix for instanced meshes?
-					not_transparent_context,
-					compiled_camera,
-					std::nullopt
-				);
-				instance->material->bind_textures(not_transparent_context, &pimpl->states, &assets);
-				instance->material->apply_lights(
-					not_transparent_context, world.lights, settings, &pimpl->states, &assets
-				);
+				pimpl->single_commands.clear();
+				pimpl->single_commands.write_stencil(false);
+				pimpl->single_commands.use_material(binds);
+				set_mesh_states(false);
+				replay(pimpl->single_commands, &backend);
 
-				render_geom_instanced(*instance);
+				render_geom_instanced(&pimpl->states, *instance);
 			}
 		}
 
@@ -273,10 +433,10 @@ void Renderer::render_world(const glm::ivec2& window_size, const World& world, c
 
 		auto& shader = pimpl->shaders_resources.skybox_shader;
 
-		shader.program->use();
+		shader.program->use(&pimpl->states);
 		bind_texture_cubemap(&pimpl->states, shader.tex_skybox_uniform, *world.skybox->cubemap);
 
-		render_geom(*world.skybox->geom);
+		render_geom(&pimpl->states, *world.skybox->geom);
 	}
 
 	std::sort(
@@ -288,56 +448,43 @@ void Renderer::render_world(const glm::ivec2& window_size, const World& world, c
 	if (transparent_meshes.empty() == false)
 	{
 		SCOPED_DEBUG_GROUP("render transparent meshes"sv);
-		for (auto& transparent_mesh: transparent_meshes)
-		{
-			const auto transparent_context = RenderContext{TransformSource::Uniform, UseTransparency::yes, settings.gamma, &shadow_context};
-
-			const auto& mesh = transparent_mesh.mesh;
-			StateChanger{&pimpl->states}
-				.depth_test(true)
-				.depth_mask(true)
-				.depth_func(Compare::less)
-				.blending(true)
-				.stencil_mask(0x0)
-				.stencil_func(Compare::always, 1, 0xFF);
-
-			if (mesh->outline)
+		record_in_parallel(&pimpl->transparent_commands, int_from_sizet(transparent_meshes.size()),
+			[&](CommandList* list, int begin, int end)
 			{
-				StateChanger{&pimpl->states}.stencil_func(Compare::always, 1, 0xFF).stencil_mask(0xFF);
+				for (int index = begin; index < end; index += 1)
+				{
+					record_mesh(list, *transparent_meshes[sizet_from_int(index)].draw);
+				}
 			}
-			mesh->material->use_shader(transparent_context);
-			mesh->material->set_uniforms(transparent_context, compiled_camera, calc_world_from_local(mesh, compiled_camera));
-			mesh->material->bind_textures(transparent_context, &pimpl->states, &assets);
-			mesh->material->apply_lights(transparent_context, world.lights, settings, &pimpl->states, &assets);
-
-			render_geom(*mesh->geom);
-		}
+		);
+		set_mesh_states(true);
+		replay(pimpl->transparent_commands, &backend);
 	}
 
 	// render outline over all other meshes
 	if (has_outlined_meshes)
 	{
 		SCOPED_DEBUG_GROUP("render outline meshes"sv);
-		for (const auto& mesh: world.meshes)
+		for (const auto& draw: mesh_draws)
 		{
-			if (const auto& mesh_outline = mesh->outline)
+			if (draw.mesh->outline)
 			{
 				StateChanger{&pimpl->states}
 					.stencil_func(Compare::not_equal, 1, 0xFF)
 					.stencil_mask(0x00)
 					.depth_test(false);
-				const auto small_scale_mat = glm::scale(glm::mat4(1.0f), {OUTLINE_SCALE, OUTLINE_SCALE, OUTLINE_SCALE});
 
 				auto& shader = pimpl->shaders_resources.single_color_shader;
-				shader.program->use();
-				shader.program->set_vec4(shader.tint_color_uni, {linear_from_srgb(*mesh_outline, settings.gamma).linear, 1});
+				shader.program->use(&pimpl->states);
+				pimpl->outline_material.bind();
+				draws.bind(draw.outline_slot);
 
-				shader.program->set_mat(shader.world_from_local_uni, calc_world_from_local(mesh, compiled_camera) * small_scale_mat);
-
-				render_geom(*mesh->geom);
+				render_geom(&pimpl->states, *draw.mesh->geom);
 			}
 		}
 	}
+
+	draws.end_drawing();
 }
 
 void Renderer::render_shadows(const glm::ivec2& window_size, const World& world, const CompiledCamera& compiled_camera) const
@@ -365,34 +512,51 @@ void Renderer::render_shadows(const glm::ivec2& window_size, const World& world,
 		.stencil_mask(0x0)
 		.stencil_func(Compare::always, 1, 0xFF);
 
-	// render solids
+	// billboards are not rendered to the shadow map
+	const auto casts_shadow = [](const MeshInstance& mesh)
+	{ return mesh.material->is_transparent() == false && mesh.billboarding == Billboarding::none; };
+
+	auto& draws = pimpl->draw_uniforms;
+	std::vector<const std::shared_ptr<MeshInstance>*> casters;
 	{
-		if (world.meshes.empty() == false)
+		for (const auto& mesh: world.meshes)
 		{
-			SCOPED_DEBUG_GROUP("render basic geom"sv);
-			for (const auto& mesh: world.meshes)
+			if (casts_shadow(*mesh))
 			{
-				if (mesh->material->is_transparent())
-				{
-					continue;
-				}
-
-				auto& shader = pimpl->shaders_resources.depth_transform_uniform;
-				shader.program->use();
-
-				// todo(Gustav): the depth shader should not be a shared type between transform uniform and instanced, this should be verified at compile time with different types
-				assert(shader.world_from_local_uni.has_value());
-				if (shader.world_from_local_uni)
-				{
-					shader.program->set_mat(*shader.world_from_local_uni, calc_world_from_local(mesh, compiled_camera));
-				}
+				casters.emplace_back(&mesh);
+			}
+		}
 
-				if (mesh->billboarding != Billboarding::none)
+		// the casters only differ in transform and geom, so all gl calls can be recorded on multiple threads
+		const auto caster_count = int_from_sizet(casters.size());
+		const auto& program = *pimpl->shaders_resources.depth_transform_uniform.program;
+		draws.begin_writing(caster_count);
+		const auto first_slot = draws.reserve(caster_count);
+		record_in_parallel(&pimpl->shadow_commands, caster_count,
+			[&](CommandList* list, int begin, int end)
+			{
+				// each list uses the program so it doesn't depend on the list before it, the state cache skips the repeats
+				list->use_program(program);
+				for (int index = begin; index < end; index += 1)
 				{
-					continue;
+					const auto& mesh = *casters[sizet_from_int(index)];
+					const auto slot = first_slot + index;
+					draws.write_at(slot, make_draw_block(calc_world_from_local(mesh, compiled_camera)));
+					list->bind_draw(slot);
+					list->draw(*mesh->geom);
 				}
-				render_geom(*mesh->geom);
 			}
+		);
+		draws.end_writing();
+	}
+
+	// render solids
+	{
+		if (casters.empty() == false)
+		{
+			SCOPED_DEBUG_GROUP("render basic geom"sv);
+			auto backend = GlCommandBackend{&pimpl->states, pimpl->shaders_resources.material_buffer.get(), &draws};
+			replay(pimpl->shadow_commands, &backend);
 		}
 
 		if (world.instances.empty() == false)
@@ -401,10 +565,9 @@ void Renderer::render_shadows(const glm::ivec2& window_size, const World& world,
 			for (const auto& instance: world.instances)
 			{
 				auto& shader = pimpl->shaders_resources.depth_transform_instanced_mat4;
-				shader.program->use();
-				assert(shader.world_from_local_uni.has_value() == false);
+				shader.program->use(&pimpl->states);
 
-				render_geom_instanced(*instance);
+				render_geom_instanced(&pimpl->states, *instance);
 			}
 		}
 
@@ -416,6 +579,8 @@ void Renderer::render_shadows(const glm::ivec2& window_size, const World& world,
 			);
 		}
 	}
+
+	draws.end_drawing();
 }
 
 }  //  namespace klotter
@@ -5,6 +5,7 @@
 #include "klotter/render/postproc.h"
 #include "klotter/render/material.h"
 #include "klotter/render/render_settings.h"
+#include "klotter/render/state.h"
 #include "klotter/render/vertex_layout.h"
 #include "klotter/render/world.h"
 
@@ -59,6 +60,10 @@ struct Renderer
 	/// verify that the renderer was fully loaded
 	[[nodiscard]] bool is_loaded() const;
 
+	/// the state changes since the last reset
+	[[nodiscard]] StateStats get_state_stats() const;
+	void reset_state_stats();
+
 	/// doesn't set the size, prefer EffectStack::render
 	void render_world(const glm::ivec2& window_size, const World&, const CompiledCamera&, const ShadowContext& shadow_context);
 
@@ -2,7 +2,9 @@
 
 #include "klotter/dependency_glad.h"
 
+#include "klotter/render/constants.h"
 #include "klotter/render/fullscreen.h"
+#include "klotter/render/render_settings.h"
 #include "klotter/render/renderer.pimpl.h"
 #include "klotter/render/shader_resource.h"
 
@@ -31,10 +33,31 @@ CameraUniformBuffer make_camera_uniform_buffer_desc()
 	return camera_uniform_buffer;
 }
 
+std::unique_ptr<ShaderCache> make_shader_cache(const RenderSettings& settings)
+{
+	if (settings.use_shader_cache == false)
+	{
+		return nullptr;
+	}
+
+	if (is_program_binary_supported() == false)
+	{
+		LOG_INFO("Driver doesn't support program binaries, shader cache is disabled");
+		return nullptr;
+	}
+
+	return std::make_unique<ShaderCache>(default_shader_cache_directory(), driver_id_from_gl());
+}
+
 RendererPimpl::RendererPimpl(const RenderSettings& set, const FullScreenGeom& full_screen)
 	: camera_uniform_buffer(make_camera_uniform_buffer_desc())
-	, shaders_resources(load_shaders(camera_uniform_buffer, set, full_screen))
+	, shader_cache(make_shader_cache(set))
+	, shaders_resources(load_shaders(camera_uniform_buffer, set, full_screen, shader_cache.get()))
+	, outline_material(shaders_resources.material_buffer)
+	, draw_uniforms(DRAW_BUFFER_INITIAL_CAPACITY)
+	, debug_drawer(&states)
 	, full_screen_geom(full_screen.geom)
+	, occlusion(shaders_resources.single_color_shader)
 {
 	const auto vendor = string_from_gl_bytes(glGetString(GL_VENDOR));
 	const auto renderer = string_from_gl_bytes(glGetString(GL_RENDERER));
@@ -45,6 +68,25 @@ RendererPimpl::RendererPimpl(const RenderSettings& set, const FullScreenGeom& fu
 	LOG_INFO("vendor %s, renderer %s", vendor.c_str(), renderer.c_str());
 	LOG_INFO("version %s (glsl %s)", version.c_str(), shading_language_version.c_str());
 	LOG_INFO("extensions %s", extensions.c_str());
+
+	outline_material.data.set_vec4(get_material_block_layout().diffuse_tint, glm::vec4{1.0f});
+
+	if (set.prewarm_shaders && set.shader_manifest_path.empty() == false)
+	{
+		shader_manifest_path = set.shader_manifest_path;
+		shaders_resources.permutations->prewarm(load_shader_manifest(shader_manifest_path));
+	}
+}
+
+RendererPimpl::~RendererPimpl()
+{
+	if (shader_manifest_path.empty() == false)
+	{
+		if (save_shader_manifest(shader_manifest_path, shaders_resources.permutations->get_used_keys()) == false)
+		{
+			LOG_ERROR("Failed to save shader manifest %s", shader_manifest_path.string().c_str());
+		}
+	}
 }
 
 
@@ -1,7 +1,12 @@
 #pragma once
 
+#include "klotter/render/command_buffer.h"
+#include "klotter/render/draw.block.h"
 #include "klotter/render/linebatch.h"
+#include "klotter/render/material.block.h"
+#include "klotter/render/occlusion.h"
 #include "klotter/render/state.h"
+#include "klotter/render/shader.cache.h"
 #include "klotter/render/shader_resource.h"
 #include "klotter/render/world.h"
 
@@ -16,12 +21,41 @@ namespace klotter
 struct RendererPimpl
 {
 	CameraUniformBuffer camera_uniform_buffer;
+
+	/// null if disabled or not supported by the driver, needs to be declared before the shaders that use it
+	std::unique_ptr<ShaderCache> shader_cache;
+
 	ShaderResource shaders_resources;
+
+	/// a white material for the outline, the color is the tint of the draw
+	MaterialBlock outline_material;
+
+	/// the transforms of all meshes in a render call
+	DrawUniformRing draw_uniforms;
+
+	/// the draws of a pass, recorded a slice per thread and kept to reuse the memory
+	std::vector<CommandList> shadow_commands;
+	std::vector<CommandList> solid_commands;
+	std::vector<CommandList> transparent_commands;
+
+	/// the draws that are recorded and replayed one at a time, between the occlusion tests and before the instanced draws
+	CommandList single_commands;
+
 	State states;
 	LineDrawer debug_drawer;
 	std::shared_ptr<CompiledGeom> full_screen_geom;
+	OcclusionCulling occlusion;
+
+	/// the permutations that were used are saved here when destroyed, empty if not prewarming
+	std::filesystem::path shader_manifest_path;
 
 	RendererPimpl(const RenderSettings& set, const FullScreenGeom& full_screen);
+	~RendererPimpl();
+
+	RendererPimpl(const RendererPimpl&) = delete;
+	RendererPimpl(RendererPimpl&&) = delete;
+	void operator=(const RendererPimpl&) = delete;
+	void operator=(RendererPimpl&&) = delete;
 };
 
 /**
@@ -0,0 +1,150 @@
+#include "klotter/render/shader.cache.h"
+
+#include "klotter/hash.h"
+#include "klotter/log.h"
+#include "klotter/str.h"
+
+#include "klotter/render/cache.h"
+
+#include "klotter/dependency_glad.h"
+
+#include <fstream>
+
+namespace klotter
+{
+
+namespace
+{
+	constexpr std::array<char, 4> cache_magic = {'K', 'S', 'H', 'B'};
+	constexpr std::uint32_t cache_version = 1;
+
+	struct CacheHeader
+	{
+		std::array<char, 4> magic;
+		std::uint32_t version;
+		ShaderCacheKey key;
+		std::uint32_t format;
+		std::uint32_t padding;
+		std::uint64_t size;
+	};
+
+	std::uint64_t hash_string(std::uint64_t hash, std::string_view str)
+	{
+		// include the size so "ab" + "c" and "a" + "bc" are different
+		const std::uint64_t size = str.size();
+		hash = hash_fnv1a(hash, &size, sizeof(size));
+		return hash_fnv1a(hash, str.data(), str.size());
+	}
+
+	std::string string_from_gl(GLenum name)
+	{
+		const auto* str = glGetString(name);
+		return str ? reinterpret_cast<const char*>(str) : "";
+	}
+}  //  namespace
+
+ShaderCache::ShaderCache(std::filesystem::path dir, std::string driver_id)
+	: directory(std::move(dir))
+	, driver(std::move(driver_id))
+{
+}
+
+ShaderCacheKey ShaderCache::key_from_program(
+	const std::string& vertex_source, const std::string& fragment_source, const CompiledShaderVertexAttributes& layout
+) const
+{
+	auto hash = fnv1a_offset_basis;
+	hash = hash_fnv1a(hash, &cache_version, sizeof(cache_version));
+	hash = hash_string(hash, driver);
+	hash = hash_string(hash, vertex_source);
+	hash = hash_string(hash, fragment_source);
+	for (const auto& element: layout.elements)
+	{
+		hash = hash_string(hash, element.name);
+		hash = hash_fnv1a(hash, &element.index, sizeof(element.index));
+	}
+	return hash;
+}
+
+std::filesystem::path ShaderCache::path_from_key(ShaderCacheKey key) const
+{
+	std::ostringstream name;
+	name << std::hex << key << ".shadercache";
+	return directory / name.str();
+}
+
+std::optional<ShaderBinary> ShaderCache::load(ShaderCacheKey key) const
+{
+	std::ifstream file{path_from_key(key), std::ios::binary};
+	if (file.good() == false)
+	{
+		return std::nullopt;
+	}
+
+	CacheHeader header;
+	if (file.read(reinterpret_cast<char*>(&header), sizeof(CacheHeader)).good() == false)
+	{
+		return std::nullopt;
+	}
+
+	// a file from a other key or version is stale
+	if (header.magic != cache_magic || header.version != cache_version || header.key != key || header.size == 0)
+	{
+		return std::nullopt;
+	}
+
+	ShaderBinary binary{header.format, std::vector<std::uint8_t>(header.size)};
+	if (file.read(reinterpret_cast<char*>(binary.data.data()), static_cast<std::streamsize>(binary.data.size())).good() == false)
+	{
+		return std::nullopt;
+	}
+
+	// there should be nothing after the binary
+	if (file.peek() != std::ifstream::traits_type::eof())
+	{
+		return std::nullopt;
+	}
+
+	return binary;
+}
+
+void ShaderCache::store(ShaderCacheKey key, const ShaderBinary& binary) const
+{
+	const auto header = CacheHeader{cache_magic, cache_version, key, binary.format, 0, binary.data.size()};
+	std::ignore = write_file_atomically(path_from_key(key), {std::as_bytes(std::span{&header, 1}), std::as_bytes(std::span{binary.data})});
+}
+
+std::filesystem::path default_shader_cache_directory()
+{
+	return default_cache_directory("klotter-shader-cache");
+}
+
+std::filesystem::path default_shader_manifest_path(std::string_view app)
+{
+	// a readable file name instead of a hash, so it's easy to find the manifest of a app
+	std::string name = "permutations";
+	if (app.empty() == false)
+	{
+		name += "-";
+		for (const auto c: app)
+		{
+			const auto is_safe = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '-';
+			name += is_safe ? c : '_';
+		}
+	}
+	return default_shader_cache_directory() / (name + ".txt");
+}
+
+std::string driver_id_from_gl()
+{
+	return Str() << string_from_gl(GL_VENDOR) << "\n" << string_from_gl(GL_RENDERER) << "\n" << string_from_gl(GL_VERSION);
+}
+
+bool is_program_binary_supported()
+{
+	GLint format_count = 0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &format_count);
+	return format_count > 0;
+}
+
+}  //  namespace klotter
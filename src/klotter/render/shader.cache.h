@@ -0,0 +1,66 @@
+#pragma once
+
+#include "klotter/render/vertex_layout.h"
+
+#include <filesystem>
+
+namespace klotter
+{
+
+/** \addtogroup render Renderer
+ *  @{
+*/
+
+/// Identifies a linked program in the \ref ShaderCache
+using ShaderCacheKey = std::uint64_t;
+
+/// A linked program as returned by the driver, only valid for the driver that created it.
+struct ShaderBinary
+{
+	std::uint32_t format = 0;
+	std::vector<std::uint8_t> data;
+};
+
+/// Stores linked program binaries on disk so later runs can skip compiling and linking.
+/// A missing, broken or stale file is treated as a cache miss and the program is compiled from source.
+struct ShaderCache
+{
+	std::filesystem::path directory;
+
+	/// the vendor, renderer and version of the driver, part of the key since a binary can't be used by a other driver
+	std::string driver;
+
+	ShaderCache(std::filesystem::path dir, std::string driver_id);
+
+	/// Creates a key from the generated source and the attribute locations that are bound before linking.
+	/// The shader options are part of the generated source.
+	[[nodiscard]] ShaderCacheKey key_from_program(
+		const std::string& vertex_source, const std::string& fragment_source, const CompiledShaderVertexAttributes& layout
+	) const;
+
+	[[nodiscard]] std::optional<ShaderBinary> load(ShaderCacheKey key) const;
+
+	/// Writes the binary with \ref write_file_atomically.
+	void store(ShaderCacheKey key, const ShaderBinary& binary) const;
+
+	[[nodiscard]] std::filesystem::path path_from_key(ShaderCacheKey key) const;
+};
+
+/// The shader cache in the \ref default_cache_directory.
+std::filesystem::path default_shader_cache_directory();
+
+/// The permutation manifest of a app in the \ref default_shader_cache_directory.
+/// @param app identifies the app, usually the base path of the executable, so apps don't prewarm each others permutations
+std::filesystem::path default_shader_manifest_path(std::string_view app);
+
+/// The driver strings of the current open gl context.
+std::string driver_id_from_gl();
+
+/// Returns true if the driver can save and load program binaries.
+bool is_program_binary_supported();
+
+/**
+ * @}
+*/
+
+}  //  namespace klotter
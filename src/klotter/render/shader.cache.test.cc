@@ -0,0 +1,99 @@
+#include "klotter/render/shader.cache.h"
+
+#include "catch2/catch_test_macros.hpp"
+
+#include <fstream>
+
+using namespace klotter;
+
+namespace
+{
+	ShaderCache make_test_cache(const std::string& name, const std::string& driver = "vendor\nrenderer\n4.3")
+	{
+		const auto dir = std::filesystem::temp_directory_path() / "klotter-shader-cache-test" / name;
+		std::filesystem::remove_all(dir);
+		return ShaderCache{dir, driver};
+	}
+
+	CompiledShaderVertexAttributes make_layout(int position_index)
+	{
+		return {{CompiledVertexElement{VertexType::position3, "a_position", position_index}}, {VertexType::position3}};
+	}
+
+	ShaderBinary make_binary()
+	{
+		return ShaderBinary{0x1234, {1, 2, 3, 4, 5, 6, 7, 8}};
+	}
+}  //  namespace
+
+TEST_CASE("shader_cache_key", "[shader]")
+{
+	const auto cache = make_test_cache("key");
+	const auto layout = make_layout(0);
+	const auto key = cache.key_from_program("vert", "frag", layout);
+
+	CHECK(key == cache.key_from_program("vert", "frag", layout));
+	CHECK(key != cache.key_from_program("vert2", "frag", layout));
+	CHECK(key != cache.key_from_program("vert", "frag2", layout));
+	CHECK(key != cache.key_from_program("ver", "tfrag", layout));
+	CHECK(key != cache.key_from_program("vert", "frag", make_layout(1)));
+
+	const auto other_driver = make_test_cache("key", "vendor\nrenderer\n4.6");
+	CHECK(key != other_driver.key_from_program("vert", "frag", layout));
+}
+
+TEST_CASE("shader_cache_roundtrip", "[shader]")
+{
+	const auto cache = make_test_cache("roundtrip");
+	const auto key = cache.key_from_program("vert", "frag", make_layout(0));
+
+	CHECK(cache.load(key).has_value() == false);
+
+	const auto binary = make_binary();
+	cache.store(key, binary);
+
+	const auto loaded = cache.load(key);
+	REQUIRE(loaded.has_value());
+	CHECK(loaded->format == binary.format);
+	CHECK(loaded->data == binary.data);
+
+	// a file stored for one key is not returned for a other key
+	const auto other_key = cache.key_from_program("vert", "other", make_layout(0));
+	CHECK(cache.load(other_key).has_value() == false);
+}
+
+TEST_CASE("shader_manifest_path_is_per_app", "[shader]")
+{
+	const auto first = default_shader_manifest_path("/games/first/");
+	const auto second = default_shader_manifest_path("C:\\games\\second\\");
+
+	CHECK(first != second);
+	CHECK(first.parent_path() == default_shader_cache_directory());
+	CHECK(second.parent_path() == default_shader_cache_directory());
+	CHECK(first.filename() == "permutations-_games_first_.txt");
+	CHECK(second.filename() == "permutations-C__games_second_.txt");
+	CHECK(default_shader_manifest_path("").filename() == "permutations.txt");
+}
+
+TEST_CASE("shader_cache_rejects_broken_files", "[shader]")
+{
+	const auto cache = make_test_cache("broken");
+	const auto key = cache.key_from_program("vert", "frag", make_layout(0));
+	cache.store(key, make_binary());
+	REQUIRE(cache.load(key).has_value());
+
+	SECTION("truncated")
+	{
+		const auto path = cache.path_from_key(key);
+		std::filesystem::resize_file(path, std::filesystem::file_size(path) - 3);
+		CHECK(cache.load(key).has_value() == false);
+	}
+
+	SECTION("garbage")
+	{
+		std::ofstream file{cache.path_from_key(key), std::ios::binary | std::ios::trunc};
+		file << "this is not a shader binary, but it is long enough to be read as a header";
+		file.close();
+		CHECK(cache.load(key).has_value() == false);
+	}
+}
@@ -7,13 +7,20 @@
 
 #include "klotter/render/constants.h"
 #include "klotter/render/opengl_utils.h"
+#include "klotter/render/shader.cache.h"
+#include "klotter/render/state.h"
 #include "klotter/render/uniform_buffer.h"
 
+#include "klotter/dependency_sdl.h"
+
+#include <cstring>
+#include <thread>
+
 namespace klotter
 {
 
 // internal "header", defined later
-void set_shader_program(unsigned int new_program, const VertexTypes& types);
+void set_debug_shader_program(unsigned int new_program, const VertexTypes& types);
 
 constexpr GLsizei max_log_length = 1024;
 
@@ -94,51 +101,248 @@ void log_source(const std::string& src)
 	}
 }
 
-void load_shader_source(
+/// returns true if the program was linked from a cached binary
+bool load_shader_binary(unsigned int shader_program, const ShaderBinary& binary)
+{
+	glProgramBinary(shader_program, binary.format, binary.data.data(), int_from_sizet(binary.data.size()));
+
+	// a binary from a updated driver fails to load, this isn't a error since we just compile it again
+	GLint success = 0;
+	glGetProgramiv(shader_program, GL_LINK_STATUS, &success);
+	return success == GL_TRUE;
+}
+
+std::optional<ShaderBinary> get_shader_binary(unsigned int shader_program)
+{
+	GLint size = 0;
+	glGetProgramiv(shader_program, GL_PROGRAM_BINARY_LENGTH, &size);
+	if (size <= 0)
+	{
+		return std::nullopt;
+	}
+
+	ShaderBinary binary;
+	binary.data.resize(sizet_from_int(size));
+	GLsizei written = 0;
+	GLenum format = 0;
+	glGetProgramBinary(shader_program, size, &written, &format, binary.data.data());
+	if (written <= 0)
+	{
+		return std::nullopt;
+	}
+	binary.data.resize(sizet_from_int(written));
+	binary.format = format;
+	return binary;
+}
+
+namespace
+{
+	// from KHR_parallel_shader_compile and ARB_parallel_shader_compile, glad is generated without them
+	constexpr GLenum gl_completion_status = 0x91B1;
+	constexpr GLuint gl_max_compiler_threads = 0xFFFFFFFF;
+	using MaxShaderCompilerThreadsFunction = void(APIENTRYP)(GLuint count);
+
+	/// Lets the driver compile on its own threads, returns true if the completion status can be polled.
+	bool enable_parallel_shader_compile()
+	{
+		static const bool is_enabled = []()
+		{
+			const auto enable = [](std::string_view extension, const char* function_name)
+			{
+				if (has_gl_extension(extension) == false)
+				{
+					return false;
+				}
+				auto* max_threads = reinterpret_cast<MaxShaderCompilerThreadsFunction>(SDL_GL_GetProcAddress(function_name));
+				if (max_threads != nullptr)
+				{
+					max_threads(gl_max_compiler_threads);
+				}
+				LOG_INFO("Compiling shaders with %s", std::string{extension}.c_str());
+				return true;
+			};
+			return enable("GL_KHR_parallel_shader_compile", "glMaxShaderCompilerThreadsKHR")
+				|| enable("GL_ARB_parallel_shader_compile", "glMaxShaderCompilerThreadsARB");
+		}();
+		return is_enabled;
+	}
+
+	float ms_since(std::chrono::steady_clock::time_point start)
+	{
+		return std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+}  //  namespace
+
+/// Starts compiling and linking a program, the status is checked in \ref finish_shader_program
+PendingShaderProgram submit_shader_program(
 	DEBUG_LABEL_ARG_MANY
 	ShaderProgram* self,
+	std::string name,
 	const std::string& vertex_source,
 	const std::string& fragment_source,
-	const CompiledShaderVertexAttributes& layout
+	const CompiledShaderVertexAttributes& layout,
+	const ShaderCache* cache
 )
 {
-	const auto vertex_shader = glCreateShader(GL_VERTEX_SHADER);
-	SET_DEBUG_LABEL_NAMED(vertex_shader, DebugLabelFor::Shader, Str() << "SHADER " << debug_label << " VERT");
-	upload_shader_source(vertex_shader, vertex_source);
-	glCompileShader(vertex_shader);
-	const auto vertex_ok = check_shader_compilation_error("vertex", vertex_shader);
+	const auto start = std::chrono::steady_clock::now();
+
+	auto pending = PendingShaderProgram{};
+	pending.program = self;
+	pending.name = std::move(name);
+	pending.layout = layout;
+	pending.cache = cache;
+	pending.submitted_at = start;
+
+	if (cache)
+	{
+		pending.cache_key = cache->key_from_program(vertex_source, fragment_source, layout);
+		if (const auto binary = cache->load(pending.cache_key); binary && load_shader_binary(self->shader_program, *binary))
+		{
+			pending.is_from_cache = true;
+			pending.submit_ms = ms_since(start);
+			return pending;
+		}
+	}
+
+	// the sources are only needed when logging errors but the status isn't known until later
+	pending.vertex_source = vertex_source;
+	pending.fragment_source = fragment_source;
+
+	pending.vertex_shader = glCreateShader(GL_VERTEX_SHADER);
+	SET_DEBUG_LABEL_NAMED(pending.vertex_shader, DebugLabelFor::Shader, Str() << "SHADER " << debug_label << " VERT");
+	upload_shader_source(pending.vertex_shader, vertex_source);
+	glCompileShader(pending.vertex_shader);
+
+	pending.fragment_shader = glCreateShader(GL_FRAGMENT_SHADER);
+	SET_DEBUG_LABEL_NAMED(pending.fragment_shader, DebugLabelFor::Shader, Str() << "SHADER " << debug_label << " FRAG");
+	upload_shader_source(pending.fragment_shader, fragment_source);
+	glCompileShader(pending.fragment_shader);
+
+	glAttachShader(self->shader_program, pending.vertex_shader);
+	glAttachShader(self->shader_program, pending.fragment_shader);
+	bind_shader_attribute_location(self->shader_program, layout);
+	if (cache)
+	{
+		glProgramParameteri(self->shader_program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	}
+	glLinkProgram(self->shader_program);
+
+	pending.submit_ms = ms_since(start);
+	return pending;
+}
+
+/// returns true if the status can be checked without waiting for the driver
+bool is_shader_program_ready(const PendingShaderProgram& pending)
+{
+	if (pending.is_from_cache)
+	{
+		return true;
+	}
+
+	GLint is_complete = GL_FALSE;
+	glGetProgramiv(pending.program->shader_program, gl_completion_status, &is_complete);
+	return is_complete == GL_TRUE;
+}
+
+/// Lists the active uniforms outside of uniform blocks.
+/// Program interface queries require gl 4.3, on older contexts (like 3.2 on apple) the table is left empty and
+/// uniforms are looked up with glGetUniformLocation instead.
+UniformTable reflect_uniforms(unsigned int shader_program)
+{
+	UniformTable table;
+	if (GLAD_GL_VERSION_4_3 == 0)
+	{
+		return table;
+	}
+
+	GLint count = 0;
+	glGetProgramInterfaceiv(shader_program, GL_UNIFORM, GL_ACTIVE_RESOURCES, &count);
+
+	GLint max_name_length = 0;
+	glGetProgramInterfaceiv(shader_program, GL_UNIFORM, GL_MAX_NAME_LENGTH, &max_name_length);
+	std::vector<char> name_buffer(sizet_from_int(std::max(max_name_length, 1)));
+
+	constexpr std::array<GLenum, 4> properties = {GL_LOCATION, GL_TYPE, GL_ARRAY_SIZE, GL_BLOCK_INDEX};
+	for (GLint index = 0; index < count; index += 1)
+	{
+		std::array<GLint, 4> values = {-1, 0, 1, -1};
+		glGetProgramResourceiv(
+			shader_program,
+			GL_UNIFORM,
+			static_cast<GLuint>(index),
+			static_cast<GLsizei>(properties.size()),
+			properties.data(),
+			static_cast<GLsizei>(values.size()),
+			nullptr,
+			values.data()
+		);
+
+		// members of a uniform block are set through the buffer
+		if (values[3] != -1)
+		{
+			continue;
+		}
+
+		GLsizei length = 0;
+		glGetProgramResourceName(
+			shader_program, GL_UNIFORM, static_cast<GLuint>(index), static_cast<GLsizei>(name_buffer.size()), &length, name_buffer.data()
+		);
+
+		add_active_uniform(
+			&table,
+			ActiveUniform{std::string{name_buffer.data(), sizet_from_int(length)}, values[0], static_cast<unsigned int>(values[1]), values[2]}
+		);
+	}
+
+	table.is_reflected = true;
+	return table;
+}
+
+/// Checks the status of a submitted program, turns the program into a zombie if it failed.
+void finish_shader_program(PendingShaderProgram* pending)
+{
+	auto* self = pending->program;
+	if (pending->is_from_cache)
+	{
+		verify_shader_attribute_location(self->shader_program, pending->layout);
+		self->uniform_table = reflect_uniforms(self->shader_program);
+		return;
+	}
+
+	const auto vertex_ok = check_shader_compilation_error("vertex", pending->vertex_shader);
 	if (vertex_ok == false)
 	{
 		LOG_INFO("Vertex source:");
-		log_source(vertex_source);
+		log_source(pending->vertex_source);
 	}
 
-	const auto fragment_shader = glCreateShader(GL_FRAGMENT_SHADER);
-	SET_DEBUG_LABEL_NAMED(fragment_shader, DebugLabelFor::Shader, Str() << "SHADER " << debug_label << " FRAG");
-	upload_shader_source(fragment_shader, fragment_source);
-	glCompileShader(fragment_shader);
-	const auto fragment_ok = check_shader_compilation_error("fragment", fragment_shader);
+	const auto fragment_ok = check_shader_compilation_error("fragment", pending->fragment_shader);
 	if (fragment_ok == false)
 	{
 		LOG_INFO("Fragment source:");
-		log_source(fragment_source);
+		log_source(pending->fragment_source);
 	}
 
-	glAttachShader(self->shader_program, vertex_shader);
-	glAttachShader(self->shader_program, fragment_shader);
-	bind_shader_attribute_location(self->shader_program, layout);
-	glLinkProgram(self->shader_program);
 	const auto link_ok = check_shader_link_error(self->shader_program);
 
-	glDeleteShader(vertex_shader);
-	glDeleteShader(fragment_shader);
+	glDeleteShader(pending->vertex_shader);
+	glDeleteShader(pending->fragment_shader);
+	pending->vertex_shader = 0;
+	pending->fragment_shader = 0;
 
 	clear_shader_program();
 
 	if (vertex_ok && fragment_ok && link_ok)
 	{
-		// nop
-		verify_shader_attribute_location(self->shader_program, layout);
+		verify_shader_attribute_location(self->shader_program, pending->layout);
+		self->uniform_table = reflect_uniforms(self->shader_program);
+		if (pending->cache)
+		{
+			if (const auto binary = get_shader_binary(self->shader_program); binary)
+			{
+				pending->cache->store(pending->cache_key, *binary);
+			}
+		}
 	}
 	else
 	{
@@ -149,26 +353,141 @@ void load_shader_source(
 }
 
 ShaderProgram::ShaderProgram(
-	DEBUG_LABEL_ARG_MANY const std::string& vertex_source, const std::string& fragment_source, const CompiledShaderVertexAttributes& layout
+	DEBUG_LABEL_ARG_MANY
+	const std::string& vertex_source,
+	const std::string& fragment_source,
+	const CompiledShaderVertexAttributes& layout,
+	const ShaderCache* cache
 )
+	: ShaderProgram(layout)
+{
+	SET_DEBUG_LABEL_NAMED(shader_program, DebugLabelFor::Program, Str() << "PROGRAM " << debug_label);
+	auto pending = submit_shader_program(SEND_DEBUG_LABEL_MANY(debug_label) this, "", vertex_source, fragment_source, layout, cache);
+	finish_shader_program(&pending);
+}
+
+ShaderProgram::ShaderProgram(const CompiledShaderVertexAttributes& layout)
 	: shader_program(glCreateProgram())
 	, debug_vertex_types(layout.debug_types)
 {
-	SET_DEBUG_LABEL_NAMED(shader_program, DebugLabelFor::Program, Str() << "PROGRAM " << debug_label);
-	load_shader_source(USE_DEBUG_LABEL_MANY(debug_label) this, vertex_source, fragment_source, layout);
 }
 
-void ShaderProgram::use() const
+ShaderCompiler::ShaderCompiler(const ShaderCache* c)
+	: cache(c)
+	, started_at(std::chrono::steady_clock::now())
+	, is_parallel(enable_parallel_shader_compile())
+{
+}
+
+ShaderCompiler::~ShaderCompiler()
+{
+	ASSERT(pending.empty() && "finish() needs to be called before the compiler is destroyed");
+}
+
+std::shared_ptr<ShaderProgram> ShaderCompiler::add(
+	DEBUG_LABEL_ARG_MANY const std::string& vertex_source, const std::string& fragment_source, const CompiledShaderVertexAttributes& layout
+)
+{
+	if (pending.empty() && finished_count == 0)
+	{
+		started_at = std::chrono::steady_clock::now();
+	}
+
+#if FF_HAS(ENABLE_GL_DEBUG)
+	const std::string name = debug_label;
+#else
+	const std::string name = Str() << "program " << pending.size();
+#endif
+
+	auto program = std::make_shared<ShaderProgram>(layout);
+	SET_DEBUG_LABEL_NAMED(program->shader_program, DebugLabelFor::Program, Str() << "PROGRAM " << debug_label);
+	pending.emplace_back(submit_shader_program(SEND_DEBUG_LABEL_MANY(debug_label) program.get(), name, vertex_source, fragment_source, layout, cache));
+	programs.emplace_back(program);
+	return program;
+}
+
+bool ShaderCompiler::finish_ready()
+{
+	// without the extension every check waits for the program so they are finished in order
+	std::vector<PendingShaderProgram> not_ready;
+	for (auto& p: pending)
+	{
+		if (is_parallel && is_shader_program_ready(p) == false)
+		{
+			not_ready.emplace_back(std::move(p));
+			continue;
+		}
+
+		finish_shader_program(&p);
+		LOG_INFO(
+			"Shader %s: submitted in %.2f ms, ready after %.2f ms%s",
+			p.name.c_str(),
+			static_cast<double>(p.submit_ms),
+			static_cast<double>(ms_since(p.submitted_at)),
+			p.is_from_cache ? " (cached)" : ""
+		);
+
+		finished_count += 1;
+		cached_count += p.is_from_cache ? 1 : 0;
+		failed_count += p.program->is_loaded() ? 0 : 1;
+	}
+	pending = std::move(not_ready);
+
+	if (pending.empty() == false)
+	{
+		return false;
+	}
+
+	if (finished_count > 0)
+	{
+		LOG_INFO(
+			"Compiled %d shaders in %.2f ms, %d from cache, %d failed%s",
+			finished_count,
+			static_cast<double>(ms_since(started_at)),
+			cached_count,
+			failed_count,
+			is_parallel ? ", in parallel" : ""
+		);
+	}
+
+	finished_count = 0;
+	cached_count = 0;
+	failed_count = 0;
+	programs.clear();
+	return true;
+}
+
+void ShaderCompiler::finish()
+{
+	while (finish_ready() == false)
+	{
+		std::this_thread::yield();
+	}
+}
+
+void ShaderProgram::use(State* states) const
 {
-	set_shader_program(shader_program, debug_vertex_types);
+	set_debug_shader_program(shader_program, debug_vertex_types);
+	StateChanger{states}.use_program(shader_program);
+}
+
+void ShaderProgram::use_while_loading() const
+{
+	set_debug_shader_program(shader_program, debug_vertex_types);
+	glUseProgram(shader_program);
+	invalidate_state_bindings();
 }
 
 ShaderProgram::ShaderProgram(ShaderProgram&& other) noexcept
 	: shader_program(other.shader_program)
 	, debug_vertex_types(std::move(other.debug_vertex_types))
+	, uniform_table(std::move(other.uniform_table))
+	, uniform_values(std::move(other.uniform_values))
 {
 	other.shader_program = 0;
 	other.debug_vertex_types = {};
+	other.uniform_table = {};
+	other.uniform_values = {};
 }
 
 ShaderProgram& ShaderProgram::operator=(ShaderProgram&& rhs) noexcept
@@ -177,9 +496,13 @@ ShaderProgram& ShaderProgram::operator=(ShaderProgram&& rhs) noexcept
 
 	shader_program = rhs.shader_program;
 	debug_vertex_types = rhs.debug_vertex_types;
+	uniform_table = std::move(rhs.uniform_table);
+	uniform_values = std::move(rhs.uniform_values);
 
 	rhs.shader_program = 0;
 	rhs.debug_vertex_types = {};
+	rhs.uniform_table = {};
+	rhs.uniform_values = {};
 
 	return *this;
 }
@@ -199,16 +522,241 @@ void ShaderProgram::clear()
 	clear_shader_program();
 	glDeleteProgram(shader_program);
 	shader_program = 0;
+	uniform_table = {};
+	uniform_values = {};
 }
 
-Uniform ShaderProgram::get_uniform(const std::string& name) const
+namespace
 {
-	const auto uni = Uniform{name, glGetUniformLocation(shader_program, name.c_str()), shader_program};
-	if (uni.is_valid() == false)
+	const char* name_from_uniform_type(GLenum type)
 	{
-		LOG_ERROR("Uniform %s not found", name.c_str());
+		switch (type)
+		{
+		case GL_FLOAT: return "float";
+		case GL_FLOAT_VEC2: return "vec2";
+		case GL_FLOAT_VEC3: return "vec3";
+		case GL_FLOAT_VEC4: return "vec4";
+		case GL_INT: return "int";
+		case GL_BOOL: return "bool";
+		case GL_FLOAT_MAT3: return "mat3";
+		case GL_FLOAT_MAT4: return "mat4";
+		case GL_SAMPLER_2D: return "sampler2D";
+		case GL_SAMPLER_2D_ARRAY: return "sampler2DArray";
+		case GL_SAMPLER_2D_SHADOW: return "sampler2DShadow";
+		case GL_SAMPLER_CUBE: return "samplerCube";
+		default: return "<other>";
+		}
 	}
-	return uni;
+
+	const char* name_from_uniform_kind(UniformKind kind)
+	{
+		switch (kind)
+		{
+		case UniformKind::any: return "any";
+		case UniformKind::float_type: return "float";
+		case UniformKind::bool_type: return "bool";
+		case UniformKind::int_type: return "int";
+		case UniformKind::vec2: return "vec2";
+		case UniformKind::vec3: return "vec3";
+		case UniformKind::vec4: return "vec4";
+		case UniformKind::mat3: return "mat3";
+		case UniformKind::mat4: return "mat4";
+		case UniformKind::texture: return "texture";
+		default: DIE("invalid uniform kind"); return "<invalid>";
+		}
+	}
+
+	bool is_sampler_type(GLenum type)
+	{
+		switch (type)
+		{
+		case GL_SAMPLER_1D:
+		case GL_SAMPLER_2D:
+		case GL_SAMPLER_3D:
+		case GL_SAMPLER_CUBE:
+		case GL_SAMPLER_1D_SHADOW:
+		case GL_SAMPLER_2D_SHADOW:
+		case GL_SAMPLER_1D_ARRAY:
+		case GL_SAMPLER_2D_ARRAY:
+		case GL_SAMPLER_1D_ARRAY_SHADOW:
+		case GL_SAMPLER_2D_ARRAY_SHADOW:
+		case GL_SAMPLER_CUBE_SHADOW:
+		case GL_SAMPLER_2D_MULTISAMPLE:
+		case GL_SAMPLER_2D_MULTISAMPLE_ARRAY:
+		case GL_SAMPLER_CUBE_MAP_ARRAY:
+		case GL_SAMPLER_CUBE_MAP_ARRAY_SHADOW:
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	bool is_uniform_kind(UniformKind kind, GLenum type)
+	{
+		switch (kind)
+		{
+		case UniformKind::any: return true;
+		case UniformKind::float_type: return type == GL_FLOAT;
+		// bools may be set with glUniform1i
+		case UniformKind::bool_type: return type == GL_BOOL || type == GL_INT;
+		case UniformKind::int_type: return type == GL_INT;
+		case UniformKind::vec2: return type == GL_FLOAT_VEC2;
+		case UniformKind::vec3: return type == GL_FLOAT_VEC3;
+		case UniformKind::vec4: return type == GL_FLOAT_VEC4;
+		case UniformKind::mat3: return type == GL_FLOAT_MAT3;
+		case UniformKind::mat4: return type == GL_FLOAT_MAT4;
+		case UniformKind::texture: return is_sampler_type(type);
+		default: DIE("invalid uniform kind"); return false;
+		}
+	}
+
+	/** The one place where a uniform that doesn't match the shader is reported.
+	 * The requested name is only built when it's reported, a found uniform is named by the reflected uniform.
+	 */
+	template<typename NameFunction>
+	Uniform uniform_from_active(unsigned int shader_program, const ActiveUniform* active, UniformKind kind, NameFunction&& get_name)
+	{
+		if (active == nullptr)
+		{
+			std::string name = get_name();
+			LOG_ERROR("Uniform %s not found", name.c_str());
+			return Uniform{std::move(name), -1, shader_program};
+		}
+
+		if (is_uniform_kind(kind, active->type) == false)
+		{
+			LOG_ERROR(
+				"Uniform %s is a %s in the shader but used as a %s",
+				get_name().c_str(),
+				name_from_uniform_type(active->type),
+				name_from_uniform_kind(kind)
+			);
+		}
+
+		return Uniform{active->name, active->location, shader_program, active->type};
+	}
+
+	Uniform uniform_from_driver(unsigned int shader_program, std::string name)
+	{
+		auto uni = Uniform{name, glGetUniformLocation(shader_program, name.c_str()), shader_program};
+		if (uni.is_valid() == false)
+		{
+			LOG_ERROR("Uniform %s not found", name.c_str());
+		}
+		return uni;
+	}
+}  //  namespace
+
+Uniform ShaderProgram::get_uniform(std::string_view name, UniformKind kind) const
+{
+	if (uniform_table.is_reflected == false)
+	{
+		return uniform_from_driver(shader_program, std::string{name});
+	}
+	return uniform_from_active(shader_program, uniform_table.find(name), kind, [name]() { return std::string{name}; });
+}
+
+Uniform ShaderProgram::get_uniform(std::string_view array, std::size_t index, std::string_view member, UniformKind kind) const
+{
+	const auto get_name = [array, index, member]()
+	{
+		const auto index_string = std::to_string(index);
+
+		std::string name;
+		name.reserve(array.size() + index_string.size() + member.size() + 3);
+		name.append(array).append("[").append(index_string).append("].").append(member);
+		return name;
+	};
+
+	if (uniform_table.is_reflected == false)
+	{
+		return uniform_from_driver(shader_program, get_name());
+	}
+	return uniform_from_active(shader_program, uniform_table.find_member(array, index, member), kind, get_name);
+}
+
+namespace
+{
+	UniformUploadStats uniform_upload_stats;
+}  //  namespace
+
+bool is_new_uniform_value(std::vector<UniformValue>* values, int location, const void* data, std::size_t size)
+{
+	ASSERT(size <= sizeof(UniformValue::data));
+
+	const auto index = sizet_from_int(location);
+	if (index >= values->size())
+	{
+		values->resize(index + 1);
+	}
+
+	// compared as bytes so a float that is -0 or nan is only skipped if it's exactly the same
+	auto& current = (*values)[index];
+	if (current.size == size && std::memcmp(current.data.data(), data, size) == 0)
+	{
+		uniform_upload_stats.skipped += 1;
+		return false;
+	}
+
+	std::memcpy(current.data.data(), data, size);
+	current.size = size;
+	uniform_upload_stats.issued += 1;
+	return true;
+}
+
+namespace
+{
+#if FF_HAS(VERIFY_UNIFORM_CACHE)
+	void verify_uniform_value(unsigned int shader_program, const Uniform& uniform, int expected)
+	{
+		GLint actual = 0;
+		glGetUniformiv(shader_program, uniform.location, &actual);
+		if (actual != expected)
+		{
+			LOG_ERROR("Uniform %s is %d but the cached value is %d", uniform.name.c_str(), actual, expected);
+			DIE("uniform cache is out of sync with the driver");
+		}
+	}
+
+	template<typename T>
+	void verify_uniform_value(unsigned int shader_program, const Uniform& uniform, const T& expected)
+	{
+		static_assert(sizeof(T) % sizeof(float) == 0);
+		std::array<GLfloat, 16> actual = {};
+		glGetUniformfv(shader_program, uniform.location, actual.data());
+		if (std::memcmp(actual.data(), &expected, sizeof(T)) != 0)
+		{
+			LOG_ERROR("Uniform %s doesn't match the cached value", uniform.name.c_str());
+			DIE("uniform cache is out of sync with the driver");
+		}
+	}
+#endif
+
+	/// Calls upload if the program doesn't already have the value.
+	template<typename T, typename Upload>
+	void set_uniform_value(
+		[[maybe_unused]] unsigned int shader_program, std::vector<UniformValue>* values, const Uniform& uniform, const T& value, Upload upload
+	)
+	{
+		if (is_new_uniform_value(values, uniform.location, &value, sizeof(T)))
+		{
+			upload();
+		}
+
+#if FF_HAS(VERIFY_UNIFORM_CACHE)
+		verify_uniform_value(shader_program, uniform, value);
+#endif
+	}
+}  //  namespace
+
+UniformUploadStats get_uniform_upload_stats()
+{
+	return uniform_upload_stats;
+}
+
+void reset_uniform_upload_stats()
+{
+	uniform_upload_stats = {};
 }
 
 void ShaderProgram::set_float(const Uniform& uniform, float value) // NOLINT(readability-make-member-function-const)
@@ -221,7 +769,7 @@ void ShaderProgram::set_float(const Uniform& uniform, float value) // NOLINT(rea
 	ASSERT(uniform.debug_shader_program == shader_program);
 
 	ASSERT(uniform.texture == -1 && "uniform is a texture not a float");
-	glUniform1f(uniform.location, value);
+	set_uniform_value(shader_program, &uniform_values, uniform, value, [&]() { glUniform1f(uniform.location, value); });
 }
 
 void ShaderProgram::set_bool(const Uniform& uniform, bool value)  // NOLINT(readability-make-member-function-const)
@@ -234,7 +782,8 @@ void ShaderProgram::set_bool(const Uniform& uniform, bool value)  // NOLINT(read
 	ASSERT(uniform.debug_shader_program == shader_program);
 
 	ASSERT(uniform.texture == -1 && "uniform is a texture not a float");
-	glUniform1i(uniform.location, value ? 1 : 0);
+	const int int_value = value ? 1 : 0;
+	set_uniform_value(shader_program, &uniform_values, uniform, int_value, [&]() { glUniform1i(uniform.location, int_value); });
 }
 
 void ShaderProgram::set_vec2(const Uniform& uniform, float x, float y) // NOLINT(readability-make-member-function-const)
@@ -247,7 +796,7 @@ void ShaderProgram::set_vec2(const Uniform& uniform, float x, float y) // NOLINT
 	ASSERT(uniform.debug_shader_program == shader_program);
 
 	ASSERT(uniform.texture == -1 && "uniform is a texture not a vec3");
-	glUniform2f(uniform.location, x, y);
+	set_uniform_value(shader_program, &uniform_values, uniform, glm::vec2{x, y}, [&]() { glUniform2f(uniform.location, x, y); });
 }
 
 void ShaderProgram::set_vec2(const Uniform& uniform, const glm::vec2& v)
@@ -265,7 +814,7 @@ void ShaderProgram::set_vec3(const Uniform& uniform, float x, float y, float z)
 	ASSERT(uniform.debug_shader_program == shader_program);
 
 	ASSERT(uniform.texture == -1 && "uniform is a texture not a vec3");
-	glUniform3f(uniform.location, x, y, z);
+	set_uniform_value(shader_program, &uniform_values, uniform, glm::vec3{x, y, z}, [&]() { glUniform3f(uniform.location, x, y, z); });
 }
 
 void ShaderProgram::set_vec3(const Uniform& uniform, const glm::vec3& v)
@@ -283,7 +832,9 @@ void ShaderProgram::set_vec4(const Uniform& uniform, float x, float y, float z,
 	ASSERT(uniform.debug_shader_program == shader_program);
 
 	ASSERT(uniform.texture == -1 && "uniform is a texture not a vec4");
-	glUniform4f(uniform.location, x, y, z, w);
+	set_uniform_value(
+		shader_program, &uniform_values, uniform, glm::vec4{x, y, z, w}, [&]() { glUniform4f(uniform.location, x, y, z, w); }
+	);
 }
 
 void ShaderProgram::set_vec4(const Uniform& uniform, const glm::vec4& v)
@@ -301,7 +852,7 @@ void ShaderProgram::set_texture(const Uniform& uniform) // NOLINT(readability-ma
 	ASSERT(uniform.debug_shader_program == shader_program);
 
 	ASSERT(uniform.texture >= 0 && "uniform needs to be a texture");
-	glUniform1i(uniform.location, uniform.texture);
+	set_uniform_value(shader_program, &uniform_values, uniform, uniform.texture, [&]() { glUniform1i(uniform.location, uniform.texture); });
 }
 
 void ShaderProgram::set_mat(const Uniform& uniform, const glm::mat4& mat) // NOLINT(readability-make-member-function-const)
@@ -314,7 +865,9 @@ void ShaderProgram::set_mat(const Uniform& uniform, const glm::mat4& mat) // NOL
 	ASSERT(uniform.debug_shader_program == shader_program);
 
 	ASSERT(uniform.texture == -1 && "uniform is a texture not a matrix4");
-	glUniformMatrix4fv(uniform.location, 1, GL_FALSE, glm::value_ptr(mat));
+	set_uniform_value(
+		shader_program, &uniform_values, uniform, mat, [&]() { glUniformMatrix4fv(uniform.location, 1, GL_FALSE, glm::value_ptr(mat)); }
+	);
 }
 
 void ShaderProgram::set_mat(const Uniform& uniform, const glm::mat3& mat) // NOLINT(readability-make-member-function-const)
@@ -327,7 +880,9 @@ void ShaderProgram::set_mat(const Uniform& uniform, const glm::mat3& mat) // NOL
 	ASSERT(uniform.debug_shader_program == shader_program);
 
 	ASSERT(uniform.texture == -1 && "uniform is a texture not a matrix3");
-	glUniformMatrix3fv(uniform.location, 1, GL_FALSE, glm::value_ptr(mat));
+	set_uniform_value(
+		shader_program, &uniform_values, uniform, mat, [&]() { glUniformMatrix3fv(uniform.location, 1, GL_FALSE, glm::value_ptr(mat)); }
+	);
 }
 
 void ShaderProgram::setup_uniform_block(const UniformBufferSetup& setup) // NOLINT(readability-make-member-function-const)
@@ -345,7 +900,7 @@ void setup_textures(ShaderProgram* shader, const std::vector<Uniform*>& uniform_
 {
 	ASSERT(uniform_list.size() <= MAX_TEXTURES_SUPPORTED);
 
-	shader->use();
+	shader->use_while_loading();
 
 	int index = 0;
 	for (const auto& uniform: uniform_list)
@@ -362,11 +917,10 @@ namespace
 	unsigned int debug_current_shader_program = 0;
 }  //  namespace
 
-void set_shader_program(unsigned int new_program, const VertexTypes& types)
+void set_debug_shader_program(unsigned int new_program, const VertexTypes& types)
 {
 	debug_current_shader_program = new_program;
 	debug_current_shader_types = types;
-	glUseProgram(new_program);
 }
 
 bool is_bound_for_shader(const std::unordered_set<VertexType>& debug_geom_shader_types)
@@ -390,7 +944,9 @@ bool is_shader_bound(unsigned int program)
 
 void clear_shader_program()
 {
-	set_shader_program(0, {});
+	set_debug_shader_program(0, {});
+	glUseProgram(0);
+	invalidate_state_bindings();
 }
 
 }  //  namespace klotter
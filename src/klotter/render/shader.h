@@ -1,16 +1,36 @@
 ﻿#pragma once
 
 #include "klotter/render/opengl_labels.h"
+#include "klotter/render/shader.cache.h"
 #include "klotter/render/uniform.h"
 #include "klotter/render/vertex_layout.h"
 
+#include <chrono>
 #include <unordered_set>
 
 namespace klotter
 {
 
+struct State;
 struct UniformBufferSetup;
 
+/// internal: The last value set for a uniform location.
+struct UniformValue
+{
+	std::array<std::uint8_t, sizeof(glm::mat4)> data = {};
+	std::size_t size = 0;  ///< 0 if no value has been set
+};
+
+/// The number of uniform values set through a \ref ShaderProgram.
+struct UniformUploadStats
+{
+	/// the number of values that were sent to the driver
+	std::size_t issued = 0;
+
+	/// the number of values that were skipped since the program already had that value
+	std::size_t skipped = 0;
+};
+
 /** RAII representation of a open gl shader program.
  */
 struct ShaderProgram
@@ -20,14 +40,22 @@ struct ShaderProgram
      * @param vertex_source glsl code for the vertex shader
      * @param fragment_source glsl code for the fragment shader
      * @param layout the vertex layout to use
+     * @param cache if not null, a linked binary is loaded from it or stored in it after compiling
      */
 	ShaderProgram(
 		DEBUG_LABEL_ARG_MANY
 		const std::string& vertex_source,
 		const std::string& fragment_source,
-		const CompiledShaderVertexAttributes& layout
+		const CompiledShaderVertexAttributes& layout,
+		const ShaderCache* cache = nullptr
 	);
 
+	/** internal: Creates a program that isn't compiled yet.
+	 * @param layout the vertex layout to use
+	 * @see \ref ShaderCompiler
+	 */
+	explicit ShaderProgram(const CompiledShaderVertexAttributes& layout);
+
 	/** Destroy the shader if it's loaded.
 	 * @see \ref clear
      */
@@ -60,14 +88,34 @@ struct ShaderProgram
 	[[nodiscard]] bool is_loaded() const;
 
 	/** Activates the ShaderProgram for rendering.
+	 * @param states the program is only sent to the driver if it isn't already in use
      */
-	void use() const;
+	void use(State* states) const;
+
+	/** Activates the ShaderProgram when loading, when there is no \ref State to go through.
+	 * @see \ref invalidate_state_bindings
+     */
+	void use_while_loading() const;
 
 	/** Get a uniform by name.
+	 * A missing uniform or a uniform with a different type is logged.
      * @param name the name of the uniform in the shader program
+     * @param kind the expected type of the uniform
      * @return Uniform object representing the location or a zombie if not found
      */
-	[[nodiscard]] Uniform get_uniform(const std::string& name) const;
+	[[nodiscard]] Uniform get_uniform(std::string_view name, UniformKind kind = UniformKind::any) const;
+
+	/** Get a member of a element in an array of structs, like `array[index].member`.
+	 * Looked up without building the full name.
+     * @param array the name of the array in the shader program
+     * @param index the index in the array
+     * @param member the name of the member in the struct
+     * @param kind the expected type of the uniform
+     * @return Uniform object representing the location or a zombie if not found
+     */
+	[[nodiscard]] Uniform get_uniform(
+		std::string_view array, std::size_t index, std::string_view member, UniformKind kind = UniformKind::any
+	) const;
 
 	/** Sets a uniform float value.
 	 * Does nothing if the uniform is a zombie.
@@ -168,8 +216,94 @@ struct ShaderProgram
 
 	unsigned int shader_program;  ///< The id of the shader program.
 	VertexTypes debug_vertex_types;	 ///< The debug information describing the vertex layout that this shader expects.
+	UniformTable uniform_table;  ///< The active uniforms, reflected once after linking.
+	std::vector<UniformValue> uniform_values;  ///< The last value set for each uniform location, indexed by location.
+};
+
+/// internal: A program that has been submitted to the driver but the status hasn't been checked.
+struct PendingShaderProgram
+{
+	ShaderProgram* program = nullptr;
+	std::string name;
+	CompiledShaderVertexAttributes layout;
+
+	const ShaderCache* cache = nullptr;
+	ShaderCacheKey cache_key = 0;
+	bool is_from_cache = false;
+
+	/// only set if compiled from source
+	std::string vertex_source;
+	std::string fragment_source;
+	unsigned int vertex_shader = 0;
+	unsigned int fragment_shader = 0;
+
+	std::chrono::steady_clock::time_point submitted_at;
+	float submit_ms = 0.0f;
+};
+
+/** Compiles many shader programs at once.
+ * Every program is submitted to the driver before any status is checked so the driver can work on them in parallel,
+ * on its own threads if KHR_parallel_shader_compile is supported.
+ * The returned programs can't be used before \ref finish has been called.
+ */
+struct ShaderCompiler
+{
+	/** @param c if not null, linked binaries are loaded from it or stored in it after compiling
+	 */
+	explicit ShaderCompiler(const ShaderCache* c);
+	~ShaderCompiler();
+
+	ShaderCompiler(const ShaderCompiler&) = delete;
+	ShaderCompiler(ShaderCompiler&&) = delete;
+	void operator=(const ShaderCompiler&) = delete;
+	void operator=(ShaderCompiler&&) = delete;
+
+	/** Start compiling a program.
+	 * @return a program that is valid once \ref finish has been called, or a zombie if it failed to compile
+	 */
+	std::shared_ptr<ShaderProgram> add(
+		DEBUG_LABEL_ARG_MANY
+		const std::string& vertex_source,
+		const std::string& fragment_source,
+		const CompiledShaderVertexAttributes& layout
+	);
+
+	/** Finish the programs that the driver is done with, without waiting for the rest.
+	 * Without parallel compile support there is no way to know if a program is done, so this waits for all.
+	 * @return true if all programs are finished
+	 */
+	bool finish_ready();
+
+	/** Wait for all programs, log errors and timings.
+	 */
+	void finish();
+
+	const ShaderCache* cache;
+	std::chrono::steady_clock::time_point started_at;
+	bool is_parallel;
+	std::vector<PendingShaderProgram> pending;
+
+	int finished_count = 0;
+	int cached_count = 0;
+	int failed_count = 0;
+
+	/// keeps the programs alive until they are finished
+	std::vector<std::shared_ptr<ShaderProgram>> programs;
 };
 
+/** Get the number of uniform values set and skipped since the last reset.
+ */
+UniformUploadStats get_uniform_upload_stats();
+
+/** Reset the uniform counters, to get the stats for a single frame.
+ */
+void reset_uniform_upload_stats();
+
+/** "internal" Returns true if the value needs to be sent to the driver and remembers it as the current value.
+ * The values are compared as bytes and the result is counted in the \ref UniformUploadStats.
+ */
+bool is_new_uniform_value(std::vector<UniformValue>* values, int location, const void* data, std::size_t size);
+
 /** Sets up textures for a shader program.
  * @param shader the shader to use
  * @param uniform_list the uniforms to associate with texture units
@@ -1,10 +1,20 @@
-﻿#include "klotter/log.h"
+﻿#include "klotter/assert.h"
+#include "klotter/cint.h"
+#include "klotter/jobs.h"
+#include "klotter/log.h"
 #include "klotter/str.h"
 
 #include "klotter/render/shader.source.h"
 
+#include "klotter/render/draw.block.h"
+#include "klotter/render/material.block.h"
+
 #include "mustache/mustache.hpp"
 
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+
 #include "default_shader.frag.glsl.h"
 #include "default_shader.vert.glsl.h"
 #include "skybox.frag.glsl.h"
@@ -30,6 +40,141 @@ ShaderOptions ShaderOptions::with_instanced_mat4() const
 	return ret;
 }
 
+ShaderOptions ShaderOptions::with_texture_arrays() const
+{
+	auto ret = *this;
+	ret.use_texture_arrays = true;
+	return ret;
+}
+
+namespace
+{
+	constexpr std::string_view manifest_header = "klotter shader permutations 1";
+
+	enum class OptionBit : ShaderPermutationKey
+	{
+		only_depth = 1 << 0,
+		use_blinn_phong = 1 << 1,
+		use_texture = 1 << 2,
+		use_lights = 1 << 3,
+		transparent_cutoff = 1 << 4,
+		use_instancing = 1 << 5,
+		use_texture_arrays = 1 << 6
+	};
+
+	constexpr int directional_lights_shift = 8;
+	constexpr int point_lights_shift = 16;
+	constexpr int frustum_lights_shift = 24;
+
+	ShaderPermutationKey key_from_bit(bool value, OptionBit bit)
+	{
+		return value ? static_cast<ShaderPermutationKey>(bit) : 0;
+	}
+
+	bool bit_from_key(ShaderPermutationKey key, OptionBit bit)
+	{
+		return (key & static_cast<ShaderPermutationKey>(bit)) != 0;
+	}
+
+	ShaderPermutationKey key_from_count(int count, int shift)
+	{
+		ASSERT(count >= 0 && count <= 0xFF);
+		return static_cast<ShaderPermutationKey>(count & 0xFF) << shift;
+	}
+
+	int count_from_key(ShaderPermutationKey key, int shift)
+	{
+		return static_cast<int>((key >> shift) & 0xFF);
+	}
+}  //  namespace
+
+ShaderPermutationKey key_from_shader_options(const ShaderOptions& options)
+{
+	return key_from_bit(options.only_depth, OptionBit::only_depth) | key_from_bit(options.use_blinn_phong, OptionBit::use_blinn_phong)
+		 | key_from_bit(options.use_texture, OptionBit::use_texture) | key_from_bit(options.use_lights, OptionBit::use_lights)
+		 | key_from_bit(options.transparent_cutoff, OptionBit::transparent_cutoff)
+		 | key_from_bit(options.use_instancing, OptionBit::use_instancing)
+		 | key_from_bit(options.use_texture_arrays, OptionBit::use_texture_arrays)
+		 | key_from_count(options.number_of_directional_lights, directional_lights_shift)
+		 | key_from_count(options.number_of_point_lights, point_lights_shift)
+		 | key_from_count(options.number_of_frustum_lights, frustum_lights_shift);
+}
+
+ShaderOptions shader_options_from_key(ShaderPermutationKey key)
+{
+	ShaderOptions options;
+	options.only_depth = bit_from_key(key, OptionBit::only_depth);
+	options.use_blinn_phong = bit_from_key(key, OptionBit::use_blinn_phong);
+	options.use_texture = bit_from_key(key, OptionBit::use_texture);
+	options.use_lights = bit_from_key(key, OptionBit::use_lights);
+	options.transparent_cutoff = bit_from_key(key, OptionBit::transparent_cutoff);
+	options.use_instancing = bit_from_key(key, OptionBit::use_instancing);
+	options.use_texture_arrays = bit_from_key(key, OptionBit::use_texture_arrays);
+	options.number_of_directional_lights = count_from_key(key, directional_lights_shift);
+	options.number_of_point_lights = count_from_key(key, point_lights_shift);
+	options.number_of_frustum_lights = count_from_key(key, frustum_lights_shift);
+	return options;
+}
+
+std::string describe_shader_options(const ShaderOptions& options)
+{
+	Str ret;
+	ret << (options.only_depth ? "depth" : (options.use_lights ? "lit" : "unlit"));
+	if (options.use_texture)
+	{
+		ret << " textured";
+	}
+	if (options.transparent_cutoff)
+	{
+		ret << " cutoff";
+	}
+	if (options.use_instancing)
+	{
+		ret << " instanced";
+	}
+	if (options.use_texture_arrays)
+	{
+		ret << " array";
+	}
+	return ret;
+}
+
+std::vector<ShaderPermutationKey> load_shader_manifest(const std::filesystem::path& path)
+{
+	std::ifstream file{path};
+	std::string line;
+	if (std::getline(file, line).good() == false || line != manifest_header)
+	{
+		return {};
+	}
+
+	std::vector<ShaderPermutationKey> keys;
+	while (std::getline(file, line))
+	{
+		ShaderPermutationKey key = 0;
+		std::istringstream ss{line};
+		if (ss >> std::hex >> key)
+		{
+			keys.emplace_back(key);
+		}
+	}
+	return keys;
+}
+
+bool save_shader_manifest(const std::filesystem::path& path, const std::vector<ShaderPermutationKey>& keys)
+{
+	std::error_code error;
+	std::filesystem::create_directories(path.parent_path(), error);
+
+	std::ofstream file{path, std::ios::trunc};
+	file << manifest_header << "\n";
+	for (const auto key: keys)
+	{
+		file << std::hex << key << "\n";
+	}
+	return file.good();
+}
+
 kainjow::mustache::mustache load_mustache(std::string_view str)
 {
 	auto input = kainjow::mustache::mustache{std::string{str.begin(), str.end()}};
@@ -43,6 +188,82 @@ kainjow::mustache::mustache load_mustache(std::string_view str)
 	return input;
 }
 
+BlurKernel calculate_gaussian_kernel(float sigma, int radius)
+{
+	ASSERT(sigma > 0.0f);
+	if (radius <= 0)
+	{
+		// 3 standard deviations covers more than 99% of the curve
+		radius = std::max(1, static_cast<int>(std::ceil(sigma * 3.0f)));
+	}
+
+	BlurKernel kernel;
+	float sum = 0.0f;
+	for (int index = 0; index <= radius; index += 1)
+	{
+		const auto x = static_cast<float>(index);
+		const auto weight = std::exp(-(x * x) / (2.0f * sigma * sigma));
+		kernel.offsets.emplace_back(x);
+		kernel.weights.emplace_back(weight);
+
+		// all taps except the center are used twice
+		sum += index == 0 ? weight : weight * 2.0f;
+	}
+
+	for (auto& weight: kernel.weights)
+	{
+		weight /= sum;
+	}
+
+	return kernel;
+}
+
+BlurKernel calculate_linear_sampled_kernel(const BlurKernel& discrete)
+{
+	ASSERT(discrete.offsets.size() == discrete.weights.size());
+	ASSERT(discrete.offsets.empty() == false);
+
+	BlurKernel kernel;
+
+	// the center is sampled exactly, merging it would blur it with the mirrored side
+	kernel.offsets.emplace_back(discrete.offsets[0]);
+	kernel.weights.emplace_back(discrete.weights[0]);
+
+	for (std::size_t index = 1; index < discrete.offsets.size(); index += 2)
+	{
+		const auto is_last = index + 1 == discrete.offsets.size();
+		if (is_last)
+		{
+			kernel.offsets.emplace_back(discrete.offsets[index]);
+			kernel.weights.emplace_back(discrete.weights[index]);
+			continue;
+		}
+
+		// sampling between the texels, weighted towards the heaviest, gives both texels their weight
+		const auto weight = discrete.weights[index] + discrete.weights[index + 1];
+		const auto offset
+			= (discrete.offsets[index] * discrete.weights[index] + discrete.offsets[index + 1] * discrete.weights[index + 1]) / weight;
+		kernel.offsets.emplace_back(offset);
+		kernel.weights.emplace_back(weight);
+	}
+
+	return kernel;
+}
+
+std::string float_array_values(const std::vector<float>& values)
+{
+	Str ret;
+	for (std::size_t index = 0; index < values.size(); index += 1)
+	{
+		if (index != 0)
+		{
+			ret << ", ";
+		}
+		ret << std::setprecision(9) << std::fixed << values[index];
+	}
+	return ret.str();
+}
+
 std::string generate_blur(std::string_view src, const BlurOptions& options)
 {
 	auto input = load_mustache(src);
@@ -53,12 +274,59 @@ std::string generate_blur(std::string_view src, const BlurOptions& options)
 	data["sample_count"] = (Str{} << options.sample_count).str();
 	data["is_gauss"] = options.is_gauss == IsGauss::yes;
 
+	data["has_kernel"] = options.kernel.has_value();
+	if (options.kernel)
+	{
+		data["tap_count"] = (Str{} << options.kernel->offsets.size()).str();
+		data["offsets"] = float_array_values(options.kernel->offsets);
+		data["weights"] = float_array_values(options.kernel->weights);
+	}
+
 	return input.render(data);
 }
 
-std::string generate(std::string_view str, const ShaderOptions& options, const std::string& uniform_buffer_source)
+std::string fused_effect_prefix(std::size_t index)
+{
+	return Str{} << "u_fx" << index << "_";
+}
+
+std::string fused_uniform_name(const std::string& prefix, const std::string& uniform_name)
+{
+	ASSERT(uniform_name.starts_with(standalone_effect_prefix));
+	return prefix + uniform_name.substr(standalone_effect_prefix.size());
+}
+
+std::string generate_post_proc_effects(std::string_view src, const PostProcEffectsOptions& options)
+{
+	auto input = load_mustache(src);
+	auto data = kainjow::mustache::data{};
+
+	auto effects = kainjow::mustache::list{};
+	for (const auto& effect: options.effects)
+	{
+		auto effect_data = kainjow::mustache::data{};
+		effect_data["prefix"] = effect.prefix;
+
+		auto effect_source = load_mustache(effect.source);
+
+		auto effect_item = kainjow::mustache::data{};
+		effect_item["name"] = effect.name;
+		effect_item["prefix"] = effect.prefix;
+		effect_item["source"] = effect_source.render(effect_data);
+		effects.emplace_back(effect_item);
+	}
+
+	data["realize"] = options.realize;
+	data["effects"] = kainjow::mustache::data{effects};
+
+	// realize keeps the alpha, but the effects has always written a opaque result
+	data["output_alpha"] = std::string{options.realize && options.effects.empty() ? "alpha" : "1.0f"};
+
+	return input.render(data);
+}
+
+kainjow::mustache::data data_from_options(const ShaderOptions& options, const std::string& uniform_buffer_source)
 {
-	auto input = load_mustache(str);
 	auto data = kainjow::mustache::data{};
 
 	data["use_lights"] = options.use_lights;
@@ -69,10 +337,13 @@ std::string generate(std::string_view str, const ShaderOptions& options, const s
 	data["number_of_frustum_lights"] = (Str() << options.number_of_frustum_lights).str();
 	data["transparent_cutoff"] = options.transparent_cutoff;
 	data["use_instancing"] = options.use_instancing;
+	data["use_texture_arrays"] = options.use_texture_arrays;
 	data["uniform_buffer_source"] = uniform_buffer_source;
+	data["material_buffer_source"] = get_material_block_layout().setup.source;
+	data["draw_buffer_source"] = get_draw_block_layout().setup.source;
 	data["only_depth"] = options.only_depth;
 
-	return input.render(data);
+	return data;
 }
 
 std::string generate(std::string_view str, const std::string& uniform_buffer_source)
@@ -85,7 +356,7 @@ std::string generate(std::string_view str, const std::string& uniform_buffer_sou
 	return input.render(data);
 }
 
-ShaderSource_withLayout load_shader_source(const ShaderOptions& options, const std::string& uniform_buffer_source)
+ShaderVertexAttributes layout_from_options(const ShaderOptions& options)
 {
 	auto layout = ShaderVertexAttributes{{VertexType::position3, "a_position"}, {VertexType::color3, "a_color"}};
 
@@ -99,11 +370,41 @@ ShaderSource_withLayout load_shader_source(const ShaderOptions& options, const s
 		layout.emplace_back(VertexElementDescription{VertexType::normal3, "a_normal"});
 	}
 
-	return ShaderSource_withLayout{
-		layout,
-		generate(DEFAULT_SHADER_VERT_GLSL, options, uniform_buffer_source),
-		generate(DEFAULT_SHADER_FRAG_GLSL, options, uniform_buffer_source)
-	};
+	return layout;
+}
+
+ShaderSource_withLayout load_shader_source(const ShaderOptions& options, const std::string& uniform_buffer_source)
+{
+	return load_shader_sources({options}, uniform_buffer_source, 1)[0];
+}
+
+std::vector<ShaderSource_withLayout> load_shader_sources(
+	const std::vector<ShaderOptions>& options, const std::string& uniform_buffer_source, int thread_count
+)
+{
+	// parsing is the expensive part so the templates are only parsed once
+	const auto vertex_template = load_mustache(DEFAULT_SHADER_VERT_GLSL);
+	const auto fragment_template = load_mustache(DEFAULT_SHADER_FRAG_GLSL);
+
+	std::vector<ShaderSource_withLayout> sources(options.size());
+
+	const auto count = int_from_sizet(options.size());
+	get_job_system().parallel_for(0, count, grain_size_from_thread_count(count, thread_count),
+		[&](int begin, int end)
+		{
+			// rendering isn't const so each range renders from its own copy
+			auto vertex = vertex_template;
+			auto fragment = fragment_template;
+			for (int index = begin; index < end; index += 1)
+			{
+				const auto& o = options[sizet_from_int(index)];
+				const auto data = data_from_options(o, uniform_buffer_source);
+				sources[sizet_from_int(index)] = ShaderSource_withLayout{layout_from_options(o), vertex.render(data), fragment.render(data)};
+			}
+		}
+	);
+
+	return sources;
 }
 
 ShaderSource load_skybox_source(const std::string& uniform_buffer_source)
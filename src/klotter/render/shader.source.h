@@ -2,6 +2,8 @@
 
 #include "klotter/render/vertex_layout.h"
 
+#include <filesystem>
+
 namespace klotter
 {
 
@@ -24,8 +26,32 @@ struct ShaderOptions
 
 	bool use_instancing = false;
 	[[nodiscard]] ShaderOptions with_instanced_mat4() const;
+
+	/// sample the material textures from texture arrays, with a layer and uv rect for each texture
+	bool use_texture_arrays = false;
+	[[nodiscard]] ShaderOptions with_texture_arrays() const;
 };
 
+/// A \ref ShaderOptions packed into a bitfield, used to identify shader permutations.
+using ShaderPermutationKey = std::uint32_t;
+
+/// Pack the options into a key, each light count needs to fit in 8 bits.
+ShaderPermutationKey key_from_shader_options(const ShaderOptions& options);
+
+/// Unpack a key created by \ref key_from_shader_options
+ShaderOptions shader_options_from_key(ShaderPermutationKey key);
+
+/// A short human readable description like "lit cutoff instanced", for logging and debug labels.
+std::string describe_shader_options(const ShaderOptions& options);
+
+/// Read a list of permutations that was written by \ref save_shader_manifest
+/// @return the keys or a empty list if the file is missing or invalid
+std::vector<ShaderPermutationKey> load_shader_manifest(const std::filesystem::path& path);
+
+/// Write a list of permutations so they can be compiled ahead of time on the next run.
+/// @return false if the file couldn't be written
+bool save_shader_manifest(const std::filesystem::path& path, const std::vector<ShaderPermutationKey>& keys);
+
 /// Shader source with the layout that is expected.
 /// @see \ref ShaderSource
 struct ShaderSource_withLayout
@@ -57,6 +83,23 @@ enum class IsGauss
 	yes
 };
 
+/// One side of a symmetric 1d blur kernel.
+/// The first tap is the center and the rest are mirrored, offsets are in texels.
+struct BlurKernel
+{
+	std::vector<float> offsets;
+	std::vector<float> weights;
+};
+
+/// Calculate a normalized gaussian kernel with one tap per texel.
+/// @param sigma the standard deviation, in texels
+/// @param radius the number of texels on each side of the center, if 0 the radius is calculated from the sigma
+BlurKernel calculate_gaussian_kernel(float sigma, int radius = 0);
+
+/// Merge adjacent taps so that a single bilinear filtered fetch samples two texels with the correct weights.
+/// The result is equivalent to the discrete kernel but needs about half the texture fetches.
+BlurKernel calculate_linear_sampled_kernel(const BlurKernel& discrete);
+
 /// Options for generating a blur shader source.
 /// @see \ref generate_blur
 struct BlurOptions
@@ -64,12 +107,59 @@ struct BlurOptions
 	BlurType blur;
 	int sample_count;
 	IsGauss is_gauss;
+
+	/// if set, the weights and offsets are emitted as constants instead of being calculated in the shader
+	std::optional<BlurKernel> kernel = std::nullopt;
 };
 
 std::string generate_blur(std::string_view src, const BlurOptions& options);
 
+/// A post-processing effect that only reads the current pixel and can be fused with other effects in a single pass.
+/// The source is a mustache template that declares the uniforms and a `vec3 {{prefix}}apply(vec3 color, vec2 uv)` function,
+/// all uniforms should start with `{{prefix}}` so several effects can live in the same shader.
+/// @see \ref generate_post_proc_effects
+struct PerPixelEffectSource
+{
+	std::string name;
+	std::string_view source;
+	std::string prefix;
+};
+
+/// Options for generating a realize and/or per-pixel effects shader.
+/// @see \ref generate_post_proc_effects
+struct PostProcEffectsOptions
+{
+	/// compose the rendered world: add bloom, tonemap and apply gamma before the effects
+	bool realize;
+
+	/// applied in order
+	std::vector<PerPixelEffectSource> effects;
+};
+
+/// The uniform prefix for a effect used by itself, uniforms are named like `u_factor`
+constexpr std::string_view standalone_effect_prefix = "u_";
+
+/// The uniform prefix for a effect at a index in a fused shader, uniforms are named like `u_fx0_factor`
+std::string fused_effect_prefix(std::size_t index);
+
+/// Convert a standalone uniform name like `u_factor` to the name used in a fused shader.
+std::string fused_uniform_name(const std::string& prefix, const std::string& uniform_name);
+
+std::string generate_post_proc_effects(std::string_view src, const PostProcEffectsOptions& options);
+
+/// The vertex attributes the default shader expects for the options.
+ShaderVertexAttributes layout_from_options(const ShaderOptions& options);
+
 ShaderSource_withLayout load_shader_source(const ShaderOptions& options, const std::string& uniform_buffer_source);
 
+/// Generate the source for many permutations of the default shader.
+/// The templates are parsed once and the permutations are rendered on worker threads.
+/// @param thread_count the most threads to use, 0 uses all threads of the job system
+/// @return the sources in the same order as the options
+std::vector<ShaderSource_withLayout> load_shader_sources(
+	const std::vector<ShaderOptions>& options, const std::string& uniform_buffer_source, int thread_count = 0
+);
+
 ShaderSource load_skybox_source(const std::string& uniform_buffer_source);
 
 }  //  namespace klotter
@@ -0,0 +1,199 @@
+#include "klotter/render/shader.source.h"
+
+#include "catch2/catch_test_macros.hpp"
+
+#include <cmath>
+#include <fstream>
+
+
+using namespace klotter;
+
+namespace
+{
+	constexpr float tolerance = 0.00001f;
+
+	float sum_of_weights(const BlurKernel& kernel)
+	{
+		float sum = 0.0f;
+		for (std::size_t index = 0; index < kernel.weights.size(); index += 1)
+		{
+			sum += index == 0 ? kernel.weights[index] : kernel.weights[index] * 2.0f;
+		}
+		return sum;
+	}
+
+	std::vector<float> make_signal()
+	{
+		std::vector<float> signal;
+		for (int index = 0; index < 64; index += 1)
+		{
+			// something that isn't smooth
+			signal.emplace_back(static_cast<float>((index * 37) % 11) + (index % 2 == 0 ? 5.0f : 0.0f));
+		}
+		return signal;
+	}
+
+	/// sample the signal like a linear filtered texture
+	float sample_linear(const std::vector<float>& signal, float position)
+	{
+		const auto left = std::floor(position);
+		const auto t = position - left;
+		const auto index = static_cast<std::size_t>(left);
+		return signal[index] * (1.0f - t) + signal[index + 1] * t;
+	}
+
+	float blur_at(const std::vector<float>& signal, std::size_t center, const BlurKernel& kernel)
+	{
+		const auto c = static_cast<float>(center);
+		float result = sample_linear(signal, c) * kernel.weights[0];
+		for (std::size_t index = 1; index < kernel.offsets.size(); index += 1)
+		{
+			result += sample_linear(signal, c + kernel.offsets[index]) * kernel.weights[index];
+			result += sample_linear(signal, c - kernel.offsets[index]) * kernel.weights[index];
+		}
+		return result;
+	}
+}
+
+TEST_CASE("blur_kernel_gaussian_is_normalized", "[blur_kernel]")
+{
+	for (const auto sigma: {0.5f, 1.0f, 1.75f, 3.3f, 8.0f})
+	{
+		const auto kernel = calculate_gaussian_kernel(sigma);
+		REQUIRE(kernel.offsets.size() == kernel.weights.size());
+		CHECK(std::abs(sum_of_weights(kernel) - 1.0f) < tolerance);
+
+		// the weights should be decreasing from the center
+		for (std::size_t index = 1; index < kernel.weights.size(); index += 1)
+		{
+			CHECK(kernel.weights[index] < kernel.weights[index - 1]);
+		}
+	}
+}
+
+TEST_CASE("blur_kernel_linear_sampling_halves_the_taps", "[blur_kernel]")
+{
+	// center + 4 texels on each side
+	const auto even = calculate_linear_sampled_kernel(calculate_gaussian_kernel(1.75f, 4));
+	CHECK(even.offsets.size() == 3);
+
+	// the last texel doesn't have a neighbour to merge with
+	const auto odd = calculate_linear_sampled_kernel(calculate_gaussian_kernel(1.75f, 5));
+	REQUIRE(odd.offsets.size() == 4);
+	CHECK(odd.offsets[3] == 5.0f);
+
+	// the offsets are between the merged texels
+	CHECK(even.offsets[0] == 0.0f);
+	CHECK(even.offsets[1] > 1.0f);
+	CHECK(even.offsets[1] < 2.0f);
+	CHECK(even.offsets[2] > 3.0f);
+	CHECK(even.offsets[2] < 4.0f);
+}
+
+TEST_CASE("blur_kernel_linear_sampling_is_equivalent_to_discrete", "[blur_kernel]")
+{
+	const auto signal = make_signal();
+
+	for (const auto sigma: {0.5f, 1.0f, 1.75f, 3.3f, 8.0f})
+	{
+		const auto discrete = calculate_gaussian_kernel(sigma);
+		const auto linear = calculate_linear_sampled_kernel(discrete);
+
+		CHECK(std::abs(sum_of_weights(linear) - 1.0f) < tolerance);
+
+		const auto radius = static_cast<std::size_t>(discrete.offsets.back());
+		REQUIRE(radius * 2 + 2 < signal.size());
+		for (std::size_t center = radius + 1; center + radius + 1 < signal.size(); center += 1)
+		{
+			const auto expected = blur_at(signal, center, discrete);
+			const auto actual = blur_at(signal, center, linear);
+			CHECK(std::abs(expected - actual) < 0.0001f);
+		}
+	}
+}
+
+TEST_CASE("shader_sources_match_single_permutations", "[shader]")
+{
+	ShaderOptions lit;
+	lit.use_lights = true;
+	lit.use_texture = true;
+	lit.number_of_point_lights = 3;
+
+	ShaderOptions depth;
+	depth.only_depth = true;
+
+	const auto options = std::vector<ShaderOptions>{
+		{}, depth, depth.with_instanced_mat4(), lit, lit.with_transparent_cutoff(), lit.with_texture_arrays().with_instanced_mat4()
+	};
+	const std::string uniform_buffer_source = "layout(std140) uniform Camera { mat4 u_clip_from_view; };";
+
+	for (const int thread_count: {1, 2, 0})
+	{
+		const auto sources = load_shader_sources(options, uniform_buffer_source, thread_count);
+		REQUIRE(sources.size() == options.size());
+		for (std::size_t index = 0; index < options.size(); index += 1)
+		{
+			const auto single = load_shader_source(options[index], uniform_buffer_source);
+			CHECK(sources[index].vertex == single.vertex);
+			CHECK(sources[index].fragment == single.fragment);
+			CHECK(sources[index].layout.size() == single.layout.size());
+		}
+	}
+
+	CHECK(load_shader_sources({}, uniform_buffer_source).empty());
+	CHECK(load_shader_sources(options, uniform_buffer_source)[3].layout.size() == 4);
+}
+
+TEST_CASE("shader_permutation_key_roundtrip", "[shader]")
+{
+	ShaderOptions lit;
+	lit.use_lights = true;
+	lit.use_texture = true;
+	lit.use_blinn_phong = false;
+	lit.number_of_directional_lights = 1;
+	lit.number_of_point_lights = 200;
+	lit.number_of_frustum_lights = 7;
+
+	ShaderOptions depth;
+	depth.only_depth = true;
+
+	for (const auto& options: {ShaderOptions{}, depth.with_instanced_mat4(), lit, lit.with_transparent_cutoff().with_texture_arrays()})
+	{
+		const auto key = key_from_shader_options(options);
+		CHECK(key_from_shader_options(shader_options_from_key(key)) == key);
+
+		const auto unpacked = shader_options_from_key(key);
+		CHECK(unpacked.only_depth == options.only_depth);
+		CHECK(unpacked.use_blinn_phong == options.use_blinn_phong);
+		CHECK(unpacked.use_texture == options.use_texture);
+		CHECK(unpacked.use_lights == options.use_lights);
+		CHECK(unpacked.transparent_cutoff == options.transparent_cutoff);
+		CHECK(unpacked.use_instancing == options.use_instancing);
+		CHECK(unpacked.use_texture_arrays == options.use_texture_arrays);
+		CHECK(unpacked.number_of_directional_lights == options.number_of_directional_lights);
+		CHECK(unpacked.number_of_point_lights == options.number_of_point_lights);
+		CHECK(unpacked.number_of_frustum_lights == options.number_of_frustum_lights);
+	}
+
+	CHECK(key_from_shader_options(lit) != key_from_shader_options(lit.with_instanced_mat4()));
+	CHECK(describe_shader_options(lit.with_transparent_cutoff().with_instanced_mat4()) == "lit textured cutoff instanced");
+}
+
+TEST_CASE("shader_manifest_roundtrip", "[shader]")
+{
+	const auto dir = std::filesystem::temp_directory_path() / "klotter-shader-manifest-test";
+	std::filesystem::remove_all(dir);
+	const auto path = dir / "permutations.txt";
+
+	CHECK(load_shader_manifest(path).empty());
+
+	const auto keys = std::vector<ShaderPermutationKey>{0, 0x12345678, 0xFFFFFFFF, 42};
+	REQUIRE(save_shader_manifest(path, keys));
+	CHECK(load_shader_manifest(path) == keys);
+
+	{
+		std::ofstream file{path, std::ios::trunc};
+		file << "not a manifest\n12\n";
+	}
+	CHECK(load_shader_manifest(path).empty());
+}
@@ -1,22 +1,28 @@
 ﻿#include "klotter/render/shader_resource.h"
 
 #include "klotter/assert.h"
+#include "klotter/cint.h"
 #include "klotter/cpp.h"
 #include "klotter/feature_flags.h"
+#include "klotter/log.h"
 #include "klotter/str.h"
 
 #include "klotter/render/camera.h"
 #include "klotter/render/constants.h"
+#include "klotter/render/draw.block.h"
 #include "klotter/render/fullscreen.h"
+#include "klotter/render/material.block.h"
 #include "klotter/render/render_settings.h"
 #include "klotter/render/shader.h"
 #include "klotter/render/shader.source.h"
 
+#include "pp.bloom_downsample.frag.glsl.h"
+#include "pp.bloom_upsample.frag.glsl.h"
 #include "pp.blur.frag.glsl.h"
-#include "pp.damage.frag.glsl.h"
+#include "pp.damage.effect.glsl.h"
 #include "pp.extract.frag.glsl.h"
-#include "pp.grayscale.frag.glsl.h"
-#include "pp.invert.frag.glsl.h"
+#include "pp.grayscale.effect.glsl.h"
+#include "pp.invert.effect.glsl.h"
 #include "pp.ping_pong_blur.frag.glsl.h"
 #include "pp.realize.frag.glsl.h"
 #include "pp.vert.glsl.h"
@@ -27,6 +33,15 @@ namespace klotter
 
 
 
+/// instanced shaders get the transform from a attribute and don't have the draw block
+void setup_draw_block(ShaderProgram* program, TransformSource model_source)
+{
+	if (model_source == TransformSource::Uniform)
+	{
+		program->setup_uniform_block(get_draw_block_layout().setup);
+	}
+}
+
 void CameraUniformBuffer::set_props(const CompiledCamera& cc) // NOLINT(readability-make-member-function-const)
 {
 	buffer->set_mat4(clip_from_view_uni, cc.clip_from_view);
@@ -40,10 +55,10 @@ LoadedShader_SingleColor::LoadedShader_SingleColor(
 )
 	: program(std::move(p))
 	, geom_layout(std::move(l))
-	, tint_color_uni(program->get_uniform("u_material.diffuse_tint"))
-	, world_from_local_uni(program->get_uniform("u_world_from_local"))
 {
 	program->setup_uniform_block(desc.setup);
+	program->setup_uniform_block(get_material_block_layout().setup);
+	program->setup_uniform_block(get_draw_block_layout().setup);
 }
 
 
@@ -53,7 +68,7 @@ LoadedShader_Skybox::LoadedShader_Skybox(
 )
 	: program(std::move(p))
 	, geom_layout(std::move(l))
-	, tex_skybox_uniform(program->get_uniform("u_skybox_tex"))
+	, tex_skybox_uniform(program->get_uniform("u_skybox_tex", UniformKind::texture))
 {
 	setup_textures(program.get(), {&tex_skybox_uniform});
 	program->setup_uniform_block(desc.setup);
@@ -67,12 +82,9 @@ LoadedShader_OnlyDepth::LoadedShader_OnlyDepth(
 )
 	: program(std::move(p))
 	, geom_layout(std::move(l))
-	, world_from_local_uni(
-		  model_source == TransformSource::Uniform ? std::optional<Uniform>{program->get_uniform("u_world_from_local")}
-												   : std::nullopt
-	  )
 {
 	program->setup_uniform_block(desc.setup);
+	setup_draw_block(program.get(), model_source);
 }
 
 LoadedShader_Unlit::LoadedShader_Unlit(
@@ -81,44 +93,42 @@ LoadedShader_Unlit::LoadedShader_Unlit(
 	const CameraUniformBuffer& desc
 )
 	: program(std::move(p))
-	, tint_color_uni(program->get_uniform("u_material.diffuse_tint"))
-	, tex_diffuse_uniform(program->get_uniform("u_material.diffuse_tex"))
-	, world_from_local_uni(
-		  model_source == TransformSource::Uniform ? std::optional<Uniform>{program->get_uniform("u_world_from_local")} : std::nullopt
-	  )
+	, tex_diffuse_uniform(program->get_uniform("u_diffuse_tex", UniformKind::texture))
 {
 	setup_textures(program.get(), {&tex_diffuse_uniform});
 	program->setup_uniform_block(desc.setup);
+	program->setup_uniform_block(get_material_block_layout().setup);
+	setup_draw_block(program.get(), model_source);
 }
 
 
 
-DirectionalLightUniforms::DirectionalLightUniforms(const ShaderProgram* program, const std::string& base)
-	: light_diffuse_color_uni(program->get_uniform(base + "diffuse"))
-	, light_specular_color_uni(program->get_uniform(base + "specular"))
-	, dir_uni(program->get_uniform(base + "dir"))
+DirectionalLightUniforms::DirectionalLightUniforms(const ShaderProgram* program, std::string_view array, std::size_t index)
+	: light_diffuse_color_uni(program->get_uniform(array, index, "diffuse", UniformKind::vec3))
+	, light_specular_color_uni(program->get_uniform(array, index, "specular", UniformKind::vec3))
+	, dir_uni(program->get_uniform(array, index, "dir", UniformKind::vec3))
 {
 }
 
 
 
-PointLightUniforms::PointLightUniforms(const ShaderProgram* program, const std::string& base)
-	: light_diffuse_color_uni(program->get_uniform(base + "diffuse"))
-	, light_specular_color_uni(program->get_uniform(base + "specular"))
-	, light_attenuation_uni(program->get_uniform(base + "attenuation"))
-	, light_world_uni(program->get_uniform(base + "world_pos"))
+PointLightUniforms::PointLightUniforms(const ShaderProgram* program, std::string_view array, std::size_t index)
+	: light_diffuse_color_uni(program->get_uniform(array, index, "diffuse", UniformKind::vec3))
+	, light_specular_color_uni(program->get_uniform(array, index, "specular", UniformKind::vec3))
+	, light_attenuation_uni(program->get_uniform(array, index, "attenuation", UniformKind::vec4))
+	, light_world_uni(program->get_uniform(array, index, "world_pos", UniformKind::vec3))
 {
 }
 
 
 
-FrustumLightUniforms::FrustumLightUniforms(const ShaderProgram* program, const std::string& base)
-	: diffuse_uni(program->get_uniform(base + "diffuse"))
-	, specular_uni(program->get_uniform(base + "specular"))
-	, attenuation_uni(program->get_uniform(base + "attenuation"))
-	, clip_from_world_uni(program->get_uniform(base + "clip_from_world"))
-	, world_pos_uni(program->get_uniform(base + "world_pos"))
-	, tex_cookie_uniform(program->get_uniform(base + "cookie"))
+FrustumLightUniforms::FrustumLightUniforms(const ShaderProgram* program, std::string_view array, std::size_t index)
+	: diffuse_uni(program->get_uniform(array, index, "diffuse", UniformKind::vec3))
+	, specular_uni(program->get_uniform(array, index, "specular", UniformKind::vec3))
+	, attenuation_uni(program->get_uniform(array, index, "attenuation", UniformKind::vec4))
+	, clip_from_world_uni(program->get_uniform(array, index, "clip_from_world", UniformKind::mat4))
+	, world_pos_uni(program->get_uniform(array, index, "world_pos", UniformKind::vec3))
+	, tex_cookie_uniform(program->get_uniform(array, index, "cookie", UniformKind::texture))
 {
 }
 
@@ -132,12 +142,12 @@ PostProcSetup operator|(PostProcSetup lhs, PostProcSetup rhs)
 
 
 std::optional<Uniform> get_uniform(
-	ShaderProgram& prog, const std::string& name, PostProcSetup setup, PostProcSetup flag
+	ShaderProgram& prog, const std::string& name, UniformKind kind, PostProcSetup setup, PostProcSetup flag
 )
 {
 	if (is_flag_set(setup, flag))
 	{
-		return prog.get_uniform(name);
+		return prog.get_uniform(name, kind);
 	}
 	else
 	{
@@ -147,12 +157,15 @@ std::optional<Uniform> get_uniform(
 
 
 
-LoadedPostProcShader::LoadedPostProcShader(std::shared_ptr<ShaderProgram> s, PostProcSetup setup)
+LoadedPostProcShader::LoadedPostProcShader(std::shared_ptr<ShaderProgram> s, PostProcSetup se, std::optional<PerPixelEffectSource> pp)
 	: program(std::move(s))
-	, tex_input_uniform(program->get_uniform("u_texture"))
-	, factor_uni(get_uniform(*program, "u_factor", setup, PostProcSetup::factor))
-	, resolution_uni(get_uniform(*program, "u_resolution", setup, PostProcSetup::resolution))
-	, time_uni(get_uniform(*program, "u_time", setup, PostProcSetup::time))
+	, setup(se)
+	, tex_input_uniform(program->get_uniform("u_texture", UniformKind::texture))
+	, factor_uni(get_uniform(*program, "u_factor", UniformKind::float_type, setup, PostProcSetup::factor))
+	, resolution_uni(get_uniform(*program, "u_resolution", UniformKind::vec2, setup, PostProcSetup::resolution))
+	, time_uni(get_uniform(*program, "u_time", UniformKind::float_type, setup, PostProcSetup::time))
+	, uv_scale_uni(get_uniform(*program, "u_uv_scale", UniformKind::vec2, setup, PostProcSetup::uv_scale))
+	, per_pixel(std::move(pp))
 {
 	setup_textures(program.get(), {&tex_input_uniform});
 }
@@ -166,38 +179,27 @@ LoadedShader_Default::LoadedShader_Default(
 	const CameraUniformBuffer& desc
 )
 	: program(std::move(p))
-	, tint_color_uni(program->get_uniform("u_material.diffuse_tint"))
-	, tex_directional_light_depth_uni(program->get_uniform("u_directional_light_depth_tex"))
-	, directional_shadow_clip_from_world_uni(program->get_uniform("u_directional_shadow_clip_from_world"))
-	, tex_diffuse_uniform(program->get_uniform("u_material.diffuse_tex"))
-	, tex_specular_uniform(program->get_uniform("u_material.specular_tex"))
-	, tex_emissive_uniform(program->get_uniform("u_material.emissive_tex"))
-	, ambient_tint_uni(program->get_uniform("u_material.ambient_tint"))
-	, specular_color_uni(program->get_uniform("u_material.specular_tint"))
-	, shininess_uni(program->get_uniform("u_material.shininess"))
-	, emissive_factor_uni(program->get_uniform("u_material.emissive_factor"))
-	, world_from_local_uni(
-		  model_source == TransformSource::Uniform ? std::optional<Uniform>{program->get_uniform("u_world_from_local")} : std::nullopt
-	  )
-	, view_position_uni(program->get_uniform("u_view_position"))
-	, light_ambient_color_uni(program->get_uniform("u_ambient_light"))
+	, tex_directional_light_depth_uni(program->get_uniform("u_directional_light_depth_tex", UniformKind::texture))
+	, directional_shadow_clip_from_world_uni(program->get_uniform("u_directional_shadow_clip_from_world", UniformKind::mat4))
+	, tex_diffuse_uniform(program->get_uniform("u_diffuse_tex", UniformKind::texture))
+	, tex_specular_uniform(program->get_uniform("u_specular_tex", UniformKind::texture))
+	, tex_emissive_uniform(program->get_uniform("u_emissive_tex", UniformKind::texture))
+	, view_position_uni(program->get_uniform("u_view_position", UniformKind::vec3))
+	, light_ambient_color_uni(program->get_uniform("u_ambient_light", UniformKind::vec3))
 {
 	for (int index = 0; index < settings.number_of_directional_lights; index += 1)
 	{
-		const std::string base = Str{} << "u_directional_lights[" << index << "].";
-		directional_lights.emplace_back(program.get(), base);
+		directional_lights.emplace_back(program.get(), "u_directional_lights", sizet_from_int(index));
 	}
 
 	for (int index = 0; index < settings.number_of_point_lights; index += 1)
 	{
-		const std::string base = Str{} << "u_point_lights[" << index << "].";
-		point_lights.emplace_back(program.get(), base);
+		point_lights.emplace_back(program.get(), "u_point_lights", sizet_from_int(index));
 	}
 
 	for (int index = 0; index < settings.number_of_frustum_lights; index += 1)
 	{
-		const std::string base = Str{} << "u_frustum_lights[" << index << "].";
-		frustum_lights.emplace_back(program.get(), base);
+		frustum_lights.emplace_back(program.get(), "u_frustum_lights", sizet_from_int(index));
 	}
 
 	std::vector<Uniform*> textures = {&tex_directional_light_depth_uni, &tex_diffuse_uniform, &tex_specular_uniform, &tex_emissive_uniform};
@@ -208,33 +210,40 @@ LoadedShader_Default::LoadedShader_Default(
 
 	setup_textures(program.get(), textures);
 	program->setup_uniform_block(desc.setup);
+	program->setup_uniform_block(get_material_block_layout().setup);
+	setup_draw_block(program.get(), model_source);
 }
 
 
 
 bool LoadedShader_Unlit_Container::is_loaded() const
 {
-	return default_shader.program->is_loaded() && transparency_shader.program->is_loaded();
+	return permutations->is_loaded();
 }
 
 
 
+ShaderOptions options_from_context(ShaderOptions options, const RenderContext& rc, UseTextureArrays use_texture_arrays)
+{
+	// solid meshes discard transparent pixels, transparent meshes are blended
+	options.transparent_cutoff = rc.use_transparency == UseTransparency::no;
+	options.use_instancing = rc.model_source == TransformSource::Instanced_mat4;
+	options.use_texture_arrays = use_texture_arrays == UseTextureArrays::yes;
+	return options;
+}
+
 const LoadedShader_Unlit& shader_from_container(const LoadedShader_Unlit_Container& container, const RenderContext& rc)
 {
-	return rc.use_transparency == UseTransparency::yes ? container.transparency_shader : container.default_shader;
+	return container.permutations->get_unlit(options_from_context(container.options, rc, UseTextureArrays::no));
 }
 
-const LoadedShader_Default& shader_from_container(const LoadedShader_Default_Container& container, const RenderContext& rc)
+const LoadedShader_Default& shader_from_container(
+	const LoadedShader_Default_Container& container, const RenderContext& rc, UseTextureArrays use_texture_arrays
+)
 {
-	switch (rc.model_source)
-	{
-	case TransformSource::Uniform:
-		return rc.use_transparency == UseTransparency::yes ? container.transparency_shader : container.default_shader;
-	case TransformSource::Instanced_mat4:
-		assert(rc.use_transparency == UseTransparency::no);	 // not currently supporting instanced transparency
-		return container.default_shader_instance;
-	default: assert(false && "unhandled"); return container.default_shader;
-	}
+	// not currently supporting instanced transparency
+	assert(rc.model_source != TransformSource::Instanced_mat4 || rc.use_transparency == UseTransparency::no);
+	return container.permutations->get_default(options_from_context(container.options, rc, use_texture_arrays));
 }
 
 
@@ -242,36 +251,50 @@ const LoadedShader_Default& shader_from_container(const LoadedShader_Default_Con
 
 bool LoadedShader_Default_Container::is_loaded() const
 {
-	return default_shader.program->is_loaded() && transparency_shader.program->is_loaded();
+	return permutations->is_loaded();
 }
 
 
 
+RealizeUniforms::RealizeUniforms(const ShaderProgram& program)
+	: tex_blurred_bloom_uniform(program.get_uniform("u_blurred_bloom", UniformKind::texture))
+	, use_blur_uniform(program.get_uniform("u_use_blur", UniformKind::bool_type))
+	, gamma_uniform(program.get_uniform("u_gamma", UniformKind::float_type))
+	, exposure_uniform(program.get_uniform("u_exposure", UniformKind::float_type))
+	, uv_scale_uniform(program.get_uniform("u_uv_scale", UniformKind::vec2))
+{
+}
 
 RealizeShader::RealizeShader(std::shared_ptr<ShaderProgram> s)
 	: program(std::move(s))
-	, tex_input_uniform(program->get_uniform("u_texture"))
-	, tex_blurred_bloom_uniform(program->get_uniform("u_blurred_bloom"))
-	, use_blur_uniform(program->get_uniform("u_use_blur"))
-	, gamma_uniform(program->get_uniform("u_gamma"))
-	, exposure_uniform(program->get_uniform("u_exposure"))
+	, tex_input_uniform(program->get_uniform("u_texture", UniformKind::texture))
+	, realize(*program)
 {
-	setup_textures(program.get(), {&tex_input_uniform, &tex_blurred_bloom_uniform});
+	setup_textures(program.get(), {&tex_input_uniform, &realize.tex_blurred_bloom_uniform});
 }
 
 
 
 ExtractShader::ExtractShader(std::shared_ptr<LoadedPostProcShader>&& sh)
 	: shader(std::move(sh))
-	, cutoff_uniform(shader->program->get_uniform("u_cutoff"))
-	, softness_uniform(shader->program->get_uniform("u_softness"))
+	, cutoff_uniform(shader->program->get_uniform("u_cutoff", UniformKind::float_type))
+	, softness_uniform(shader->program->get_uniform("u_softness", UniformKind::float_type))
+{
+}
+
+BloomDownsampleShader::BloomDownsampleShader(std::shared_ptr<LoadedPostProcShader>&& sh)
+	: shader(std::move(sh))
+	, use_karis_average_uniform(shader->program->get_uniform("u_use_karis_average", UniformKind::bool_type))
 {
 }
 
-PingPongBlurShader::PingPongBlurShader(std::shared_ptr<LoadedPostProcShader>&& sh)
+BloomUpsampleShader::BloomUpsampleShader(std::shared_ptr<LoadedPostProcShader>&& sh)
 	: shader(std::move(sh))
-	, is_horizontal_uniform(shader->program->get_uniform("u_is_horizontal"))
+	, tex_current_uniform(shader->program->get_uniform("u_current", UniformKind::texture))
+	, filter_radius_uniform(shader->program->get_uniform("u_filter_radius", UniformKind::float_type))
+	, weight_uniform(shader->program->get_uniform("u_weight", UniformKind::float_type))
 {
+	setup_textures(shader->program.get(), {&shader->tex_input_uniform, &tex_current_uniform});
 }
 
 
@@ -288,7 +311,11 @@ bool ShaderResource::is_loaded() const
 		&& pp_grayscale->program->is_loaded()
 		&& pp_blurv->program->is_loaded()
 		&& pp_blurh->program->is_loaded()
-		&& pp_realize.program->is_loaded();
+		&& pp_realize.program->is_loaded()
+		&& pp_ping.horizontal->program->is_loaded()
+		&& pp_ping.vertical->program->is_loaded()
+		&& pp_bloom_downsample.shader->program->is_loaded()
+		&& pp_bloom_upsample.shader->program->is_loaded();
 }
 
 
@@ -330,18 +357,16 @@ struct LoadedShader
 	CompiledGeomVertexAttributes geom_layout;
 };
 
-std::optional<int> get_instance_start_index(const LoadedShader* shader)
+std::optional<int> get_instance_start_index(const CompiledGeomVertexAttributes* layout)
 {
-	if (shader == nullptr)
+	if (layout == nullptr)
 	{
 		return std::nullopt;
 	}
 
-	const CompiledGeomVertexAttributes& layout = shader->geom_layout;
-
 	int max = 0;
 
-	for (const auto& entry: layout.elements)
+	for (const auto& entry: layout->elements)
 	{
 		max = std::max(entry.index, max);
 	}
@@ -349,7 +374,19 @@ std::optional<int> get_instance_start_index(const LoadedShader* shader)
 	return max + 1;
 }
 
-LoadedShader load_shader(DEBUG_LABEL_ARG_MANY const BaseShaderData& base_layout, const ShaderSource_withLayout& source, TransformSource model_source, const LoadedShader* instance_base = nullptr)
+CompiledGeomVertexAttributes geom_layout_from_options(const BaseShaderData& base_layout, const ShaderOptions& options)
+{
+	return get_geom_layout(compile_attribute_layouts(base_layout, {layout_from_options(options)}));
+}
+
+LoadedShader load_shader(
+	DEBUG_LABEL_ARG_MANY
+	ShaderCompiler* compiler,
+	const BaseShaderData& base_layout,
+	const ShaderSource_withLayout& source,
+	TransformSource model_source,
+	const CompiledGeomVertexAttributes* instance_base = nullptr
+)
 {
 	auto layout_compiler = compile_attribute_layouts(base_layout, {source.layout});
 	const auto geom_layout = get_geom_layout(layout_compiler);
@@ -368,21 +405,253 @@ LoadedShader load_shader(DEBUG_LABEL_ARG_MANY const BaseShaderData& base_layout,
 
 	const auto compiled_layout = compile_shader_layout(layout_compiler, source.layout, instance_prop, start_index);
 
-	auto program = std::make_shared<ShaderProgram>(USE_DEBUG_LABEL_MANY(debug_label) source.vertex, source.fragment, compiled_layout);
+	auto program = compiler->add(USE_DEBUG_LABEL_MANY(debug_label) source.vertex, source.fragment, compiled_layout);
 
 	return {program, geom_layout};
 }
 
 
 
-ShaderResource load_shaders(const CameraUniformBuffer& desc, const RenderSettings& settings, const FullScreenGeom& full_screen)
+std::shared_ptr<ShaderProgram> add_per_pixel_effect(
+	DEBUG_LABEL_ARG_MANY ShaderCompiler* compiler, const PerPixelEffectSource& effect, const FullScreenGeom& full_screen
+)
+{
+	return compiler->add(
+		SEND_DEBUG_LABEL_MANY(debug_label)
+		std::string{PP_VERT_GLSL}, generate_post_proc_effects(PP_REALIZE_FRAG_GLSL, {false, {effect}}), full_screen.layout
+	);
+}
+
+ShaderPermutationCache::ShaderPermutationCache(
+	const CameraUniformBuffer* d, const RenderSettings& s, std::vector<VertexType> base, const ShaderCache* c
+)
+	: desc(d)
+	, settings(s)
+	, base_layout(std::move(base))
+	, cache(c)
+{
+}
+
+ShaderPermutationCache::~ShaderPermutationCache()
+{
+	finish_prewarm();
+}
+
+const LoadedShader_Unlit& ShaderPermutationCache::get_unlit(const ShaderOptions& options)
+{
+	ASSERT(options.use_lights == false);
+	const auto& permutation = get(options);
+	ASSERT(permutation.unlit);
+	return *permutation.unlit;
+}
+
+const LoadedShader_Default& ShaderPermutationCache::get_default(const ShaderOptions& options)
+{
+	ASSERT(options.use_lights);
+	const auto& permutation = get(options);
+	ASSERT(permutation.lit);
+	return *permutation.lit;
+}
+
+const ShaderPermutationCache::Permutation& ShaderPermutationCache::get(const ShaderOptions& options)
+{
+	const auto key = key_from_shader_options(options);
+	auto& permutation = load(key, options);
+
+	// record on first use and not on compile, so prewarmed permutations that are used are saved in the manifest again
+	if (permutation.is_used == false)
+	{
+		permutation.is_used = true;
+		used_keys.emplace_back(key);
+	}
+	return permutation;
+}
+
+ShaderPermutationCache::Permutation& ShaderPermutationCache::load(ShaderPermutationKey key, const ShaderOptions& options)
+{
+	if (const auto found = permutations.find(key); found != permutations.end() && (found->second.unlit || found->second.lit))
+	{
+		return found->second;
+	}
+
+	// the permutation was requested before the prewarm finished, so wait for it instead of compiling it again
+	if (std::find(prewarm_keys.begin(), prewarm_keys.end(), key) != prewarm_keys.end())
+	{
+		finish_prewarm();
+		return permutations[key];
+	}
+
+	LOG_INFO("Compiling shader %s on first use", describe_shader_options(options).c_str());
+	ShaderCompiler compiler{cache};
+	submit(&compiler, key, load_shader_source(options, desc->setup.source));
+	compiler.finish();
+	create_shaders(key);
+	return permutations[key];
+}
+
+void ShaderPermutationCache::submit(ShaderCompiler* compiler, ShaderPermutationKey key, const ShaderSource_withLayout& source)
+{
+	const auto options = shader_options_from_key(key);
+	auto loaded = load_shader(
+		USE_DEBUG_LABEL_MANY(describe_shader_options(options))
+		compiler, base_layout, source, options.use_instancing ? TransformSource::Instanced_mat4 : TransformSource::Uniform
+	);
+	permutations[key].program = std::move(loaded.program);
+}
+
+void ShaderPermutationCache::create_shaders(ShaderPermutationKey key)
+{
+	// the wrappers query uniforms so the program needs to be finished
+	auto& permutation = permutations[key];
+	const auto options = shader_options_from_key(key);
+	const auto model_source = options.use_instancing ? TransformSource::Instanced_mat4 : TransformSource::Uniform;
+	if (options.use_lights)
+	{
+		permutation.lit = std::make_unique<LoadedShader_Default>(
+			model_source,
+			permutation.program,
+			settings,
+			*desc
+		);
+	}
+	else
+	{
+		permutation.unlit = std::make_unique<LoadedShader_Unlit>(model_source, permutation.program, *desc);
+	}
+}
+
+void ShaderPermutationCache::prewarm(const std::vector<ShaderPermutationKey>& keys)
+{
+	finish_prewarm();
+
+	std::vector<ShaderOptions> options;
+	for (const auto key: keys)
+	{
+		const auto o = shader_options_from_key(key);
+		const auto is_compiled = permutations.find(key) != permutations.end();
+		const auto is_duplicate = std::find(prewarm_keys.begin(), prewarm_keys.end(), key) != prewarm_keys.end();
+
+		// a manifest from a run with other settings might list permutations that can't be requested
+		const auto matches_settings = o.use_lights == false
+			|| (o.number_of_directional_lights == settings.number_of_directional_lights
+				&& o.number_of_point_lights == settings.number_of_point_lights
+				&& o.number_of_frustum_lights == settings.number_of_frustum_lights);
+
+		if (is_compiled || is_duplicate || matches_settings == false || o.only_depth)
+		{
+			continue;
+		}
+
+		prewarm_keys.emplace_back(key);
+		options.emplace_back(o);
+	}
+
+	if (prewarm_keys.empty())
+	{
+		return;
+	}
+
+	LOG_INFO("Prewarming %d shader permutations", int_from_sizet(prewarm_keys.size()));
+	is_prewarm_loading = true;
+	get_job_system().run(
+		[this, options, source = desc->setup.source]() { prewarm_sources = load_shader_sources(options, source); },
+		&prewarm_loading
+	);
+}
+
+void ShaderPermutationCache::update()
+{
+	if (is_prewarm_loading && prewarm_loading.is_done())
+	{
+		submit_prewarm_sources();
+	}
+
+	if (prewarm_compiler && prewarm_compiler->finish_ready())
+	{
+		complete_prewarm();
+	}
+}
+
+void ShaderPermutationCache::submit_prewarm_sources()
 {
-	const auto single_color_shader = load_shader_source({}, desc.setup.source);
+	get_job_system().wait(&prewarm_loading);
+	is_prewarm_loading = false;
+	const auto sources = std::move(prewarm_sources);
+	prewarm_sources.clear();
+	ASSERT(sources.size() == prewarm_keys.size());
+
+	prewarm_compiler = std::make_unique<ShaderCompiler>(cache);
+	for (std::size_t index = 0; index < sources.size(); index += 1)
+	{
+		submit(prewarm_compiler.get(), prewarm_keys[index], sources[index]);
+	}
+}
 
+void ShaderPermutationCache::complete_prewarm()
+{
+	for (const auto key: prewarm_keys)
+	{
+		create_shaders(key);
+	}
+	prewarm_keys.clear();
+	prewarm_compiler.reset();
+}
+
+void ShaderPermutationCache::finish_prewarm()
+{
+	if (is_prewarm_loading)
+	{
+		submit_prewarm_sources();
+	}
+
+	if (prewarm_compiler)
+	{
+		prewarm_compiler->finish();
+		complete_prewarm();
+	}
+}
+
+const std::vector<ShaderPermutationKey>& ShaderPermutationCache::get_used_keys() const
+{
+	return used_keys;
+}
+
+bool ShaderPermutationCache::is_loaded() const
+{
+	return std::all_of(
+		permutations.begin(),
+		permutations.end(),
+		[](const auto& entry) { return entry.second.program->is_loaded(); }
+	);
+}
+
+int ShaderPermutationCache::get_compiled_count() const
+{
+	return int_from_sizet(permutations.size());
+}
+
+ShaderResource load_shaders(
+	const CameraUniformBuffer& desc, const RenderSettings& settings, const FullScreenGeom& full_screen, const ShaderCache* cache
+)
+{
 	ShaderOptions depth_shader_options;
 	depth_shader_options.only_depth = true;
-	const auto depth_transform_uniform = load_shader_source(depth_shader_options, desc.setup.source);
-	const auto depth_transform_instanced_mat4 = load_shader_source(depth_shader_options.with_instanced_mat4(), desc.setup.source);
+
+	ShaderOptions unlit_shader_options;
+	unlit_shader_options.use_texture = true;
+
+	ShaderOptions default_shader_options;
+	default_shader_options.use_lights = true;
+	default_shader_options.use_texture = true;
+	default_shader_options.number_of_directional_lights = settings.number_of_directional_lights;
+	default_shader_options.number_of_point_lights = settings.number_of_point_lights;
+	default_shader_options.number_of_frustum_lights = settings.number_of_frustum_lights;
+
+	// the shaders that are always used are generated at once, the unlit and default shaders are compiled on first use
+	const auto sources = load_shader_sources({{}, depth_shader_options, depth_shader_options.with_instanced_mat4()}, desc.setup.source);
+	const auto& single_color_shader = sources[0];
+	const auto& depth_transform_uniform = sources[1];
+	const auto& depth_transform_instanced_mat4 = sources[2];
 
 	const auto skybox_source = load_skybox_source(desc.setup.source);
 	const auto skybox_shader = ShaderSource_withLayout{
@@ -396,72 +665,18 @@ ShaderResource load_shaders(const CameraUniformBuffer& desc, const RenderSetting
 			&depth_transform_instanced_mat4.layout
 		});
 
-	ShaderOptions unlit_shader_options;
-	unlit_shader_options.use_texture = true;
+	const auto unlit_geom_layout = geom_layout_from_options(global_shader_data, unlit_shader_options);
+	const auto default_geom_layout = geom_layout_from_options(global_shader_data, default_shader_options);
 
-	ShaderOptions default_shader_options;
-	default_shader_options.use_lights = true;
-	default_shader_options.use_texture = true;
-	default_shader_options.number_of_directional_lights = settings.number_of_directional_lights;
-	default_shader_options.number_of_point_lights = settings.number_of_point_lights;
-	default_shader_options.number_of_frustum_lights = settings.number_of_frustum_lights;
+	// submit everything before checking any status so the driver can compile in parallel
+	ShaderCompiler compiler{cache};
 
-	auto loaded_unlit = load_shader(
-		USE_DEBUG_LABEL_MANY("unlit")
-		global_shader_data,
-		load_shader_source(unlit_shader_options.with_transparent_cutoff(), desc.setup.source),
-		TransformSource::Uniform
-	);
-	auto loaded_default = load_shader(
-		USE_DEBUG_LABEL_MANY("default")
-		global_shader_data,
-		load_shader_source(default_shader_options.with_transparent_cutoff(), desc.setup.source),
-		TransformSource::Uniform
-	);
-	auto loaded_default_instanced = load_shader(
-		USE_DEBUG_LABEL_MANY("default instanced")
-		global_shader_data,
-		load_shader_source(default_shader_options.with_transparent_cutoff().with_instanced_mat4(), desc.setup.source),
-		TransformSource::Instanced_mat4
-	);
-
-	auto loaded_unlit_transparency = load_shader(
-		USE_DEBUG_LABEL_MANY("unlit transparency")
-		global_shader_data, load_shader_source(unlit_shader_options, desc.setup.source), TransformSource::Uniform
-	);
-	auto loaded_default_transparency = load_shader(
-		USE_DEBUG_LABEL_MANY("default transparency")
-		global_shader_data, load_shader_source(default_shader_options, desc.setup.source), TransformSource::Uniform
-	);
-
-	// todo(Gustav): should the asserts here be runtime errors? currently all setups are compile-time...
-	assert(loaded_unlit.geom_layout.debug_types == loaded_unlit_transparency.geom_layout.debug_types);
-	assert(loaded_default.geom_layout.debug_types == loaded_default_transparency.geom_layout.debug_types);
-	assert(
-		loaded_default.geom_layout.debug_types == loaded_default_instanced.geom_layout.debug_types
-	);	// is this valid? should this fail?
-
-	auto pp_invert = std::make_shared<LoadedPostProcShader>(
-		std::make_shared<ShaderProgram>(
-			USE_DEBUG_LABEL_MANY("pp invert")
-			std::string{PP_VERT_GLSL}, std::string{PP_INVERT_FRAG_GLSL}, full_screen.layout
-		),
-		PostProcSetup::factor
-	);
-	auto pp_grayscale = std::make_shared<LoadedPostProcShader>(
-		std::make_shared<ShaderProgram>(
-			USE_DEBUG_LABEL_MANY("pp grayscale")
-			std::string{PP_VERT_GLSL}, std::string{PP_GRAYSCALE_FRAG_GLSL}, full_screen.layout
-		),
-		PostProcSetup::factor
-	);
-	auto pp_damage = std::make_shared<LoadedPostProcShader>(
-		std::make_shared<ShaderProgram>(
-			USE_DEBUG_LABEL_MANY("pp damage")
-			std::string{PP_VERT_GLSL}, std::string{PP_DAMAGE_FRAG_GLSL}, full_screen.layout
-		),
-		PostProcSetup::factor | PostProcSetup::resolution | PostProcSetup::time
-	);
+	const auto invert_effect = PerPixelEffectSource{"invert", PP_INVERT_EFFECT_GLSL, std::string{standalone_effect_prefix}};
+	const auto grayscale_effect = PerPixelEffectSource{"grayscale", PP_GRAYSCALE_EFFECT_GLSL, std::string{standalone_effect_prefix}};
+	const auto damage_effect = PerPixelEffectSource{"damage", PP_DAMAGE_EFFECT_GLSL, std::string{standalone_effect_prefix}};
+	auto pp_invert_program = add_per_pixel_effect(USE_DEBUG_LABEL_MANY("pp invert") &compiler, invert_effect, full_screen);
+	auto pp_grayscale_program = add_per_pixel_effect(USE_DEBUG_LABEL_MANY("pp grayscale") &compiler, grayscale_effect, full_screen);
+	auto pp_damage_program = add_per_pixel_effect(USE_DEBUG_LABEL_MANY("pp damage") &compiler, damage_effect, full_screen);
 
 	constexpr IsGauss use_gauss =
 #if FF_HAS(BLUR_USE_GAUSS)
@@ -471,57 +686,85 @@ ShaderResource load_shaders(const CameraUniformBuffer& desc, const RenderSetting
 #endif
 		;
 
-	auto pp_blurv = std::make_shared<LoadedPostProcShader>(
-		std::make_shared<ShaderProgram>(
-			USE_DEBUG_LABEL_MANY("pp blur vert")
-			std::string{PP_VERT_GLSL},
-			generate_blur(PP_BLUR_FRAG_GLSL, {BlurType::vertical, BLUR_SAMPLES, use_gauss}),
-			full_screen.layout
-		),
-		PostProcSetup::factor
+	auto pp_blurv_program = compiler.add(
+		USE_DEBUG_LABEL_MANY("pp blur vert")
+		std::string{PP_VERT_GLSL},
+		generate_blur(PP_BLUR_FRAG_GLSL, {BlurType::vertical, BLUR_SAMPLES, use_gauss}),
+		full_screen.layout
 	);
-	auto pp_blurh = std::make_shared<LoadedPostProcShader>(
-		std::make_shared<ShaderProgram>(
-			USE_DEBUG_LABEL_MANY("pp blur hor")
-			std::string{PP_VERT_GLSL},
-			generate_blur(PP_BLUR_FRAG_GLSL, {BlurType::horizontal, BLUR_SAMPLES, use_gauss}),
-			full_screen.layout
-		),
-		PostProcSetup::factor | PostProcSetup::resolution
+	auto pp_blurh_program = compiler.add(
+		USE_DEBUG_LABEL_MANY("pp blur hor")
+		std::string{PP_VERT_GLSL},
+		generate_blur(PP_BLUR_FRAG_GLSL, {BlurType::horizontal, BLUR_SAMPLES, use_gauss}),
+		full_screen.layout
 	);
 
-	auto pp_realize = RealizeShader{std::make_shared<ShaderProgram>(
-			USE_DEBUG_LABEL_MANY("pp realize")
-			std::string{PP_VERT_GLSL}, std::string{PP_REALIZE_FRAG_GLSL}, full_screen.layout
-		)};
-	auto pp_extract = ExtractShader{std::make_shared<LoadedPostProcShader>(
-		std::make_shared<ShaderProgram>(
-			USE_DEBUG_LABEL_MANY("pp extract") std::string{PP_VERT_GLSL},
-			std::string{PP_EXTRACT_FRAG_GLSL},
-			full_screen.layout
-		),
-		PostProcSetup::none
-	)};
-	auto pp_ping = PingPongBlurShader{std::make_shared<LoadedPostProcShader>(
-		std::make_shared<ShaderProgram>(
-			USE_DEBUG_LABEL_MANY("pp ping-pong") std::string{PP_VERT_GLSL},
-			std::string{PP_PING_PONG_BLUR_FRAG_GLSL},
+	auto pp_realize_program = compiler.add(
+		USE_DEBUG_LABEL_MANY("pp realize")
+		std::string{PP_VERT_GLSL}, generate_post_proc_effects(PP_REALIZE_FRAG_GLSL, {true, {}}), full_screen.layout
+	);
+	auto pp_extract_program = compiler.add(
+		USE_DEBUG_LABEL_MANY("pp extract") std::string{PP_VERT_GLSL},
+		std::string{PP_EXTRACT_FRAG_GLSL},
+		full_screen.layout
+	);
+	const auto bloom_kernel = calculate_linear_sampled_kernel(calculate_gaussian_kernel(BLOOM_BLUR_SIGMA));
+	const auto add_ping_pong = [&](BlurType blur_type, [[maybe_unused]] std::string_view label)
+	{
+		return compiler.add(
+			USE_DEBUG_LABEL_MANY(Str{} << "pp ping-pong " << label) std::string{PP_VERT_GLSL},
+			generate_blur(PP_PING_PONG_BLUR_FRAG_GLSL, {blur_type, int_from_sizet(bloom_kernel.offsets.size()), IsGauss::yes, bloom_kernel}),
 			full_screen.layout
-		),
-		PostProcSetup::none
-	)};
+		);
+	};
+	auto pp_ping_horizontal_program = add_ping_pong(BlurType::horizontal, "horizontal");
+	auto pp_ping_vertical_program = add_ping_pong(BlurType::vertical, "vertical");
+	auto pp_bloom_downsample_program = compiler.add(
+		USE_DEBUG_LABEL_MANY("pp bloom downsample") std::string{PP_VERT_GLSL},
+		std::string{PP_BLOOM_DOWNSAMPLE_FRAG_GLSL},
+		full_screen.layout
+	);
+	auto pp_bloom_upsample_program = compiler.add(
+		USE_DEBUG_LABEL_MANY("pp bloom upsample") std::string{PP_VERT_GLSL},
+		std::string{PP_BLOOM_UPSAMPLE_FRAG_GLSL},
+		full_screen.layout
+	);
 
 	auto loaded_single_color = load_shader(
-		USE_DEBUG_LABEL_MANY("single color") global_shader_data, single_color_shader, TransformSource::Uniform
+		USE_DEBUG_LABEL_MANY("single color") &compiler, global_shader_data, single_color_shader, TransformSource::Uniform
 	);
 	auto loaded_depth_transform_uniform = load_shader(
-		USE_DEBUG_LABEL_MANY("depth transform uniform") global_shader_data, depth_transform_uniform, TransformSource::Uniform
+		USE_DEBUG_LABEL_MANY("depth transform uniform") &compiler, global_shader_data, depth_transform_uniform, TransformSource::Uniform
 	);
 	auto loaded_depth_transform_instanced_mat4 = load_shader(
-		USE_DEBUG_LABEL_MANY("depth transform instanced") global_shader_data, depth_transform_instanced_mat4, TransformSource::Instanced_mat4, &loaded_default_instanced
+		USE_DEBUG_LABEL_MANY("depth transform instanced")
+		&compiler, global_shader_data, depth_transform_instanced_mat4, TransformSource::Instanced_mat4, &default_geom_layout
 	);
 	auto loaded_skybox_shader
-		= load_shader(USE_DEBUG_LABEL_MANY("skybox"){}, skybox_shader, TransformSource::Uniform);
+		= load_shader(USE_DEBUG_LABEL_MANY("skybox") &compiler, {}, skybox_shader, TransformSource::Uniform);
+
+	// the wrappers below query uniforms so all programs needs to be done
+	compiler.finish();
+
+	auto permutations = std::make_shared<ShaderPermutationCache>(&desc, settings, global_shader_data, cache);
+
+	auto pp_invert = std::make_shared<LoadedPostProcShader>(pp_invert_program, PostProcSetup::factor, invert_effect);
+	auto pp_grayscale = std::make_shared<LoadedPostProcShader>(pp_grayscale_program, PostProcSetup::factor, grayscale_effect);
+	auto pp_damage = std::make_shared<LoadedPostProcShader>(
+		pp_damage_program, PostProcSetup::factor | PostProcSetup::resolution | PostProcSetup::time, damage_effect
+	);
+	auto pp_blurv = std::make_shared<LoadedPostProcShader>(pp_blurv_program, PostProcSetup::factor);
+	auto pp_blurh = std::make_shared<LoadedPostProcShader>(pp_blurh_program, PostProcSetup::factor | PostProcSetup::resolution);
+	auto pp_realize = RealizeShader{pp_realize_program};
+	auto pp_extract = ExtractShader{std::make_shared<LoadedPostProcShader>(pp_extract_program, PostProcSetup::uv_scale)};
+	auto pp_ping = PingPongBlurShader{
+		std::make_shared<LoadedPostProcShader>(pp_ping_horizontal_program, PostProcSetup::uv_scale),
+		std::make_shared<LoadedPostProcShader>(pp_ping_vertical_program, PostProcSetup::uv_scale)
+	};
+	auto pp_bloom_downsample
+		= BloomDownsampleShader{std::make_shared<LoadedPostProcShader>(pp_bloom_downsample_program, PostProcSetup::uv_scale)};
+	auto pp_bloom_upsample
+		= BloomUpsampleShader{std::make_shared<LoadedPostProcShader>(pp_bloom_upsample_program, PostProcSetup::uv_scale)};
 
 	return {
 		// todo(Gustav): not really happy with sending "the same" argument twice, loaded_X.program and loaded_X.geom_layout
@@ -538,17 +781,9 @@ ShaderResource load_shaders(const CameraUniformBuffer& desc, const RenderSetting
 			desc
 		},
 		.skybox_shader = LoadedShader_Skybox{std::move(loaded_skybox_shader.program), loaded_skybox_shader.geom_layout, desc},
-		.unlit_shader_container = LoadedShader_Unlit_Container{
-			loaded_unlit.geom_layout,
-			LoadedShader_Unlit{TransformSource::Uniform, std::move(loaded_unlit.program), desc},
-			LoadedShader_Unlit{TransformSource::Uniform, std::move(loaded_unlit_transparency.program), desc}
-		},
-		.default_shader_container = LoadedShader_Default_Container{
-			loaded_default.geom_layout,
-			LoadedShader_Default{TransformSource::Uniform, std::move(loaded_default.program), settings, desc},
-			LoadedShader_Default{TransformSource::Uniform, std::move(loaded_default_transparency.program), settings, desc},
-			LoadedShader_Default{TransformSource::Instanced_mat4, std::move(loaded_default_instanced.program), settings, desc}
-		},
+		.permutations = permutations,
+		.unlit_shader_container = LoadedShader_Unlit_Container{unlit_geom_layout, unlit_shader_options, permutations.get()},
+		.default_shader_container = LoadedShader_Default_Container{default_geom_layout, default_shader_options, permutations.get()},
 		.pp_invert = pp_invert,
 		.pp_grayscale = pp_grayscale,
 		.pp_damage = pp_damage,
@@ -556,10 +791,78 @@ ShaderResource load_shaders(const CameraUniformBuffer& desc, const RenderSetting
 		.pp_blurh = pp_blurh,
 		.pp_realize = pp_realize,
 		.pp_extract = pp_extract,
-		.pp_ping = pp_ping
+		.pp_ping = pp_ping,
+		.pp_bloom_downsample = pp_bloom_downsample,
+		.pp_bloom_upsample = pp_bloom_upsample,
+		.full_screen_layout = full_screen.layout,
+		.shader_cache = cache,
+		.material_buffer = std::make_shared<MaterialUniformBuffer>(MATERIAL_BUFFER_INITIAL_CAPACITY),
+		.fused_effects = {}
 	};
 }
 
+std::shared_ptr<FusedEffectsShader> get_fused_effects_shader(
+	ShaderResource* resource, bool realize, const std::vector<const LoadedPostProcShader*>& effects
+)
+{
+	const auto key = FusedEffectsKey{realize, effects};
+	if (const auto found = resource->fused_effects.find(key); found != resource->fused_effects.end())
+	{
+		return found->second;
+	}
+
+	auto options = PostProcEffectsOptions{realize, {}};
+	Str name;
+	name << "pp fused" << (realize ? " realize" : "");
+	for (std::size_t index = 0; index < effects.size(); index += 1)
+	{
+		ASSERT(effects[index]->per_pixel.has_value());
+		const auto& effect = *effects[index]->per_pixel;
+		options.effects.emplace_back(PerPixelEffectSource{effect.name, effect.source, fused_effect_prefix(index)});
+		name << " " << effect.name;
+	}
+
+	auto program = std::make_shared<ShaderProgram>(
+		USE_DEBUG_LABEL_MANY(name.str())
+		std::string{PP_VERT_GLSL},
+		generate_post_proc_effects(PP_REALIZE_FRAG_GLSL, options),
+		resource->full_screen_layout,
+		resource->shader_cache
+	);
+
+	auto fused = std::make_shared<FusedEffectsShader>(FusedEffectsShader{
+		program,
+		program->get_uniform("u_texture", UniformKind::texture),
+		realize ? std::optional<RealizeUniforms>{RealizeUniforms{*program}} : std::nullopt,
+		{}
+	});
+
+	for (std::size_t index = 0; index < effects.size(); index += 1)
+	{
+		const auto& prefix = options.effects[index].prefix;
+		const auto setup = effects[index]->setup;
+		fused->effects.emplace_back(FusedEffectUniforms{
+			prefix,
+			get_uniform(*program, fused_uniform_name(prefix, "u_factor"), UniformKind::float_type, setup, PostProcSetup::factor),
+			get_uniform(*program, fused_uniform_name(prefix, "u_resolution"), UniformKind::vec2, setup, PostProcSetup::resolution),
+			get_uniform(*program, fused_uniform_name(prefix, "u_time"), UniformKind::float_type, setup, PostProcSetup::time)
+		});
+	}
+
+	if (fused->realize)
+	{
+		setup_textures(program.get(), {&fused->tex_input_uniform, &fused->realize->tex_blurred_bloom_uniform});
+	}
+	else
+	{
+		setup_textures(program.get(), {&fused->tex_input_uniform});
+	}
+
+	LOG_INFO("Compiled %s", name.str().c_str());
+	resource->fused_effects.emplace(key, fused);
+	return fused;
+}
+
 
 
 }  //  namespace klotter
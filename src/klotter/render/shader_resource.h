@@ -1,17 +1,25 @@
 #pragma once
 
+#include "klotter/jobs.h"
+
+#include "klotter/render/render_settings.h"
+#include "klotter/render/shader.source.h"
 #include "klotter/render/uniform.h"
 #include "klotter/render/uniform_buffer.h"
 #include "klotter/render/vertex_layout.h"
 
+#include <map>
+
 namespace klotter
 {
 struct FullScreenGeom;
-struct RenderSettings;
 struct CompiledGeomVertexAttributes;
 struct ShaderProgram;
+struct ShaderCache;
+struct ShaderCompiler;
 struct CompiledCamera;
 struct ShadowContext;
+struct MaterialUniformBuffer;
 
 /** \addtogroup render Renderer
  *  @{
@@ -50,8 +58,6 @@ struct LoadedShader_SingleColor
 
 	std::shared_ptr<ShaderProgram> program;
 	CompiledGeomVertexAttributes geom_layout;
-	Uniform tint_color_uni;
-	Uniform world_from_local_uni;
 };
 
 /// Only writes depth.
@@ -65,8 +71,6 @@ struct LoadedShader_OnlyDepth
 
 	std::shared_ptr<ShaderProgram> program;
 	CompiledGeomVertexAttributes geom_layout;
-
-	std::optional<Uniform> world_from_local_uni;
 };
 
 /// A skybox shader.
@@ -89,17 +93,15 @@ struct LoadedShader_Unlit
 
 	explicit LoadedShader_Unlit(TransformSource model_source, std::shared_ptr<ShaderProgram> p, const CameraUniformBuffer& desc);
 
-	Uniform tint_color_uni;
 	Uniform tex_diffuse_uniform;
-
-	std::optional<Uniform> world_from_local_uni;
 };
 
 /// Uniform for a directional light.
 /// @see \ref DirectionalLight
 struct DirectionalLightUniforms
 {
-	DirectionalLightUniforms(const ShaderProgram* program, const std::string& base);
+	/// looks up the members of `array[index]`
+	DirectionalLightUniforms(const ShaderProgram* program, std::string_view array, std::size_t index);
 
 	Uniform light_diffuse_color_uni;
 	Uniform light_specular_color_uni;
@@ -110,7 +112,8 @@ struct DirectionalLightUniforms
 /// @see \ref PointLight
 struct PointLightUniforms
 {
-	PointLightUniforms(const ShaderProgram* program, const std::string& base);
+	/// looks up the members of `array[index]`
+	PointLightUniforms(const ShaderProgram* program, std::string_view array, std::size_t index);
 
 	Uniform light_diffuse_color_uni;
 	Uniform light_specular_color_uni;
@@ -122,7 +125,8 @@ struct PointLightUniforms
 /// @see \ref FrustumLight
 struct FrustumLightUniforms
 {
-	FrustumLightUniforms(const ShaderProgram* program, const std::string& base);
+	/// looks up the members of `array[index]`
+	FrustumLightUniforms(const ShaderProgram* program, std::string_view array, std::size_t index);
 
 	Uniform diffuse_uni;
 	Uniform specular_uni;
@@ -132,13 +136,23 @@ struct FrustumLightUniforms
 	Uniform tex_cookie_uniform;
 };
 
+/// A "named boolean"
+enum class UseTextureArrays
+{
+	yes,
+	no
+};
+
 /// Bitmask for what features each postproc shader wants.
 enum class PostProcSetup
 {
 	none = 0,
 	factor = 1 << 1,
 	resolution = 1 << 2,
-	time = 1 << 3
+	time = 1 << 3,
+
+	/// the input is only rendered to partially, like when using dynamic resolution
+	uv_scale = 1 << 4
 };
 PostProcSetup operator|(PostProcSetup lhs, PostProcSetup rhs);
 
@@ -146,12 +160,17 @@ PostProcSetup operator|(PostProcSetup lhs, PostProcSetup rhs);
 struct LoadedPostProcShader
 {
 	std::shared_ptr<ShaderProgram> program;
+	PostProcSetup setup;
 	Uniform tex_input_uniform;
 	std::optional<Uniform> factor_uni;
 	std::optional<Uniform> resolution_uni;
 	std::optional<Uniform> time_uni;
+	std::optional<Uniform> uv_scale_uni;
+
+	/// if set, the effect only reads the current pixel and can be fused with other effects
+	std::optional<PerPixelEffectSource> per_pixel;
 
-	explicit LoadedPostProcShader(std::shared_ptr<ShaderProgram> s, PostProcSetup setup);
+	explicit LoadedPostProcShader(std::shared_ptr<ShaderProgram> s, PostProcSetup setup, std::optional<PerPixelEffectSource> pp = std::nullopt);
 };
 
 /// Part of a loaded "default" shader.
@@ -161,21 +180,17 @@ struct LoadedShader_Default
 	std::shared_ptr<ShaderProgram> program;
 
 	LoadedShader_Default(
-		TransformSource model_source, std::shared_ptr<ShaderProgram> p, const RenderSettings& settings, const CameraUniformBuffer& desc
+		TransformSource model_source,
+		std::shared_ptr<ShaderProgram> p,
+		const RenderSettings& settings,
+		const CameraUniformBuffer& desc
 	);
 
-	Uniform tint_color_uni;
 	Uniform tex_directional_light_depth_uni;
 	Uniform directional_shadow_clip_from_world_uni;
 	Uniform tex_diffuse_uniform;
 	Uniform tex_specular_uniform;
 	Uniform tex_emissive_uniform;
-	Uniform ambient_tint_uni;
-	Uniform specular_color_uni;
-	Uniform shininess_uni;
-	Uniform emissive_factor_uni;
-
-	std::optional<Uniform> world_from_local_uni;
 
 	Uniform view_position_uni;
 	Uniform light_ambient_color_uni;
@@ -208,13 +223,89 @@ struct RenderContext
 	{}
 };
 
+/// The unlit and default shaders, compiled the first time a permutation is requested.
+/// Permutations can also be compiled in the background with \ref prewarm, like the ones that were used last run.
+struct ShaderPermutationCache
+{
+	ShaderPermutationCache(
+		const CameraUniformBuffer* d, const RenderSettings& s, std::vector<VertexType> base, const ShaderCache* c
+	);
+	~ShaderPermutationCache();
+
+	ShaderPermutationCache(const ShaderPermutationCache&) = delete;
+	ShaderPermutationCache(ShaderPermutationCache&&) = delete;
+	void operator=(const ShaderPermutationCache&) = delete;
+	void operator=(ShaderPermutationCache&&) = delete;
+
+	/// Get a unlit permutation, compiles it if this is the first request.
+	const LoadedShader_Unlit& get_unlit(const ShaderOptions& options);
+
+	/// Get a lit permutation, compiles it if this is the first request.
+	const LoadedShader_Default& get_default(const ShaderOptions& options);
+
+	/// Start generating the sources on the job system, the programs are compiled in \ref update.
+	/// Permutations that doesn't match the current settings are ignored.
+	void prewarm(const std::vector<ShaderPermutationKey>& keys);
+
+	/// Compile the prewarmed permutations that are ready, doesn't wait for the driver if parallel compile is supported.
+	void update();
+
+	/// The permutations that have been requested, in the order they were first requested.
+	[[nodiscard]] const std::vector<ShaderPermutationKey>& get_used_keys() const;
+
+	/// verify that the permutations that are compiled so far are loaded
+	[[nodiscard]] bool is_loaded() const;
+
+	[[nodiscard]] int get_compiled_count() const;
+
+   private:
+
+	struct Permutation
+	{
+		std::shared_ptr<ShaderProgram> program;
+
+		/// set when the program is finished, depending on if the permutation uses lights
+		std::unique_ptr<LoadedShader_Unlit> unlit;
+		std::unique_ptr<LoadedShader_Default> lit;
+
+		/// set the first time the permutation is requested, prewarmed permutations are compiled before that
+		bool is_used = false;
+	};
+
+	const Permutation& get(const ShaderOptions& options);
+	Permutation& load(ShaderPermutationKey key, const ShaderOptions& options);
+	void submit(ShaderCompiler* compiler, ShaderPermutationKey key, const ShaderSource_withLayout& source);
+	void create_shaders(ShaderPermutationKey key);
+
+	void submit_prewarm_sources();
+	void complete_prewarm();
+	void finish_prewarm();
+
+	const CameraUniformBuffer* desc;
+	RenderSettings settings;
+	std::vector<VertexType> base_layout;
+	const ShaderCache* cache;
+
+	std::unordered_map<ShaderPermutationKey, Permutation> permutations;
+	std::vector<ShaderPermutationKey> used_keys;
+
+	std::vector<ShaderPermutationKey> prewarm_keys;
+
+	/// the sources are generated on the job system and only read when the counter is done
+	JobCounter prewarm_loading;
+	bool is_prewarm_loading = false;
+	std::vector<ShaderSource_withLayout> prewarm_sources;
+	std::unique_ptr<ShaderCompiler> prewarm_compiler;
+};
+
 /// A unlit shader.
 struct LoadedShader_Unlit_Container
 {
 	CompiledGeomVertexAttributes geom_layout;
 
-	LoadedShader_Unlit default_shader;
-	LoadedShader_Unlit transparency_shader;
+	/// the permutations are selected from these options and the render context
+	ShaderOptions options;
+	ShaderPermutationCache* permutations;
 
 	[[nodiscard]] bool is_loaded() const;
 };
@@ -224,18 +315,33 @@ struct LoadedShader_Default_Container
 {
 	CompiledGeomVertexAttributes geom_layout;
 
-	LoadedShader_Default default_shader;
-	LoadedShader_Default transparency_shader;
-	LoadedShader_Default default_shader_instance;
+	/// the permutations are selected from these options and the render context
+	ShaderOptions options;
+	ShaderPermutationCache* permutations;
 
 	[[nodiscard]] bool is_loaded() const;
 };
 
-/// Select the correct sub shader from a container.
+/// Select the correct sub shader from a container, it's compiled if this is the first time it's requested.
 [[nodiscard]] const LoadedShader_Unlit& shader_from_container(const LoadedShader_Unlit_Container& container, const RenderContext& rc);
 
-/// Select the correct sub shader from a container.
-[[nodiscard]] const LoadedShader_Default& shader_from_container(const LoadedShader_Default_Container& container, const RenderContext& rc);
+/// Select the correct sub shader from a container, it's compiled if this is the first time it's requested.
+[[nodiscard]] const LoadedShader_Default& shader_from_container(
+	const LoadedShader_Default_Container& container, const RenderContext& rc, UseTextureArrays use_texture_arrays = UseTextureArrays::no
+);
+
+/// The uniforms for composing a rendered image, besides the input texture.
+struct RealizeUniforms
+{
+	explicit RealizeUniforms(const ShaderProgram& program);
+
+	Uniform tex_blurred_bloom_uniform;
+
+	Uniform use_blur_uniform;
+	Uniform gamma_uniform;
+	Uniform exposure_uniform;
+	Uniform uv_scale_uniform;
+};
 
 // todo(Gustav): Rename this to composing shader
 /// The shader data for composing a rendered image.
@@ -245,13 +351,31 @@ struct RealizeShader
 
 	std::shared_ptr<ShaderProgram> program;
 	Uniform tex_input_uniform;
-	Uniform tex_blurred_bloom_uniform;
+	RealizeUniforms realize;
+};
 
-	Uniform use_blur_uniform;
-	Uniform gamma_uniform;
-	Uniform exposure_uniform;
+/// The uniforms for a single effect in a \ref FusedEffectsShader
+struct FusedEffectUniforms
+{
+	std::string prefix;
+	std::optional<Uniform> factor_uni;
+	std::optional<Uniform> resolution_uni;
+	std::optional<Uniform> time_uni;
 };
 
+/// A generated shader that applies a chain of per-pixel effects in a single pass.
+/// Optionally the realize step is done first so the effects can be applied directly on the rendered world.
+struct FusedEffectsShader
+{
+	std::shared_ptr<ShaderProgram> program;
+	Uniform tex_input_uniform;
+	std::optional<RealizeUniforms> realize;
+	std::vector<FusedEffectUniforms> effects;
+};
+
+/// Fused shaders are cached on if realize is included and the effect shaders.
+using FusedEffectsKey = std::pair<bool, std::vector<const LoadedPostProcShader*>>;
+
 /// Extracts data for a bloom
 struct ExtractShader
 {
@@ -262,12 +386,31 @@ struct ExtractShader
 	Uniform softness_uniform;
 };
 
+/// Blurs the bloom, with one shader for each direction.
 struct PingPongBlurShader
 {
-	explicit PingPongBlurShader(std::shared_ptr<LoadedPostProcShader>&& sh);
+	std::shared_ptr<LoadedPostProcShader> horizontal;
+	std::shared_ptr<LoadedPostProcShader> vertical;
+};
+
+/// Downsamples a bloom mip to half the size.
+struct BloomDownsampleShader
+{
+	explicit BloomDownsampleShader(std::shared_ptr<LoadedPostProcShader>&& sh);
+
+	std::shared_ptr<LoadedPostProcShader> shader;
+	Uniform use_karis_average_uniform;
+};
+
+/// Upsamples a bloom mip and adds it to the mip of the target size.
+struct BloomUpsampleShader
+{
+	explicit BloomUpsampleShader(std::shared_ptr<LoadedPostProcShader>&& sh);
 
 	std::shared_ptr<LoadedPostProcShader> shader;
-	Uniform is_horizontal_uniform;
+	Uniform tex_current_uniform;
+	Uniform filter_radius_uniform;
+	Uniform weight_uniform;
 };
 
 
@@ -279,6 +422,9 @@ struct ShaderResource
 	LoadedShader_OnlyDepth depth_transform_instanced_mat4;
 	LoadedShader_Skybox skybox_shader;
 
+	/// owns the permutations of the containers below
+	std::shared_ptr<ShaderPermutationCache> permutations;
+
 	LoadedShader_Unlit_Container unlit_shader_container;
 	LoadedShader_Default_Container default_shader_container;
 
@@ -294,12 +440,34 @@ struct ShaderResource
 	RealizeShader pp_realize;
 	ExtractShader pp_extract;
 	PingPongBlurShader pp_ping;
+	BloomDownsampleShader pp_bloom_downsample;
+	BloomUpsampleShader pp_bloom_upsample;
+
+	/// the layout of the full screen geom, for compiling post-processing shaders after loading
+	CompiledShaderVertexAttributes full_screen_layout;
+
+	/// the cache used when compiling fused shaders, may be null
+	const ShaderCache* shader_cache;
+
+	/// the parameters of all materials, shared with the materials so they can release their range
+	std::shared_ptr<MaterialUniformBuffer> material_buffer;
+
+	std::map<FusedEffectsKey, std::shared_ptr<FusedEffectsShader>> fused_effects;
 
 	/// verify that the shaders are loaded
 	[[nodiscard]] bool is_loaded() const;
 };
 
-ShaderResource load_shaders(const CameraUniformBuffer& desc, const RenderSettings& settings, const FullScreenGeom& full_screen);
+/// Compile all shaders, if the cache is not null compiled programs are loaded from and stored in it.
+ShaderResource load_shaders(
+	const CameraUniformBuffer& desc, const RenderSettings& settings, const FullScreenGeom& full_screen, const ShaderCache* cache
+);
+
+/// Get a cached fused shader or generate and compile a new one.
+/// All effects are required to be per-pixel effects and no effect may be repeated.
+std::shared_ptr<FusedEffectsShader> get_fused_effects_shader(
+	ShaderResource* resource, bool realize, const std::vector<const LoadedPostProcShader*>& effects
+);
 
 /**
  * @}
@@ -4,24 +4,27 @@
 // uniforms
 
 {{^only_depth}}
-struct Material
-{
-    vec4 diffuse_tint; // diffuse + alpha
+{{material_buffer_source}}
+
 {{#use_texture}}
-    sampler2D diffuse_tex;
+{{#use_texture_arrays}}
+uniform sampler2DArray u_diffuse_tex;
+{{/use_texture_arrays}}
+{{^use_texture_arrays}}
+uniform sampler2D u_diffuse_tex;
+{{/use_texture_arrays}}
 {{/use_texture}}
 
-    {{#use_lights}}
-    sampler2D specular_tex;
-    sampler2D emissive_tex;
-    float emissive_factor;
-    vec3 ambient_tint;
-    vec3 specular_tint;
-    float shininess;
-    {{/use_lights}}
-};
-
-uniform Material u_material;
+{{#use_lights}}
+{{#use_texture_arrays}}
+uniform sampler2DArray u_specular_tex;
+uniform sampler2DArray u_emissive_tex;
+{{/use_texture_arrays}}
+{{^use_texture_arrays}}
+uniform sampler2D u_specular_tex;
+uniform sampler2D u_emissive_tex;
+{{/use_texture_arrays}}
+{{/use_lights}}
 {{/only_depth}}
 
 {{#use_lights}}
@@ -83,6 +86,17 @@ in vec4 v_directional_shadow_clip_position;
 // output
 out vec4 o_frag_color;
 
+///////////////////////////////////////////////////////////////////////////////
+// texture arrays
+{{#use_texture_arrays}}
+
+// the layer is either a full texture or a atlas page where the texture is at the rect
+vec4 sample_material_texture(sampler2DArray tex, vec4 rect, float layer)
+{
+    return texture(tex, vec3(rect.xy + v_tex_coord * rect.zw, layer));
+}
+{{/use_texture_arrays}}
+
 ///////////////////////////////////////////////////////////////////////////////
 // s curve
 {{#use_lights}}
@@ -237,9 +251,16 @@ void main()
 {{#use_lights}}
     vec3 normal = normalize(v_normal);
     vec3 view_direction = normalize(u_view_position - v_worldspace);
-    vec4 tex = texture(u_material.diffuse_tex, v_tex_coord);
-    vec3 spec_t = texture(u_material.specular_tex, v_tex_coord).rgb;
-    vec3 emi_t = texture(u_material.emissive_tex, v_tex_coord).rgb;
+{{#use_texture_arrays}}
+    vec4 tex = sample_material_texture(u_diffuse_tex, u_material.diffuse_rect, u_material.diffuse_layer);
+    vec3 spec_t = sample_material_texture(u_specular_tex, u_material.specular_rect, u_material.specular_layer).rgb;
+    vec3 emi_t = sample_material_texture(u_emissive_tex, u_material.emissive_rect, u_material.emissive_layer).rgb;
+{{/use_texture_arrays}}
+{{^use_texture_arrays}}
+    vec4 tex = texture(u_diffuse_tex, v_tex_coord);
+    vec3 spec_t = texture(u_specular_tex, v_tex_coord).rgb;
+    vec3 emi_t = texture(u_emissive_tex, v_tex_coord).rgb;
+{{/use_texture_arrays}}
     vec3 base_color = tex.rgb * v_color.rgb;
     float alpha = tex.a * u_material.diffuse_tint.a;
 
@@ -281,7 +302,7 @@ void main()
 {{/use_lights}}
 {{^use_lights}}
 {{#use_texture}}
-    vec4 object_color = texture(u_material.diffuse_tex, v_tex_coord)
+    vec4 object_color = texture(u_diffuse_tex, v_tex_coord)
         * u_material.diffuse_tint.rgba * vec4(v_color.rgb, 1.0);
 {{#transparent_cutoff}}
     if(object_color.a < 0.1)
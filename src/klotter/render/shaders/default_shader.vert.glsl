@@ -19,7 +19,7 @@ in vec2 a_tex_coord;
 in mat4 u_world_from_local; // hacky way to define a attribute :/
 {{/use_instancing}}
 {{^use_instancing}}
-uniform mat4 u_world_from_local;
+{{draw_buffer_source}}
 {{/use_instancing}}
 
 {{#use_lights}}
@@ -48,11 +48,21 @@ void main()
 
 {{#use_lights}}
     v_worldspace = vec3(u_world_from_local * vec4(a_position.xyz, 1.0));
-    v_normal = mat3(transpose(inverse(u_world_from_local))) * a_normal; // move to cpu
+{{#use_instancing}}
+    v_normal = mat3(transpose(inverse(u_world_from_local))) * a_normal;
+{{/use_instancing}}
+{{^use_instancing}}
+    v_normal = mat3(u_normal_from_local) * a_normal;
+{{/use_instancing}}
     v_directional_shadow_clip_position = u_directional_shadow_clip_from_world * world_position;
 {{/use_lights}}
 {{^only_depth}}
+{{#use_instancing}}
     v_color = a_color;
+{{/use_instancing}}
+{{^use_instancing}}
+    v_color = a_color * u_tint.rgb;
+{{/use_instancing}}
     v_tex_coord = a_tex_coord;
 {{/only_depth}}
 }
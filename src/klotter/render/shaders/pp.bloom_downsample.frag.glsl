@@ -0,0 +1,94 @@
+#version 330 core
+
+// 13-tap downsample from "Next Generation Post Processing in Call of Duty: Advanced Warfare" by Jorge Jimenez
+
+uniform sampler2D u_texture;
+
+// the first downsample uses a karis average to reduce fireflies from very bright pixels
+uniform bool u_use_karis_average;
+
+// the part of the input that is rendered to, when using dynamic resolution
+uniform vec2 u_uv_scale;
+
+in vec2 v_tex_coord;
+
+out vec4 o_frag_color;
+
+float calculate_luma(vec3 color)
+{
+    return dot(color, vec3(0.2126, 0.7152, 0.0722));
+}
+
+float karis_weight(vec3 color)
+{
+    return 1.0f / (1.0f + calculate_luma(color));
+}
+
+vec3 average_box(vec3 a, vec3 b, vec3 c, vec3 d)
+{
+    if(u_use_karis_average)
+    {
+        float wa = karis_weight(a);
+        float wb = karis_weight(b);
+        float wc = karis_weight(c);
+        float wd = karis_weight(d);
+        return (a * wa + b * wb + c * wc + d * wd) / (wa + wb + wc + wd);
+    }
+    else
+    {
+        return (a + b + c + d) * 0.25f;
+    }
+}
+
+vec3 sample_input(vec2 uv)
+{
+    // don't sample outside of the rendered part
+    vec2 uv_max = u_uv_scale - 0.5 / textureSize(u_texture, 0);
+    return texture(u_texture, min(uv, uv_max)).rgb;
+}
+
+void main()
+{
+    // size of a single texel in the source
+    vec2 t = 1.0 / textureSize(u_texture, 0);
+    vec2 uv = v_tex_coord * u_uv_scale;
+
+    // a - b - c
+    // - j - k -
+    // d - e - f
+    // - l - m -
+    // g - h - i
+    vec3 a = sample_input(uv + vec2(-2*t.x,  2*t.y));
+    vec3 b = sample_input(uv + vec2(     0,  2*t.y));
+    vec3 c = sample_input(uv + vec2( 2*t.x,  2*t.y));
+
+    vec3 d = sample_input(uv + vec2(-2*t.x,      0));
+    vec3 e = sample_input(uv                        );
+    vec3 f = sample_input(uv + vec2( 2*t.x,      0));
+
+    vec3 g = sample_input(uv + vec2(-2*t.x, -2*t.y));
+    vec3 h = sample_input(uv + vec2(     0, -2*t.y));
+    vec3 i = sample_input(uv + vec2( 2*t.x, -2*t.y));
+
+    vec3 j = sample_input(uv + vec2(-t.x,  t.y));
+    vec3 k = sample_input(uv + vec2( t.x,  t.y));
+    vec3 l = sample_input(uv + vec2(-t.x, -t.y));
+    vec3 m = sample_input(uv + vec2( t.x, -t.y));
+
+    // the center box gets half the weight, the 4 overlapping corner boxes share the rest
+    vec3 color = average_box(j, k, l, m) * 0.5f;
+    color += average_box(a, b, d, e) * 0.125f;
+    color += average_box(b, c, e, f) * 0.125f;
+    color += average_box(d, e, g, h) * 0.125f;
+    color += average_box(e, f, h, i) * 0.125f;
+
+    // a single nan or inf would spread over the whole bloom in the following passes so drop it,
+    // clamp to the largest half float and keep it positive
+    if(any(isnan(color)) || any(isinf(color)))
+    {
+        color = vec3(0.0f);
+    }
+    color = clamp(color, 0.0001f, 65504.0f);
+
+    o_frag_color = vec4(color, 1.0);
+}
@@ -0,0 +1,64 @@
+#version 330 core
+
+// 9-tap tent upsample of the smaller mip, accumulated with the downsampled mip of the same size
+
+// the smaller mip, is upsampled
+uniform sampler2D u_texture;
+
+// the downsampled mip with the same size as the target
+uniform sampler2D u_current;
+
+// the radius of the tent filter in texels of the smaller mip
+uniform float u_filter_radius;
+
+// the last upsample scales down the sum of all mips
+uniform float u_weight;
+
+// the part of the inputs that is rendered to, when using dynamic resolution
+uniform vec2 u_uv_scale;
+
+in vec2 v_tex_coord;
+
+out vec4 o_frag_color;
+
+vec3 sample_input(vec2 uv)
+{
+    // don't sample outside of the rendered part
+    vec2 uv_max = u_uv_scale - 0.5 / textureSize(u_texture, 0);
+    return texture(u_texture, min(uv, uv_max)).rgb;
+}
+
+void main()
+{
+    vec2 uv = v_tex_coord * u_uv_scale;
+    vec2 radius = u_filter_radius / vec2(textureSize(u_texture, 0));
+    float x = radius.x;
+    float y = radius.y;
+
+    // a - b - c
+    // d - e - f
+    // g - h - i
+    vec3 a = sample_input(uv + vec2(-x,  y));
+    vec3 b = sample_input(uv + vec2( 0,  y));
+    vec3 c = sample_input(uv + vec2( x,  y));
+
+    vec3 d = sample_input(uv + vec2(-x,  0));
+    vec3 e = sample_input(uv              );
+    vec3 f = sample_input(uv + vec2( x,  0));
+
+    vec3 g = sample_input(uv + vec2(-x, -y));
+    vec3 h = sample_input(uv + vec2( 0, -y));
+    vec3 i = sample_input(uv + vec2( x, -y));
+
+    // 1 2 1
+    // 2 4 2  / 16
+    // 1 2 1
+    vec3 upsampled = e * 4.0f;
+    upsampled += (b + d + f + h) * 2.0f;
+    upsampled += (a + c + g + i);
+    upsampled *= 1.0f / 16.0f;
+
+    vec3 current = texture(u_current, uv).rgb;
+
+    o_frag_color = vec4((current + upsampled) * u_weight, 1.0);
+}
@@ -1,17 +1,12 @@
-#version 330 core
+uniform float {{prefix}}factor;
+uniform vec2 {{prefix}}resolution;
 
-in vec2 v_tex_coord;
-uniform sampler2D u_texture;
-uniform float u_factor;
-uniform vec2 u_resolution;
+uniform float {{prefix}}vignette_radius;
+uniform float {{prefix}}vignette_smoothness;
+uniform float {{prefix}}vignette_darkening;
+uniform float {{prefix}}noise_scale;
 
-uniform float u_vignette_radius;
-uniform float u_vignette_smoothness;
-uniform float u_vignette_darkening;
-uniform float u_noise_scale;
-
-uniform float u_time;
-out vec4 o_frag_color;
+uniform float {{prefix}}time;
 
 // basically a tinted vignette with noise (needs tweaking)
 // https://www.youtube.com/watch?v=7MklBPjPmMg
@@ -91,20 +86,18 @@ float cnoise(vec3 P){
 }
 
 
-void main()
+vec3 {{prefix}}apply(vec3 color, vec2 uv)
 {
     vec3 tint = vec3(1, 0, 0);
 
-    float nf = min(1, max(0, cnoise(vec3(v_tex_coord * u_noise_scale, u_time)) * 0.5 + 0.5));
+    float nf = min(1, max(0, cnoise(vec3(uv * {{prefix}}noise_scale, {{prefix}}time)) * 0.5 + 0.5));
     float nfs = nf;
 
-    float size = min(u_resolution.x, u_resolution.y);
-    float scale = 1 - length((v_tex_coord - 0.5) * u_resolution) / size;
-    float sm = smoothstep(u_vignette_radius, u_vignette_radius + u_vignette_smoothness, scale);
-    float vignette = mix(1, 1-u_vignette_darkening, sm);
-    
-    vec3 color = texture(u_texture, v_tex_coord).rgb;
+    float size = min({{prefix}}resolution.x, {{prefix}}resolution.y);
+    float scale = 1 - length((uv - 0.5) * {{prefix}}resolution) / size;
+    float sm = smoothstep({{prefix}}vignette_radius, {{prefix}}vignette_radius + {{prefix}}vignette_smoothness, scale);
+    float vignette = mix(1, 1-{{prefix}}vignette_darkening, sm);
 
     vec3 damage = mix(color, tint, vignette * nfs);
-    o_frag_color = vec4(mix(color, damage, u_factor), 1.0f);
+    return mix(color, damage, {{prefix}}factor);
 }
@@ -5,6 +5,9 @@ uniform sampler2D u_texture;
 uniform float u_cutoff;
 uniform float u_softness;
 
+// the part of the input that is rendered to, when using dynamic resolution
+uniform vec2 u_uv_scale;
+
 in vec2 v_tex_coord;
 
 out vec4 o_frag_color;
@@ -23,7 +26,7 @@ float calculate_contribution(float brightness)
 
 void main()
 {
-    vec4 sampled = texture(u_texture, v_tex_coord);
+    vec4 sampled = texture(u_texture, v_tex_coord * u_uv_scale);
     float alpha = sampled.a;
     vec3 color = sampled.rgb;
 
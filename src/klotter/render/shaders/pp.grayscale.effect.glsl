@@ -0,0 +1,8 @@
+uniform float {{prefix}}factor;
+
+vec3 {{prefix}}apply(vec3 color, vec2 uv)
+{
+    float avg = 0.2126 * color.r + 0.7152 * color.g + 0.0722 * color.b;
+    vec3 grayscale = vec3(avg, avg, avg);
+    return mix(color, grayscale, {{prefix}}factor);
+}
@@ -0,0 +1,7 @@
+uniform float {{prefix}}factor;
+
+vec3 {{prefix}}apply(vec3 color, vec2 uv)
+{
+    vec3 inverted = 1 - color;
+    return mix(color, inverted, {{prefix}}factor);
+}
@@ -1,39 +1,51 @@
 #version 330 core
 
+// a separable gaussian blur with weights calculated on the cpu,
+// adjacent texels are merged into a single linear filtered fetch so each tap samples two texels
+
+#define TAP_COUNT {{tap_count}}
+
 uniform sampler2D u_texture;
-uniform bool u_is_horizontal;
 
-uniform float weight[5] = float[] (0.227027, 0.1945946, 0.1216216, 0.054054, 0.016216);
+// the part of the input that is rendered to, when using dynamic resolution
+uniform vec2 u_uv_scale;
+
+// the first tap is the center, the rest are mirrored
+const float offsets[TAP_COUNT] = float[] ({{offsets}});
+const float weights[TAP_COUNT] = float[] ({{weights}});
 
 in vec2 v_tex_coord;
 
 out vec4 o_frag_color;
 
+vec3 sample_input(vec2 uv)
+{
+    // don't sample outside of the rendered part
+    vec2 uv_max = u_uv_scale - 0.5 / textureSize(u_texture, 0);
+    return texture(u_texture, min(uv, uv_max)).rgb;
+}
+
 void main()
 {             
     // gets size of single texel
     vec2 tex_offset = 1.0 / textureSize(u_texture, 0);
+    vec2 uv = v_tex_coord * u_uv_scale;
 
-    // current fragment's contribution
-    vec3 result = texture(u_texture, v_tex_coord).rgb * weight[0];
+{{#is_horizontal}}
+    vec2 direction = vec2(tex_offset.x, 0.0);
+{{/is_horizontal}}
+{{#is_vertical}}
+    vec2 direction = vec2(0.0, tex_offset.y);
+{{/is_vertical}}
 
+    // current fragment's contribution
+    vec3 result = sample_input(uv) * weights[0];
 
-    if(u_is_horizontal)
-    {
-        for(int i = 1; i < 5; ++i)
-        {
-            result += texture(u_texture, v_tex_coord + vec2(tex_offset.x * i, 0.0)).rgb * weight[i];
-            result += texture(u_texture, v_tex_coord - vec2(tex_offset.x * i, 0.0)).rgb * weight[i];
-        }
-    }
-    else
+    for(int i = 1; i < TAP_COUNT; ++i)
     {
-        for(int i = 1; i < 5; ++i)
-        {
-            result += texture(u_texture, v_tex_coord + vec2(0.0, tex_offset.y * i)).rgb * weight[i];
-            result += texture(u_texture, v_tex_coord - vec2(0.0, tex_offset.y * i)).rgb * weight[i];
-        }
+        result += sample_input(uv + direction * offsets[i]) * weights[i];
+        result += sample_input(uv - direction * offsets[i]) * weights[i];
     }
     
     o_frag_color = vec4(result, 1.0);
-}
\ No newline at end of file
+}
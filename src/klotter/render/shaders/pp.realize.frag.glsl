@@ -1,25 +1,48 @@
 #version 330 core
 
+// composes the rendered world (bloom, tonemap and gamma) and/or applies a chain of per-pixel effects
+
 uniform sampler2D u_texture;
+
+{{#realize}}
 uniform sampler2D u_blurred_bloom;
 
 uniform bool u_use_blur;
 uniform float u_gamma;
 uniform float u_exposure;
 
+// the part of the rendered world that is rendered to, when using dynamic resolution
+uniform vec2 u_uv_scale;
+{{/realize}}
+
 in vec2 v_tex_coord;
 
 out vec4 o_frag_color;
 
+{{#effects}}
+///////////////////////////////////////////////////////////////////////////////
+// {{name}}
+{{source}}
+
+{{/effects}}
+
 void main()
 {
-    vec4 sampled = texture(u_texture, v_tex_coord);
+{{#realize}}
+    // the world may be rendered at a lower resolution, this upscales it
+    vec2 source_coord = v_tex_coord * u_uv_scale;
+{{/realize}}
+{{^realize}}
+    vec2 source_coord = v_tex_coord;
+{{/realize}}
+    vec4 sampled = texture(u_texture, source_coord);
     float alpha = sampled.a;
     vec3 color = sampled.rgb;
 
+{{#realize}}
     if(u_use_blur)
     {
-        vec3 blur = texture(u_blurred_bloom, v_tex_coord).rgb;
+        vec3 blur = texture(u_blurred_bloom, source_coord).rgb;
         color += blur;
     }
 
@@ -34,6 +57,12 @@ void main()
         // exposure tone mapping
         color = vec3(1.0f) - exp(-color * u_exposure);
     }
-    vec3 corrected = pow(color.rgb, vec3(1.0f/u_gamma));
-    o_frag_color = vec4(corrected, alpha);
+    color = pow(color.rgb, vec3(1.0f/u_gamma));
+{{/realize}}
+
+{{#effects}}
+    color = {{prefix}}apply(color, v_tex_coord);
+{{/effects}}
+
+    o_frag_color = vec4(color, {{output_alpha}});
 }
@@ -11,9 +11,21 @@
 namespace klotter
 {
 
+namespace
+{
+	u64 current_bindings_generation = 0;
+}  //  namespace
+
+void invalidate_state_bindings()
+{
+	current_bindings_generation += 1;
+}
+
 template<typename T>
-bool should_change(std::optional<T>* current_state, T new_state)
+bool should_change(std::optional<T>* current_state, T new_state, StateCounter* counter)
 {
+	counter->requested += 1;
+
 	// if there is a value, and that is the same... then don't update opengl
 	if (*current_state && *current_state == new_state)
 	{
@@ -21,12 +33,13 @@ bool should_change(std::optional<T>* current_state, T new_state)
 	}
 
 	*current_state = new_state;
+	counter->issued += 1;
 	return true;
 }
 
-void apply(std::optional<bool>* current_state, bool new_state, GLenum gl_type)
+void apply(std::optional<bool>* current_state, bool new_state, GLenum gl_type, StateCounter* counter)
 {
-	if (should_change(current_state, new_state))
+	if (should_change(current_state, new_state, counter))
 	{
 		if (new_state)
 		{
@@ -74,29 +87,39 @@ GLenum enum_from_sa (StencilAction sa)
 StateChanger::StateChanger(State* s)
 	: states(s)
 {
+	if (states->bindings_generation != current_bindings_generation)
+	{
+		states->active_texture = std::nullopt;
+		states->texture_bound = {};
+		states->program = std::nullopt;
+		states->vertex_array = std::nullopt;
+		states->array_buffer = std::nullopt;
+		states->framebuffer = std::nullopt;
+		states->bindings_generation = current_bindings_generation;
+	}
 }
 
 StateChanger& StateChanger::cull_face(bool new_state)
 {
-	apply(&states->cull_face, new_state, GL_CULL_FACE);
+	apply(&states->cull_face, new_state, GL_CULL_FACE, &states->stats.capabilities);
 	return *this;
 }
 
 StateChanger& StateChanger::blending(bool new_state)
 {
-	apply(&states->blending, new_state, GL_BLEND);
+	apply(&states->blending, new_state, GL_BLEND, &states->stats.capabilities);
 	return *this;
 }
 
 StateChanger& StateChanger::depth_test(bool new_state)
 {
-	apply(&states->depth_test, new_state, GL_DEPTH_TEST);
+	apply(&states->depth_test, new_state, GL_DEPTH_TEST, &states->stats.capabilities);
 	return *this;
 }
 
 StateChanger& StateChanger::depth_mask(bool new_state)
 {
-	if (should_change(&states->depth_mask, new_state))
+	if (should_change(&states->depth_mask, new_state, &states->stats.capabilities))
 	{
 		glDepthMask(new_state ? GL_TRUE : GL_FALSE);
 	}
@@ -105,7 +128,7 @@ StateChanger& StateChanger::depth_mask(bool new_state)
 
 StateChanger& StateChanger::depth_func(Compare new_state)
 {
-	if (should_change(&states->depth_func, new_state))
+	if (should_change(&states->depth_func, new_state, &states->stats.capabilities))
 	{
 		const auto mode = enum_from_c(new_state);
 		glDepthFunc(mode);
@@ -114,16 +137,26 @@ StateChanger& StateChanger::depth_func(Compare new_state)
 	return *this;
 }
 
+StateChanger& StateChanger::color_mask(bool new_state)
+{
+	if (should_change(&states->color_mask, new_state, &states->stats.capabilities))
+	{
+		const GLboolean mask = new_state ? GL_TRUE : GL_FALSE;
+		glColorMask(mask, mask, mask, mask);
+	}
+	return *this;
+}
+
 StateChanger& StateChanger::stencil_test(bool new_state)
 {
-	apply(&states->stencil_test, new_state, GL_STENCIL_TEST);
+	apply(&states->stencil_test, new_state, GL_STENCIL_TEST, &states->stats.capabilities);
 	return *this;
 }
 
 /// Set a bitmask that is ANDed with the stencil value about to be written to the buffer.
 StateChanger& StateChanger::stencil_mask(u32 new_state)
 {
-	if (should_change(&states->stencil_mask, new_state))
+	if (should_change(&states->stencil_mask, new_state, &states->stats.capabilities))
 	{
 		glStencilMask(new_state);
 	}
@@ -133,7 +166,7 @@ StateChanger& StateChanger::stencil_mask(u32 new_state)
 
 StateChanger& StateChanger::stencil_func(Compare func, i32 ref, u32 mask)
 {
-	if (should_change(&states->stencil_func, {func, ref, mask}))
+	if (should_change(&states->stencil_func, {func, ref, mask}, &states->stats.capabilities))
 	{
 		glStencilFunc(enum_from_c(func), ref, mask);
 	}
@@ -143,7 +176,7 @@ StateChanger& StateChanger::stencil_func(Compare func, i32 ref, u32 mask)
 
 StateChanger& StateChanger::render_mode(RenderMode new_state)
 {
-	if (should_change(&states->render_mode, new_state))
+	if (should_change(&states->render_mode, new_state, &states->stats.capabilities))
 	{
 		const auto mode = ([new_state]() -> GLenum
 			{
@@ -162,7 +195,7 @@ StateChanger& StateChanger::render_mode(RenderMode new_state)
 
 StateChanger& StateChanger::stencil_op(StencilAction stencil_fail, StencilAction depth_fail, StencilAction pass)
 {
-	if (should_change(&states->stencil_op, {stencil_fail, depth_fail, pass}))
+	if (should_change(&states->stencil_op, {stencil_fail, depth_fail, pass}, &states->stats.capabilities))
 	{
 		// todo(Gustav): look into using glStencilOpSeparate instead to specify front and back faces
 		// https://registry.khronos.org/OpenGL-Refpages/gl4/html/glStencilOpSeparate.xhtml
@@ -174,7 +207,7 @@ StateChanger& StateChanger::stencil_op(StencilAction stencil_fail, StencilAction
 
 StateChanger& StateChanger::cull_face_mode(CullFace new_state)
 {
-	if (should_change(&states->cull_face_mode, new_state))
+	if (should_change(&states->cull_face_mode, new_state, &states->stats.capabilities))
 	{
 		const auto mode = ([new_state]() -> GLenum
 			{
@@ -193,7 +226,7 @@ StateChanger& StateChanger::cull_face_mode(CullFace new_state)
 
 StateChanger& StateChanger::blend_mode(Blend src, Blend dst)
 {
-	if (should_change(&states->blend_mode, {src, dst}))
+	if (should_change(&states->blend_mode, {src, dst}, &states->stats.capabilities))
 	{
 		const auto convert = [](Blend b) -> GLenum
 		{
@@ -228,7 +261,7 @@ StateChanger& StateChanger::blend_mode(Blend src, Blend dst)
 
 StateChanger& StateChanger::activate_texture(int new_texture)
 {
-	if (should_change(&states->active_texture, new_texture))
+	if (should_change(&states->active_texture, new_texture, &states->stats.textures))
 	{
 		glActiveTexture(glenum_from_int(GL_TEXTURE0 + new_texture));
 	}
@@ -238,7 +271,7 @@ StateChanger& StateChanger::activate_texture(int new_texture)
 StateChanger& StateChanger::bind_texture_2d(int slot, unsigned int texture)
 {
 	ASSERT(slot == states->active_texture);
-	if (should_change(&states->texture_bound[sizet_from_int(slot)], texture))
+	if (should_change(&states->texture_bound[sizet_from_int(slot)], texture, &states->stats.textures))
 	{
 		glBindTexture(GL_TEXTURE_2D, texture);
 	}
@@ -248,13 +281,77 @@ StateChanger& StateChanger::bind_texture_2d(int slot, unsigned int texture)
 StateChanger& StateChanger::bind_texture_cubemap(int slot, unsigned int texture)
 {
 	ASSERT(slot == states->active_texture);
-	if (should_change(&states->texture_bound[sizet_from_int(slot)], texture))
+	if (should_change(&states->texture_bound[sizet_from_int(slot)], texture, &states->stats.textures))
 	{
 		glBindTexture(GL_TEXTURE_CUBE_MAP, texture);
 	}
 	return *this;
 }
 
+StateChanger& StateChanger::bind_texture_2d_array(int slot, unsigned int texture)
+{
+	ASSERT(slot == states->active_texture);
+	if (should_change(&states->texture_bound[sizet_from_int(slot)], texture, &states->stats.textures))
+	{
+		glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+	}
+	return *this;
+}
+
+StateChanger& StateChanger::use_program(unsigned int program)
+{
+	if (should_change(&states->program, program, &states->stats.programs))
+	{
+		glUseProgram(program);
+	}
+	return *this;
+}
+
+StateChanger& StateChanger::bind_vertex_array(unsigned int vertex_array)
+{
+	if (should_change(&states->vertex_array, vertex_array, &states->stats.vertex_arrays))
+	{
+		glBindVertexArray(vertex_array);
+	}
+	return *this;
+}
+
+StateChanger& StateChanger::bind_array_buffer(unsigned int buffer)
+{
+	if (should_change(&states->array_buffer, buffer, &states->stats.buffers))
+	{
+		glBindBuffer(GL_ARRAY_BUFFER, buffer);
+	}
+	return *this;
+}
+
+StateChanger& StateChanger::bind_framebuffer(unsigned int framebuffer)
+{
+	if (should_change(&states->framebuffer, framebuffer, &states->stats.framebuffers))
+	{
+		glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	}
+	return *this;
+}
+
+StateChanger& StateChanger::viewport(const glm::ivec2& size)
+{
+	if (should_change(&states->viewport, glm::ivec4{0, 0, size.x, size.y}, &states->stats.viewports))
+	{
+		glViewport(0, 0, size.x, size.y);
+	}
+	return *this;
+}
+
+StateChanger& StateChanger::clear_color(const glm::vec4& color)
+{
+	if (should_change(&states->clear_color, color, &states->stats.clear_colors))
+	{
+		glClearColor(color.r, color.g, color.b, color.a);
+	}
+	return *this;
+}
+
 void bind_texture_2d(State* states, const Uniform& uniform, const Texture2d& texture)
 {
 	if (uniform.is_valid() == false)
@@ -289,4 +386,15 @@ void bind_texture_cubemap(State* states, const Uniform& uniform, const TextureCu
 	StateChanger{states}.activate_texture(uniform.texture).bind_texture_cubemap(uniform.texture, texture.id);
 }
 
+void bind_texture_2d_array(State* states, const Uniform& uniform, const TextureArray& texture)
+{
+	if (uniform.is_valid() == false)
+	{
+		return;
+	}
+	ASSERT(uniform.texture >= 0);
+
+	StateChanger{states}.activate_texture(uniform.texture).bind_texture_2d_array(uniform.texture, texture.id);
+}
+
 }  //  namespace klotter
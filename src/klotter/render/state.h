@@ -18,6 +18,7 @@ namespace klotter
 struct FrameBuffer;
 struct TextureCubemap;
 struct Texture2d;
+struct TextureArray;
 struct Uniform;
 
 
@@ -111,6 +112,31 @@ using StencilOp = std::tuple<StencilAction, StencilAction, StencilAction>;
 
 
 
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Stats
+
+/// The number of changes that were requested and how many of them were sent to the driver.
+struct StateCounter
+{
+	int requested = 0;
+	int issued = 0;
+};
+
+/// Counts the state changes, reset every frame to get the changes of a single frame.
+struct StateStats
+{
+	StateCounter capabilities;  ///< enables, masks, compare functions and modes
+	StateCounter textures;
+	StateCounter programs;
+	StateCounter vertex_arrays;
+	StateCounter buffers;
+	StateCounter framebuffers;
+	StateCounter viewports;
+	StateCounter clear_colors;
+};
+
+
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 // State
 
@@ -127,6 +153,8 @@ struct State
 	std::optional<bool> depth_mask;
 	std::optional<Compare> depth_func;
 
+	std::optional<bool> color_mask;
+
 	std::optional<bool> stencil_test;
 	std::optional<u32> stencil_mask;
 
@@ -136,8 +164,31 @@ struct State
 
 	std::optional<int> active_texture;
 	std::array<std::optional<unsigned int>, MAX_TEXTURES_SUPPORTED> texture_bound;
+
+	std::optional<unsigned int> program;
+	std::optional<unsigned int> vertex_array;
+
+	/// the element buffer is part of the vertex array and isn't tracked separately
+	std::optional<unsigned int> array_buffer;
+
+	/// bound to both the read and the draw target
+	std::optional<unsigned int> framebuffer;
+
+	std::optional<glm::ivec4> viewport;
+	std::optional<glm::vec4> clear_color;
+
+	StateStats stats;
+
+	/// the bindings above are forgotten when this doesn't match \ref invalidate_state_bindings
+	u64 bindings_generation = 0;
 };
 
+/** Call after binding or deleting objects without a \ref State.
+ * The bindings of all states are forgotten so the next bind is sent to the driver.
+ * Meant for loading and destroying objects, binding this way while rendering defeats the cache.
+ */
+void invalidate_state_bindings();
+
 
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////
@@ -155,6 +206,9 @@ struct StateChanger
 	StateChanger& depth_test(bool new_state);
 	StateChanger& depth_mask(bool new_state);
 	StateChanger& depth_func(Compare new_state);
+
+	/// Enable or disable writing to all the color channels.
+	StateChanger& color_mask(bool new_state);
 	StateChanger& stencil_test(bool new_state);
 
 	/// Set a bitmask that is ANDed with the stencil value about to be written to the buffer.
@@ -180,11 +234,20 @@ struct StateChanger
 	StateChanger& activate_texture(int new_texture);
 	StateChanger& bind_texture_2d(int slot, unsigned int texture);
 	StateChanger& bind_texture_cubemap(int slot, unsigned int texture);
+	StateChanger& bind_texture_2d_array(int slot, unsigned int texture);
+
+	StateChanger& use_program(unsigned int program);
+	StateChanger& bind_vertex_array(unsigned int vertex_array);
+	StateChanger& bind_array_buffer(unsigned int buffer);
+	StateChanger& bind_framebuffer(unsigned int framebuffer);
+	StateChanger& viewport(const glm::ivec2& size);
+	StateChanger& clear_color(const glm::vec4& color);
 };
 
 void bind_texture_2d(State* states, const Uniform& uniform, const Texture2d& texture);
 void bind_texture_2d(State* states, const Uniform& uniform, const FrameBuffer& texture);
 void bind_texture_cubemap(State* states, const Uniform& uniform, const TextureCubemap& texture);
+void bind_texture_2d_array(State* states, const Uniform& uniform, const TextureArray& texture);
 
 /**
  * @}
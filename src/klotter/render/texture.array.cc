@@ -0,0 +1,400 @@
+#include "klotter/render/texture.array.h"
+
+#include "klotter/assert.h"
+#include "klotter/cint.h"
+#include "klotter/str.h"
+
+#include <algorithm>
+#include <map>
+#include <tuple>
+
+namespace klotter
+{
+
+namespace
+{
+	bool is_power_of_two(int value)
+	{
+		return value > 0 && (value & (value - 1)) == 0;
+	}
+
+	/// the mips of the atlas stop when the padding is a single pixel
+	int calculate_atlas_level_count(int padding)
+	{
+		int levels = 1;
+		for (int size = padding; size > 1; size /= 2)
+		{
+			levels += 1;
+		}
+		return levels;
+	}
+
+	/// textures that can share a array
+	using ArrayKey = std::tuple<int, int, TextureEdge, Transparency, ColorData>;
+
+	/// textures that can share a atlas
+	using AtlasKey = std::tuple<Transparency, ColorData>;
+
+	ArrayKey array_key_from_input(const TextureArrayInput& input)
+	{
+		return {input.width, input.height, input.te, input.t, input.cd};
+	}
+
+	/// copy the image into the page and extend the edge pixels into the padding so filtering doesn't bleed
+	void blit_with_padding(RgbaImage* page, const RgbaImage& image, const AtlasRect& rect, int padding)
+	{
+		const auto min_x = std::max(0, rect.x - padding);
+		const auto min_y = std::max(0, rect.y - padding);
+		const auto max_x = std::min(page->width, rect.x + rect.width + padding);
+		const auto max_y = std::min(page->height, rect.y + rect.height + padding);
+
+		for (int y = min_y; y < max_y; y += 1)
+		{
+			const auto src_y = std::clamp(y - rect.y, 0, image.height - 1);
+			for (int x = min_x; x < max_x; x += 1)
+			{
+				const auto src_x = std::clamp(x - rect.x, 0, image.width - 1);
+				const auto* src = &image.pixels[sizet_from_int((src_y * image.width + src_x) * 4)];
+				auto* dst = &page->pixels[sizet_from_int((y * page->width + x) * 4)];
+				std::copy(src, src + 4, dst);
+			}
+		}
+	}
+}  //  namespace
+
+// ------------------------------------------------------------------------------------------------
+// atlas packer
+
+AtlasPacker::AtlasPacker(int w, int h, int p)
+	: width(w)
+	, height(h)
+	, padding(p)
+	, skyline{{0, 0, w}}
+{
+	ASSERT(is_power_of_two(padding));
+}
+
+std::optional<AtlasRect> AtlasPacker::add(int w, int h)
+{
+	ASSERT(w > 0 && h > 0);
+
+	// align the cells to the padding so the mips of each texture line up
+	const auto cell_width = round_up(w + padding * 2, padding);
+	const auto cell_height = round_up(h + padding * 2, padding);
+
+	// bottom-left: pick the position with the lowest top, and the leftmost of those
+	std::optional<std::size_t> best_index;
+	int best_y = 0;
+	for (std::size_t index = 0; index < skyline.size(); index += 1)
+	{
+		const auto x = skyline[index].x;
+		if (x + cell_width > width)
+		{
+			break;
+		}
+
+		// the cell rests on the highest node it covers
+		int y = 0;
+		for (std::size_t covered = index; covered < skyline.size() && skyline[covered].x < x + cell_width; covered += 1)
+		{
+			y = std::max(y, skyline[covered].y);
+		}
+
+		if (y + cell_height > height)
+		{
+			continue;
+		}
+
+		if (best_index.has_value() == false || y < best_y)
+		{
+			best_index = index;
+			best_y = y;
+		}
+	}
+
+	if (best_index.has_value() == false)
+	{
+		return std::nullopt;
+	}
+
+	const auto x = skyline[*best_index].x;
+	skyline.insert(skyline.begin() + static_cast<std::ptrdiff_t>(*best_index), Node{x, best_y + cell_height, cell_width});
+
+	// shrink or remove the nodes that are now below the new node
+	for (auto index = *best_index + 1; index < skyline.size();)
+	{
+		auto& node = skyline[index];
+		const auto& previous = skyline[index - 1];
+		const auto previous_end = previous.x + previous.width;
+		if (node.x >= previous_end)
+		{
+			break;
+		}
+
+		const auto shrink = previous_end - node.x;
+		if (node.width <= shrink)
+		{
+			skyline.erase(skyline.begin() + static_cast<std::ptrdiff_t>(index));
+			continue;
+		}
+
+		node.x += shrink;
+		node.width -= shrink;
+		break;
+	}
+
+	// merge neighbours at the same height
+	for (std::size_t index = 1; index < skyline.size();)
+	{
+		if (skyline[index - 1].y == skyline[index].y)
+		{
+			skyline[index - 1].width += skyline[index].width;
+			skyline.erase(skyline.begin() + static_cast<std::ptrdiff_t>(index));
+			continue;
+		}
+		index += 1;
+	}
+
+	return AtlasRect{x + padding, best_y + padding, w, h};
+}
+
+float AtlasPacker::get_usage() const
+{
+	std::size_t used = 0;
+	for (const auto& node: skyline)
+	{
+		used += sizet_from_int(node.width) * sizet_from_int(node.y);
+	}
+	return static_cast<float>(used) / (static_cast<float>(width) * static_cast<float>(height));
+}
+
+// ------------------------------------------------------------------------------------------------
+// layout
+
+int calculate_mip_level_count(int width, int height)
+{
+	int levels = 1;
+	for (int size = std::max(width, height); size > 1; size /= 2)
+	{
+		levels += 1;
+	}
+	return levels;
+}
+
+TextureArrayLayout layout_texture_arrays(const std::vector<TextureArrayInput>& inputs, const TextureArraySettings& settings)
+{
+	ASSERT(is_power_of_two(settings.atlas_padding));
+
+	std::map<ArrayKey, std::vector<std::size_t>> same_size;
+	for (std::size_t index = 0; index < inputs.size(); index += 1)
+	{
+		same_size[array_key_from_input(inputs[index])].emplace_back(index);
+	}
+
+	const auto fits_in_atlas = [&](const TextureArrayInput& input)
+	{
+		const auto max_size = settings.atlas_size - settings.atlas_padding * 2;
+		return input.width <= max_size && input.height <= max_size;
+	};
+
+	TextureArrayLayout layout;
+	layout.locations.resize(inputs.size());
+
+	// repeating textures can't be in a atlas since the texture coordinates wrap around the whole page
+	std::map<AtlasKey, std::vector<std::size_t>> atlas_candidates;
+	for (const auto& [key, indices]: same_size)
+	{
+		const auto& first = inputs[indices[0]];
+		const auto use_array = first.te == TextureEdge::repeat || int_from_sizet(indices.size()) >= settings.min_array_layers
+							|| fits_in_atlas(first) == false;
+		if (use_array == false)
+		{
+			auto& candidates = atlas_candidates[{first.t, first.cd}];
+			candidates.insert(candidates.end(), indices.begin(), indices.end());
+			continue;
+		}
+
+		const auto array_index = layout.arrays.size();
+		layout.arrays.emplace_back(TextureArrayDescription{
+			first.width,
+			first.height,
+			int_from_sizet(indices.size()),
+			calculate_mip_level_count(first.width, first.height),
+			first.te,
+			first.t,
+			first.cd,
+			false
+		});
+		for (std::size_t layer = 0; layer < indices.size(); layer += 1)
+		{
+			layout.locations[indices[layer]]
+				= TextureArrayLocation{array_index, int_from_sizet(layer), AtlasRect{0, 0, first.width, first.height}};
+		}
+	}
+
+	for (auto& [key, indices]: atlas_candidates)
+	{
+		// tallest first packs better with a skyline
+		std::ranges::sort(
+			indices,
+			[&](std::size_t lhs, std::size_t rhs)
+			{
+				const auto& l = inputs[lhs];
+				const auto& r = inputs[rhs];
+				return std::tie(r.height, r.width, lhs) < std::tie(l.height, l.width, rhs);
+			}
+		);
+
+		const auto array_index = layout.arrays.size();
+		std::vector<AtlasPacker> pages;
+		for (const auto index: indices)
+		{
+			const auto& input = inputs[index];
+
+			// first page that fits, or a new page
+			std::optional<AtlasRect> rect;
+			std::size_t page = 0;
+			while (rect.has_value() == false)
+			{
+				if (page == pages.size())
+				{
+					pages.emplace_back(settings.atlas_size, settings.atlas_size, settings.atlas_padding);
+				}
+				rect = pages[page].add(input.width, input.height);
+				if (rect.has_value() == false)
+				{
+					page += 1;
+				}
+			}
+
+			layout.locations[index] = TextureArrayLocation{array_index, int_from_sizet(page), *rect};
+		}
+
+		const auto [t, cd] = key;
+		layout.arrays.emplace_back(TextureArrayDescription{
+			settings.atlas_size,
+			settings.atlas_size,
+			int_from_sizet(pages.size()),
+			calculate_atlas_level_count(settings.atlas_padding),
+			TextureEdge::clamp,
+			t,
+			cd,
+			true
+		});
+	}
+
+	return layout;
+}
+
+glm::vec4 uv_rect_from_rect(const AtlasRect& rect, int layer_width, int layer_height)
+{
+	const auto w = float_from_int(layer_width);
+	const auto h = float_from_int(layer_height);
+	return {float_from_int(rect.x) / w, float_from_int(rect.y) / h, float_from_int(rect.width) / w, float_from_int(rect.height) / h};
+}
+
+// ------------------------------------------------------------------------------------------------
+// material texture arrays
+
+MaterialTextureId MaterialTextureArrays::add(RgbaImage image, TextureEdge te, Transparency t, ColorData cd)
+{
+	ASSERT(built.empty());
+	const auto input = TextureArrayInput{image.width, image.height, te, t, cd};
+	pending.emplace_back(Pending{std::move(image), input});
+	return pending.size() - 1;
+}
+
+MaterialTextureId MaterialTextureArrays::add_color(SingleColor color, ColorData cd)
+{
+	// a few pixels so the color survives the filtering and padding in a atlas
+	constexpr int size = 4;
+	const auto value = static_cast<std::uint32_t>(color);
+	const auto rgba = std::array<std::uint8_t, 4>{
+		static_cast<std::uint8_t>(value & 0xFF),
+		static_cast<std::uint8_t>((value >> 8) & 0xFF),
+		static_cast<std::uint8_t>((value >> 16) & 0xFF),
+		static_cast<std::uint8_t>((value >> 24) & 0xFF)
+	};
+
+	RgbaImage image{size, size, {}};
+	for (int pixel = 0; pixel < size * size; pixel += 1)
+	{
+		image.pixels.insert(image.pixels.end(), rgba.begin(), rgba.end());
+	}
+	return add(std::move(image), TextureEdge::clamp, Transparency::exclude, cd);
+}
+
+void MaterialTextureArrays::build(DEBUG_LABEL_ARG_MANY TextureRenderStyle trs, const TextureArraySettings& settings)
+{
+	ASSERT(built.empty());
+
+	std::vector<TextureArrayInput> inputs;
+	for (const auto& p: pending)
+	{
+		inputs.emplace_back(p.input);
+	}
+	const auto layout = layout_texture_arrays(inputs, settings);
+
+	for (std::size_t array_index = 0; array_index < layout.arrays.size(); array_index += 1)
+	{
+		const auto& desc = layout.arrays[array_index];
+		auto array = std::make_shared<TextureArray>(
+			USE_DEBUG_LABEL_MANY(Str() << debug_label << (desc.is_atlas ? " atlas " : " ") << array_index)
+			desc.width, desc.height, desc.layer_count, desc.level_count, desc.te, trs, desc.t, desc.cd
+		);
+
+		if (desc.is_atlas)
+		{
+			// compose each page and create the mips of the whole page, the padding keeps the textures apart
+			for (int layer = 0; layer < desc.layer_count; layer += 1)
+			{
+				RgbaImage page{desc.width, desc.height, std::vector<std::uint8_t>(sizet_from_int(desc.width * desc.height * 4))};
+				for (std::size_t index = 0; index < pending.size(); index += 1)
+				{
+					const auto& location = layout.locations[index];
+					if (location.array_index == array_index && location.layer == layer)
+					{
+						blit_with_padding(&page, pending[index].image, location.rect, settings.atlas_padding);
+					}
+				}
+
+				// the box filter keeps the aligned cells from bleeding into each other
+				auto mips = generate_mips(page, desc.cd);
+				mips.resize(sizet_from_int(desc.level_count));
+				array->upload_layer(layer, views_from_images(mips));
+			}
+		}
+		else
+		{
+			for (std::size_t index = 0; index < pending.size(); index += 1)
+			{
+				const auto& location = layout.locations[index];
+				if (location.array_index == array_index)
+				{
+					const auto mips = generate_mips(pending[index].image, desc.cd, mip_settings_from_transparency(desc.t));
+					array->upload_layer(location.layer, views_from_images(mips));
+				}
+			}
+		}
+
+		arrays.emplace_back(std::move(array));
+	}
+
+	for (std::size_t index = 0; index < pending.size(); index += 1)
+	{
+		const auto& location = layout.locations[index];
+		const auto& desc = layout.arrays[location.array_index];
+		built.emplace_back(
+			MaterialTexture{arrays[location.array_index], location.layer, uv_rect_from_rect(location.rect, desc.width, desc.height)}
+		);
+	}
+	pending.clear();
+}
+
+MaterialTexture MaterialTextureArrays::get(MaterialTextureId id) const
+{
+	ASSERT(id < built.size());
+	return built[id];
+}
+
+}  //  namespace klotter
@@ -0,0 +1,164 @@
+#pragma once
+
+#include "klotter/render/texture.mips.h"
+
+namespace klotter
+{
+
+/** \addtogroup texture
+ *  @{
+*/
+
+/// A rectangle in pixels.
+struct AtlasRect
+{
+	int x = 0;
+	int y = 0;
+	int width = 0;
+	int height = 0;
+};
+
+/// Packs rectangles into a fixed size page with the skyline bottom-left heuristic.
+/// Each rectangle is surrounded by a padding and placed on a multiple of the padding, so mips don't bleed between rectangles.
+struct AtlasPacker
+{
+	int width;
+	int height;
+	int padding;
+
+	AtlasPacker(int w, int h, int p);
+
+	/// @return the rectangle without the padding, or nullopt if the page is full
+	std::optional<AtlasRect> add(int w, int h);
+
+	/// the ratio of the page that is below the skyline, including padding and wasted space
+	[[nodiscard]] float get_usage() const;
+
+   private:
+
+	struct Node
+	{
+		int x;
+		int y;
+		int width;
+	};
+
+	std::vector<Node> skyline;
+};
+
+/// The size and format of a texture that is added to the \ref MaterialTextureArrays
+struct TextureArrayInput
+{
+	int width;
+	int height;
+	TextureEdge te;
+	Transparency t;
+	ColorData cd;
+};
+
+/// Settings for how textures are grouped in arrays.
+struct TextureArraySettings
+{
+	/// the size of a atlas page, odd sized textures larger than this get a array of their own
+	int atlas_size = 1024;
+
+	/// the padding around each texture in the atlas, must be a power of two
+	/// and limits the number of mips of the atlas so they don't bleed
+	int atlas_padding = 8;
+
+	/// the number of clamped textures of the same size needed to create a array, fewer are packed into the atlas
+	int min_array_layers = 2;
+};
+
+/// A array to create.
+struct TextureArrayDescription
+{
+	int width;
+	int height;
+	int layer_count;
+	int level_count;
+	TextureEdge te;
+	Transparency t;
+	ColorData cd;
+
+	/// if true, the layers are atlas pages and the textures are packed into them
+	bool is_atlas;
+};
+
+/// Where a texture was placed.
+struct TextureArrayLocation
+{
+	std::size_t array_index;
+	int layer;
+
+	/// the pixels of the texture in the layer, the full layer if it's not a atlas
+	AtlasRect rect;
+};
+
+/// The arrays to create and where each texture goes.
+struct TextureArrayLayout
+{
+	std::vector<TextureArrayDescription> arrays;
+
+	/// one for each input, in the same order
+	std::vector<TextureArrayLocation> locations;
+};
+
+/// The number of mip levels in a full chain down to 1x1.
+int calculate_mip_level_count(int width, int height);
+
+/// Groups the textures in arrays, repeating and common sizes get a array of their own and the rest are packed into atlas pages.
+/// This doesn't touch open gl so it can be used offline.
+TextureArrayLayout layout_texture_arrays(const std::vector<TextureArrayInput>& inputs, const TextureArraySettings& settings = {});
+
+/// The uv offset and scale of a rect in a layer, sample with `uv * rect.zw + rect.xy`.
+glm::vec4 uv_rect_from_rect(const AtlasRect& rect, int layer_width, int layer_height);
+
+/// A texture in a \ref TextureArray
+struct MaterialTexture
+{
+	std::shared_ptr<TextureArray> array;
+	int layer = 0;
+
+	/// offset in xy and scale in zw
+	glm::vec4 uv_rect = {0.0f, 0.0f, 1.0f, 1.0f};
+};
+
+/// A handle to a texture added to a \ref MaterialTextureArrays
+using MaterialTextureId = std::size_t;
+
+/// Collects material textures and packs them into texture arrays.
+/// Materials that sample from the same arrays share the binds and can be batched together.
+struct MaterialTextureArrays
+{
+	/// add a decoded image, the pixels are kept until \ref build is called
+	MaterialTextureId add(RgbaImage image, TextureEdge te, Transparency t, ColorData cd);
+
+	/// add a texture with a single color, useful as a default for a material without a texture
+	MaterialTextureId add_color(SingleColor color, ColorData cd);
+
+	/// create the arrays and upload all added images
+	void build(DEBUG_LABEL_ARG_MANY TextureRenderStyle trs, const TextureArraySettings& settings = {});
+
+	/// can only be called after \ref build
+	[[nodiscard]] MaterialTexture get(MaterialTextureId id) const;
+
+	std::vector<std::shared_ptr<TextureArray>> arrays;
+
+   private:
+
+	struct Pending
+	{
+		RgbaImage image;
+		TextureArrayInput input;
+	};
+
+	std::vector<Pending> pending;
+	std::vector<MaterialTexture> built;
+};
+
+/**
+ * @}
+*/
+
+}  //  namespace klotter
@@ -0,0 +1,122 @@
+#include "klotter/render/texture.array.h"
+
+#include "catch2/catch_test_macros.hpp"
+
+using namespace klotter;
+
+namespace
+{
+	bool overlaps(const AtlasRect& lhs, const AtlasRect& rhs, int padding)
+	{
+		return lhs.x - padding < rhs.x + rhs.width && rhs.x - padding < lhs.x + lhs.width && lhs.y - padding < rhs.y + rhs.height
+			&& rhs.y - padding < lhs.y + lhs.height;
+	}
+
+	TextureArrayInput make_input(int width, int height, TextureEdge te = TextureEdge::clamp)
+	{
+		return {width, height, te, Transparency::exclude, ColorData::color_data};
+	}
+}  //  namespace
+
+TEST_CASE("atlas_packer_places_without_overlap", "[texture]")
+{
+	constexpr int padding = 4;
+	auto packer = AtlasPacker{256, 256, padding};
+
+	std::vector<AtlasRect> placed;
+	for (int index = 0; index < 40; index += 1)
+	{
+		const auto rect = packer.add(10 + (index * 7) % 23, 5 + (index * 11) % 31);
+		REQUIRE(rect.has_value());
+		placed.emplace_back(*rect);
+	}
+
+	for (std::size_t lhs = 0; lhs < placed.size(); lhs += 1)
+	{
+		const auto& rect = placed[lhs];
+		CHECK(rect.x % padding == 0);
+		CHECK(rect.y % padding == 0);
+		CHECK(rect.x >= padding);
+		CHECK(rect.y >= padding);
+		CHECK(rect.x + rect.width + padding <= 256);
+		CHECK(rect.y + rect.height + padding <= 256);
+
+		for (std::size_t rhs = lhs + 1; rhs < placed.size(); rhs += 1)
+		{
+			CHECK_FALSE(overlaps(rect, placed[rhs], padding));
+		}
+	}
+
+	CHECK(packer.get_usage() > 0.0f);
+	CHECK(packer.get_usage() <= 1.0f);
+}
+
+TEST_CASE("atlas_packer_rejects_when_full", "[texture]")
+{
+	// the padded cells are 56x56 and 32x32
+	auto packer = AtlasPacker{96, 96, 8};
+	CHECK(packer.add(40, 40).has_value());
+	CHECK(packer.add(40, 40).has_value() == false);
+	CHECK(packer.add(16, 16).has_value());
+}
+
+TEST_CASE("texture_array_layout", "[texture]")
+{
+	const auto inputs = std::vector<TextureArrayInput>{
+		make_input(64, 64),
+		make_input(64, 64),
+		make_input(30, 20),
+		make_input(64, 64),
+		make_input(17, 45),
+		make_input(32, 32, TextureEdge::repeat),
+		make_input(2048, 100)
+	};
+	const auto layout = layout_texture_arrays(inputs);
+	REQUIRE(layout.locations.size() == inputs.size());
+
+	// same sized textures share a array
+	const auto& shared = layout.locations[0];
+	CHECK(layout.locations[1].array_index == shared.array_index);
+	CHECK(layout.locations[3].array_index == shared.array_index);
+	CHECK(layout.arrays[shared.array_index].layer_count == 3);
+	CHECK(layout.arrays[shared.array_index].level_count == 7);
+	CHECK(layout.arrays[shared.array_index].is_atlas == false);
+
+	// odd sizes share a atlas page
+	const auto& odd = layout.locations[2];
+	CHECK(layout.locations[4].array_index == odd.array_index);
+	CHECK(layout.locations[4].layer == odd.layer);
+	CHECK(layout.arrays[odd.array_index].is_atlas);
+	CHECK(layout.arrays[odd.array_index].level_count == 4);
+	CHECK(odd.rect.width == 30);
+	CHECK(odd.rect.height == 20);
+
+	// repeating and too large textures can't be in a atlas
+	CHECK(layout.arrays[layout.locations[5].array_index].is_atlas == false);
+	CHECK(layout.arrays[layout.locations[6].array_index].is_atlas == false);
+
+	CHECK(layout.arrays.size() == 4);
+}
+
+TEST_CASE("texture_array_layout_spills_to_new_page", "[texture]")
+{
+	TextureArraySettings settings;
+	settings.atlas_size = 128;
+
+	std::vector<TextureArrayInput> inputs;
+	for (int index = 0; index < 5; index += 1)
+	{
+		inputs.emplace_back(make_input(50 + index, 50));
+	}
+	const auto layout = layout_texture_arrays(inputs, settings);
+
+	REQUIRE(layout.arrays.size() == 1);
+	CHECK(layout.arrays[0].is_atlas);
+	CHECK(layout.arrays[0].layer_count == 5);
+}
+
+TEST_CASE("texture_array_uv_rect", "[texture]")
+{
+	const auto rect = uv_rect_from_rect({64, 32, 128, 16}, 256, 128);
+	CHECK(rect == glm::vec4{0.25f, 0.25f, 0.5f, 0.125f});
+}
@@ -0,0 +1,531 @@
+#include "klotter/render/texture.async.h"
+
+#include "klotter/assert.h"
+#include "klotter/cint.h"
+#include "klotter/jobs.h"
+#include "klotter/log.h"
+#include "klotter/str.h"
+
+#include "klotter/render/opengl_utils.h"
+#include "klotter/render/texture.cache.h"
+#include "klotter/render/texture.io.h"
+#include "klotter/render/texture.mips.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <variant>
+
+namespace klotter
+{
+
+namespace
+{
+	struct TextureJob
+	{
+		std::weak_ptr<Texture2d> target;
+		embedded_binary image_binary;
+		TextureRenderStyle trs;
+		Transparency transparency;
+		ColorData cd;
+		const TextureCache* cache;
+	};
+
+	struct CubemapJob
+	{
+		std::weak_ptr<TextureCubemap> target;
+		std::array<embedded_binary, cubemap_size> images;
+		ColorData cd;
+		const TextureCache* cache;
+	};
+
+	using Job = std::variant<TextureJob, CubemapJob>;
+
+	/// A job with the decoded images, one for a texture and six for a cubemap.
+	struct DecodedJob
+	{
+		Job job;
+		std::vector<PixelData> images;
+
+		/// the rgba mip chain of a texture, empty if the texture doesn't use mips
+		std::vector<RgbaImage> mips;
+	};
+
+	std::size_t channels_from_transparency(Transparency t)
+	{
+		return t == Transparency::include ? 4 : 3;
+	}
+
+	std::size_t size_of_image(const PixelData& image, std::size_t channels)
+	{
+		return sizet_from_int(image.width) * sizet_from_int(image.height) * channels;
+	}
+
+	std::size_t channels_of(const DecodedJob& decoded)
+	{
+		const auto* texture = std::get_if<TextureJob>(&decoded.job);
+		return texture ? channels_from_transparency(texture->transparency) : std::size_t{3};
+	}
+
+	/// the size of all the pixels or 0 if any image failed to decode
+	std::size_t size_of_decoded(const DecodedJob& decoded)
+	{
+		if (decoded.mips.empty() == false)
+		{
+			std::size_t total = 0;
+			for (const auto& mip: decoded.mips)
+			{
+				total += mip.pixels.size();
+			}
+			return total;
+		}
+
+		const auto channels = channels_of(decoded);
+
+		std::size_t total = 0;
+		for (const auto& image: decoded.images)
+		{
+			if (image.pixel_data == nullptr)
+			{
+				return 0;
+			}
+			total += size_of_image(image, channels);
+		}
+		return total;
+	}
+
+	/// the size of all decoded images and mips, the images are kept even if the mips are uploaded instead
+	std::size_t size_of_decoded_on_cpu(const DecodedJob& decoded)
+	{
+		const auto channels = channels_of(decoded);
+
+		std::size_t total = 0;
+		for (const auto& image: decoded.images)
+		{
+			if (image.pixel_data != nullptr)
+			{
+				total += size_of_image(image, channels);
+			}
+		}
+		for (const auto& mip: decoded.mips)
+		{
+			total += mip.pixels.size();
+		}
+		return total;
+	}
+
+	bool is_same_size(const std::vector<PixelData>& images)
+	{
+		return std::ranges::all_of(
+			images,
+			[&](const PixelData& image) { return image.width == images[0].width && image.height == images[0].height; }
+		);
+	}
+
+	bool is_valid_cubemap(const std::vector<PixelData>& images)
+	{
+		const auto is_loaded = std::ranges::all_of(images, [](const PixelData& image) { return image.pixel_data != nullptr; });
+		return images.size() == cubemap_size && is_loaded && is_same_size(images);
+	}
+
+	/// A pixel unpack buffer and the fence that signals when the last upload from it is done.
+	struct PixelBuffer
+	{
+		unsigned int id = 0;
+		std::size_t capacity = 0;
+		GLsync fence = nullptr;
+	};
+}  //  namespace
+
+struct AsyncTextureLoaderPimpl
+{
+	AsyncTextureLoaderSettings settings;
+
+	std::mutex mutex;
+	std::deque<DecodedJob> decoded;
+
+	/// number of jobs that are queued, decoding or waiting for upload
+	std::size_t pending = 0;
+
+	/// the jobs that are queued or decoding on the job system, queued jobs are skipped when stopping
+	JobCounter decoding;
+	std::atomic<bool> is_stopping = false;
+
+	// only accessed on the gl thread
+	std::vector<PixelBuffer> pixel_buffers;
+	std::size_t next_pixel_buffer = 0;
+
+	explicit AsyncTextureLoaderPimpl(const AsyncTextureLoaderSettings& s)
+		: settings(s)
+	{
+	}
+
+	~AsyncTextureLoaderPimpl()
+	{
+		is_stopping = true;
+		get_job_system().wait(&decoding);
+
+		for (auto& buffer: pixel_buffers)
+		{
+			if (buffer.fence != nullptr)
+			{
+				glDeleteSync(buffer.fence);
+			}
+			glDeleteBuffers(1, &buffer.id);
+		}
+	}
+
+	AsyncTextureLoaderPimpl(const AsyncTextureLoaderPimpl&) = delete;
+	AsyncTextureLoaderPimpl(AsyncTextureLoaderPimpl&&) = delete;
+	void operator=(const AsyncTextureLoaderPimpl&) = delete;
+	void operator=(AsyncTextureLoaderPimpl&&) = delete;
+
+	void add_job(Job job)
+	{
+		{
+			std::scoped_lock lock{mutex};
+			pending += 1;
+		}
+		get_job_system().run([this, job = std::move(job)]() mutable { decode(std::move(job)); }, &decoding);
+	}
+
+	void decode(Job job)
+	{
+		if (is_stopping)
+		{
+			return;
+		}
+
+		std::vector<PixelData> images;
+		std::vector<RgbaImage> mips;
+		if (const auto* texture = std::get_if<TextureJob>(&job); texture)
+		{
+			const auto include_transparency = texture->transparency == Transparency::include;
+			const auto channels = include_transparency ? 4 : 3;
+			images.emplace_back(texture->image_binary, include_transparency);
+			if (images[0].pixel_data && texture->cache)
+			{
+				const auto key = key_from_texture(texture->image_binary, texture->transparency, texture->cd);
+				mips = store_in_texture_cache(*texture->cache, key, images[0], channels, texture->transparency, texture->cd);
+			}
+			else if (images[0].pixel_data && texture->trs == TextureRenderStyle::mipmap)
+			{
+				const auto& image = images[0];
+				mips = generate_mips(
+					rgba_from_pixels(image.pixel_data, image.width, image.height, channels),
+					texture->cd,
+					mip_settings_from_transparency(texture->transparency)
+				);
+			}
+		}
+		else
+		{
+			const auto& cubemap = std::get<CubemapJob>(job);
+			constexpr auto include_transparency = false;
+			constexpr auto flip = false;
+			for (const auto& image: cubemap.images)
+			{
+				images.emplace_back(image, include_transparency, flip);
+			}
+			if (cubemap.cache && is_valid_cubemap(images))
+			{
+				std::vector<std::vector<MipPixels>> faces;
+				for (const auto& image: images)
+				{
+					faces.emplace_back(std::vector<MipPixels>{{image.pixel_data, image.width, image.height}});
+				}
+				cubemap.cache->store(key_from_cubemap(cubemap.images, cubemap.cd), 3, faces);
+			}
+		}
+
+		std::scoped_lock lock{mutex};
+		decoded.emplace_back(DecodedJob{std::move(job), std::move(images), std::move(mips)});
+	}
+
+	void create_pixel_buffers()
+	{
+		ASSERT(settings.pixel_buffer_count > 0);
+		pixel_buffers.resize(settings.pixel_buffer_count);
+		for (std::size_t index = 0; index < pixel_buffers.size(); index += 1)
+		{
+			glGenBuffers(1, &pixel_buffers[index].id);
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pixel_buffers[index].id);
+			SET_DEBUG_LABEL_NAMED(pixel_buffers[index].id, DebugLabelFor::Buffer, Str() << "PBO texture upload " << index);
+		}
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	}
+
+	/// returns true if the previous upload from the buffer is complete, without blocking
+	static bool is_ready(PixelBuffer* buffer)
+	{
+		if (buffer->fence == nullptr)
+		{
+			return true;
+		}
+
+		// flush so the fence is guaranteed to signal eventually
+		const auto result = glClientWaitSync(buffer->fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+		if (result == GL_TIMEOUT_EXPIRED)
+		{
+			return false;
+		}
+
+		glDeleteSync(buffer->fence);
+		buffer->fence = nullptr;
+		return true;
+	}
+
+	/// copies the pixels to the buffer, and returns the offsets of each image or mip in the buffer
+	static std::vector<void*> copy_to_buffer(PixelBuffer* buffer, const DecodedJob& job, std::size_t total_size, std::size_t channels)
+	{
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer->id);
+		if (buffer->capacity < total_size)
+		{
+			glBufferData(GL_PIXEL_UNPACK_BUFFER, static_cast<GLsizeiptr>(total_size), nullptr, GL_STREAM_DRAW);
+			buffer->capacity = total_size;
+		}
+
+		// the fence guarantees the gpu is done with the buffer so no need to synchronize
+		auto* mapped = static_cast<unsigned char*>(glMapBufferRange(
+			GL_PIXEL_UNPACK_BUFFER,
+			0,
+			static_cast<GLsizeiptr>(total_size),
+			GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT
+		));
+		ASSERT(mapped);
+
+		std::vector<void*> offsets;
+		std::size_t offset = 0;
+		const auto add = [&](const void* pixels, std::size_t size)
+		{
+			std::memcpy(mapped + offset, pixels, size);
+
+			// when a buffer is bound the pointer is a offset into the buffer
+			offsets.emplace_back(reinterpret_cast<void*>(offset));
+			offset += size;
+		};
+
+		if (job.mips.empty() == false)
+		{
+			for (const auto& mip: job.mips)
+			{
+				add(mip.pixels.data(), mip.pixels.size());
+			}
+		}
+		else
+		{
+			for (const auto& image: job.images)
+			{
+				add(image.pixel_data, size_of_image(image, channels));
+			}
+		}
+
+		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+		return offsets;
+	}
+
+	/// upload a job that failed to decode, the image is replaced with the failure color so it's visible
+	static void upload_failure(const DecodedJob& job)
+	{
+		LOG_ERROR("ERROR: Failed to load image from image source");
+		auto pixel = image_load_failure_color;
+
+		if (const auto* texture_job = std::get_if<TextureJob>(&job.job); texture_job)
+		{
+			if (auto texture = texture_job->target.lock(); texture)
+			{
+				texture->upload(&pixel, GL_RGBA, 1, 1, texture_job->trs, texture_job->transparency, texture_job->cd);
+			}
+		}
+		else
+		{
+			const auto& cubemap_job = std::get<CubemapJob>(job.job);
+			if (auto cubemap = cubemap_job.target.lock(); cubemap)
+			{
+				cubemap->upload({&pixel, &pixel, &pixel, &pixel, &pixel, &pixel}, 1, 1, cubemap_job.cd);
+			}
+		}
+	}
+
+	/// returns false if the upload had to wait for a buffer
+	bool upload(const DecodedJob& job, std::size_t* uploaded_bytes)
+	{
+		const auto total_size = size_of_decoded(job);
+		const auto is_valid = total_size > 0 && is_same_size(job.images);
+		if (is_valid == false)
+		{
+			upload_failure(job);
+			return true;
+		}
+
+		auto& buffer = pixel_buffers[next_pixel_buffer];
+		if (is_ready(&buffer) == false)
+		{
+			return false;
+		}
+
+		const auto* texture_job = std::get_if<TextureJob>(&job.job);
+		const auto* cubemap_job = std::get_if<CubemapJob>(&job.job);
+		auto texture = texture_job ? texture_job->target.lock() : nullptr;
+		auto cubemap = cubemap_job ? cubemap_job->target.lock() : nullptr;
+		if (texture == nullptr && cubemap == nullptr)
+		{
+			// nobody is using the texture anymore
+			return true;
+		}
+
+		const auto channels = texture_job ? channels_from_transparency(texture_job->transparency) : std::size_t{3};
+		const auto offsets = copy_to_buffer(&buffer, job, total_size, channels);
+
+		// rgb rows aren't always 4 byte aligned
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		const auto width = job.images[0].width;
+		const auto height = job.images[0].height;
+		if (texture && job.mips.empty() == false)
+		{
+			std::vector<MipPixels> mips;
+			for (std::size_t level = 0; level < job.mips.size(); level += 1)
+			{
+				mips.emplace_back(MipPixels{offsets[level], job.mips[level].width, job.mips[level].height});
+			}
+			texture->upload(mips, texture_job->trs, texture_job->transparency, texture_job->cd);
+		}
+		else if (texture)
+		{
+			const GLenum pixel_format = channels == 4 ? GL_RGBA : GL_RGB;
+			texture->upload(offsets[0], pixel_format, width, height, texture_job->trs, texture_job->transparency, texture_job->cd);
+		}
+		else
+		{
+			std::array<const void*, cubemap_size> faces = {};
+			std::ranges::copy(offsets, faces.begin());
+			cubemap->upload(faces, width, height, cubemap_job->cd);
+		}
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		buffer.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		next_pixel_buffer = (next_pixel_buffer + 1) % pixel_buffers.size();
+
+		*uploaded_bytes += total_size;
+		return true;
+	}
+
+	void update()
+	{
+		if (pixel_buffers.empty())
+		{
+			create_pixel_buffers();
+		}
+
+		std::size_t uploaded_bytes = 0;
+		bool has_uploaded = false;
+		while (has_uploaded == false || uploaded_bytes < settings.upload_budget_per_frame)
+		{
+			std::optional<DecodedJob> job;
+			{
+				std::scoped_lock lock{mutex};
+				if (decoded.empty())
+				{
+					break;
+				}
+				job = std::move(decoded.front());
+				decoded.pop_front();
+			}
+
+			if (upload(*job, &uploaded_bytes) == false)
+			{
+				// all buffers are in use, try again next frame
+				std::scoped_lock lock{mutex};
+				decoded.emplace_front(std::move(*job));
+				break;
+			}
+
+			has_uploaded = true;
+			std::scoped_lock lock{mutex};
+			pending -= 1;
+		}
+	}
+
+	std::size_t get_pending_count()
+	{
+		std::scoped_lock lock{mutex};
+		return pending;
+	}
+
+	std::size_t get_decoded_bytes()
+	{
+		std::scoped_lock lock{mutex};
+		std::size_t total = 0;
+		for (const auto& job: decoded)
+		{
+			total += size_of_decoded_on_cpu(job);
+		}
+		return total;
+	}
+};
+
+AsyncTextureLoader::AsyncTextureLoader(const AsyncTextureLoaderSettings& settings)
+	: pimpl(std::make_unique<AsyncTextureLoaderPimpl>(settings))
+{
+}
+
+AsyncTextureLoader::~AsyncTextureLoader() = default;
+
+std::shared_ptr<Texture2d> AsyncTextureLoader::load_texture(
+	DEBUG_LABEL_ARG_MANY const embedded_binary& image_binary,
+	TextureEdge te,
+	TextureRenderStyle trs,
+	Transparency t,
+	ColorData cd,
+	SingleColor placeholder,
+	const TextureCache* cache
+)
+{
+	auto texture = std::make_shared<Texture2d>(load_image_from_color(SEND_DEBUG_LABEL_MANY(debug_label) placeholder, te, trs, t, cd));
+	pimpl->add_job(TextureJob{texture, image_binary, trs, t, cd, cache});
+	return texture;
+}
+
+std::shared_ptr<TextureCubemap> AsyncTextureLoader::load_cubemap(
+	DEBUG_LABEL_ARG_MANY const std::array<embedded_binary, cubemap_size>& images,
+	ColorData cd,
+	SingleColor placeholder,
+	const TextureCache* cache
+)
+{
+	auto cubemap = std::make_shared<TextureCubemap>(load_cubemap_from_color(SEND_DEBUG_LABEL_MANY(debug_label) placeholder, cd));
+	pimpl->add_job(CubemapJob{cubemap, images, cd, cache});
+	return cubemap;
+}
+
+void AsyncTextureLoader::update()
+{
+	pimpl->update();
+}
+
+std::size_t AsyncTextureLoader::get_pending_count() const
+{
+	return pimpl->get_pending_count();
+}
+
+std::size_t AsyncTextureLoader::get_decoded_bytes() const
+{
+	return pimpl->get_decoded_bytes();
+}
+
+void AsyncTextureLoader::finish()
+{
+	// help decoding instead of waiting for the workers
+	get_job_system().wait(&pimpl->decoding);
+	while (pimpl->get_pending_count() > 0)
+	{
+		pimpl->update();
+		std::this_thread::yield();
+	}
+}
+
+}  //  namespace klotter
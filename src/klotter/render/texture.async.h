@@ -0,0 +1,79 @@
+#pragma once
+
+#include "klotter/render/texture.h"
+
+#include "embed/types.h"
+
+namespace klotter
+{
+
+/** \addtogroup texture
+ *  @{
+*/
+
+struct AsyncTextureLoaderPimpl;
+struct TextureCache;
+
+/// Settings for the \ref AsyncTextureLoader
+struct AsyncTextureLoaderSettings
+{
+	/// the number of pixel buffer objects used for uploading
+	std::size_t pixel_buffer_count = 3;
+
+	/// how many bytes to upload each frame, at least one texture is uploaded each frame
+	std::size_t upload_budget_per_frame = std::size_t{8} * 1024 * 1024;
+};
+
+/// Decodes images on the job system and uploads them on the gl thread.
+/// The returned textures are usable directly and show a placeholder color until the image has been uploaded.
+/// Uploads go through a ring of pixel buffer objects so the driver can copy the pixels without stalling the frame.
+struct AsyncTextureLoader
+{
+	explicit AsyncTextureLoader(const AsyncTextureLoaderSettings& settings = {});
+	~AsyncTextureLoader();
+
+	AsyncTextureLoader(const AsyncTextureLoader&) = delete;
+	AsyncTextureLoader(AsyncTextureLoader&&) = delete;
+	void operator=(const AsyncTextureLoader&) = delete;
+	void operator=(AsyncTextureLoader&&) = delete;
+
+	std::unique_ptr<AsyncTextureLoaderPimpl> pimpl;
+
+	/// @param cache if set, the decoded image is added to the cache on the worker thread
+	[[nodiscard]] std::shared_ptr<Texture2d> load_texture(
+		DEBUG_LABEL_ARG_MANY const embedded_binary& image_binary,
+		TextureEdge te,
+		TextureRenderStyle trs,
+		Transparency t,
+		ColorData cd,
+		SingleColor placeholder,
+		const TextureCache* cache = nullptr
+	);
+
+	/// @param images images in the following order: right, left, top, bottom, back and front
+	/// @param cache if set, the decoded images are added to the cache on the worker thread
+	[[nodiscard]] std::shared_ptr<TextureCubemap> load_cubemap(
+		DEBUG_LABEL_ARG_MANY const std::array<embedded_binary, cubemap_size>& images,
+		ColorData cd,
+		SingleColor placeholder,
+		const TextureCache* cache = nullptr
+	);
+
+	/// Upload decoded images within the frame budget, call once per frame on the gl thread.
+	void update();
+
+	/// the number of textures that are still decoding or waiting to be uploaded
+	[[nodiscard]] std::size_t get_pending_count() const;
+
+	/// the size of the decoded images and mips that are waiting to be uploaded
+	[[nodiscard]] std::size_t get_decoded_bytes() const;
+
+	/// Block until all textures are uploaded, useful for loading screens.
+	void finish();
+};
+
+/**
+ * @}
+*/
+
+}  //  namespace klotter
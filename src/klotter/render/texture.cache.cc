@@ -0,0 +1,271 @@
+#include "klotter/render/texture.cache.h"
+
+#include "klotter/assert.h"
+#include "klotter/cint.h"
+#include "klotter/hash.h"
+#include "klotter/log.h"
+
+#include "klotter/render/cache.h"
+#include "klotter/render/texture.io.h"
+
+#include <cstring>
+#include <sstream>
+
+namespace klotter
+{
+
+namespace
+{
+	/// bump when the layout of the file or the way mips are generated changes to invalidate all old files
+	constexpr std::uint32_t cache_version = 2;
+
+	constexpr std::uint32_t cache_magic = 0x4354'4C4B;  // "KLTC"
+
+	struct CacheHeader
+	{
+		std::uint32_t magic;
+		std::uint32_t version;
+		TextureCacheKey key;
+		std::uint32_t channels;
+		std::uint32_t face_count;
+		std::uint32_t mip_count;
+		std::uint32_t padding;
+	};
+
+	struct CacheMip
+	{
+		std::uint32_t width;
+		std::uint32_t height;
+		std::uint64_t offset;
+	};
+
+	std::size_t size_of_mip(const CacheMip& mip, std::uint32_t channels)
+	{
+		return std::size_t{mip.width} * std::size_t{mip.height} * std::size_t{channels};
+	}
+}  //  namespace
+
+TextureCacheKey key_from_images(std::span<const embedded_binary> images, Transparency t, ColorData cd, bool flip)
+{
+	auto hash = fnv1a_offset_basis;
+	hash = hash_fnv1a(hash, &cache_version, sizeof(cache_version));
+	for (const auto& image: images)
+	{
+		hash = hash_fnv1a(hash, image.data, image.size);
+	}
+	const auto settings = std::array<std::uint8_t, 3>{
+		static_cast<std::uint8_t>(t), static_cast<std::uint8_t>(cd), static_cast<std::uint8_t>(flip ? 1 : 0)
+	};
+	return hash_fnv1a(hash, settings.data(), settings.size());
+}
+
+TextureCacheKey key_from_texture(const embedded_binary& image, Transparency t, ColorData cd)
+{
+	constexpr auto flip = true;
+	return key_from_images({&image, 1}, t, cd, flip);
+}
+
+TextureCacheKey key_from_cubemap(const std::array<embedded_binary, cubemap_size>& images, ColorData cd)
+{
+	constexpr auto flip = false;
+	return key_from_images(images, Transparency::exclude, cd, flip);
+}
+
+// ------------------------------------------------------------------------------------------------
+// cache
+
+TextureCache::TextureCache(std::filesystem::path dir)
+	: directory(std::move(dir))
+{
+}
+
+std::filesystem::path TextureCache::path_from_key(TextureCacheKey key) const
+{
+	std::ostringstream name;
+	name << std::hex << key << ".texcache";
+	return directory / name.str();
+}
+
+bool TextureCache::contains(TextureCacheKey key) const
+{
+	std::error_code error;
+	return std::filesystem::exists(path_from_key(key), error);
+}
+
+std::optional<CachedImage> TextureCache::load(TextureCacheKey key) const
+{
+	auto file = std::make_unique<MappedFile>(path_from_key(key));
+	if (file->data == nullptr || file->size < sizeof(CacheHeader))
+	{
+		return std::nullopt;
+	}
+
+	CacheHeader header;
+	std::memcpy(&header, file->data, sizeof(CacheHeader));
+	if (header.magic != cache_magic || header.version != cache_version || header.key != key)
+	{
+		LOG_INFO("Texture cache file for %llx is stale", static_cast<unsigned long long>(key));
+		return std::nullopt;
+	}
+
+	const auto mip_table_size = std::size_t{header.face_count} * std::size_t{header.mip_count} * sizeof(CacheMip);
+	if (header.face_count == 0 || header.mip_count == 0 || sizeof(CacheHeader) + mip_table_size > file->size)
+	{
+		return std::nullopt;
+	}
+
+	CachedImage image;
+	image.channels = static_cast<int>(header.channels);
+	for (std::uint32_t face = 0; face < header.face_count; face += 1)
+	{
+		auto& mips = image.faces.emplace_back();
+		for (std::uint32_t level = 0; level < header.mip_count; level += 1)
+		{
+			CacheMip mip;
+			const auto entry = sizeof(CacheHeader) + (std::size_t{face} * header.mip_count + level) * sizeof(CacheMip);
+			std::memcpy(&mip, file->data + entry, sizeof(CacheMip));
+
+			if (mip.offset + size_of_mip(mip, header.channels) > file->size)
+			{
+				LOG_INFO("Texture cache file for %llx is truncated", static_cast<unsigned long long>(key));
+				return std::nullopt;
+			}
+			mips.emplace_back(MipPixels{file->data + mip.offset, static_cast<int>(mip.width), static_cast<int>(mip.height)});
+		}
+	}
+
+	image.file = std::move(file);
+	return image;
+}
+
+void TextureCache::store(TextureCacheKey key, int channels, const std::vector<std::vector<MipPixels>>& faces) const
+{
+	ASSERT(faces.empty() == false);
+	const auto mip_count = faces[0].size();
+
+	const auto header = CacheHeader{
+		cache_magic, cache_version, key, static_cast<std::uint32_t>(channels), u32_from_sizet(faces.size()), u32_from_sizet(mip_count), 0
+	};
+
+	std::vector<CacheMip> table;
+	auto offset = sizeof(CacheHeader) + faces.size() * mip_count * sizeof(CacheMip);
+	for (const auto& face: faces)
+	{
+		ASSERT(face.size() == mip_count);
+		for (const auto& mip: face)
+		{
+			const auto entry = CacheMip{static_cast<std::uint32_t>(mip.width), static_cast<std::uint32_t>(mip.height), offset};
+			table.emplace_back(entry);
+			offset += size_of_mip(entry, header.channels);
+		}
+	}
+
+	std::vector<std::span<const std::byte>> parts = {std::as_bytes(std::span{&header, 1}), std::as_bytes(std::span{table})};
+	std::size_t entry = 0;
+	for (const auto& face: faces)
+	{
+		for (const auto& mip: face)
+		{
+			parts.emplace_back(static_cast<const std::byte*>(mip.pixels), size_of_mip(table[entry], header.channels));
+			entry += 1;
+		}
+	}
+
+	std::ignore = write_file_atomically(path_from_key(key), parts);
+}
+
+std::filesystem::path default_texture_cache_directory()
+{
+	return default_cache_directory("klotter-texture-cache");
+}
+
+// ------------------------------------------------------------------------------------------------
+// loading
+
+std::vector<RgbaImage> store_in_texture_cache(
+	const TextureCache& cache, TextureCacheKey key, const PixelData& image, int channels, Transparency t, ColorData cd
+)
+{
+	ASSERT(image.pixel_data != nullptr);
+
+	const auto mips = generate_mips(rgba_from_pixels(image.pixel_data, image.width, image.height, channels), cd, mip_settings_from_transparency(t));
+	cache.store(key, 4, {views_from_images(mips)});
+	return mips;
+}
+
+Texture2d load_image_from_cache(
+	DEBUG_LABEL_ARG_MANY
+	const TextureCache& cache, const embedded_binary& image_binary, TextureEdge te, TextureRenderStyle trs, Transparency t, ColorData cd
+)
+{
+	const auto key = key_from_texture(image_binary, t, cd);
+
+	if (const auto cached = cache.load(key); cached && cached->channels == 4 && cached->faces.size() == 1)
+	{
+		return {SEND_DEBUG_LABEL_MANY(debug_label) cached->faces[0], te, trs, t, cd};
+	}
+
+	const auto include_transparency = t == Transparency::include;
+	const auto parsed = PixelData{image_binary, include_transparency};
+	if (parsed.pixel_data == nullptr)
+	{
+		LOG_ERROR("ERROR: Failed to load image from image source");
+		return load_image_from_color(SEND_DEBUG_LABEL_MANY(debug_label) image_load_failure_color, te, trs, t, cd);
+	}
+
+	const auto mips = store_in_texture_cache(cache, key, parsed, include_transparency ? 4 : 3, t, cd);
+	return {SEND_DEBUG_LABEL_MANY(debug_label) views_from_images(mips), te, trs, t, cd};
+}
+
+TextureCubemap load_cubemap_from_cache(
+	DEBUG_LABEL_ARG_MANY
+	const TextureCache& cache, const std::array<embedded_binary, cubemap_size>& images, ColorData cd
+)
+{
+	const auto key = key_from_cubemap(images, cd);
+
+	if (const auto cached = cache.load(key); cached && cached->channels == 3 && cached->faces.size() == cubemap_size)
+	{
+		const auto& faces = cached->faces;
+		const auto width = faces[0][0].width;
+		const auto height = faces[0][0].height;
+		return {
+			SEND_DEBUG_LABEL_MANY(debug_label)
+			{faces[0][0].pixels, faces[1][0].pixels, faces[2][0].pixels, faces[3][0].pixels, faces[4][0].pixels, faces[5][0].pixels},
+			width,
+			height,
+			cd
+		};
+	}
+
+	// a miss, load as usual and cache the faces if they are valid
+	std::vector<PixelData> parsed;
+	for (const auto& image: images)
+	{
+		constexpr auto include_transparency = false;
+		constexpr auto flip = false;
+		parsed.emplace_back(image, include_transparency, flip);
+	}
+	const auto is_valid = std::ranges::all_of(
+		parsed,
+		[&](const PixelData& face)
+		{ return face.pixel_data != nullptr && face.width == parsed[0].width && face.height == parsed[0].height; }
+	);
+	if (is_valid == false)
+	{
+		return load_cubemap_from_embedded(SEND_DEBUG_LABEL_MANY(debug_label) images, cd);
+	}
+
+	std::vector<std::vector<MipPixels>> faces;
+	std::array<const void*, cubemap_size> pixels = {};
+	for (std::size_t face = 0; face < cubemap_size; face += 1)
+	{
+		faces.emplace_back(std::vector<MipPixels>{{parsed[face].pixel_data, parsed[face].width, parsed[face].height}});
+		pixels[face] = parsed[face].pixel_data;
+	}
+	cache.store(key, 3, faces);
+
+	return {SEND_DEBUG_LABEL_MANY(debug_label) pixels, parsed[0].width, parsed[0].height, cd};
+}
+
+}  //  namespace klotter
@@ -0,0 +1,91 @@
+#pragma once
+
+#include "klotter/mapped_file.h"
+
+#include "klotter/render/texture.compress.h"
+
+#include "embed/types.h"
+
+#include <filesystem>
+#include <span>
+
+namespace klotter
+{
+
+/** \addtogroup texture
+ *  @{
+*/
+
+struct PixelData;
+
+/// Identifies a decoded image in the \ref TextureCache.
+using TextureCacheKey = std::uint64_t;
+
+/// Creates a key from the source bytes and the settings that change the decoded pixels.
+TextureCacheKey key_from_images(std::span<const embedded_binary> images, Transparency t, ColorData cd, bool flip);
+
+/// The key of a texture loaded with \ref load_image_from_cache
+TextureCacheKey key_from_texture(const embedded_binary& image, Transparency t, ColorData cd);
+
+/// The key of a cubemap loaded with \ref load_cubemap_from_cache
+TextureCacheKey key_from_cubemap(const std::array<embedded_binary, cubemap_size>& images, ColorData cd);
+
+/// A image loaded from the cache, the pixels point into the mapped file.
+struct CachedImage
+{
+	std::unique_ptr<MappedFile> file;
+
+	/// 3 for rgb and 4 for rgba
+	int channels = 0;
+
+	/// the mips of each face, a texture has 1 face and a cubemap has 6
+	std::vector<std::vector<MipPixels>> faces;
+};
+
+/// Stores decoded pixels and the cpu generated mip chain as raw files that can be mapped directly on the next run.
+/// A missing, broken or stale file is treated as a cache miss.
+struct TextureCache
+{
+	std::filesystem::path directory;
+
+	explicit TextureCache(std::filesystem::path dir);
+
+	/// returns true if there is a file for the key, the file may still be stale
+	[[nodiscard]] bool contains(TextureCacheKey key) const;
+
+	[[nodiscard]] std::optional<CachedImage> load(TextureCacheKey key) const;
+
+	/// Writes the faces to the cache with \ref write_file_atomically, safe to call from multiple threads.
+	void store(TextureCacheKey key, int channels, const std::vector<std::vector<MipPixels>>& faces) const;
+
+	[[nodiscard]] std::filesystem::path path_from_key(TextureCacheKey key) const;
+};
+
+/// The texture cache in the \ref default_cache_directory.
+std::filesystem::path default_texture_cache_directory();
+
+/// Generates the mips of a decoded rgb or rgba image and stores them as rgba in the cache, safe to call from any thread.
+/// @return the full mip chain that was stored
+std::vector<RgbaImage> store_in_texture_cache(
+	const TextureCache& cache, TextureCacheKey key, const PixelData& image, int channels, Transparency t, ColorData cd
+);
+
+/// Load a texture from the cache, on a miss the image is decoded and added to the cache.
+[[nodiscard]]
+Texture2d load_image_from_cache(
+	DEBUG_LABEL_ARG_MANY
+	const TextureCache& cache, const embedded_binary& image_binary, TextureEdge te, TextureRenderStyle trs, Transparency t, ColorData cd
+);
+
+/// Load a cubemap from the cache, on a miss the images are decoded and added to the cache.
+[[nodiscard]]
+TextureCubemap load_cubemap_from_cache(
+	DEBUG_LABEL_ARG_MANY
+	const TextureCache& cache, const std::array<embedded_binary, cubemap_size>& images, ColorData cd
+);
+
+/**
+ * @}
+*/
+
+}  //  namespace klotter
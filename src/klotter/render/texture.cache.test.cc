@@ -0,0 +1,100 @@
+#include "klotter/render/texture.cache.h"
+
+#include "catch2/catch_test_macros.hpp"
+
+#include <fstream>
+
+using namespace klotter;
+
+namespace
+{
+	const auto source_bytes = std::array<char, 4>{'a', 'b', 'c', 'd'};
+	const auto other_bytes = std::array<char, 4>{'a', 'b', 'c', 'e'};
+
+	const embedded_binary source{source_bytes.data(), static_cast<unsigned int>(source_bytes.size())};
+	const embedded_binary other{other_bytes.data(), static_cast<unsigned int>(other_bytes.size())};
+
+	/// a empty cache in the temp folder
+	TextureCache make_cache(const std::string& name)
+	{
+		const auto dir = std::filesystem::temp_directory_path() / "klotter-texture-cache-test" / name;
+		std::filesystem::remove_all(dir);
+		return TextureCache{dir};
+	}
+
+	std::vector<std::vector<MipPixels>> single_face(const std::vector<std::uint8_t>& large, const std::vector<std::uint8_t>& small)
+	{
+		return {{MipPixels{large.data(), 2, 2}, MipPixels{small.data(), 1, 1}}};
+	}
+}  //  namespace
+
+TEST_CASE("texture_cache_key", "[texture]")
+{
+	const auto key = key_from_texture(source, Transparency::exclude, ColorData::color_data);
+
+	CHECK(key == key_from_texture(source, Transparency::exclude, ColorData::color_data));
+	CHECK(key != key_from_texture(other, Transparency::exclude, ColorData::color_data));
+	CHECK(key != key_from_texture(source, Transparency::include, ColorData::color_data));
+	CHECK(key != key_from_texture(source, Transparency::exclude, ColorData::non_color_data));
+	CHECK(key != key_from_images({&source, 1}, Transparency::exclude, ColorData::color_data, false));
+}
+
+TEST_CASE("texture_cache_roundtrip", "[texture]")
+{
+	const auto cache = make_cache("roundtrip");
+	const auto key = key_from_texture(source, Transparency::include, ColorData::color_data);
+
+	const auto large = std::vector<std::uint8_t>{
+		1, 2, 3, 4, 5, 6, 7, 8,
+		9, 10, 11, 12, 13, 14, 15, 16
+	};
+	const auto small = std::vector<std::uint8_t>{17, 18, 19, 20};
+
+	CHECK(cache.contains(key) == false);
+	CHECK(cache.load(key).has_value() == false);
+
+	cache.store(key, 4, single_face(large, small));
+	REQUIRE(cache.contains(key));
+
+	const auto loaded = cache.load(key);
+	REQUIRE(loaded.has_value());
+	CHECK(loaded->channels == 4);
+	REQUIRE(loaded->faces.size() == 1);
+	REQUIRE(loaded->faces[0].size() == 2);
+
+	const auto& mips = loaded->faces[0];
+	CHECK(mips[0].width == 2);
+	CHECK(mips[0].height == 2);
+	CHECK(mips[1].width == 1);
+	CHECK(mips[1].height == 1);
+
+	const auto* first = static_cast<const std::uint8_t*>(mips[0].pixels);
+	const auto* second = static_cast<const std::uint8_t*>(mips[1].pixels);
+	CHECK(std::vector<std::uint8_t>(first, first + large.size()) == large);
+	CHECK(std::vector<std::uint8_t>(second, second + small.size()) == small);
+}
+
+TEST_CASE("texture_cache_broken_files_are_misses", "[texture]")
+{
+	const auto cache = make_cache("broken");
+	const auto key = key_from_texture(source, Transparency::include, ColorData::color_data);
+
+	const auto large = std::vector<std::uint8_t>(16, 0x42);
+	const auto small = std::vector<std::uint8_t>(4, 0x42);
+	cache.store(key, 4, single_face(large, small));
+
+	SECTION("truncated")
+	{
+		const auto path = cache.path_from_key(key);
+		std::filesystem::resize_file(path, std::filesystem::file_size(path) - 1);
+		CHECK(cache.load(key).has_value() == false);
+	}
+
+	SECTION("stale")
+	{
+		// a file from a other key or a older version
+		const auto other_key = key_from_texture(other, Transparency::include, ColorData::color_data);
+		std::filesystem::copy_file(cache.path_from_key(key), cache.path_from_key(other_key));
+		CHECK(cache.load(other_key).has_value() == false);
+	}
+}
@@ -7,7 +7,11 @@
 #include "klotter/cpp.h"
 
 #include "klotter/render/opengl_utils.h"
+#include "klotter/render/state.h"
+#include "klotter/render/texture.compress.h"
 #include "klotter/render/texture.io.h"
+#include "klotter/render/texture.ktx.h"
+#include "klotter/render/texture.mips.h"
 
 #include "stb_image.h"
 
@@ -24,11 +28,11 @@ namespace klotter
 
 namespace
 {
-	/// the color of an image that failed to load, html hot-pink
-	constexpr SingleColor image_load_failure_color = color_from_rgba(0xFF, 0x69, 0xB4, 0xFF);
-
 	constexpr unsigned int invalid_id = 0;
 
+	/// the open gl default for GL_TEXTURE_MAX_LEVEL
+	constexpr GLint default_max_level = 1000;
+
 	[[nodiscard]]
 	unsigned int create_texture()
 	{
@@ -84,6 +88,67 @@ namespace
 			return GL_RGBA;
 		}
 	}
+
+	// s3tc isn't core so the enums aren't in the glad profile, check is_block_format_supported before using them
+	constexpr GLenum gl_compressed_rgb_s3tc_dxt1 = 0x83F0;
+	constexpr GLenum gl_compressed_rgba_s3tc_dxt5 = 0x83F3;
+	constexpr GLenum gl_compressed_srgb_s3tc_dxt1 = 0x8C4C;
+	constexpr GLenum gl_compressed_srgb_alpha_s3tc_dxt5 = 0x8C4F;
+
+	[[nodiscard]]
+	GLenum internal_format_from_block_format(BlockFormat format, ColorData cd)
+	{
+		const auto is_srgb = cd == ColorData::color_data;
+		switch (format)
+		{
+		case BlockFormat::bc1: return is_srgb ? gl_compressed_srgb_s3tc_dxt1 : gl_compressed_rgb_s3tc_dxt1;
+		case BlockFormat::bc3: return is_srgb ? gl_compressed_srgb_alpha_s3tc_dxt5 : gl_compressed_rgba_s3tc_dxt5;
+		case BlockFormat::bc4: return GL_COMPRESSED_RED_RGTC1;
+		case BlockFormat::bc5: return GL_COMPRESSED_RG_RGTC2;
+		case BlockFormat::bc7: return is_srgb ? GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM : GL_COMPRESSED_RGBA_BPTC_UNORM;
+		default:
+			DIE("Invalid block format");
+			return GL_COMPRESSED_RGBA_BPTC_UNORM;
+		}
+	}
+
+	/// if the driver can sample the format, if not the blocks are decoded on the cpu before uploading
+	[[nodiscard]]
+	bool is_block_format_supported(BlockFormat format)
+	{
+		const auto is_version = [](int major, int minor) { return GLVersion.major > major || (GLVersion.major == major && GLVersion.minor >= minor); };
+		switch (format)
+		{
+		case BlockFormat::bc1:
+		case BlockFormat::bc3: return has_gl_extension("GL_EXT_texture_compression_s3tc");
+		// rgtc is core since 3.0
+		case BlockFormat::bc4:
+		case BlockFormat::bc5: return true;
+		case BlockFormat::bc7: return is_version(4, 2) || has_gl_extension("GL_ARB_texture_compression_bptc");
+		default:
+			DIE("Invalid block format");
+			return false;
+		}
+	}
+
+	[[nodiscard]]
+	Transparency transparency_from_block_format(BlockFormat format)
+	{
+		return format == BlockFormat::bc3 || format == BlockFormat::bc7 ? Transparency::include : Transparency::exclude;
+	}
+
+	/// assumes 4 bytes per pixel since most drivers pad rgb to rgba
+	std::size_t gpu_bytes_of_image(int width, int height, bool include_mips)
+	{
+		std::size_t bytes = sizet_from_int(width) * sizet_from_int(height) * 4;
+		while (include_mips && (width > 1 || height > 1))
+		{
+			width = std::max(1, width / 2);
+			height = std::max(1, height / 2);
+			bytes += sizet_from_int(width) * sizet_from_int(height) * 4;
+		}
+		return bytes;
+	}
 }  //  namespace
 
 // ------------------------------------------------------------------------------------------------
@@ -101,8 +166,10 @@ BaseTexture::~BaseTexture()
 
 BaseTexture::BaseTexture(BaseTexture&& rhs) noexcept
 	: id(rhs.id)
+	, gpu_bytes(rhs.gpu_bytes)
 {
 	rhs.id = invalid_id;
+	rhs.gpu_bytes = 0;
 }
 
 BaseTexture& BaseTexture::operator=(BaseTexture&& rhs) noexcept
@@ -110,8 +177,10 @@ BaseTexture& BaseTexture::operator=(BaseTexture&& rhs) noexcept
 	unload();
 
 	id = rhs.id;
+	gpu_bytes = rhs.gpu_bytes;
 
 	rhs.id = invalid_id;
+	rhs.gpu_bytes = 0;
 
 	return *this;
 }
@@ -122,6 +191,10 @@ void BaseTexture::unload()
 	{
 		glDeleteTextures(1, &id);
 		id = invalid_id;
+		gpu_bytes = 0;
+
+		// the name can be reused by the next texture
+		invalidate_state_bindings();
 	}
 }
 
@@ -132,14 +205,28 @@ Texture2d::Texture2d(DEBUG_LABEL_ARG_MANY const void* pixel_data, unsigned int p
 {
 	// todo(Gustav): use states
 	glBindTexture(GL_TEXTURE_2D, id);
+	invalidate_state_bindings();
 	SET_DEBUG_LABEL_NAMED(id, DebugLabelFor::Texture, Str() << "TEXTURE2d " << debug_label);
 
 	set_texture_wrap(GL_TEXTURE_2D, te, std::nullopt);
 
+	upload(pixel_data, pixel_format, width, height, trs, t, cd);
+}
+
+void Texture2d::upload(const void* pixel_data, unsigned int pixel_format, int width, int height, TextureRenderStyle trs, Transparency t, ColorData cd)
+{
+	// todo(Gustav): use states
+	glBindTexture(GL_TEXTURE_2D, id);
+	invalidate_state_bindings();
+
 	const auto filter = min_mag_from_trs(trs);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter.min);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter.mag);
 
+	// reset the levels in case the texture was uploaded with baked mips before
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, default_max_level);
+
 	glTexImage2D(
 		GL_TEXTURE_2D,
 		0,
@@ -156,49 +243,169 @@ Texture2d::Texture2d(DEBUG_LABEL_ARG_MANY const void* pixel_data, unsigned int p
 	{
 		glGenerateMipmap(GL_TEXTURE_2D);
 	}
+
+	gpu_bytes = gpu_bytes_of_image(width, height, trs == TextureRenderStyle::mipmap);
+}
+
+Texture2d::Texture2d(DEBUG_LABEL_ARG_MANY const std::vector<MipPixels>& mips, TextureEdge te, TextureRenderStyle trs, Transparency t, ColorData cd)
+{
+	// todo(Gustav): use states
+	glBindTexture(GL_TEXTURE_2D, id);
+	invalidate_state_bindings();
+	SET_DEBUG_LABEL_NAMED(id, DebugLabelFor::Texture, Str() << "TEXTURE2d " << debug_label);
+
+	set_texture_wrap(GL_TEXTURE_2D, te, std::nullopt);
+
+	upload(mips, trs, t, cd);
 }
 
-struct PixelData
+void Texture2d::upload(const std::vector<MipPixels>& mips, TextureRenderStyle trs, Transparency t, ColorData cd)
 {
-	stbi_uc* pixel_data = nullptr;
-	int width = 0;
-	int height = 0;
+	ASSERT(mips.empty() == false);
+
+	// todo(Gustav): use states
+	glBindTexture(GL_TEXTURE_2D, id);
+	invalidate_state_bindings();
+
+	const auto filter = min_mag_from_trs(trs);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter.min);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter.mag);
+
+	// if mips are requested but not all are provided, generate the rest
+	const auto has_all_mips = mips.back().width == 1 && mips.back().height == 1;
+	const auto level_count = trs == TextureRenderStyle::mipmap ? mips.size() : 1;
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, has_all_mips || trs != TextureRenderStyle::mipmap ? int_from_sizet(level_count) - 1 : default_max_level);
 
-	PixelData(const embedded_binary& image_binary, bool include_transparency, bool flip = true)
+	// allocate all levels first so the driver doesn't reallocate when a level is added
+	for (std::size_t level = 0; level < level_count; level += 1)
 	{
-		int junk_channels = 0;
-		stbi_set_flip_vertically_on_load(flip ? 1 : 0);
+		glTexImage2D(
+			GL_TEXTURE_2D,
+			int_from_sizet(level),
+			internal_format_from_color_data(t, cd),
+			mips[level].width,
+			mips[level].height,
+			0,
+			GL_RGBA,
+			GL_UNSIGNED_BYTE,
+			nullptr
+		);
+	}
 
-		pixel_data = stbi_load_from_memory(
-			reinterpret_cast<const unsigned char*>(image_binary.data),
-			int_from_unsigned_int(image_binary.size),
-			&width,
-			&height,
-			&junk_channels,
-			include_transparency ? 4 : 3
+	for (std::size_t level = 0; level < level_count; level += 1)
+	{
+		glTexSubImage2D(
+			GL_TEXTURE_2D, int_from_sizet(level), 0, 0, mips[level].width, mips[level].height, GL_RGBA, GL_UNSIGNED_BYTE, mips[level].pixels
 		);
+	}
 
-		if (pixel_data == nullptr)
-		{
-			LOG_ERROR("ERROR: Failed to read pixel data");
-			width = 0;
-			height = 0;
-		}
+	if (trs == TextureRenderStyle::mipmap && has_all_mips == false)
+	{
+		glGenerateMipmap(GL_TEXTURE_2D);
 	}
 
-	~PixelData()
+	gpu_bytes = gpu_bytes_of_image(mips[0].width, mips[0].height, trs == TextureRenderStyle::mipmap);
+}
+
+Texture2d::Texture2d(DEBUG_LABEL_ARG_MANY const CompressedTexture& compressed, TextureEdge te, TextureRenderStyle trs)
+{
+	// todo(Gustav): use states
+	glBindTexture(GL_TEXTURE_2D, id);
+	invalidate_state_bindings();
+	SET_DEBUG_LABEL_NAMED(id, DebugLabelFor::Texture, Str() << "TEXTURE2d " << debug_label);
+
+	set_texture_wrap(GL_TEXTURE_2D, te, std::nullopt);
+
+	upload(compressed, trs);
+}
+
+void Texture2d::upload(const CompressedTexture& compressed, TextureRenderStyle trs)
+{
+	ASSERT(compressed.mips.empty() == false);
+
+	// only upload the first level if mips aren't used, otherwise use the baked mips
+	const auto level_count = trs == TextureRenderStyle::mipmap ? compressed.mips.size() : 1;
+
+	if (is_block_format_supported(compressed.format) == false)
 	{
-		if (pixel_data != nullptr)
-		{
-			stbi_image_free(pixel_data);
-		}
+		LOG_INFO("Block format isn't supported by the driver, decoding %d mips on the cpu", int_from_sizet(level_count));
+		const auto decoded = decode_texture(compressed, level_count);
+		upload(views_from_images(decoded), trs, transparency_from_block_format(compressed.format), compressed.cd);
+		return;
 	}
 
-	PixelData(const PixelData&) = delete;
-	PixelData(PixelData&&) = delete;
-	void operator=(const PixelData&) = delete;
-	void operator=(PixelData&&) = delete;
-};
+	// todo(Gustav): use states
+	glBindTexture(GL_TEXTURE_2D, id);
+	invalidate_state_bindings();
+
+	const auto filter = min_mag_from_trs(trs);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter.min);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter.mag);
+
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, int_from_sizet(level_count) - 1);
+
+	const auto internal_format = internal_format_from_block_format(compressed.format, compressed.cd);
+	gpu_bytes = 0;
+	for (std::size_t level = 0; level < level_count; level += 1)
+	{
+		const auto& mip = compressed.mips[level];
+		gpu_bytes += mip.data.size();
+		glCompressedTexImage2D(
+			GL_TEXTURE_2D,
+			int_from_sizet(level),
+			internal_format,
+			mip.width,
+			mip.height,
+			0,
+			int_from_sizet(mip.data.size()),
+			mip.data.data()
+		);
+	}
+}
+
+PixelData::PixelData(const embedded_binary& image_binary, bool include_transparency, bool flip)
+{
+	int junk_channels = 0;
+
+	// the thread version so images can be decoded on worker threads
+	stbi_set_flip_vertically_on_load_thread(flip ? 1 : 0);
+
+	pixel_data = stbi_load_from_memory(
+		reinterpret_cast<const unsigned char*>(image_binary.data),
+		int_from_unsigned_int(image_binary.size),
+		&width,
+		&height,
+		&junk_channels,
+		include_transparency ? 4 : 3
+	);
+
+	if (pixel_data == nullptr)
+	{
+		LOG_ERROR("ERROR: Failed to read pixel data");
+		width = 0;
+		height = 0;
+	}
+}
+
+PixelData::~PixelData()
+{
+	if (pixel_data != nullptr)
+	{
+		stbi_image_free(pixel_data);
+	}
+}
+
+PixelData::PixelData(PixelData&& rhs) noexcept
+	: pixel_data(rhs.pixel_data)
+	, width(rhs.width)
+	, height(rhs.height)
+{
+	rhs.pixel_data = nullptr;
+	rhs.width = 0;
+	rhs.height = 0;
+}
 
 [[nodiscard]]
 Texture2d load_image_from_embedded(
@@ -214,25 +421,122 @@ Texture2d load_image_from_embedded(
 		return load_image_from_color(SEND_DEBUG_LABEL_MANY(debug_label) image_load_failure_color, te, trs, t, cd);
 	}
 
+	if (trs == TextureRenderStyle::mipmap)
+	{
+		// generate the mips on the cpu since glGenerateMipmap doesn't filter in linear space on all drivers
+		const auto channels = include_transparency ? 4 : 3;
+		const auto mips = generate_mips(
+			rgba_from_pixels(parsed.pixel_data, parsed.width, parsed.height, channels), cd, mip_settings_from_transparency(t)
+		);
+		return {SEND_DEBUG_LABEL_MANY(debug_label) views_from_images(mips), te, trs, t, cd};
+	}
+
 	const GLenum pixel_format = include_transparency ? GL_RGBA : GL_RGB;
 	return {SEND_DEBUG_LABEL_MANY(debug_label) parsed.pixel_data, pixel_format, parsed.width, parsed.height, te, trs, t, cd};
 }
 
+[[nodiscard]]
+Texture2d load_image_from_ktx2(DEBUG_LABEL_ARG_MANY const embedded_binary& container, TextureEdge te, TextureRenderStyle trs)
+{
+	const auto compressed = read_ktx2(reinterpret_cast<const std::uint8_t*>(container.data), container.size);
+	if (compressed.has_value() == false)
+	{
+		LOG_ERROR("ERROR: Failed to load compressed image from image source");
+		return load_image_from_color(
+			SEND_DEBUG_LABEL_MANY(debug_label) image_load_failure_color, te, trs, Transparency::exclude, ColorData::color_data
+		);
+	}
+
+	return {SEND_DEBUG_LABEL_MANY(debug_label) *compressed, te, trs};
+}
+
 [[nodiscard]]
 Texture2d load_image_from_color(DEBUG_LABEL_ARG_MANY SingleColor pixel, TextureEdge te, TextureRenderStyle trs, Transparency t, ColorData cd)
 {
 	return {SEND_DEBUG_LABEL_MANY(debug_label) & pixel, GL_RGBA, 1, 1, te, trs, t, cd};
 }
 
+// ------------------------------------------------------------------------------------------------
+// texture array
+
+TextureArray::TextureArray(
+	DEBUG_LABEL_ARG_MANY int w, int h, int layers, int levels, TextureEdge te, TextureRenderStyle trs, Transparency t, ColorData cd
+)
+	: width(w)
+	, height(h)
+	, layer_count(layers)
+	, level_count(trs == TextureRenderStyle::mipmap ? levels : 1)
+{
+	ASSERT(layers > 0 && levels > 0);
+
+	// todo(Gustav): use states
+	glBindTexture(GL_TEXTURE_2D_ARRAY, id);
+	invalidate_state_bindings();
+	SET_DEBUG_LABEL_NAMED(id, DebugLabelFor::Texture, Str() << "TEXTURE2d array " << debug_label);
+
+	set_texture_wrap(GL_TEXTURE_2D_ARRAY, te, std::nullopt);
+
+	const auto filter = min_mag_from_trs(trs);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, filter.min);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, filter.mag);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BASE_LEVEL, 0);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, level_count - 1);
+
+	gpu_bytes = 0;
+	for (int level = 0; level < level_count; level += 1)
+	{
+		gpu_bytes += gpu_bytes_of_image(std::max(1, width >> level), std::max(1, height >> level), false) * sizet_from_int(layer_count);
+		glTexImage3D(
+			GL_TEXTURE_2D_ARRAY,
+			level,
+			internal_format_from_color_data(t, cd),
+			std::max(1, width >> level),
+			std::max(1, height >> level),
+			layer_count,
+			0,
+			GL_RGBA,
+			GL_UNSIGNED_BYTE,
+			nullptr
+		);
+	}
+}
+
+void TextureArray::upload_layer(int layer, const std::vector<MipPixels>& mips)
+{
+	ASSERT(layer >= 0 && layer < layer_count);
+	ASSERT(mips.empty() == false && mips[0].width == width && mips[0].height == height);
+
+	// todo(Gustav): use states
+	glBindTexture(GL_TEXTURE_2D_ARRAY, id);
+	invalidate_state_bindings();
+
+	const auto levels = std::min(level_count, int_from_sizet(mips.size()));
+	for (int level = 0; level < levels; level += 1)
+	{
+		const auto& mip = mips[sizet_from_int(level)];
+		glTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, layer, mip.width, mip.height, 1, GL_RGBA, GL_UNSIGNED_BYTE, mip.pixels);
+	}
+}
+
 // ------------------------------------------------------------------------------------------------
 // cubemap
 
-TextureCubemap::TextureCubemap(DEBUG_LABEL_ARG_MANY const std::array<void*, cubemap_size>& pixel_data, int width, int height, ColorData cd)
+TextureCubemap::TextureCubemap(DEBUG_LABEL_ARG_MANY const std::array<const void*, cubemap_size>& pixel_data, int width, int height, ColorData cd)
 {
 	// todo(Gustav): use states
 	glBindTexture(GL_TEXTURE_CUBE_MAP, id);
+	invalidate_state_bindings();
 	SET_DEBUG_LABEL_NAMED(id, DebugLabelFor::Texture, Str() << "TEXTURE CUBEMAP " << debug_label);
 
+	upload(pixel_data, width, height, cd);
+}
+
+void TextureCubemap::upload(const std::array<const void*, cubemap_size>& pixel_data, int width, int height, ColorData cd)
+{
+	// todo(Gustav): use states
+	glBindTexture(GL_TEXTURE_CUBE_MAP, id);
+	invalidate_state_bindings();
+
 	for (size_t index = 0; index < cubemap_size; index += 1)
 	{
 		glTexImage2D(
@@ -247,6 +551,7 @@ TextureCubemap::TextureCubemap(DEBUG_LABEL_ARG_MANY const std::array<void*, cube
 			pixel_data[index]
 		);
 	}
+	gpu_bytes = gpu_bytes_of_image(width, height, false) * cubemap_size;
 
 	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
@@ -362,17 +667,19 @@ FrameBuffer::~FrameBuffer()
 		glDeleteRenderbuffers(1, &rbo);
 		rbo = 0;
 	}
+	invalidate_state_bindings();
 }
 
-BoundFbo::BoundFbo(std::shared_ptr<FrameBuffer> f)
-	: fbo(std::move(f))
+BoundFbo::BoundFbo(State* s, std::shared_ptr<FrameBuffer> f)
+	: states(s)
+	, fbo(std::move(f))
 {
-	glBindFramebuffer(GL_FRAMEBUFFER, fbo->fbo);
+	StateChanger{states}.bind_framebuffer(fbo->fbo);
 }
 
 BoundFbo::~BoundFbo()
 {
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	StateChanger{states}.bind_framebuffer(0);
 }
 
 [[nodiscard]]
@@ -512,6 +819,7 @@ std::shared_ptr<FrameBuffer> FrameBufferBuilder::build(DEBUG_LABEL_ARG_SINGLE) c
 	// setup texture
 	const GLenum target = is_msaa ? GL_TEXTURE_2D_MULTISAMPLE : GL_TEXTURE_2D;
 	glBindTexture(target, fbo->id);
+	invalidate_state_bindings();
 	SET_DEBUG_LABEL_NAMED(fbo->id, DebugLabelFor::Texture, Str() << "TEXTURE FRAMEBUFFER " << debug_label);
 	if (is_msaa == false)
 	{
@@ -550,7 +858,8 @@ std::shared_ptr<FrameBuffer> FrameBufferBuilder::build(DEBUG_LABEL_ARG_SINGLE) c
 	}
 
 	// setup fbo
-	auto bound = BoundFbo{fbo};
+	glBindFramebuffer(GL_FRAMEBUFFER, fbo->fbo);
+	invalidate_state_bindings();
 	SET_DEBUG_LABEL_NAMED(fbo->fbo, DebugLabelFor::FrameBuffer, Str() << "FBO " << debug_label);
 	constexpr GLint mipmap_level = 0;
 	glFramebufferTexture2D(GL_FRAMEBUFFER, color_bits_per_pixel == ColorBitsPerPixel::use_depth? GL_DEPTH_ATTACHMENT : GL_COLOR_ATTACHMENT0, target, fbo->id, mipmap_level);
@@ -590,7 +899,10 @@ std::shared_ptr<FrameBuffer> FrameBufferBuilder::build(DEBUG_LABEL_ARG_SINGLE) c
 		fbo->rbo = 0;
 	}
 
-	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+	const auto status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	if (status != GL_FRAMEBUFFER_COMPLETE)
 	{
 		LOG_ERROR("Failed to create frame buffer");
 		return nullptr;
@@ -600,17 +912,19 @@ std::shared_ptr<FrameBuffer> FrameBufferBuilder::build(DEBUG_LABEL_ARG_SINGLE) c
 }
 
 
-void resolve_multisampled_buffer(const FrameBuffer& src, FrameBuffer* dst)
+void resolve_multisampled_buffer(State* states, const FrameBuffer& src, FrameBuffer* dst, const glm::ivec2& size)
 {
 	glBindFramebuffer(GL_READ_FRAMEBUFFER, src.fbo);
 	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, dst->fbo);
 
 	ASSERT(src.size == dst->size);
+	ASSERT(size.x <= src.size.x && size.y <= src.size.y);
 
-	glBlitFramebuffer(0, 0, src.size.x, src.size.y, 0, 0, dst->size.x, dst->size.y, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+	glBlitFramebuffer(0, 0, size.x, size.y, 0, 0, size.x, size.y, GL_COLOR_BUFFER_BIT, GL_NEAREST);
 
-	glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
-	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+	// the read and draw targets were bound separately so the tracked binding is unknown
+	states->framebuffer = std::nullopt;
+	StateChanger{states}.bind_framebuffer(0);
 }
 
 
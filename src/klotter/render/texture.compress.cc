@@ -0,0 +1,740 @@
+#include "klotter/render/texture.compress.h"
+
+#include "klotter/assert.h"
+#include "klotter/cint.h"
+#include "klotter/jobs.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace klotter
+{
+
+namespace
+{
+	using Color = glm::vec4;
+	using BlockColors = std::array<Color, block_pixel_count>;
+	using BlockIndices = std::array<int, block_pixel_count>;
+
+	/// a color line through the block, the palette is interpolated between the endpoints
+	struct Endpoints
+	{
+		Color first;
+		Color second;
+	};
+
+	BlockColors colors_from_block(const PixelBlock& pixels, const Color& mask)
+	{
+		BlockColors colors;
+		for (std::size_t index = 0; index < block_pixel_count; index += 1)
+		{
+			const auto* p = &pixels[index * 4];
+			colors[index] = Color{p[0], p[1], p[2], p[3]} * mask;
+		}
+		return colors;
+	}
+
+	float distance_squared(const Color& lhs, const Color& rhs)
+	{
+		const auto d = lhs - rhs;
+		return glm::dot(d, d);
+	}
+
+	/// fits a line through the colors using the principal axis and returns the extremes
+	Endpoints find_endpoints(const BlockColors& colors, const Color& mask)
+	{
+		Color mean{0.0f};
+		for (const auto& c: colors)
+		{
+			mean += c;
+		}
+		mean /= static_cast<float>(block_pixel_count);
+
+		glm::mat4 covariance{0.0f};
+		for (const auto& c: colors)
+		{
+			const auto d = c - mean;
+			covariance += glm::outerProduct(d, d);
+		}
+
+		// power iteration to find the axis with the most variance
+		Color axis = mask;
+		for (int iteration = 0; iteration < 8; iteration += 1)
+		{
+			const auto next = covariance * axis;
+			const auto length = glm::length(next);
+			if (length < 0.0001f)
+			{
+				break;
+			}
+			axis = next / length;
+		}
+
+		float min_t = std::numeric_limits<float>::max();
+		float max_t = std::numeric_limits<float>::lowest();
+		for (const auto& c: colors)
+		{
+			const auto t = glm::dot(c - mean, axis);
+			min_t = std::min(min_t, t);
+			max_t = std::max(max_t, t);
+		}
+
+		const auto clamp_color = [&](const Color& c) { return glm::clamp(c, Color{0.0f}, Color{255.0f}) * mask; };
+		return {clamp_color(mean + axis * max_t), clamp_color(mean + axis * min_t)};
+	}
+
+	/// least squares fit of the endpoints given how far along the line each pixel is
+	std::optional<Endpoints> refine_endpoints(const BlockColors& colors, const std::array<float, block_pixel_count>& weights, const Color& mask)
+	{
+		float aa = 0.0f;
+		float ab = 0.0f;
+		float bb = 0.0f;
+		Color ax{0.0f};
+		Color bx{0.0f};
+		for (std::size_t index = 0; index < block_pixel_count; index += 1)
+		{
+			const auto b = weights[index];
+			const auto a = 1.0f - b;
+			aa += a * a;
+			ab += a * b;
+			bb += b * b;
+			ax += a * colors[index];
+			bx += b * colors[index];
+		}
+
+		const auto determinant = aa * bb - ab * ab;
+		if (std::abs(determinant) < 0.0001f)
+		{
+			return std::nullopt;
+		}
+
+		const auto first = (ax * bb - bx * ab) / determinant;
+		const auto second = (bx * aa - ax * ab) / determinant;
+		return Endpoints{glm::clamp(first, Color{0.0f}, Color{255.0f}) * mask, glm::clamp(second, Color{0.0f}, Color{255.0f}) * mask};
+	}
+
+	/// writes bits from the least significant bit and up
+	struct BitWriter
+	{
+		std::uint8_t* data;
+		std::size_t bit = 0;
+
+		void write(std::uint32_t value, std::size_t count)
+		{
+			for (std::size_t index = 0; index < count; index += 1)
+			{
+				if ((value >> index) & 1)
+				{
+					data[bit / 8] = static_cast<std::uint8_t>(data[bit / 8] | (1 << (bit % 8)));
+				}
+				bit += 1;
+			}
+		}
+	};
+
+	struct BitReader
+	{
+		const std::uint8_t* data;
+		std::size_t bit = 0;
+
+		std::uint32_t read(std::size_t count)
+		{
+			std::uint32_t value = 0;
+			for (std::size_t index = 0; index < count; index += 1)
+			{
+				value |= static_cast<std::uint32_t>((data[bit / 8] >> (bit % 8)) & 1) << index;
+				bit += 1;
+			}
+			return value;
+		}
+	};
+
+	// --------------------------------------------------------------------------------------------
+	// bc1
+
+	std::uint16_t pack_565(const Color& c)
+	{
+		const auto r = static_cast<std::uint16_t>(std::round(std::clamp(c.r, 0.0f, 255.0f) * 31.0f / 255.0f));
+		const auto g = static_cast<std::uint16_t>(std::round(std::clamp(c.g, 0.0f, 255.0f) * 63.0f / 255.0f));
+		const auto b = static_cast<std::uint16_t>(std::round(std::clamp(c.b, 0.0f, 255.0f) * 31.0f / 255.0f));
+		return static_cast<std::uint16_t>((r << 11) | (g << 5) | b);
+	}
+
+	glm::ivec3 unpack_565(std::uint16_t c)
+	{
+		const auto r = (c >> 11) & 31;
+		const auto g = (c >> 5) & 63;
+		const auto b = c & 31;
+		return {(r << 3) | (r >> 2), (g << 2) | (g >> 4), (b << 3) | (b >> 2)};
+	}
+
+	/// the 4 colors, the last is transparent black when the block is in 3 color mode
+	std::array<glm::ivec4, 4> palette_from_bc1(std::uint16_t c0, std::uint16_t c1, bool allow_three_colors)
+	{
+		const auto a = unpack_565(c0);
+		const auto b = unpack_565(c1);
+		if (c0 > c1 || allow_three_colors == false)
+		{
+			return {glm::ivec4{a, 255}, glm::ivec4{b, 255}, glm::ivec4{(2 * a + b) / 3, 255}, glm::ivec4{(a + 2 * b) / 3, 255}};
+		}
+		else
+		{
+			return {glm::ivec4{a, 255}, glm::ivec4{b, 255}, glm::ivec4{(a + b) / 2, 255}, glm::ivec4{0, 0, 0, 0}};
+		}
+	}
+
+	constexpr std::array<float, 4> bc1_weights = {0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f};
+
+	struct Bc1Block
+	{
+		std::uint16_t c0 = 0;
+		std::uint16_t c1 = 0;
+		BlockIndices indices = {};
+		float error = 0.0f;
+	};
+
+	/// the encoder always uses the 4 color mode, so the block is the same in bc1 and bc3
+	Bc1Block fit_bc1(const BlockColors& colors, const Endpoints& endpoints)
+	{
+		Bc1Block block;
+		block.c0 = pack_565(endpoints.first);
+		block.c1 = pack_565(endpoints.second);
+		if (block.c0 < block.c1)
+		{
+			std::swap(block.c0, block.c1);
+		}
+
+		const auto palette = palette_from_bc1(block.c0, block.c1, false);
+		const auto color_count = block.c0 == block.c1 ? std::size_t{1} : std::size_t{4};
+		for (std::size_t pixel = 0; pixel < block_pixel_count; pixel += 1)
+		{
+			float best_error = std::numeric_limits<float>::max();
+			for (std::size_t index = 0; index < color_count; index += 1)
+			{
+				const auto c = Color{glm::vec3{palette[index]}, 0.0f};
+				const auto error = distance_squared(colors[pixel], c);
+				if (error < best_error)
+				{
+					best_error = error;
+					block.indices[pixel] = static_cast<int>(index);
+				}
+			}
+			block.error += best_error;
+		}
+
+		return block;
+	}
+
+	void encode_bc1(const PixelBlock& pixels, std::uint8_t* data)
+	{
+		const auto mask = Color{1.0f, 1.0f, 1.0f, 0.0f};
+		const auto colors = colors_from_block(pixels, mask);
+
+		auto best = fit_bc1(colors, find_endpoints(colors, mask));
+		for (int iteration = 0; iteration < 2 && best.c0 != best.c1; iteration += 1)
+		{
+			std::array<float, block_pixel_count> weights;
+			for (std::size_t pixel = 0; pixel < block_pixel_count; pixel += 1)
+			{
+				weights[pixel] = bc1_weights[sizet_from_int(best.indices[pixel])];
+			}
+			const auto refined = refine_endpoints(colors, weights, mask);
+			if (refined.has_value() == false)
+			{
+				break;
+			}
+			const auto candidate = fit_bc1(colors, *refined);
+			if (candidate.error >= best.error)
+			{
+				break;
+			}
+			best = candidate;
+		}
+
+		BitWriter writer{data};
+		writer.write(best.c0, 16);
+		writer.write(best.c1, 16);
+		for (const auto index: best.indices)
+		{
+			writer.write(static_cast<std::uint32_t>(index), 2);
+		}
+	}
+
+	void decode_bc1(const std::uint8_t* data, bool allow_three_colors, PixelBlock* pixels)
+	{
+		BitReader reader{data};
+		const auto c0 = static_cast<std::uint16_t>(reader.read(16));
+		const auto c1 = static_cast<std::uint16_t>(reader.read(16));
+		const auto palette = palette_from_bc1(c0, c1, allow_three_colors);
+		for (std::size_t pixel = 0; pixel < block_pixel_count; pixel += 1)
+		{
+			const auto& c = palette[reader.read(2)];
+			for (int channel = 0; channel < 4; channel += 1)
+			{
+				(*pixels)[pixel * 4 + sizet_from_int(channel)] = static_cast<std::uint8_t>(c[channel]);
+			}
+		}
+	}
+
+	// --------------------------------------------------------------------------------------------
+	// bc4
+
+	std::array<int, 8> palette_from_bc4(int r0, int r1)
+	{
+		if (r0 > r1)
+		{
+			return {
+				r0, r1,
+				(6 * r0 + 1 * r1 + 3) / 7, (5 * r0 + 2 * r1 + 3) / 7, (4 * r0 + 3 * r1 + 3) / 7,
+				(3 * r0 + 4 * r1 + 3) / 7, (2 * r0 + 5 * r1 + 3) / 7, (1 * r0 + 6 * r1 + 3) / 7
+			};
+		}
+		else
+		{
+			return {
+				r0, r1,
+				(4 * r0 + 1 * r1 + 2) / 5, (3 * r0 + 2 * r1 + 2) / 5, (2 * r0 + 3 * r1 + 2) / 5, (1 * r0 + 4 * r1 + 2) / 5,
+				0, 255
+			};
+		}
+	}
+
+	/// encodes a single channel of the block
+	void encode_bc4(const PixelBlock& pixels, std::size_t channel, std::uint8_t* data)
+	{
+		int min_value = 255;
+		int max_value = 0;
+		for (std::size_t pixel = 0; pixel < block_pixel_count; pixel += 1)
+		{
+			const int value = pixels[pixel * 4 + channel];
+			min_value = std::min(min_value, value);
+			max_value = std::max(max_value, value);
+		}
+
+		BitWriter writer{data};
+		writer.write(static_cast<std::uint32_t>(max_value), 8);
+		writer.write(static_cast<std::uint32_t>(min_value), 8);
+
+		// when equal, the 6 value mode is used but all interpolated values are the same
+		const auto palette = palette_from_bc4(max_value, min_value);
+		for (std::size_t pixel = 0; pixel < block_pixel_count; pixel += 1)
+		{
+			const int value = pixels[pixel * 4 + channel];
+			std::uint32_t best_index = 0;
+			int best_error = 256;
+			for (std::size_t index = 0; index < palette.size(); index += 1)
+			{
+				const auto error = std::abs(palette[index] - value);
+				if (error < best_error)
+				{
+					best_error = error;
+					best_index = static_cast<std::uint32_t>(index);
+				}
+			}
+			writer.write(best_index, 3);
+		}
+	}
+
+	void decode_bc4(const std::uint8_t* data, std::size_t channel, PixelBlock* pixels)
+	{
+		BitReader reader{data};
+		const auto r0 = static_cast<int>(reader.read(8));
+		const auto r1 = static_cast<int>(reader.read(8));
+		const auto palette = palette_from_bc4(r0, r1);
+		for (std::size_t pixel = 0; pixel < block_pixel_count; pixel += 1)
+		{
+			(*pixels)[pixel * 4 + channel] = static_cast<std::uint8_t>(palette[reader.read(3)]);
+		}
+	}
+
+	// --------------------------------------------------------------------------------------------
+	// bc7
+
+	// only mode 6 is used: a single subset with 7+1 bit rgba endpoints and 4 bit indices
+
+	constexpr std::array<int, 16> bc7_weights = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+	constexpr std::uint32_t bc7_mode6 = 6;
+
+	struct Bc7Endpoint
+	{
+		glm::ivec4 quantized = glm::ivec4{0};
+		int p = 0;
+
+		[[nodiscard]] glm::ivec4 expand() const
+		{
+			return quantized * 2 + p;
+		}
+	};
+
+	Bc7Endpoint quantize_bc7(const Color& c)
+	{
+		Bc7Endpoint best;
+		float best_error = std::numeric_limits<float>::max();
+		for (int p = 0; p < 2; p += 1)
+		{
+			Bc7Endpoint candidate;
+			candidate.p = p;
+			for (int channel = 0; channel < 4; channel += 1)
+			{
+				candidate.quantized[channel] = std::clamp(static_cast<int>(std::round((c[channel] - static_cast<float>(p)) / 2.0f)), 0, 127);
+			}
+			const auto error = distance_squared(Color{candidate.expand()}, c);
+			if (error < best_error)
+			{
+				best_error = error;
+				best = candidate;
+			}
+		}
+		return best;
+	}
+
+	glm::ivec4 interpolate_bc7(const glm::ivec4& e0, const glm::ivec4& e1, int weight)
+	{
+		return ((64 - weight) * e0 + weight * e1 + 32) / 64;
+	}
+
+	struct Bc7Block
+	{
+		Bc7Endpoint e0;
+		Bc7Endpoint e1;
+		BlockIndices indices = {};
+		float error = 0.0f;
+	};
+
+	Bc7Block fit_bc7(const BlockColors& colors, const Endpoints& endpoints)
+	{
+		Bc7Block block;
+		block.e0 = quantize_bc7(endpoints.first);
+		block.e1 = quantize_bc7(endpoints.second);
+
+		std::array<Color, 16> palette;
+		for (std::size_t index = 0; index < palette.size(); index += 1)
+		{
+			palette[index] = Color{interpolate_bc7(block.e0.expand(), block.e1.expand(), bc7_weights[index])};
+		}
+
+		for (std::size_t pixel = 0; pixel < block_pixel_count; pixel += 1)
+		{
+			float best_error = std::numeric_limits<float>::max();
+			for (std::size_t index = 0; index < palette.size(); index += 1)
+			{
+				const auto error = distance_squared(colors[pixel], palette[index]);
+				if (error < best_error)
+				{
+					best_error = error;
+					block.indices[pixel] = static_cast<int>(index);
+				}
+			}
+			block.error += best_error;
+		}
+
+		return block;
+	}
+
+	void encode_bc7(const PixelBlock& pixels, std::uint8_t* data)
+	{
+		const auto mask = Color{1.0f};
+		const auto colors = colors_from_block(pixels, mask);
+
+		auto best = fit_bc7(colors, find_endpoints(colors, mask));
+		for (int iteration = 0; iteration < 2; iteration += 1)
+		{
+			std::array<float, block_pixel_count> weights;
+			for (std::size_t pixel = 0; pixel < block_pixel_count; pixel += 1)
+			{
+				weights[pixel] = static_cast<float>(bc7_weights[sizet_from_int(best.indices[pixel])]) / 64.0f;
+			}
+			const auto refined = refine_endpoints(colors, weights, mask);
+			if (refined.has_value() == false)
+			{
+				break;
+			}
+			const auto candidate = fit_bc7(colors, *refined);
+			if (candidate.error >= best.error)
+			{
+				break;
+			}
+			best = candidate;
+		}
+
+		// the msb of the first index is implicitly 0, swap the endpoints if it isn't
+		if (best.indices[0] >= 8)
+		{
+			std::swap(best.e0, best.e1);
+			for (auto& index: best.indices)
+			{
+				index = 15 - index;
+			}
+		}
+
+		BitWriter writer{data};
+		writer.write(1 << bc7_mode6, bc7_mode6 + 1);
+		for (int channel = 0; channel < 4; channel += 1)
+		{
+			writer.write(static_cast<std::uint32_t>(best.e0.quantized[channel]), 7);
+			writer.write(static_cast<std::uint32_t>(best.e1.quantized[channel]), 7);
+		}
+		writer.write(static_cast<std::uint32_t>(best.e0.p), 1);
+		writer.write(static_cast<std::uint32_t>(best.e1.p), 1);
+		for (std::size_t pixel = 0; pixel < block_pixel_count; pixel += 1)
+		{
+			writer.write(static_cast<std::uint32_t>(best.indices[pixel]), pixel == 0 ? 3 : 4);
+		}
+	}
+
+	void decode_bc7(const std::uint8_t* data, PixelBlock* pixels)
+	{
+		BitReader reader{data};
+		if (reader.read(bc7_mode6 + 1) != (1 << bc7_mode6))
+		{
+			// only mode 6 is decoded since it's the only mode that is encoded
+			pixels->fill(0);
+			return;
+		}
+
+		Bc7Endpoint e0;
+		Bc7Endpoint e1;
+		for (int channel = 0; channel < 4; channel += 1)
+		{
+			e0.quantized[channel] = static_cast<int>(reader.read(7));
+			e1.quantized[channel] = static_cast<int>(reader.read(7));
+		}
+		e0.p = static_cast<int>(reader.read(1));
+		e1.p = static_cast<int>(reader.read(1));
+
+		for (std::size_t pixel = 0; pixel < block_pixel_count; pixel += 1)
+		{
+			const auto index = reader.read(pixel == 0 ? 3 : 4);
+			const auto c = interpolate_bc7(e0.expand(), e1.expand(), bc7_weights[index]);
+			for (int channel = 0; channel < 4; channel += 1)
+			{
+				(*pixels)[pixel * 4 + sizet_from_int(channel)] = static_cast<std::uint8_t>(c[channel]);
+			}
+		}
+	}
+
+	// --------------------------------------------------------------------------------------------
+	// image
+
+	int block_count(int pixels)
+	{
+		return (pixels + 3) / 4;
+	}
+
+	/// get a block from the image, pixels outside of the image are clamped to the edge
+	PixelBlock extract_block(const RgbaImage& image, int block_x, int block_y)
+	{
+		PixelBlock block;
+		for (int y = 0; y < 4; y += 1)
+		{
+			for (int x = 0; x < 4; x += 1)
+			{
+				const auto src_x = std::min(block_x * 4 + x, image.width - 1);
+				const auto src_y = std::min(block_y * 4 + y, image.height - 1);
+				const auto src = sizet_from_int((src_y * image.width + src_x) * 4);
+				const auto dst = sizet_from_int((y * 4 + x) * 4);
+				std::copy_n(image.pixels.begin() + static_cast<std::ptrdiff_t>(src), 4, block.begin() + static_cast<std::ptrdiff_t>(dst));
+			}
+		}
+		return block;
+	}
+}  //  namespace
+
+std::size_t size_of_block(BlockFormat format)
+{
+	switch (format)
+	{
+	case BlockFormat::bc1:
+	case BlockFormat::bc4: return 8;
+	case BlockFormat::bc3:
+	case BlockFormat::bc5:
+	case BlockFormat::bc7: return 16;
+	default: DIE("invalid block format"); return 16;
+	}
+}
+
+std::size_t size_of_compressed_image(BlockFormat format, int width, int height)
+{
+	return sizet_from_int(block_count(width)) * sizet_from_int(block_count(height)) * size_of_block(format);
+}
+
+BlockFormat select_block_format(int channel_count, CompressionQuality quality)
+{
+	switch (channel_count)
+	{
+	case 1: return BlockFormat::bc4;
+	case 2: return BlockFormat::bc5;
+	case 3: return quality == CompressionQuality::high ? BlockFormat::bc7 : BlockFormat::bc1;
+	case 4: return quality == CompressionQuality::high ? BlockFormat::bc7 : BlockFormat::bc3;
+	default: DIE("invalid channel count"); return BlockFormat::bc7;
+	}
+}
+
+void encode_block(BlockFormat format, const PixelBlock& pixels, std::uint8_t* block)
+{
+	std::fill_n(block, size_of_block(format), std::uint8_t{0});
+	switch (format)
+	{
+	case BlockFormat::bc1: encode_bc1(pixels, block); break;
+	case BlockFormat::bc3:
+		encode_bc4(pixels, 3, block);
+		encode_bc1(pixels, block + 8);
+		break;
+	case BlockFormat::bc4: encode_bc4(pixels, 0, block); break;
+	case BlockFormat::bc5:
+		encode_bc4(pixels, 0, block);
+		encode_bc4(pixels, 1, block + 8);
+		break;
+	case BlockFormat::bc7: encode_bc7(pixels, block); break;
+	default: DIE("invalid block format"); break;
+	}
+}
+
+void decode_block(BlockFormat format, const std::uint8_t* block, PixelBlock* pixels)
+{
+	// start with the defaults for missing channels
+	for (std::size_t pixel = 0; pixel < block_pixel_count; pixel += 1)
+	{
+		(*pixels)[pixel * 4 + 0] = 0;
+		(*pixels)[pixel * 4 + 1] = 0;
+		(*pixels)[pixel * 4 + 2] = 0;
+		(*pixels)[pixel * 4 + 3] = 255;
+	}
+
+	switch (format)
+	{
+	case BlockFormat::bc1: decode_bc1(block, true, pixels); break;
+	case BlockFormat::bc3:
+		decode_bc1(block + 8, false, pixels);
+		decode_bc4(block, 3, pixels);
+		break;
+	case BlockFormat::bc4: decode_bc4(block, 0, pixels); break;
+	case BlockFormat::bc5:
+		decode_bc4(block, 0, pixels);
+		decode_bc4(block + 8, 1, pixels);
+		break;
+	case BlockFormat::bc7: decode_bc7(block, pixels); break;
+	default: DIE("invalid block format"); break;
+	}
+}
+
+std::vector<std::uint8_t> encode_image(const RgbaImage& image, BlockFormat format, int thread_count)
+{
+	ASSERT(image.width > 0 && image.height > 0);
+	ASSERT(image.pixels.size() == sizet_from_int(image.width * image.height * 4));
+
+	const auto blocks_x = block_count(image.width);
+	const auto blocks_y = block_count(image.height);
+	const auto block_size = size_of_block(format);
+
+	std::vector<std::uint8_t> data(size_of_compressed_image(format, image.width, image.height));
+
+	get_job_system().parallel_for(0, blocks_y, grain_size_from_thread_count(blocks_y, thread_count),
+		[&](int first_row, int last_row)
+		{
+			for (int row = first_row; row < last_row; row += 1)
+			{
+				for (int column = 0; column < blocks_x; column += 1)
+				{
+					const auto offset = sizet_from_int(row * blocks_x + column) * block_size;
+					encode_block(format, extract_block(image, column, row), data.data() + offset);
+				}
+			}
+		}
+	);
+
+	return data;
+}
+
+RgbaImage decode_image(BlockFormat format, const std::uint8_t* data, int width, int height)
+{
+	RgbaImage image{width, height, std::vector<std::uint8_t>(sizet_from_int(width * height * 4))};
+
+	const auto blocks_x = block_count(width);
+	const auto blocks_y = block_count(height);
+	const auto block_size = size_of_block(format);
+
+	PixelBlock pixels;
+	for (int row = 0; row < blocks_y; row += 1)
+	{
+		for (int column = 0; column < blocks_x; column += 1)
+		{
+			decode_block(format, data + sizet_from_int(row * blocks_x + column) * block_size, &pixels);
+			for (int y = 0; y < 4; y += 1)
+			{
+				for (int x = 0; x < 4; x += 1)
+				{
+					const auto dst_x = column * 4 + x;
+					const auto dst_y = row * 4 + y;
+					if (dst_x >= width || dst_y >= height)
+					{
+						continue;
+					}
+					const auto src = sizet_from_int((y * 4 + x) * 4);
+					const auto dst = sizet_from_int((dst_y * width + dst_x) * 4);
+					std::copy_n(pixels.begin() + static_cast<std::ptrdiff_t>(src), 4, image.pixels.begin() + static_cast<std::ptrdiff_t>(dst));
+				}
+			}
+		}
+	}
+
+	return image;
+}
+
+CompressedTexture compress_texture(const RgbaImage& image, BlockFormat format, ColorData cd, int thread_count)
+{
+	CompressedTexture texture;
+	texture.format = format;
+	texture.cd = cd;
+
+	MipSettings settings;
+	settings.thread_count = thread_count;
+	for (const auto& mip: generate_mips(image, cd, settings))
+	{
+		texture.mips.emplace_back(CompressedMip{mip.width, mip.height, encode_image(mip, format, thread_count)});
+	}
+
+	return texture;
+}
+
+std::vector<RgbaImage> decode_texture(const CompressedTexture& texture, std::size_t level_count)
+{
+	ASSERT(level_count <= texture.mips.size());
+
+	std::vector<RgbaImage> images;
+	for (std::size_t level = 0; level < level_count; level += 1)
+	{
+		const auto& mip = texture.mips[level];
+		images.emplace_back(decode_image(texture.format, mip.data.data(), mip.width, mip.height));
+	}
+	return images;
+}
+
+float calculate_psnr(const RgbaImage& lhs, const RgbaImage& rhs, int channel_count)
+{
+	ASSERT(lhs.width == rhs.width && lhs.height == rhs.height);
+	ASSERT(channel_count >= 1 && channel_count <= 4);
+
+	double sum = 0.0;
+	const auto pixel_count = sizet_from_int(lhs.width * lhs.height);
+	for (std::size_t pixel = 0; pixel < pixel_count; pixel += 1)
+	{
+		for (std::size_t channel = 0; channel < sizet_from_int(channel_count); channel += 1)
+		{
+			const auto d = static_cast<double>(lhs.pixels[pixel * 4 + channel]) - static_cast<double>(rhs.pixels[pixel * 4 + channel]);
+			sum += d * d;
+		}
+	}
+
+	if (sum == 0.0)
+	{
+		return std::numeric_limits<float>::infinity();
+	}
+
+	const auto mse = sum / static_cast<double>(pixel_count * sizet_from_int(channel_count));
+	return static_cast<float>(10.0 * std::log10(255.0 * 255.0 / mse));
+}
+
+}  //  namespace klotter
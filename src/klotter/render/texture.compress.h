@@ -0,0 +1,96 @@
+#pragma once
+
+#include "klotter/render/texture.mips.h"
+
+#include <cstdint>
+
+namespace klotter
+{
+
+/** \addtogroup texture
+ *  @{
+*/
+
+/// A gpu block compression format, all formats compress 4x4 pixel blocks.
+enum class BlockFormat
+{
+	/// rgb in 8 bytes, for opaque color maps
+	bc1,
+
+	/// rgba in 16 bytes, bc1 color with a bc4 alpha
+	bc3,
+
+	/// a single channel in 8 bytes, for specular maps, cookies and other grayscale maps
+	bc4,
+
+	/// two channels in 16 bytes, for tangent space normal maps
+	bc5,
+
+	/// rgba in 16 bytes, for when quality matters
+	bc7
+};
+
+/// How to pick between the formats that can store the same channels.
+enum class CompressionQuality
+{
+	fast,
+	high
+};
+
+/// A single mip level of a compressed texture.
+struct CompressedMip
+{
+	int width = 0;
+	int height = 0;
+	std::vector<std::uint8_t> data;
+};
+
+/// A block compressed texture with all mips baked in, the first mip is the full size image.
+struct CompressedTexture
+{
+	BlockFormat format = BlockFormat::bc1;
+	ColorData cd = ColorData::color_data;
+	std::vector<CompressedMip> mips;
+};
+
+constexpr std::size_t block_pixel_count = 16;
+
+/// The rgba pixels of a 4x4 block, in row order.
+using PixelBlock = std::array<std::uint8_t, block_pixel_count * 4>;
+
+/// The number of bytes a 4x4 block is compressed to.
+std::size_t size_of_block(BlockFormat format);
+
+/// The number of bytes a image is compressed to, partial blocks at the edges are stored as full blocks.
+std::size_t size_of_compressed_image(BlockFormat format, int width, int height);
+
+/// Picks a format given the number of channels the image uses.
+/// @param channel_count 1 for grayscale, 2 for normal maps, 3 for color and 4 for color with transparency
+BlockFormat select_block_format(int channel_count, CompressionQuality quality);
+
+void encode_block(BlockFormat format, const PixelBlock& pixels, std::uint8_t* block);
+
+/// Decodes a block like the gpu would, missing channels are 0 except alpha that is 255.
+void decode_block(BlockFormat format, const std::uint8_t* block, PixelBlock* pixels);
+
+/// Compresses a image, the blocks are encoded in parallel.
+/// @param thread_count the most threads to use, 0 uses all threads of the job system
+std::vector<std::uint8_t> encode_image(const RgbaImage& image, BlockFormat format, int thread_count = 0);
+
+RgbaImage decode_image(BlockFormat format, const std::uint8_t* data, int width, int height);
+
+/// Compresses the image and all it's mip levels down to 1x1, the mips are generated with \ref generate_mips
+CompressedTexture compress_texture(const RgbaImage& image, BlockFormat format, ColorData cd, int thread_count = 0);
+
+/// Decodes the first level_count mips, for drivers that can't sample the format.
+std::vector<RgbaImage> decode_texture(const CompressedTexture& texture, std::size_t level_count);
+
+/// The peak signal to noise ratio in decibels between the first channel_count channels of two images of the same size.
+/// Identical images return infinity.
+float calculate_psnr(const RgbaImage& lhs, const RgbaImage& rhs, int channel_count);
+
+/**
+ * @}
+*/
+
+}  //  namespace klotter
@@ -0,0 +1,127 @@
+// offline tool that compresses a image to a KTX2 container with baked mips
+
+#include "klotter/render/texture.compress.h"
+#include "klotter/render/texture.ktx.h"
+
+#include "stb_image.h"
+
+#include <fstream>
+#include <iostream>
+#include <string>
+
+using namespace klotter;
+
+namespace
+{
+
+void print_usage()
+{
+	std::cerr << "usage: tool_compress_texture <input image> <output.ktx2> [options]\n"
+			  << "  --channels <n>   the channels to keep: 1 for grayscale, 2 for normal maps, 3 for color and 4 for color with alpha\n"
+			  << "  --format <name>  bc1, bc3, bc4, bc5 or bc7, overrides the channel based selection\n"
+			  << "  --quality high   use bc7 for color\n"
+			  << "  --linear         the image isn't color data, like a specular or normal map\n"
+			  << "  --threads <n>    the number of threads to encode with, default is all cores\n";
+}
+
+std::optional<BlockFormat> format_from_name(const std::string& name)
+{
+	if (name == "bc1") return BlockFormat::bc1;
+	if (name == "bc3") return BlockFormat::bc3;
+	if (name == "bc4") return BlockFormat::bc4;
+	if (name == "bc5") return BlockFormat::bc5;
+	if (name == "bc7") return BlockFormat::bc7;
+	return std::nullopt;
+}
+
+}  //  namespace
+
+int main(int argc, char** argv)
+{
+	if (argc < 3)
+	{
+		print_usage();
+		return -1;
+	}
+
+	const std::string input = argv[1];
+	const std::string output = argv[2];
+
+	std::optional<int> channels;
+	std::optional<BlockFormat> format;
+	auto quality = CompressionQuality::fast;
+	auto cd = ColorData::color_data;
+	int thread_count = 0;
+
+	for (int index = 3; index < argc; index += 1)
+	{
+		const std::string arg = argv[index];
+		const auto has_value = index + 1 < argc;
+		if (arg == "--channels" && has_value)
+		{
+			channels = std::stoi(argv[++index]);
+		}
+		else if (arg == "--format" && has_value)
+		{
+			format = format_from_name(argv[++index]);
+			if (format.has_value() == false)
+			{
+				std::cerr << "Unknown format " << argv[index] << "\n";
+				return -1;
+			}
+		}
+		else if (arg == "--quality" && has_value)
+		{
+			quality = std::string{argv[++index]} == "high" ? CompressionQuality::high : CompressionQuality::fast;
+		}
+		else if (arg == "--linear")
+		{
+			cd = ColorData::non_color_data;
+		}
+		else if (arg == "--threads" && has_value)
+		{
+			thread_count = std::stoi(argv[++index]);
+		}
+		else
+		{
+			std::cerr << "Unknown argument " << arg << "\n";
+			print_usage();
+			return -1;
+		}
+	}
+
+	// flip like the runtime loader so the container can be uploaded as is
+	stbi_set_flip_vertically_on_load(1);
+
+	RgbaImage image;
+	int file_channels = 0;
+	auto* pixels = stbi_load(input.c_str(), &image.width, &image.height, &file_channels, 4);
+	if (pixels == nullptr)
+	{
+		std::cerr << "Failed to load " << input << ": " << stbi_failure_reason() << "\n";
+		return -1;
+	}
+	image.pixels.assign(pixels, pixels + static_cast<std::size_t>(image.width) * static_cast<std::size_t>(image.height) * 4);
+	stbi_image_free(pixels);
+
+	// grayscale with alpha is expanded to rgba
+	const auto used_channels = channels.value_or(file_channels == 2 ? 4 : file_channels);
+	const auto selected_format = format.value_or(select_block_format(used_channels, quality));
+
+	const auto compressed = compress_texture(image, selected_format, cd, thread_count);
+	const auto container = write_ktx2(compressed);
+
+	std::ofstream file{output, std::ios::binary};
+	if (file.good() == false)
+	{
+		std::cerr << "Failed to open " << output << "\n";
+		return -1;
+	}
+	file.write(reinterpret_cast<const char*>(container.data()), static_cast<std::streamsize>(container.size()));
+
+	const auto decoded = decode_image(selected_format, compressed.mips[0].data.data(), image.width, image.height);
+	const auto psnr_channels = selected_format == BlockFormat::bc4 ? 1 : selected_format == BlockFormat::bc5 ? 2 : 3;
+	std::cout << "Wrote " << output << ": " << image.width << "x" << image.height << ", " << compressed.mips.size() << " mips, "
+			  << container.size() << " bytes, psnr " << calculate_psnr(image, decoded, psnr_channels) << " dB\n";
+	return 0;
+}
@@ -0,0 +1,155 @@
+#include "klotter/render/texture.compress.h"
+
+#include "catch2/catch_test_macros.hpp"
+
+#include <random>
+
+using namespace klotter;
+
+namespace
+{
+	RgbaImage make_image(int width, int height, const std::function<glm::ivec4(int, int)>& color)
+	{
+		RgbaImage image{width, height, std::vector<std::uint8_t>(static_cast<std::size_t>(width * height * 4))};
+		for (int y = 0; y < height; y += 1)
+		{
+			for (int x = 0; x < width; x += 1)
+			{
+				const auto c = color(x, y);
+				for (int channel = 0; channel < 4; channel += 1)
+				{
+					image.pixels[static_cast<std::size_t>((y * width + x) * 4 + channel)] = static_cast<std::uint8_t>(c[channel]);
+				}
+			}
+		}
+		return image;
+	}
+
+	/// a smooth image, like a photo
+	RgbaImage make_gradient(int width, int height)
+	{
+		return make_image(
+			width,
+			height,
+			[&](int x, int y)
+			{
+				const auto r = x * 255 / (width - 1);
+				const auto g = y * 255 / (height - 1);
+				return glm::ivec4{r, g, (r + g) / 2, 255 - r};
+			}
+		);
+	}
+
+	/// the worst case for block compression
+	RgbaImage make_noise(int width, int height)
+	{
+		auto generator = std::mt19937{42};
+		auto distribution = std::uniform_int_distribution<int>{0, 255};
+		return make_image(
+			width,
+			height,
+			[&](int, int) { return glm::ivec4{distribution(generator), distribution(generator), distribution(generator), 255}; }
+		);
+	}
+
+	float psnr_after_compression(const RgbaImage& image, BlockFormat format, int channel_count)
+	{
+		const auto compressed = encode_image(image, format);
+		REQUIRE(compressed.size() == size_of_compressed_image(format, image.width, image.height));
+		const auto decoded = decode_image(format, compressed.data(), image.width, image.height);
+		return calculate_psnr(image, decoded, channel_count);
+	}
+}  //  namespace
+
+TEST_CASE("compress_select_format", "[texture]")
+{
+	CHECK(select_block_format(1, CompressionQuality::fast) == BlockFormat::bc4);
+	CHECK(select_block_format(2, CompressionQuality::fast) == BlockFormat::bc5);
+	CHECK(select_block_format(3, CompressionQuality::fast) == BlockFormat::bc1);
+	CHECK(select_block_format(4, CompressionQuality::fast) == BlockFormat::bc3);
+	CHECK(select_block_format(3, CompressionQuality::high) == BlockFormat::bc7);
+	CHECK(select_block_format(4, CompressionQuality::high) == BlockFormat::bc7);
+}
+
+TEST_CASE("compress_solid_color_is_lossless", "[texture]")
+{
+	// a color that is exactly representable in 565
+	const auto image = make_image(8, 8, [](int, int) { return glm::ivec4{0xFF, 0x00, 0x84, 0xFF}; });
+
+	CHECK(std::isinf(psnr_after_compression(image, BlockFormat::bc1, 3)));
+	CHECK(std::isinf(psnr_after_compression(image, BlockFormat::bc3, 4)));
+	CHECK(std::isinf(psnr_after_compression(image, BlockFormat::bc4, 1)));
+	CHECK(std::isinf(psnr_after_compression(image, BlockFormat::bc5, 2)));
+	CHECK(psnr_after_compression(image, BlockFormat::bc7, 4) > 45.0f);
+}
+
+TEST_CASE("compress_gradient_psnr", "[texture]")
+{
+	const auto image = make_gradient(64, 64);
+
+	CHECK(psnr_after_compression(image, BlockFormat::bc1, 3) > 35.0f);
+	CHECK(psnr_after_compression(image, BlockFormat::bc3, 4) > 35.0f);
+	CHECK(psnr_after_compression(image, BlockFormat::bc4, 1) > 45.0f);
+	CHECK(psnr_after_compression(image, BlockFormat::bc5, 2) > 45.0f);
+	CHECK(psnr_after_compression(image, BlockFormat::bc7, 4) > 40.0f);
+}
+
+TEST_CASE("compress_bc7_is_better_than_bc1", "[texture]")
+{
+	const auto image = make_noise(32, 32);
+	CHECK(psnr_after_compression(image, BlockFormat::bc7, 3) > psnr_after_compression(image, BlockFormat::bc1, 3));
+}
+
+TEST_CASE("compress_partial_blocks", "[texture]")
+{
+	const auto image = make_image(13, 6, [](int x, int y) { return glm::ivec4{x * 10, y * 20, 0, 255}; });
+
+	CHECK(size_of_compressed_image(BlockFormat::bc1, 13, 6) == 4 * 2 * 8);
+	CHECK(psnr_after_compression(image, BlockFormat::bc5, 2) > 40.0f);
+}
+
+TEST_CASE("compress_single_and_multi_threaded_are_equal", "[texture]")
+{
+	const auto image = make_noise(64, 32);
+	CHECK(encode_image(image, BlockFormat::bc1, 1) == encode_image(image, BlockFormat::bc1, 4));
+}
+
+TEST_CASE("compress_texture_bakes_all_mips", "[texture]")
+{
+	const auto compressed = compress_texture(make_gradient(16, 4), BlockFormat::bc1, ColorData::color_data, 1);
+
+	REQUIRE(compressed.mips.size() == 5);
+	CHECK(compressed.mips[0].width == 16);
+	CHECK(compressed.mips[0].height == 4);
+	CHECK(compressed.mips[2].width == 4);
+	CHECK(compressed.mips[2].height == 1);
+	CHECK(compressed.mips[4].width == 1);
+	CHECK(compressed.mips[4].height == 1);
+
+	for (const auto& mip: compressed.mips)
+	{
+		CHECK(mip.data.size() == size_of_compressed_image(BlockFormat::bc1, mip.width, mip.height));
+	}
+}
+
+TEST_CASE("compress_texture_decodes_requested_mips", "[texture]")
+{
+	const auto image = make_gradient(16, 8);
+	const auto compressed = compress_texture(image, BlockFormat::bc7, ColorData::non_color_data, 1);
+
+	// only the first level is decoded when mips aren't used
+	CHECK(decode_texture(compressed, 1).size() == 1);
+
+	const auto decoded = decode_texture(compressed, compressed.mips.size());
+	REQUIRE(decoded.size() == compressed.mips.size());
+	for (std::size_t level = 0; level < decoded.size(); level += 1)
+	{
+		CHECK(decoded[level].width == compressed.mips[level].width);
+		CHECK(decoded[level].height == compressed.mips[level].height);
+		CHECK(decoded[level].pixels.size() == static_cast<std::size_t>(decoded[level].width * decoded[level].height * 4));
+	}
+
+	// the first mip is the image itself
+	const auto first = encode_image(image, BlockFormat::bc7, 1);
+	CHECK(decoded[0].pixels == decode_image(BlockFormat::bc7, first.data(), image.width, image.height).pixels);
+}
@@ -7,6 +7,8 @@
 namespace klotter
 {
 
+struct State;
+
 /** \addtogroup texture
  *  @{
 */
@@ -69,6 +71,9 @@ struct BaseTexture
 {
 	unsigned int id;
 
+	/// "internal" a estimate of the memory the texture uses on the gpu, updated on each upload
+	std::size_t gpu_bytes = 0;
+
 	BaseTexture();
 	~BaseTexture();
 
@@ -82,6 +87,16 @@ struct BaseTexture
 	void unload();
 };
 
+struct CompressedTexture;
+
+/// 8-bit rgba pixels of a single mip level, the pixels are owned by someone else.
+struct MipPixels
+{
+	const void* pixels;
+	int width;
+	int height;
+};
+
 /// A 2d image texture.
 struct Texture2d : BaseTexture
 {
@@ -89,10 +104,45 @@ struct Texture2d : BaseTexture
 
 	/// "internal"
 	Texture2d(DEBUG_LABEL_ARG_MANY const void* pixel_data, unsigned int pixel_format, int w, int h, TextureEdge te, TextureRenderStyle trs, Transparency t, ColorData cd);
+
+	/// "internal" replace the pixels of the texture, keeping the id so all users get the new data.
+	/// If a pixel unpack buffer is bound, pixel_data is a offset into that buffer.
+	void upload(const void* pixel_data, unsigned int pixel_format, int w, int h, TextureRenderStyle trs, Transparency t, ColorData cd);
+
+	/// "internal" create a texture with mips that are already generated, the first mip is the full size image.
+	Texture2d(DEBUG_LABEL_ARG_MANY const std::vector<MipPixels>& mips, TextureEdge te, TextureRenderStyle trs, Transparency t, ColorData cd);
+
+	/// "internal" replace the pixels of the texture with mips that are already generated
+	void upload(const std::vector<MipPixels>& mips, TextureRenderStyle trs, Transparency t, ColorData cd);
+
+	/// "internal" create a block compressed texture, the mips are uploaded as is instead of being generated.
+	Texture2d(DEBUG_LABEL_ARG_MANY const CompressedTexture& compressed, TextureEdge te, TextureRenderStyle trs);
+
+	/// "internal" replace the texture with block compressed data
+	void upload(const CompressedTexture& compressed, TextureRenderStyle trs);
 };
 
 Texture2d load_image_from_color(DEBUG_LABEL_ARG_MANY SingleColor pixel, TextureEdge te, TextureRenderStyle trs, Transparency t, ColorData cd);
 
+/// A array of 2d images with the same size and format, sampled with a layer index.
+/// Textures in the same array share a single bind.
+/// @see \ref MaterialTextureArrays
+struct TextureArray : BaseTexture
+{
+	int width;
+	int height;
+	int layer_count;
+	int level_count;
+
+	TextureArray() = delete;
+
+	/// "internal" allocate all layers and mip levels, the layers are undefined until they are uploaded
+	TextureArray(DEBUG_LABEL_ARG_MANY int w, int h, int layers, int levels, TextureEdge te, TextureRenderStyle trs, Transparency t, ColorData cd);
+
+	/// "internal" replace the pixels of a layer, missing mip levels are left as is
+	void upload_layer(int layer, const std::vector<MipPixels>& mips);
+};
+
 // todo(Gustav): turn into an enum?
 /// 0=right(x+), 1=left(x-), 2=top(y+), 3=bottom(y-), 4=front(z+), 5=back(z-)
 constexpr std::size_t cubemap_size = 6;
@@ -103,7 +153,11 @@ struct TextureCubemap : BaseTexture
 {
 	TextureCubemap() = delete;
 
-	TextureCubemap(DEBUG_LABEL_ARG_MANY const std::array<void*, cubemap_size>& pixel_data, int width, int height, ColorData cd);
+	TextureCubemap(DEBUG_LABEL_ARG_MANY const std::array<const void*, cubemap_size>& pixel_data, int width, int height, ColorData cd);
+
+	/// "internal" replace the pixels of all faces, keeping the id so all users get the new data.
+	/// If a pixel unpack buffer is bound, pixel_data are offsets into that buffer.
+	void upload(const std::array<const void*, cubemap_size>& pixel_data, int width, int height, ColorData cd);
 };
 
 TextureCubemap load_cubemap_from_color(DEBUG_LABEL_ARG_MANY SingleColor pixel, ColorData cd);
@@ -194,9 +248,10 @@ std::shared_ptr<FrameBuffer> build_hdr_floating_framebuffer(DEBUG_LABEL_ARG_MANY
 std::shared_ptr<FrameBuffer> build_shadow_framebuffer(DEBUG_LABEL_ARG_MANY const glm::ivec2& size);
 
 
-/// raii class to render to a FrameBuffer
+/// raii class to render to a FrameBuffer, binds the default framebuffer when done
 struct BoundFbo
 {
+	State* states;
 	std::shared_ptr<FrameBuffer> fbo;
 
 	BoundFbo(const BoundFbo&) = delete;
@@ -204,11 +259,12 @@ struct BoundFbo
 	void operator=(const BoundFbo&) = delete;
 	void operator=(BoundFbo&&) = delete;
 
-	explicit BoundFbo(std::shared_ptr<FrameBuffer> f);
+	BoundFbo(State* s, std::shared_ptr<FrameBuffer> f);
 	~BoundFbo();
 };
 
-void resolve_multisampled_buffer(const FrameBuffer& src, FrameBuffer* dst);
+/// Resolve the lower left part of the multisampled buffer, both buffers needs to be the same size.
+void resolve_multisampled_buffer(State* states, const FrameBuffer& src, FrameBuffer* dst, const glm::ivec2& size);
 
 /**
  * @}
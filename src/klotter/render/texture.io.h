@@ -7,12 +7,41 @@
 namespace klotter
 {
 
+/// the color of an image that failed to load, html hot-pink
+constexpr SingleColor image_load_failure_color = color_from_rgba(0xFF, 0x69, 0xB4, 0xFF);
+
+/// Decoded 8-bit pixels of a image.
+/// Decoding is safe to do on any thread.
+struct PixelData
+{
+	unsigned char* pixel_data = nullptr;
+	int width = 0;
+	int height = 0;
+
+	PixelData(const embedded_binary& image_binary, bool include_transparency, bool flip = true);
+	~PixelData();
+
+	PixelData(PixelData&& rhs) noexcept;
+
+	PixelData(const PixelData&) = delete;
+	void operator=(const PixelData&) = delete;
+	void operator=(PixelData&&) = delete;
+};
+
 [[nodiscard]]
 Texture2d load_image_from_embedded(
 	DEBUG_LABEL_ARG_MANY 
 	const embedded_binary& image_binary, TextureEdge te, TextureRenderStyle trs, Transparency t, ColorData cd
 );
 
+/// Load a block compressed texture with baked mips from a KTX2 container.
+/// @see \ref write_ktx2
+[[nodiscard]]
+Texture2d load_image_from_ktx2(
+	DEBUG_LABEL_ARG_MANY 
+	const embedded_binary& container, TextureEdge te, TextureRenderStyle trs
+);
+
 /**
 @param images images in the following order: right, left, top, bottom, back and front
 @param cd How to load/interpret the color from the image
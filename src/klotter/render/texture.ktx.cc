@@ -0,0 +1,346 @@
+#include "klotter/render/texture.ktx.h"
+
+#include "klotter/assert.h"
+#include "klotter/cint.h"
+#include "klotter/log.h"
+
+#include <cstring>
+
+namespace klotter
+{
+
+namespace
+{
+	constexpr std::array<std::uint8_t, 12> ktx2_identifier = {0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A};
+
+	// identifier, 9 u32 fields and the index with 4 u32 and 2 u64
+	constexpr std::size_t header_size = 12 + 9 * 4 + 4 * 4 + 2 * 8;
+
+	constexpr std::size_t level_index_entry_size = 3 * 8;
+
+	// vulkan format enums
+	constexpr std::uint32_t vk_format_bc1_rgb_unorm = 131;
+	constexpr std::uint32_t vk_format_bc1_rgb_srgb = 132;
+	constexpr std::uint32_t vk_format_bc3_unorm = 137;
+	constexpr std::uint32_t vk_format_bc3_srgb = 138;
+	constexpr std::uint32_t vk_format_bc4_unorm = 139;
+	constexpr std::uint32_t vk_format_bc5_unorm = 141;
+	constexpr std::uint32_t vk_format_bc7_unorm = 145;
+	constexpr std::uint32_t vk_format_bc7_srgb = 146;
+
+	// khronos data format color models
+	constexpr std::uint32_t dfd_model_bc1a = 128;
+	constexpr std::uint32_t dfd_model_bc3 = 130;
+	constexpr std::uint32_t dfd_model_bc4 = 131;
+	constexpr std::uint32_t dfd_model_bc5 = 132;
+	constexpr std::uint32_t dfd_model_bc7 = 134;
+
+	constexpr std::uint32_t dfd_transfer_linear = 1;
+	constexpr std::uint32_t dfd_transfer_srgb = 2;
+
+	constexpr std::uint32_t dfd_channel_color = 0;
+	constexpr std::uint32_t dfd_channel_green = 1;
+	constexpr std::uint32_t dfd_channel_alpha = 15;
+
+	bool is_srgb(const CompressedTexture& texture)
+	{
+		// only the color formats have srgb variants
+		return texture.cd == ColorData::color_data
+			&& (texture.format == BlockFormat::bc1 || texture.format == BlockFormat::bc3 || texture.format == BlockFormat::bc7);
+	}
+
+	std::uint32_t vk_format_from(const CompressedTexture& texture)
+	{
+		const auto srgb = is_srgb(texture);
+		switch (texture.format)
+		{
+		case BlockFormat::bc1: return srgb ? vk_format_bc1_rgb_srgb : vk_format_bc1_rgb_unorm;
+		case BlockFormat::bc3: return srgb ? vk_format_bc3_srgb : vk_format_bc3_unorm;
+		case BlockFormat::bc4: return vk_format_bc4_unorm;
+		case BlockFormat::bc5: return vk_format_bc5_unorm;
+		case BlockFormat::bc7: return srgb ? vk_format_bc7_srgb : vk_format_bc7_unorm;
+		default: DIE("invalid block format"); return 0;
+		}
+	}
+
+	struct FormatFromVk
+	{
+		BlockFormat format;
+		ColorData cd;
+	};
+
+	std::optional<FormatFromVk> format_from_vk(std::uint32_t vk_format)
+	{
+		switch (vk_format)
+		{
+		case vk_format_bc1_rgb_unorm: return FormatFromVk{BlockFormat::bc1, ColorData::non_color_data};
+		case vk_format_bc1_rgb_srgb: return FormatFromVk{BlockFormat::bc1, ColorData::color_data};
+		case vk_format_bc3_unorm: return FormatFromVk{BlockFormat::bc3, ColorData::non_color_data};
+		case vk_format_bc3_srgb: return FormatFromVk{BlockFormat::bc3, ColorData::color_data};
+		case vk_format_bc4_unorm: return FormatFromVk{BlockFormat::bc4, ColorData::non_color_data};
+		case vk_format_bc5_unorm: return FormatFromVk{BlockFormat::bc5, ColorData::non_color_data};
+		case vk_format_bc7_unorm: return FormatFromVk{BlockFormat::bc7, ColorData::non_color_data};
+		case vk_format_bc7_srgb: return FormatFromVk{BlockFormat::bc7, ColorData::color_data};
+		default: return std::nullopt;
+		}
+	}
+
+	struct DfdSample
+	{
+		std::uint32_t channel;
+		std::uint32_t bit_offset;
+		std::uint32_t bit_length;
+	};
+
+	struct Writer
+	{
+		std::vector<std::uint8_t> data;
+
+		void u32(std::uint32_t value)
+		{
+			for (int index = 0; index < 4; index += 1)
+			{
+				data.emplace_back(static_cast<std::uint8_t>(value >> (index * 8)));
+			}
+		}
+
+		void u64(std::uint64_t value)
+		{
+			for (int index = 0; index < 8; index += 1)
+			{
+				data.emplace_back(static_cast<std::uint8_t>(value >> (index * 8)));
+			}
+		}
+
+		void align(std::size_t alignment)
+		{
+			while (data.size() % alignment != 0)
+			{
+				data.emplace_back(0);
+			}
+		}
+
+		/// overwrite a already written value
+		void u64_at(std::size_t offset, std::uint64_t value)
+		{
+			for (std::size_t index = 0; index < 8; index += 1)
+			{
+				data[offset + index] = static_cast<std::uint8_t>(value >> (index * 8));
+			}
+		}
+	};
+
+	struct Reader
+	{
+		const std::uint8_t* data;
+		std::size_t size;
+		std::size_t offset = 0;
+		bool is_ok = true;
+
+		std::uint64_t read(std::size_t bytes)
+		{
+			if (offset + bytes > size)
+			{
+				is_ok = false;
+				return 0;
+			}
+			std::uint64_t value = 0;
+			for (std::size_t index = 0; index < bytes; index += 1)
+			{
+				value |= static_cast<std::uint64_t>(data[offset + index]) << (index * 8);
+			}
+			offset += bytes;
+			return value;
+		}
+
+		std::uint32_t u32()
+		{
+			return static_cast<std::uint32_t>(read(4));
+		}
+
+		std::uint64_t u64()
+		{
+			return read(8);
+		}
+	};
+
+	/// the basic data format descriptor, required by the container but not used when reading
+	std::vector<std::uint8_t> create_dfd(const CompressedTexture& texture)
+	{
+		const auto block_bits = u32_from_sizet(size_of_block(texture.format) * 8);
+
+		std::uint32_t model = 0;
+		std::vector<DfdSample> samples;
+		switch (texture.format)
+		{
+		case BlockFormat::bc1:
+			model = dfd_model_bc1a;
+			samples = {{dfd_channel_color, 0, 64}};
+			break;
+		case BlockFormat::bc3:
+			model = dfd_model_bc3;
+			samples = {{dfd_channel_alpha, 0, 64}, {dfd_channel_color, 64, 64}};
+			break;
+		case BlockFormat::bc4:
+			model = dfd_model_bc4;
+			samples = {{dfd_channel_color, 0, 64}};
+			break;
+		case BlockFormat::bc5:
+			model = dfd_model_bc5;
+			samples = {{dfd_channel_color, 0, 64}, {dfd_channel_green, 64, 64}};
+			break;
+		case BlockFormat::bc7:
+			model = dfd_model_bc7;
+			samples = {{dfd_channel_color, 0, 128}};
+			break;
+		default: DIE("invalid block format"); break;
+		}
+
+		const auto block_size = u32_from_sizet(24 + samples.size() * 16);
+
+		Writer writer;
+		writer.u32(block_size + 4);
+
+		// vendor and type are 0 for the basic block, version 2
+		writer.u32(0);
+		writer.u32(2 | (block_size << 16));
+
+		// model, primaries (bt709), transfer and flags (straight alpha)
+		const auto transfer = is_srgb(texture) ? dfd_transfer_srgb : dfd_transfer_linear;
+		writer.u32(model | (1 << 8) | (transfer << 16));
+
+		// 4x4x1x1 texel block, stored as size - 1
+		writer.u32(3 | (3 << 8));
+
+		writer.u32(block_bits / 8);
+		writer.u32(0);
+
+		for (const auto& sample: samples)
+		{
+			writer.u32(sample.bit_offset | ((sample.bit_length - 1) << 16) | (sample.channel << 24));
+			writer.u32(0);
+			writer.u32(0);
+			writer.u32(0xFFFFFFFF);
+		}
+
+		return writer.data;
+	}
+}  //  namespace
+
+std::vector<std::uint8_t> write_ktx2(const CompressedTexture& texture)
+{
+	ASSERT(texture.mips.empty() == false);
+
+	const auto dfd = create_dfd(texture);
+	const auto level_count = texture.mips.size();
+
+	Writer writer;
+	writer.data.insert(writer.data.end(), ktx2_identifier.begin(), ktx2_identifier.end());
+	writer.u32(vk_format_from(texture));
+	writer.u32(1);  // type size, 1 for block compressed formats
+	writer.u32(static_cast<std::uint32_t>(texture.mips[0].width));
+	writer.u32(static_cast<std::uint32_t>(texture.mips[0].height));
+	writer.u32(0);  // depth
+	writer.u32(0);  // layers
+	writer.u32(1);  // faces
+	writer.u32(u32_from_sizet(level_count));
+	writer.u32(0);  // no supercompression
+
+	const auto dfd_offset = header_size + level_count * level_index_entry_size;
+	writer.u32(u32_from_sizet(dfd_offset));
+	writer.u32(u32_from_sizet(dfd.size()));
+	writer.u32(0);  // no key value data
+	writer.u32(0);
+	writer.u64(0);  // no supercompression global data
+	writer.u64(0);
+	ASSERT(writer.data.size() == header_size);
+
+	// the level index is filled in when the levels are written
+	const auto level_index_offset = writer.data.size();
+	for (std::size_t level = 0; level < level_count; level += 1)
+	{
+		writer.u64(0);
+		writer.u64(0);
+		writer.u64(0);
+	}
+
+	writer.data.insert(writer.data.end(), dfd.begin(), dfd.end());
+
+	// levels are stored from smallest to largest so streaming can show the small mips first
+	const auto block_size = size_of_block(texture.format);
+	for (std::size_t reverse_level = level_count; reverse_level > 0; reverse_level -= 1)
+	{
+		const auto level = reverse_level - 1;
+		const auto& mip = texture.mips[level];
+		ASSERT(mip.data.size() == size_of_compressed_image(texture.format, mip.width, mip.height));
+
+		writer.align(block_size);
+		const auto entry = level_index_offset + level * level_index_entry_size;
+		writer.u64_at(entry, writer.data.size());
+		writer.u64_at(entry + 8, mip.data.size());
+		writer.u64_at(entry + 16, mip.data.size());
+		writer.data.insert(writer.data.end(), mip.data.begin(), mip.data.end());
+	}
+
+	return writer.data;
+}
+
+std::optional<CompressedTexture> read_ktx2(const std::uint8_t* data, std::size_t size)
+{
+	if (size < header_size || std::memcmp(data, ktx2_identifier.data(), ktx2_identifier.size()) != 0)
+	{
+		LOG_ERROR("ERROR: Not a KTX2 container");
+		return std::nullopt;
+	}
+
+	Reader reader{data, size, ktx2_identifier.size()};
+	const auto vk_format = reader.u32();
+	[[maybe_unused]] const auto type_size = reader.u32();
+	const auto width = reader.u32();
+	const auto height = reader.u32();
+	const auto depth = reader.u32();
+	const auto layers = reader.u32();
+	const auto faces = reader.u32();
+	const auto level_count = std::max(reader.u32(), std::uint32_t{1});
+	const auto supercompression = reader.u32();
+
+	const auto format = format_from_vk(vk_format);
+	if (format.has_value() == false)
+	{
+		LOG_ERROR("ERROR: Unsupported KTX2 format %d", static_cast<int>(vk_format));
+		return std::nullopt;
+	}
+	if (depth != 0 || layers != 0 || faces != 1 || supercompression != 0)
+	{
+		LOG_ERROR("ERROR: Only uncompressed 2d KTX2 textures are supported");
+		return std::nullopt;
+	}
+
+	CompressedTexture texture;
+	texture.format = format->format;
+	texture.cd = format->cd;
+
+	reader.offset = header_size;
+	for (std::uint32_t level = 0; level < level_count; level += 1)
+	{
+		const auto offset = reader.u64();
+		const auto length = reader.u64();
+		[[maybe_unused]] const auto uncompressed_length = reader.u64();
+
+		const auto mip_width = std::max(1, static_cast<int>(width >> level));
+		const auto mip_height = std::max(1, static_cast<int>(height >> level));
+		const auto expected_length = size_of_compressed_image(texture.format, mip_width, mip_height);
+		if (reader.is_ok == false || length != expected_length || offset + length > size)
+		{
+			LOG_ERROR("ERROR: Invalid KTX2 level %d", static_cast<int>(level));
+			return std::nullopt;
+		}
+
+		const auto* level_data = data + offset;
+		texture.mips.emplace_back(CompressedMip{mip_width, mip_height, {level_data, level_data + length}});
+	}
+
+	return texture;
+}
+
+}  //  namespace klotter
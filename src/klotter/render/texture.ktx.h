@@ -0,0 +1,24 @@
+#pragma once
+
+#include "klotter/render/texture.compress.h"
+
+namespace klotter
+{
+
+/** \addtogroup texture
+ *  @{
+*/
+
+/// Stores a compressed texture and all it's mips in a KTX2 container.
+std::vector<std::uint8_t> write_ktx2(const CompressedTexture& texture);
+
+/// Reads a KTX2 container with a block compressed format written by \ref write_ktx2 or a compatible tool.
+/// Supercompressed, array, cubemap and 3d textures are not supported.
+/// @return the texture or none if the data isn't a supported KTX2 container
+std::optional<CompressedTexture> read_ktx2(const std::uint8_t* data, std::size_t size);
+
+/**
+ * @}
+*/
+
+}  //  namespace klotter
@@ -0,0 +1,61 @@
+#include "klotter/render/texture.ktx.h"
+
+#include "catch2/catch_test_macros.hpp"
+
+using namespace klotter;
+
+namespace
+{
+	RgbaImage make_checker(int width, int height)
+	{
+		RgbaImage image{width, height, std::vector<std::uint8_t>(static_cast<std::size_t>(width * height * 4))};
+		for (std::size_t index = 0; index < image.pixels.size(); index += 1)
+		{
+			const auto pixel = index / 4;
+			image.pixels[index] = ((pixel % 3) == 0) ? 0xFF : 0x20;
+		}
+		return image;
+	}
+}  //  namespace
+
+TEST_CASE("ktx2_roundtrip", "[texture]")
+{
+	const auto texture = compress_texture(make_checker(32, 16), BlockFormat::bc7, ColorData::color_data, 1);
+	const auto container = write_ktx2(texture);
+
+	const auto read = read_ktx2(container.data(), container.size());
+	REQUIRE(read.has_value());
+	CHECK(read->format == BlockFormat::bc7);
+	CHECK(read->cd == ColorData::color_data);
+	REQUIRE(read->mips.size() == texture.mips.size());
+	for (std::size_t level = 0; level < texture.mips.size(); level += 1)
+	{
+		CHECK(read->mips[level].width == texture.mips[level].width);
+		CHECK(read->mips[level].height == texture.mips[level].height);
+		CHECK(read->mips[level].data == texture.mips[level].data);
+	}
+}
+
+TEST_CASE("ktx2_linear_single_channel", "[texture]")
+{
+	const auto texture = compress_texture(make_checker(8, 8), BlockFormat::bc4, ColorData::non_color_data, 1);
+	const auto container = write_ktx2(texture);
+
+	const auto read = read_ktx2(container.data(), container.size());
+	REQUIRE(read.has_value());
+	CHECK(read->format == BlockFormat::bc4);
+	CHECK(read->cd == ColorData::non_color_data);
+}
+
+TEST_CASE("ktx2_rejects_invalid_data", "[texture]")
+{
+	const auto texture = compress_texture(make_checker(8, 8), BlockFormat::bc1, ColorData::color_data, 1);
+	auto container = write_ktx2(texture);
+
+	// truncated
+	CHECK(read_ktx2(container.data(), container.size() - 1).has_value() == false);
+
+	// not a ktx2 file
+	container[1] = 0;
+	CHECK(read_ktx2(container.data(), container.size()).has_value() == false);
+}
@@ -0,0 +1,348 @@
+#include "klotter/render/texture.mips.h"
+
+#include "klotter/assert.h"
+#include "klotter/cint.h"
+#include "klotter/jobs.h"
+
+#include "klotter/render/color.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numbers>
+
+namespace klotter
+{
+
+namespace
+{
+	/// a image with floating point pixels, color data is stored in linear space
+	struct FloatImage
+	{
+		int width = 0;
+		int height = 0;
+		std::vector<glm::vec4> pixels;
+	};
+
+	/// weights for the source pixels of a downsampled pixel, the first tap is offset from the center
+	struct Kernel
+	{
+		std::vector<float> weights;
+
+		/// the offset from the first source pixel (2*x) to the first tap
+		int first_offset;
+	};
+
+	/// cutout textures use the same default cutoff as the renderer
+	constexpr float default_alpha_cutoff = 0.5f;
+
+	constexpr int kaiser_radius = 2;
+	constexpr float kaiser_alpha = 4.0f;
+
+	/// bessel function of the first kind, used by the kaiser window
+	float bessel_i0(float x)
+	{
+		float sum = 1.0f;
+		float term = 1.0f;
+		for (int k = 1; k < 16; k += 1)
+		{
+			const auto f = x / (2.0f * static_cast<float>(k));
+			term *= f * f;
+			sum += term;
+		}
+		return sum;
+	}
+
+	float sinc(float x)
+	{
+		if (std::abs(x) < 0.0001f)
+		{
+			return 1.0f;
+		}
+		const auto px = std::numbers::pi_v<float> * x;
+		return std::sin(px) / px;
+	}
+
+	Kernel make_kernel(MipFilter filter)
+	{
+		switch (filter)
+		{
+		case MipFilter::box: return {{0.5f, 0.5f}, 0};
+		case MipFilter::kaiser:
+			{
+				// the kernel covers the radius in the downsampled image, that is twice the number of source pixels on each side
+				Kernel kernel{{}, 1 - 2 * kaiser_radius};
+				float sum = 0.0f;
+				for (int tap = 0; tap < 4 * kaiser_radius; tap += 1)
+				{
+					// distance from the center of the downsampled pixel, in downsampled pixels
+					const auto t = (static_cast<float>(kernel.first_offset + tap) + 0.5f - 1.0f) / 2.0f;
+					const auto r = t / static_cast<float>(kaiser_radius);
+					const auto window = bessel_i0(kaiser_alpha * std::sqrt(std::max(0.0f, 1.0f - r * r))) / bessel_i0(kaiser_alpha);
+					const auto weight = sinc(t) * window;
+					kernel.weights.emplace_back(weight);
+					sum += weight;
+				}
+				for (auto& w: kernel.weights)
+				{
+					w /= sum;
+				}
+				return kernel;
+			}
+		default: DIE("invalid mip filter"); return {{0.5f, 0.5f}, 0};
+		}
+	}
+
+	const std::array<float, 256>& srgb_to_linear_table()
+	{
+		static const auto table = []()
+		{
+			std::array<float, 256> values;
+			for (std::size_t index = 0; index < values.size(); index += 1)
+			{
+				values[index] = linear_from_srgb(static_cast<float>(index) / 255.0f);
+			}
+			return values;
+		}();
+		return table;
+	}
+
+	/// the linear values halfway between two srgb values, used to find the closest srgb value
+	const std::array<float, 255>& srgb_thresholds_table()
+	{
+		static const auto table = []()
+		{
+			const auto& linear = srgb_to_linear_table();
+			std::array<float, 255> values;
+			for (std::size_t index = 0; index < values.size(); index += 1)
+			{
+				values[index] = (linear[index] + linear[index + 1]) / 2.0f;
+			}
+			return values;
+		}();
+		return table;
+	}
+
+	std::uint8_t unorm8_from_float(float value)
+	{
+		return static_cast<std::uint8_t>(std::clamp(std::round(value * 255.0f), 0.0f, 255.0f));
+	}
+
+	FloatImage float_from_rgba(const RgbaImage& image, bool is_color)
+	{
+		FloatImage result{image.width, image.height, std::vector<glm::vec4>(sizet_from_int(image.width * image.height))};
+		for (std::size_t index = 0; index < result.pixels.size(); index += 1)
+		{
+			const auto* p = &image.pixels[index * 4];
+			const auto a = static_cast<float>(p[3]) / 255.0f;
+			if (is_color)
+			{
+				result.pixels[index] = {linear_from_srgb8(p[0]), linear_from_srgb8(p[1]), linear_from_srgb8(p[2]), a};
+			}
+			else
+			{
+				result.pixels[index] = glm::vec4{p[0], p[1], p[2], p[3]} / 255.0f;
+			}
+		}
+		return result;
+	}
+
+	RgbaImage rgba_from_float(const FloatImage& image, bool is_color, float alpha_scale)
+	{
+		RgbaImage result{image.width, image.height, std::vector<std::uint8_t>(image.pixels.size() * 4)};
+		for (std::size_t index = 0; index < image.pixels.size(); index += 1)
+		{
+			const auto& p = image.pixels[index];
+			auto* dst = &result.pixels[index * 4];
+			for (int channel = 0; channel < 3; channel += 1)
+			{
+				dst[channel] = is_color ? srgb8_from_linear(p[channel]) : unorm8_from_float(p[channel]);
+			}
+			dst[3] = unorm8_from_float(p.a * alpha_scale);
+		}
+		return result;
+	}
+
+	/// runs the function for each row, split over the job system
+	template<typename F>
+	void for_each_row(int rows, int thread_count, F&& f)
+	{
+		get_job_system().parallel_for(0, rows, grain_size_from_thread_count(rows, thread_count),
+			[&](int begin, int end)
+			{
+				for (int row = begin; row < end; row += 1)
+				{
+					f(row);
+				}
+			}
+		);
+	}
+
+	/// downsamples a single axis with the kernel, pixels outside the image are clamped to the edge
+	FloatImage downsample_axis(const FloatImage& src, const Kernel& kernel, bool horizontal, int thread_count)
+	{
+		const auto src_size = horizontal ? src.width : src.height;
+		if (src_size == 1)
+		{
+			return src;
+		}
+
+		const auto dst_size = src_size / 2;
+		FloatImage dst{horizontal ? dst_size : src.width, horizontal ? src.height : dst_size, {}};
+		dst.pixels.resize(sizet_from_int(dst.width * dst.height));
+
+		const auto get = [&](int x, int y) -> const glm::vec4& { return src.pixels[sizet_from_int(y * src.width + x)]; };
+
+		for_each_row(
+			dst.height,
+			thread_count,
+			[&](int y)
+			{
+				for (int x = 0; x < dst.width; x += 1)
+				{
+					glm::vec4 sum{0.0f};
+					const auto first = (horizontal ? x : y) * 2 + kernel.first_offset;
+					for (std::size_t tap = 0; tap < kernel.weights.size(); tap += 1)
+					{
+						const auto s = std::clamp(first + static_cast<int>(tap), 0, src_size - 1);
+						sum += kernel.weights[tap] * (horizontal ? get(s, y) : get(x, s));
+					}
+
+					// negative lobes of the kaiser filter can overshoot
+					dst.pixels[sizet_from_int(y * dst.width + x)] = glm::clamp(sum, glm::vec4{0.0f}, glm::vec4{1.0f});
+				}
+			}
+		);
+
+		return dst;
+	}
+
+	float coverage_of(const FloatImage& image, float cutoff, float alpha_scale)
+	{
+		std::size_t covered = 0;
+		for (const auto& p: image.pixels)
+		{
+			if (p.a * alpha_scale > cutoff)
+			{
+				covered += 1;
+			}
+		}
+		return static_cast<float>(covered) / static_cast<float>(image.pixels.size());
+	}
+
+	/// binary search for a alpha scale that gives the same coverage as the source
+	float find_alpha_scale(const FloatImage& image, float cutoff, float target_coverage)
+	{
+		float lower = 0.0f;
+		float upper = 4.0f;
+		float scale = 1.0f;
+		for (int iteration = 0; iteration < 16; iteration += 1)
+		{
+			const auto coverage = coverage_of(image, cutoff, scale);
+			if (coverage < target_coverage)
+			{
+				lower = scale;
+			}
+			else if (coverage > target_coverage)
+			{
+				upper = scale;
+			}
+			else
+			{
+				break;
+			}
+			scale = (lower + upper) / 2.0f;
+		}
+		return scale;
+	}
+}  //  namespace
+
+MipSettings mip_settings_from_transparency(Transparency t)
+{
+	MipSettings settings;
+	if (t == Transparency::include)
+	{
+		settings.alpha_cutoff = default_alpha_cutoff;
+	}
+	return settings;
+}
+
+float linear_from_srgb8(std::uint8_t value)
+{
+	return srgb_to_linear_table()[value];
+}
+
+std::uint8_t srgb8_from_linear(float value)
+{
+	const auto& thresholds = srgb_thresholds_table();
+	const auto found = std::upper_bound(thresholds.begin(), thresholds.end(), value);
+	return static_cast<std::uint8_t>(std::distance(thresholds.begin(), found));
+}
+
+RgbaImage rgba_from_pixels(const unsigned char* pixels, int width, int height, int channels)
+{
+	ASSERT(channels == 3 || channels == 4);
+	const auto pixel_count = sizet_from_int(width * height);
+	const auto src_channels = sizet_from_int(channels);
+
+	RgbaImage rgba{width, height, std::vector<std::uint8_t>(pixel_count * 4)};
+	for (std::size_t pixel = 0; pixel < pixel_count; pixel += 1)
+	{
+		for (std::size_t channel = 0; channel < 4; channel += 1)
+		{
+			rgba.pixels[pixel * 4 + channel] = channel < src_channels ? pixels[pixel * src_channels + channel] : 0xFF;
+		}
+	}
+	return rgba;
+}
+
+std::vector<RgbaImage> generate_mips(const RgbaImage& image, ColorData cd, const MipSettings& settings)
+{
+	ASSERT(image.width > 0 && image.height > 0);
+
+	const auto is_color = cd == ColorData::color_data;
+	const auto kernel = make_kernel(settings.filter);
+
+	std::vector<RgbaImage> mips;
+	mips.emplace_back(image);
+
+	// each mip is created from the unquantized previous mip so errors don't accumulate
+	auto current = float_from_rgba(image, is_color);
+	const auto target_coverage = settings.alpha_cutoff ? coverage_of(current, *settings.alpha_cutoff, 1.0f) : 0.0f;
+
+	while (current.width > 1 || current.height > 1)
+	{
+		current = downsample_axis(current, kernel, true, settings.thread_count);
+		current = downsample_axis(current, kernel, false, settings.thread_count);
+
+		const auto alpha_scale = settings.alpha_cutoff ? find_alpha_scale(current, *settings.alpha_cutoff, target_coverage) : 1.0f;
+		mips.emplace_back(rgba_from_float(current, is_color, alpha_scale));
+	}
+
+	return mips;
+}
+
+float calculate_alpha_coverage(const RgbaImage& image, float cutoff)
+{
+	std::size_t covered = 0;
+	const auto pixel_count = sizet_from_int(image.width * image.height);
+	for (std::size_t pixel = 0; pixel < pixel_count; pixel += 1)
+	{
+		if (static_cast<float>(image.pixels[pixel * 4 + 3]) / 255.0f > cutoff)
+		{
+			covered += 1;
+		}
+	}
+	return static_cast<float>(covered) / static_cast<float>(pixel_count);
+}
+
+std::vector<MipPixels> views_from_images(const std::vector<RgbaImage>& images)
+{
+	std::vector<MipPixels> mips;
+	for (const auto& image: images)
+	{
+		mips.emplace_back(MipPixels{image.pixels.data(), image.width, image.height});
+	}
+	return mips;
+}
+
+}  //  namespace klotter
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "klotter/render/texture.h"
+
+#include <cstdint>
+
+namespace klotter
+{
+
+/** \addtogroup texture
+ *  @{
+*/
+
+/// An uncompressed image with 4 8-bit channels per pixel, rows are stored bottom to top like in open gl.
+struct RgbaImage
+{
+	int width = 0;
+	int height = 0;
+	std::vector<std::uint8_t> pixels;
+};
+
+/// The kernel used when downsampling a mip.
+enum class MipFilter
+{
+	/// average 2x2 pixels, fast but slightly blurry and aliased
+	box,
+
+	/// a kaiser windowed sinc, sharper mips with less aliasing
+	kaiser
+};
+
+struct MipSettings
+{
+	MipFilter filter = MipFilter::box;
+
+	/// for cutout textures, scale the alpha of each mip so the same ratio of pixels pass the alpha test as in the source.
+	/// Without this, cutout textures like grass fades away in the distance.
+	std::optional<float> alpha_cutoff;
+
+	/// the most threads to use, 0 uses all threads of the job system
+	int thread_count = 0;
+};
+
+/// The mip settings that are used when loading textures, cutout textures preserve their alpha coverage.
+MipSettings mip_settings_from_transparency(Transparency t);
+
+/// Converts a 8-bit srgb value to linear, using a lookup table.
+float linear_from_srgb8(std::uint8_t value);
+
+/// Converts a linear value to the closest 8-bit srgb value.
+std::uint8_t srgb8_from_linear(float value);
+
+/// Converts 8-bit rgb or rgba pixels to a rgba image.
+RgbaImage rgba_from_pixels(const unsigned char* pixels, int width, int height, int channels);
+
+/// Generates the full mip chain down to 1x1, the first image is the source.
+/// Color data is filtered in linear space and the result is the same regardless of the number of threads.
+std::vector<RgbaImage> generate_mips(const RgbaImage& image, ColorData cd, const MipSettings& settings = {});
+
+/// The ratio of pixels that has a alpha above the cutoff.
+float calculate_alpha_coverage(const RgbaImage& image, float cutoff);
+
+/// Views of the images that can be uploaded with \ref Texture2d
+std::vector<MipPixels> views_from_images(const std::vector<RgbaImage>& images);
+
+/**
+ * @}
+*/
+
+}  //  namespace klotter
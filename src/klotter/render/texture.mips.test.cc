@@ -0,0 +1,142 @@
+#include "klotter/render/texture.mips.h"
+
+#include "catch2/catch_test_macros.hpp"
+
+#include <random>
+
+using namespace klotter;
+
+namespace
+{
+	RgbaImage make_image(int width, int height, const std::function<glm::ivec4(int, int)>& color)
+	{
+		RgbaImage image{width, height, std::vector<std::uint8_t>(static_cast<std::size_t>(width * height * 4))};
+		for (int y = 0; y < height; y += 1)
+		{
+			for (int x = 0; x < width; x += 1)
+			{
+				const auto c = color(x, y);
+				for (int channel = 0; channel < 4; channel += 1)
+				{
+					image.pixels[static_cast<std::size_t>((y * width + x) * 4 + channel)] = static_cast<std::uint8_t>(c[channel]);
+				}
+			}
+		}
+		return image;
+	}
+
+	/// alternating black and white columns
+	RgbaImage make_stripes(int width, int height)
+	{
+		return make_image(width, height, [](int x, int) { return x % 2 == 0 ? glm::ivec4{0, 0, 0, 255} : glm::ivec4{255, 255, 255, 255}; });
+	}
+
+	/// a cutout like a leaf or a fence, with soft edges
+	RgbaImage make_cutout(int width, int height)
+	{
+		std::mt19937 generator{42};
+		std::uniform_int_distribution<int> distribution{0, 255};
+		return make_image(width, height, [&](int, int) { return glm::ivec4{40, 160, 40, distribution(generator) > 160 ? 255 : 64}; });
+	}
+
+	glm::ivec4 pixel_at(const RgbaImage& image, int x, int y)
+	{
+		const auto* p = &image.pixels[static_cast<std::size_t>((y * image.width + x) * 4)];
+		return {p[0], p[1], p[2], p[3]};
+	}
+}  //  namespace
+
+TEST_CASE("mips_srgb_roundtrip", "[texture]")
+{
+	for (int value = 0; value < 256; value += 1)
+	{
+		const auto srgb = static_cast<std::uint8_t>(value);
+		CHECK(srgb8_from_linear(linear_from_srgb8(srgb)) == srgb);
+	}
+	CHECK(srgb8_from_linear(-1.0f) == 0);
+	CHECK(srgb8_from_linear(2.0f) == 255);
+}
+
+TEST_CASE("mips_chain_size", "[texture]")
+{
+	const auto mips = generate_mips(make_stripes(16, 4), ColorData::color_data);
+	REQUIRE(mips.size() == 5);
+	CHECK(mips[1].width == 8);
+	CHECK(mips[1].height == 2);
+	CHECK(mips[2].width == 4);
+	CHECK(mips[2].height == 1);
+	CHECK(mips[4].width == 1);
+	CHECK(mips[4].height == 1);
+	for (const auto& mip: mips)
+	{
+		CHECK(mip.pixels.size() == static_cast<std::size_t>(mip.width * mip.height * 4));
+	}
+}
+
+TEST_CASE("mips_are_gamma_correct", "[texture]")
+{
+	const auto stripes = make_stripes(4, 4);
+
+	// averaging black and white in linear space is a 50% gray that is brighter than 128 in srgb
+	const auto color = generate_mips(stripes, ColorData::color_data);
+	CHECK(pixel_at(color[1], 0, 0) == glm::ivec4{188, 188, 188, 255});
+
+	// non color data like normal maps are averaged as is
+	const auto linear = generate_mips(stripes, ColorData::non_color_data);
+	CHECK(pixel_at(linear[1], 0, 0) == glm::ivec4{128, 128, 128, 255});
+}
+
+TEST_CASE("mips_are_deterministic", "[texture]")
+{
+	const auto image = make_cutout(64, 32);
+
+	for (const auto filter: {MipFilter::box, MipFilter::kaiser})
+	{
+		MipSettings single;
+		single.filter = filter;
+		single.thread_count = 1;
+
+		auto many = single;
+		many.thread_count = 4;
+
+		const auto lhs = generate_mips(image, ColorData::color_data, single);
+		const auto rhs = generate_mips(image, ColorData::color_data, many);
+		REQUIRE(lhs.size() == rhs.size());
+		for (std::size_t level = 0; level < lhs.size(); level += 1)
+		{
+			CHECK(lhs[level].pixels == rhs[level].pixels);
+		}
+	}
+}
+
+TEST_CASE("mips_kaiser_keeps_flat_areas", "[texture]")
+{
+	const auto flat = make_image(16, 16, [](int, int) { return glm::ivec4{50, 100, 200, 255}; });
+
+	MipSettings settings;
+	settings.filter = MipFilter::kaiser;
+	const auto mips = generate_mips(flat, ColorData::color_data, settings);
+	for (const auto& mip: mips)
+	{
+		CHECK(pixel_at(mip, mip.width - 1, mip.height - 1) == glm::ivec4{50, 100, 200, 255});
+	}
+}
+
+TEST_CASE("mips_preserve_alpha_coverage", "[texture]")
+{
+	constexpr float cutoff = 0.5f;
+	const auto image = make_cutout(64, 64);
+	const auto source_coverage = calculate_alpha_coverage(image, cutoff);
+
+	const auto plain = generate_mips(image, ColorData::color_data);
+	const auto preserved = generate_mips(image, ColorData::color_data, mip_settings_from_transparency(Transparency::include));
+
+	// a mip with enough pixels to measure coverage
+	constexpr std::size_t level = 3;
+	REQUIRE(preserved[level].width == 8);
+
+	const auto plain_error = std::abs(calculate_alpha_coverage(plain[level], cutoff) - source_coverage);
+	const auto preserved_error = std::abs(calculate_alpha_coverage(preserved[level], cutoff) - source_coverage);
+	CHECK(preserved_error < 0.05f);
+	CHECK(preserved_error < plain_error);
+}
@@ -1,11 +1,14 @@
 #include "klotter/render/uniform.h"
 
+#include "klotter/str.h"
+
 namespace klotter
 {
-Uniform::Uniform(std::string n, int l, unsigned int sp)
+Uniform::Uniform(std::string n, int l, unsigned int sp, unsigned int t)
 	: name(std::move(n))
 	  , location(l)
 	, debug_shader_program(sp)
+	, type(t)
 {
 }
 
@@ -14,4 +17,105 @@ bool Uniform::is_valid() const
 	return location >= 0;
 }
 
+namespace
+{
+	const ActiveUniform* find_in(const StringViewMap<ActiveUniform>& map, std::string_view name)
+	{
+		const auto found = map.find(name);
+		return found == map.end() ? nullptr : &found->second;
+	}
+
+	/// adds name and, for a basic array reported as name[0], every element and the name without [0]
+	void add_with_elements(StringViewMap<ActiveUniform>* map, std::string_view name, const ActiveUniform& uniform)
+	{
+		constexpr std::string_view first_element = "[0]";
+
+		if (uniform.array_size <= 1 || name.ends_with(first_element) == false)
+		{
+			map->insert_or_assign(std::string{name}, uniform);
+			return;
+		}
+
+		const auto base = name.substr(0, name.size() - first_element.size());
+		map->insert_or_assign(std::string{base}, uniform);
+		for (int index = 0; index < uniform.array_size; index += 1)
+		{
+			auto element = uniform;
+			element.location = uniform.location + index;
+			map->insert_or_assign(Str() << base << "[" << index << "]", element);
+		}
+	}
+
+	struct StructArrayMember
+	{
+		std::string_view array;
+		std::size_t index;
+		std::string_view member;
+	};
+
+	/// splits array[index].member, the member may contain more dots and brackets
+	std::optional<StructArrayMember> parse_struct_array_member(std::string_view name)
+	{
+		const auto open = name.find('[');
+		if (open == std::string_view::npos || open == 0)
+		{
+			return std::nullopt;
+		}
+
+		const auto close = name.find("].", open);
+		if (close == std::string_view::npos || close == open + 1)
+		{
+			return std::nullopt;
+		}
+
+		std::size_t index = 0;
+		for (const auto c: name.substr(open + 1, close - open - 1))
+		{
+			if (c < '0' || c > '9')
+			{
+				return std::nullopt;
+			}
+			index = index * 10 + static_cast<std::size_t>(c - '0');
+		}
+
+		return StructArrayMember{name.substr(0, open), index, name.substr(close + 2)};
+	}
+}  //  namespace
+
+const ActiveUniform* UniformTable::find(std::string_view name) const
+{
+	return find_in(uniforms, name);
+}
+
+const ActiveUniform* UniformTable::find_member(std::string_view array, std::size_t index, std::string_view member) const
+{
+	const auto found = struct_arrays.find(array);
+	if (found == struct_arrays.end() || index >= found->second.size())
+	{
+		return nullptr;
+	}
+	return find_in(found->second[index], member);
+}
+
+void add_active_uniform(UniformTable* table, const ActiveUniform& uniform)
+{
+	add_with_elements(&table->uniforms, uniform.name, uniform);
+
+	if (const auto parsed = parse_struct_array_member(uniform.name); parsed)
+	{
+		auto found = table->struct_arrays.find(parsed->array);
+		if (found == table->struct_arrays.end())
+		{
+			found = table->struct_arrays.emplace(std::string{parsed->array}, std::vector<StringViewMap<ActiveUniform>>{}).first;
+		}
+
+		auto& elements = found->second;
+		if (elements.size() <= parsed->index)
+		{
+			elements.resize(parsed->index + 1);
+		}
+		add_with_elements(&elements[parsed->index], parsed->member, uniform);
+	}
+}
+
 }  //  namespace klotter
@@ -11,13 +11,75 @@ struct Uniform
 	int location = -1;
 	unsigned int debug_shader_program = 0;
 	int texture = -1;  ///< The value is >=0 if this is uniform maps to a texture
+	unsigned int type = 0;  ///< The open gl type of the uniform or 0 if unknown
 
 	/// Creates a invalid uniform
 	Uniform() = default;
 
-	Uniform(std::string n, int l, unsigned int sp);
+	Uniform(std::string n, int l, unsigned int sp, unsigned int t = 0);
 
 	[[nodiscard]] bool is_valid() const;
 };
 
+/// The type a uniform is expected to have, checked against the type reported by the driver.
+enum class UniformKind
+{
+	any,
+	float_type,
+	bool_type,
+	int_type,
+	vec2,
+	vec3,
+	vec4,
+	mat3,
+	mat4,
+	texture
+};
+
+/// A uniform as reported by the driver.
+struct ActiveUniform
+{
+	std::string name;
+	int location = -1;
+	unsigned int type = 0;
+	int array_size = 1;
+};
+
+/// Hashes strings and string views the same way, so a map can be searched without creating a std::string.
+struct StringViewHash
+{
+	using is_transparent = void;
+
+	std::size_t operator()(std::string_view str) const
+	{
+		return std::hash<std::string_view>{}(str);
+	}
+};
+
+template<typename T>
+using StringViewMap = std::unordered_map<std::string, T, StringViewHash, std::equal_to<>>;
+
+/** All active uniforms in a program, outside of uniform blocks.
+ * Created once after linking so looking up a uniform doesn't need to ask the driver.
+ */
+struct UniformTable
+{
+	/// all uniforms by full name, arrays are also found without the [0] suffix
+	StringViewMap<ActiveUniform> uniforms;
+
+	/// members of arrays of structs, u_lights[2].color is found as struct_arrays["u_lights"][2]["color"]
+	StringViewMap<std::vector<StringViewMap<ActiveUniform>>> struct_arrays;
+
+	/// false if the driver couldn't list the uniforms and lookups need to ask the driver
+	bool is_reflected = false;
+
+	[[nodiscard]] const ActiveUniform* find(std::string_view name) const;
+	[[nodiscard]] const ActiveUniform* find_member(std::string_view array, std::size_t index, std::string_view member) const;
+};
+
+/** internal: Add a uniform as reported by the driver.
+ * Arrays are reported once by the driver as name[0], every element is added.
+ */
+void add_active_uniform(UniformTable* table, const ActiveUniform& uniform);
+
 }  //  namespace klotter
@@ -0,0 +1,141 @@
+#include "klotter/render/uniform.h"
+
+#include "klotter/render/shader.h"
+
+#include "catch2/catch_test_macros.hpp"
+
+#include <bit>
+
+using namespace klotter;
+
+namespace
+{
+	constexpr unsigned int float_type = 0x1406;
+	constexpr unsigned int vec3_type = 0x8B51;
+
+	UniformTable make_table(const std::vector<ActiveUniform>& uniforms)
+	{
+		UniformTable table;
+		for (const auto& u: uniforms)
+		{
+			add_active_uniform(&table, u);
+		}
+		table.is_reflected = true;
+		return table;
+	}
+}  //  namespace
+
+TEST_CASE("uniform_table_find", "[uniform]")
+{
+	const auto table = make_table({ActiveUniform{"u_factor", 3, float_type, 1}, ActiveUniform{"u_material.shininess", 7, float_type, 1}});
+
+	REQUIRE(table.find("u_factor") != nullptr);
+	CHECK(table.find("u_factor")->location == 3);
+	CHECK(table.find("u_factor")->type == float_type);
+
+	REQUIRE(table.find("u_material.shininess") != nullptr);
+	CHECK(table.find("u_material.shininess")->location == 7);
+
+	CHECK(table.find("u_missing") == nullptr);
+	CHECK(table.find("u_material") == nullptr);
+	CHECK(table.struct_arrays.empty());
+}
+
+TEST_CASE("uniform_table_basic_array", "[uniform]")
+{
+	const auto table = make_table({ActiveUniform{"u_weights[0]", 10, float_type, 4}});
+
+	REQUIRE(table.find("u_weights") != nullptr);
+	CHECK(table.find("u_weights")->location == 10);
+
+	REQUIRE(table.find("u_weights[0]") != nullptr);
+	CHECK(table.find("u_weights[0]")->location == 10);
+
+	REQUIRE(table.find("u_weights[3]") != nullptr);
+	CHECK(table.find("u_weights[3]")->location == 13);
+
+	CHECK(table.find("u_weights[4]") == nullptr);
+}
+
+TEST_CASE("uniform_table_struct_array", "[uniform]")
+{
+	const auto table = make_table(
+		{ActiveUniform{"u_point_lights[0].diffuse", 20, vec3_type, 1},
+		 ActiveUniform{"u_point_lights[1].diffuse", 21, vec3_type, 1},
+		 ActiveUniform{"u_point_lights[1].specular", 22, vec3_type, 1},
+		 ActiveUniform{"u_point_lights[1].weights[0]", 23, float_type, 2}}
+	);
+
+	REQUIRE(table.find_member("u_point_lights", 0, "diffuse") != nullptr);
+	CHECK(table.find_member("u_point_lights", 0, "diffuse")->location == 20);
+	CHECK(table.find_member("u_point_lights", 0, "specular") == nullptr);
+
+	REQUIRE(table.find_member("u_point_lights", 1, "specular") != nullptr);
+	CHECK(table.find_member("u_point_lights", 1, "specular")->location == 22);
+	CHECK(table.find_member("u_point_lights", 1, "specular")->type == vec3_type);
+
+	REQUIRE(table.find_member("u_point_lights", 1, "weights[1]") != nullptr);
+	CHECK(table.find_member("u_point_lights", 1, "weights[1]")->location == 24);
+
+	CHECK(table.find_member("u_point_lights", 2, "diffuse") == nullptr);
+	CHECK(table.find_member("u_frustum_lights", 0, "diffuse") == nullptr);
+
+	// the full name is also found
+	REQUIRE(table.find("u_point_lights[1].diffuse") != nullptr);
+	CHECK(table.find("u_point_lights[1].diffuse")->location == 21);
+}
+
+TEST_CASE("uniform_value_cache", "[uniform]")
+{
+	std::vector<UniformValue> values;
+	reset_uniform_upload_stats();
+
+	const auto set = [&](int location, float f) { return is_new_uniform_value(&values, location, &f, sizeof(f)); };
+
+	// the first value is always sent and a location beyond the size grows the cache
+	CHECK(set(3, 1.0f));
+	CHECK(values.size() == 4);
+	CHECK(values[0].size == 0);
+	CHECK(values[3].size == sizeof(float));
+
+	// the same value is skipped, a changed value is sent
+	CHECK(set(3, 1.0f) == false);
+	CHECK(set(3, 2.0f));
+	CHECK(set(3, 2.0f) == false);
+
+	// locations are cached separately and a lower location doesn't shrink the cache
+	CHECK(set(1, 2.0f));
+	CHECK(values.size() == 4);
+
+	// a value of a different size is sent even if the bytes start the same
+	const auto vec = glm::vec2{2.0f, 0.0f};
+	CHECK(is_new_uniform_value(&values, 3, &vec, sizeof(vec)));
+	CHECK(is_new_uniform_value(&values, 3, &vec, sizeof(vec)) == false);
+
+	const auto stats = get_uniform_upload_stats();
+	CHECK(stats.issued == 4);
+	CHECK(stats.skipped == 3);
+
+	reset_uniform_upload_stats();
+	CHECK(get_uniform_upload_stats().issued == 0);
+	CHECK(get_uniform_upload_stats().skipped == 0);
+}
+
+TEST_CASE("uniform_value_cache_compares_bytes", "[uniform]")
+{
+	std::vector<UniformValue> values;
+	const auto set = [&](float f) { return is_new_uniform_value(&values, 0, &f, sizeof(f)); };
+
+	// -0 and 0 are equal as floats but not as bytes
+	CHECK(set(0.0f));
+	CHECK(set(-0.0f));
+	CHECK(set(-0.0f) == false);
+
+	// nan isn't equal to itself as a float, but the same nan is skipped and a different payload is sent
+	const auto nan = std::bit_cast<float>(0x7FC00000u);
+	const auto other_nan = std::bit_cast<float>(0x7FC00001u);
+	CHECK(set(nan));
+	CHECK(set(nan) == false);
+	CHECK(set(other_nan));
+	CHECK(set(other_nan) == false);
+}
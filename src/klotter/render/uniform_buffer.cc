@@ -1,6 +1,7 @@
 #include "klotter/render/uniform_buffer.h"
 
 #include "klotter/assert.h"
+#include "klotter/cint.h"
 #include "klotter/str.h"
 
 #include "klotter/render/opengl_labels.h"
@@ -11,42 +12,71 @@ namespace klotter
 
 using UniformBufferDescription = std::vector<UniformProp>;
 
-/// returns the size in bytes
-int size_of(const UniformProp& prop, bool align)
+namespace
 {
 	constexpr int n = 4;  // in bytes
-	constexpr int n2 = n * 2;
-	constexpr int n4 = n * 4;
-	switch (prop.array_count == 1 ? prop.type : UniformType::vec4)
+	constexpr int vec4_size = n * 4;
+
+	/// returns the size in bytes of a single element
+	int size_of(UniformType type)
 	{
-	case UniformType::bool_type:
-	case UniformType::int_type:
-	case UniformType::float_type:
-		return n;
-	case UniformType::vec2: return n2;
-	case UniformType::vec3:
-	case UniformType::vec4:
-		return n4;
-	case UniformType::mat4: return n4 * (align ? 1 : 4);
-	default: DIE("invalid uniform type"); return 0;
+		switch (type)
+		{
+		case UniformType::bool_type:
+		case UniformType::int_type:
+		case UniformType::float_type:
+			return n;
+		case UniformType::vec2: return n * 2;
+		case UniformType::vec3: return n * 3;
+		case UniformType::vec4: return vec4_size;
+		case UniformType::mat4: return vec4_size * 4;
+		default: DIE("invalid uniform type"); return 0;
+		}
 	}
-}
 
-int calculate_alignment_bytes(int current_size, const UniformProp& prop)
-{
-	const auto size = size_of(prop, true);
-	const auto mod = current_size % size;
-	if (mod == 0)
+	/// the std140 base alignment, arrays are always aligned to a vec4
+	int alignment_of(const UniformProp& prop)
 	{
-		return 0;
+		if (prop.array_count > 1)
+		{
+			return vec4_size;
+		}
+
+		switch (prop.type)
+		{
+		case UniformType::bool_type:
+		case UniformType::int_type:
+		case UniformType::float_type:
+			return n;
+		case UniformType::vec2: return n * 2;
+		case UniformType::vec3:
+		case UniformType::vec4:
+		case UniformType::mat4:
+			return vec4_size;
+		default: DIE("invalid uniform type"); return 0;
+		}
 	}
 
-	const auto to_add = size - mod;
-	ASSERT((to_add + mod) % size == 0);
-	return to_add;
+	/// the size of the prop, including the padding between array elements
+	int total_size_of(const UniformProp& prop)
+	{
+		return prop.array_count > 1 ? array_stride_of(prop.type) * prop.array_count : size_of(prop.type);
+	}
+
+	int offset_of(const CompiledUniformProp& prop, UniformType type, int index)
+	{
+		ASSERT(prop.type == type);
+		ASSERT(index >= 0 && index < prop.array_count);
+		return prop.offset + index * array_stride_of(type);
+	}
+}  //  namespace
+
+int array_stride_of(UniformType type)
+{
+	return round_up(size_of(type), vec4_size);
 }
 
-std::string source_from(const std::string& name, const UniformBufferDescription& desc)
+std::string source_from(const std::string& name, const std::string& instance_name, const UniformBufferDescription& desc)
 {
 	const auto string_from_type = [](UniformType t)
 	{
@@ -75,8 +105,12 @@ std::string source_from(const std::string& name, const UniformBufferDescription&
 		}
 		ss << ";\n";
 	}
-	ss << "};"
-	   << "\n";
+	ss << "}";
+	if (instance_name.empty() == false)
+	{
+		ss << " " << instance_name;
+	}
+	ss << ";\n";
 	return ss.str();
 }
 
@@ -85,24 +119,77 @@ void UniformBufferCompiler::add(CompiledUniformProp* target, UniformType type, c
 	props.emplace_back(UniformProp{target, type, name, array_count});
 }
 
-UniformBufferSetup UniformBufferCompiler::compile(const std::string& name, int binding_point) const
+UniformBufferSetup UniformBufferCompiler::compile(const std::string& name, int binding_point, const std::string& instance_name) const
 {
 	UniformBufferSetup target;
 	target.size = 0;
 	target.binding_point = binding_point;
 	target.name = name;
-	target.source = source_from(name, props);
+	target.source = source_from(name, instance_name, props);
 	for (const auto& p: props)
 	{
-		const auto size = size_of(p, false);
-		target.size += calculate_alignment_bytes(target.size, p);
+		target.size = round_up(target.size, alignment_of(p));
 		*p.target = {target.size, p.type, p.array_count};
-		target.size += size * p.array_count;
+		target.size += total_size_of(p);
 	}
 
+	// std140 pads the block to a vec4, this is the size the driver reports and expects a bound range to be
+	target.size = round_up(target.size, vec4_size);
+
 	return target;
 }
 
+UniformBlockData::UniformBlockData(const UniformBufferSetup& setup)
+	: bytes(sizet_from_int(setup.size), 0)
+{
+}
+
+namespace
+{
+	void write_to_block(std::vector<std::uint8_t>* bytes, int offset, const void* data, std::size_t size)
+	{
+		ASSERT(offset >= 0 && sizet_from_int(offset) + size <= bytes->size());
+		std::memcpy(bytes->data() + offset, data, size);
+	}
+}  //  namespace
+
+void UniformBlockData::set_bool(const CompiledUniformProp& prop, bool b, int index)
+{
+	// a bool is stored as a 4 byte int in a block
+	const int i = b ? 1 : 0;
+	write_to_block(&bytes, offset_of(prop, UniformType::bool_type, index), &i, sizeof(i));
+}
+
+void UniformBlockData::set_int(const CompiledUniformProp& prop, int i, int index)
+{
+	write_to_block(&bytes, offset_of(prop, UniformType::int_type, index), &i, sizeof(i));
+}
+
+void UniformBlockData::set_float(const CompiledUniformProp& prop, float f, int index)
+{
+	write_to_block(&bytes, offset_of(prop, UniformType::float_type, index), &f, sizeof(f));
+}
+
+void UniformBlockData::set_vec2(const CompiledUniformProp& prop, const glm::vec2& v, int index)
+{
+	write_to_block(&bytes, offset_of(prop, UniformType::vec2, index), glm::value_ptr(v), sizeof(v));
+}
+
+void UniformBlockData::set_vec3(const CompiledUniformProp& prop, const glm::vec3& v, int index)
+{
+	write_to_block(&bytes, offset_of(prop, UniformType::vec3, index), glm::value_ptr(v), sizeof(v));
+}
+
+void UniformBlockData::set_vec4(const CompiledUniformProp& prop, const glm::vec4& v, int index)
+{
+	write_to_block(&bytes, offset_of(prop, UniformType::vec4, index), glm::value_ptr(v), sizeof(v));
+}
+
+void UniformBlockData::set_mat4(const CompiledUniformProp& prop, const glm::mat4& m, int index)
+{
+	write_to_block(&bytes, offset_of(prop, UniformType::mat4, index), glm::value_ptr(m), sizeof(m));
+}
+
 namespace
 {
 	const UniformBuffer* bound_buffer = nullptr;
@@ -168,12 +255,83 @@ void UniformBuffer::unload()
 	id = 0;
 }
 
-void UniformBuffer::set_mat4(const CompiledUniformProp& prop, const glm::mat4& m) // NOLINT(readability-convert-member-functions-to-static)
+namespace
+{
+	void upload_to_bound(const UniformBuffer* self, int offset, const void* data, std::size_t size)
+	{
+		ASSERT(bound_buffer == self);
+		glBufferSubData(GL_UNIFORM_BUFFER, offset, static_cast<GLsizeiptr>(size), data);
+	}
+
+	/// restores the binding that \ref BoundUniformBuffer expects after binding some other buffer
+	void restore_bound_buffer()
+	{
+		glBindBuffer(GL_UNIFORM_BUFFER, bound_buffer != nullptr ? bound_buffer->id : 0);
+	}
+}  //  namespace
+
+void UniformBuffer::set_bool(const CompiledUniformProp& prop, bool b, int index)
+{
+	const int i = b ? 1 : 0;
+	upload_to_bound(this, offset_of(prop, UniformType::bool_type, index), &i, sizeof(i));
+}
+
+void UniformBuffer::set_int(const CompiledUniformProp& prop, int i, int index)
+{
+	upload_to_bound(this, offset_of(prop, UniformType::int_type, index), &i, sizeof(i));
+}
+
+void UniformBuffer::set_float(const CompiledUniformProp& prop, float f, int index)
+{
+	upload_to_bound(this, offset_of(prop, UniformType::float_type, index), &f, sizeof(f));
+}
+
+void UniformBuffer::set_vec2(const CompiledUniformProp& prop, const glm::vec2& v, int index)
+{
+	upload_to_bound(this, offset_of(prop, UniformType::vec2, index), glm::value_ptr(v), sizeof(v));
+}
+
+void UniformBuffer::set_vec3(const CompiledUniformProp& prop, const glm::vec3& v, int index)
+{
+	upload_to_bound(this, offset_of(prop, UniformType::vec3, index), glm::value_ptr(v), sizeof(v));
+}
+
+void UniformBuffer::set_vec4(const CompiledUniformProp& prop, const glm::vec4& v, int index)
+{
+	upload_to_bound(this, offset_of(prop, UniformType::vec4, index), glm::value_ptr(v), sizeof(v));
+}
+
+void UniformBuffer::set_mat4(const CompiledUniformProp& prop, const glm::mat4& m, int index)
+{
+	upload_to_bound(this, offset_of(prop, UniformType::mat4, index), glm::value_ptr(m), sizeof(m));
+}
+
+void UniformBuffer::set_data(int offset, const UniformBlockData& data) // NOLINT(readability-make-member-function-const)
+{
+	glBindBuffer(GL_UNIFORM_BUFFER, id);
+	glBufferSubData(GL_UNIFORM_BUFFER, offset, static_cast<GLsizeiptr>(data.bytes.size()), data.bytes.data());
+	restore_bound_buffer();
+}
+
+void UniformBuffer::bind_range(int binding_point, int offset, int size) const
+{
+	bind_uniform_buffer_range(id, binding_point, offset, size);
+}
+
+void bind_uniform_buffer_range(unsigned int buffer, int binding_point, int offset, int size)
+{
+	// binding a range also changes the generic binding
+	glBindBufferRange(GL_UNIFORM_BUFFER, gluint_from_int(binding_point), buffer, offset, size);
+	restore_bound_buffer();
+}
+
+void copy_uniform_buffer(const UniformBuffer& src, UniformBuffer* dst, int size)
 {
-	// todo(Gustav): verify that the prop belongs to self
-	ASSERT(prop.type == UniformType::mat4 && prop.array_count == 1);
-	// todo(Gustav): replace sizeof with actual size
-	glBufferSubData(GL_UNIFORM_BUFFER, prop.offset, sizeof(glm::mat4), glm::value_ptr(m));
+	glBindBuffer(GL_COPY_READ_BUFFER, src.id);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, dst->id);
+	glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, size);
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
 }
 
 }  //  namespace klotter
@@ -47,22 +47,60 @@ struct UniformProp
 	int array_count;
 };
 
+/// Lays out the props with the std140 rules, so the layout is the same for all drivers.
 struct UniformBufferCompiler
 {
 	void add(CompiledUniformProp* target, UniformType type, const std::string& name, int array_count = 1);
 
+	/** Compile the layout and generate the glsl source.
+	 * @param name the name of the block
+	 * @param binding_point the binding point of the block
+	 * @param instance_name if not empty, the props are accessed in glsl through this name like instance.prop
+	 */
 	[[nodiscard]]
-	UniformBufferSetup compile(const std::string& name, int binding_point) const;
+	UniformBufferSetup compile(const std::string& name, int binding_point, const std::string& instance_name = "") const;
 
 	std::vector<UniformProp> props;
 };
 
+/// The distance in bytes between two elements in a array prop.
+int array_stride_of(UniformType type);
+
+/// A cpu side copy of a uniform block, written with the same layout as the buffer so it can be uploaded in a single call.
+struct UniformBlockData
+{
+	explicit UniformBlockData(const UniformBufferSetup& setup);
+
+	void set_bool(const CompiledUniformProp& prop, bool b, int index = 0);
+	void set_int(const CompiledUniformProp& prop, int i, int index = 0);
+	void set_float(const CompiledUniformProp& prop, float f, int index = 0);
+	void set_vec2(const CompiledUniformProp& prop, const glm::vec2& v, int index = 0);
+	void set_vec3(const CompiledUniformProp& prop, const glm::vec3& v, int index = 0);
+	void set_vec4(const CompiledUniformProp& prop, const glm::vec4& v, int index = 0);
+	void set_mat4(const CompiledUniformProp& prop, const glm::mat4& m, int index = 0);
+
+	std::vector<std::uint8_t> bytes;
+};
+
 struct UniformBuffer
 {
 	DEBUG_LABEL_EXPLICIT_MANY UniformBuffer(DEBUG_LABEL_ARG_MANY const UniformBufferSetup& setup);
 	~UniformBuffer();
 
-	void set_mat4(const CompiledUniformProp& prop, const glm::mat4& m);
+	// the setters require the buffer to be bound
+	void set_bool(const CompiledUniformProp& prop, bool b, int index = 0);
+	void set_int(const CompiledUniformProp& prop, int i, int index = 0);
+	void set_float(const CompiledUniformProp& prop, float f, int index = 0);
+	void set_vec2(const CompiledUniformProp& prop, const glm::vec2& v, int index = 0);
+	void set_vec3(const CompiledUniformProp& prop, const glm::vec3& v, int index = 0);
+	void set_vec4(const CompiledUniformProp& prop, const glm::vec4& v, int index = 0);
+	void set_mat4(const CompiledUniformProp& prop, const glm::mat4& m, int index = 0);
+
+	/// Upload a block to a offset in the buffer, doesn't require the buffer to be bound.
+	void set_data(int offset, const UniformBlockData& data);
+
+	/// Bind a part of the buffer to a binding point, doesn't change the bound buffer.
+	void bind_range(int binding_point, int offset, int size) const;
 
 	UniformBuffer(const UniformBuffer&) = delete;
 	void operator=(const UniformBuffer&) = delete;
@@ -89,6 +127,12 @@ struct BoundUniformBuffer
 	UniformBuffer* buffer;
 };
 
+/// Bind a part of a buffer that isn't a \ref UniformBuffer to a binding point, doesn't change the bound buffer.
+void bind_uniform_buffer_range(unsigned int buffer, int binding_point, int offset, int size);
+
+/// Copy the start of a buffer to another buffer, doesn't change the bound buffer.
+void copy_uniform_buffer(const UniformBuffer& src, UniformBuffer* dst, int size);
+
 /**
  * @}
 */
@@ -35,7 +35,7 @@ TEST_CASE("uniform_buffer_test_simple", "[uniform_buffer]")
 	CHECK(values.offset == 96);
 	CHECK(boolean.offset == 144);
 	CHECK(integer.offset == 148);
-	CHECK(setup.size == 152);
+	CHECK(setup.size == 160);
 }
 
 TEST_CASE("uniform_buffer_test_basic_mat", "[uniform_buffer]")
@@ -64,3 +64,102 @@ TEST_CASE("uniform_buffer_test_basic_mat", "[uniform_buffer]")
 		"};\n"
 	));
 }
+
+
+TEST_CASE("uniform_buffer_test_std140_packing", "[uniform_buffer]")
+{
+	UniformBufferSetup setup;
+	CompiledUniformProp color;
+	CompiledUniformProp factor;
+	CompiledUniformProp offset;
+	CompiledUniformProp weights;
+	CompiledUniformProp directions;
+	CompiledUniformProp transforms;
+	CompiledUniformProp last;
+
+	{
+		UniformBufferCompiler compiler;
+		compiler.add(&color, UniformType::vec3, "color");
+		compiler.add(&factor, UniformType::float_type, "factor");
+		compiler.add(&offset, UniformType::vec2, "offset");
+		compiler.add(&weights, UniformType::vec2, "weights", 2);
+		compiler.add(&directions, UniformType::vec3, "directions", 2);
+		compiler.add(&transforms, UniformType::mat4, "transforms", 2);
+		compiler.add(&last, UniformType::int_type, "last");
+		setup = compiler.compile("P", 2, "u_p");
+	}
+
+	// a scalar fits after a vec3
+	CHECK(color.offset == 0);
+	CHECK(factor.offset == 12);
+	CHECK(offset.offset == 16);
+
+	// arrays are aligned to and padded to vec4
+	CHECK(weights.offset == 32);
+	CHECK(directions.offset == 64);
+	CHECK(transforms.offset == 96);
+	CHECK(last.offset == 224);
+	CHECK(setup.size == 240);
+
+	CHECK(array_stride_of(UniformType::float_type) == 16);
+	CHECK(array_stride_of(UniformType::vec3) == 16);
+	CHECK(array_stride_of(UniformType::mat4) == 64);
+
+	CHECK(catchy::StringEq(
+		setup.source,
+		"layout (std140) uniform P\n"
+		"{\n"
+		"\tvec3 color;\n"
+		"\tfloat factor;\n"
+		"\tvec2 offset;\n"
+		"\tvec2 weights[2];\n"
+		"\tvec3 directions[2];\n"
+		"\tmat4 transforms[2];\n"
+		"\tint last;\n"
+		"} u_p;\n"
+	));
+}
+
+TEST_CASE("uniform_buffer_test_block_data", "[uniform_buffer]")
+{
+	CompiledUniformProp color;
+	CompiledUniformProp factor;
+	CompiledUniformProp enabled;
+	CompiledUniformProp values;
+
+	UniformBufferCompiler compiler;
+	compiler.add(&color, UniformType::vec3, "color");
+	compiler.add(&factor, UniformType::float_type, "factor");
+	compiler.add(&enabled, UniformType::bool_type, "enabled");
+	compiler.add(&values, UniformType::float_type, "values", 2);
+	const auto setup = compiler.compile("B", 0);
+
+	auto data = UniformBlockData{setup};
+	REQUIRE(data.bytes.size() == 64);
+
+	data.set_vec3(color, {1.0f, 2.0f, 3.0f});
+	data.set_float(factor, 4.0f);
+	data.set_bool(enabled, true);
+	data.set_float(values, 5.0f, 1);
+
+	const auto read_float = [&](std::size_t offset)
+	{
+		float f = 0.0f;
+		std::memcpy(&f, data.bytes.data() + offset, sizeof(f));
+		return f;
+	};
+	const auto read_int = [&](std::size_t offset)
+	{
+		int i = 0;
+		std::memcpy(&i, data.bytes.data() + offset, sizeof(i));
+		return i;
+	};
+
+	CHECK(read_float(0) == 1.0f);
+	CHECK(read_float(4) == 2.0f);
+	CHECK(read_float(8) == 3.0f);
+	CHECK(read_float(12) == 4.0f);
+	CHECK(read_int(16) == 1);
+	CHECK(read_float(32) == 0.0f);
+	CHECK(read_float(48) == 5.0f);
+}
@@ -4,21 +4,25 @@
 #include "klotter/str.h"
 
 #include "klotter/render/geom.extract.h"
+#include "klotter/render/geom.h"
 #include "klotter/render/opengl_utils.h"
 #include "klotter/render/shader.h"
+#include "klotter/render/state.h"
 #include "klotter/render/vertex_layout.h"
 
+#include <limits>
 #include <utility>
 
 namespace klotter
 {
 
-CompiledGeom::CompiledGeom(u32 b, u32 a, u32 e, const CompiledGeomVertexAttributes& att, i32 tc)
+CompiledGeom::CompiledGeom(u32 b, u32 a, u32 e, const CompiledGeomVertexAttributes& att, i32 tc, const LocalAabb& bb)
 	: vbo(b)
 	, vao(a)
 	, ebo(e)
 	, number_of_triangles(tc)
 	, debug_types(att.debug_types.begin(), att.debug_types.end())
+	, aabb(bb)
 
 {
 }
@@ -55,6 +59,22 @@ std::shared_ptr<MeshInstance_TransformInstanced> make_mesh_instance(
 	return instance;
 }
 
+LocalAabb calc_local_aabb(const Geom& geom)
+{
+	if (geom.vertices.empty())
+	{
+		return {glm::vec3{0.0f}, glm::vec3{0.0f}};
+	}
+
+	auto aabb = LocalAabb{glm::vec3{std::numeric_limits<float>::max()}, glm::vec3{std::numeric_limits<float>::lowest()}};
+	for (const auto& vertex: geom.vertices)
+	{
+		aabb.min = glm::min(aabb.min, vertex.position);
+		aabb.max = glm::max(aabb.max, vertex.position);
+	}
+	return aabb;
+}
+
 std::shared_ptr<CompiledGeom> compile_geom(DEBUG_LABEL_ARG_MANY const Geom& geom, const CompiledGeomVertexAttributes& geom_layout)
 {
 	const auto ex = extract_geom(geom, geom_layout);
@@ -109,7 +129,11 @@ std::shared_ptr<CompiledGeom> compile_geom(DEBUG_LABEL_ARG_MANY const Geom& geom
 		GL_STATIC_DRAW
 	);
 
-	return std::make_shared<CompiledGeom>(vbo, vao, ebo, geom_layout, ex.face_size);
+	invalidate_state_bindings();
+
+	auto compiled = std::make_shared<CompiledGeom>(vbo, vao, ebo, geom_layout, ex.face_size, calc_local_aabb(geom));
+	compiled->gpu_bytes = ex.data.size() + sizeof(u32) * ex.indices.size();
+	return compiled;
 }
 
 CompiledGeom::~CompiledGeom()
@@ -122,6 +146,8 @@ CompiledGeom::~CompiledGeom()
 
 	glBindVertexArray(0);
 	destroy_vertex_array(vao);
+
+	invalidate_state_bindings();
 }
 
 std::shared_ptr<CompiledGeom_TransformInstance> compile_geom_with_transform_instance(
@@ -202,6 +228,8 @@ std::shared_ptr<CompiledGeom_TransformInstance> compile_geom_with_transform_inst
 		GL_STATIC_DRAW
 	);
 
+	invalidate_state_bindings();
+
 	return std::make_shared<CompiledGeom_TransformInstance>(
 		instance_vbo, max_instances, vbo, vao, ebo, geom_layout, ex.face_size
 	);
@@ -215,14 +243,14 @@ LocalAxis MeshInstance::get_local_axis() const
 	};
 }
 
-void render_geom(const CompiledGeom& geom)
+void render_geom(State* states, const CompiledGeom& geom)
 {
 	ASSERT(is_bound_for_shader(geom.debug_types));
-	glBindVertexArray(geom.vao);
+	StateChanger{states}.bind_vertex_array(geom.vao);
 	glDrawElements(GL_TRIANGLES, geom.number_of_triangles * 3, GL_UNSIGNED_INT, nullptr);
 }
 
-void render_geom_instanced(const MeshInstance_TransformInstanced& instanced)
+void render_geom_instanced(State* states, const MeshInstance_TransformInstanced& instanced)
 {
 	auto* geom = instanced.geom.get();
 	ASSERT(is_bound_for_shader(geom->debug_types));
@@ -233,12 +261,12 @@ void render_geom_instanced(const MeshInstance_TransformInstanced& instanced)
 	{
 		const std::size_t step_size
 			= std::min(instanced.world_from_locals.size() - start_index, instanced.geom->max_instances);
-		glBindBuffer(GL_ARRAY_BUFFER, instanced.geom->instance_vbo);
+		StateChanger{states}.bind_array_buffer(instanced.geom->instance_vbo);
 		glBufferSubData(
 			GL_ARRAY_BUFFER, 0, glsizeiptr_from_sizet(sizeof(glm::mat4) * step_size), &instanced.world_from_locals[start_index]
 		);
 
-		glBindVertexArray(geom->vao);
+		StateChanger{states}.bind_vertex_array(geom->vao);
 		glDrawElementsInstanced(
 			GL_TRIANGLES,
 			geom->number_of_triangles * 3,
@@ -260,6 +288,8 @@ CompiledGeom_TransformInstance::~CompiledGeom_TransformInstance()
 
 	glBindVertexArray(0);
 	destroy_vertex_array(vao);
+
+	invalidate_state_bindings();
 }
 
 CameraVectors create_vectors(const DirectionalLight& p)
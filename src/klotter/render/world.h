@@ -16,6 +16,13 @@ struct Geom;
 */
 
 
+/// An axis aligned bounding box in the local space of a Geom.
+struct LocalAabb
+{
+	glm::vec3 min;
+	glm::vec3 max;
+};
+
 /// Represents a Geom on the GPU.
 struct CompiledGeom
 {
@@ -24,8 +31,12 @@ struct CompiledGeom
 	u32 ebo;
 	i32 number_of_triangles;
 	std::unordered_set<VertexType> debug_types;
+	LocalAabb aabb;
 
-	explicit CompiledGeom(u32, u32, u32, const CompiledGeomVertexAttributes&, i32);
+	/// the size of the vertex and index buffers
+	std::size_t gpu_bytes = 0;
+
+	explicit CompiledGeom(u32, u32, u32, const CompiledGeomVertexAttributes&, i32, const LocalAabb&);
 	~CompiledGeom();
 
 	CompiledGeom(const CompiledGeom&) = delete;
@@ -79,6 +90,23 @@ enum class Billboarding
 	axial_y_fast
 };
 
+/// Defines how (or if) a mesh is tested against the depth buffer on the gpu before it's rendered.
+/// The bounding box of the mesh is rendered in a occlusion query, and the result is used to skip the mesh.
+/// Only useful for heavy meshes that are often hidden behind other meshes since each query also has a cost.
+enum class OcclusionTest
+{
+	/// Always render the mesh.
+	none,
+
+	/// Let the gpu skip the mesh with a conditional render using the latest query.
+	/// The cpu still issues the draw calls but the vertex cost is removed.
+	conditional_render,
+
+	/// Read back the query result a frame later and don't issue the draw calls if the mesh is hidden.
+	/// Saves both cpu and gpu time but hidden meshes that become visible pops in a frame late.
+	skip
+};
+
 /// Stores Geom + Material (aka a mesh) and its current transform.
 struct MeshInstance
 {
@@ -86,11 +114,15 @@ struct MeshInstance
 	std::shared_ptr<Material> material;
 
 	std::optional<Rgb> outline;
+	OcclusionTest occlusion = OcclusionTest::none; ///< only used for solid meshes
 
 	glm::vec3 world_position = glm::vec3{0.0f};
 	glm::vec3 rotation = glm::vec3{0.0f};  ///< yaw pitch roll
 	Billboarding billboarding = Billboarding::none;	 ///< if not none, rotation is ignored
 
+	/// if this is a copy in a \ref WorldSnapshot, the mesh it was copied from
+	const MeshInstance* snapshot_of = nullptr;
+
 	LocalAxis get_local_axis() const;
 };
 
@@ -111,8 +143,8 @@ std::shared_ptr<MeshInstance_TransformInstanced> make_mesh_instance(
 	std::shared_ptr<CompiledGeom_TransformInstance> geom, std::shared_ptr<Material> mat
 );
 
-void render_geom(const CompiledGeom& geom);
-void render_geom_instanced(const MeshInstance_TransformInstanced& instanced);
+void render_geom(State* states, const CompiledGeom& geom);
+void render_geom_instanced(State* states, const MeshInstance_TransformInstanced& instanced);
 
 
 /// A directional light,
@@ -0,0 +1,88 @@
+#include "klotter/render/world.snapshot.h"
+
+#include "klotter/assert.h"
+
+namespace klotter
+{
+
+namespace
+{
+	template<typename T>
+	void copy_instances(const std::vector<std::shared_ptr<T>>& source, std::vector<std::shared_ptr<T>>* dest)
+	{
+		dest->resize(source.size());
+		for (std::size_t index = 0; index < source.size(); index += 1)
+		{
+			ASSERT(source[index] != nullptr);
+			auto& copy = (*dest)[index];
+			if (copy == nullptr)
+			{
+				copy = std::make_shared<T>(*source[index]);
+			}
+			else
+			{
+				*copy = *source[index];
+			}
+		}
+	}
+}  //  namespace
+
+void copy_to_snapshot(const World& world, World* snapshot)
+{
+	copy_instances(world.meshes, &snapshot->meshes);
+	for (std::size_t index = 0; index < world.meshes.size(); index += 1)
+	{
+		const auto& mesh = *world.meshes[index];
+		snapshot->meshes[index]->snapshot_of = mesh.snapshot_of != nullptr ? mesh.snapshot_of : &mesh;
+	}
+
+	copy_instances(world.instances, &snapshot->instances);
+
+	snapshot->lights = world.lights;
+	snapshot->clear_color = world.clear_color;
+	snapshot->skybox = world.skybox;
+}
+
+WorldSnapshot* SnapshotBuffer::begin_write()
+{
+	std::unique_lock lock{mutex};
+	ASSERT(writing == -1);
+
+	const auto target = latest == 0 ? 1 : 0;
+	is_released.wait(lock, [this, target]() { return reading != target; });
+	writing = target;
+	return &snapshots[target];
+}
+
+void SnapshotBuffer::end_write()
+{
+	std::scoped_lock lock{mutex};
+	ASSERT(writing != -1);
+
+	latest = writing;
+	writing = -1;
+}
+
+const WorldSnapshot* SnapshotBuffer::acquire()
+{
+	std::scoped_lock lock{mutex};
+	ASSERT(reading == -1);
+
+	if (latest == -1)
+	{
+		return nullptr;
+	}
+	reading = latest;
+	return &snapshots[reading];
+}
+
+void SnapshotBuffer::release()
+{
+	{
+		std::scoped_lock lock{mutex};
+		reading = -1;
+	}
+	is_released.notify_all();
+}
+
+}  //  namespace klotter
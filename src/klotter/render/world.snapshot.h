@@ -0,0 +1,63 @@
+#pragma once
+
+#include "klotter/render/camera.h"
+#include "klotter/render/world.h"
+
+#include <condition_variable>
+#include <mutex>
+
+namespace klotter
+{
+
+/** \addtogroup render Renderer
+ *  @{
+*/
+
+/// The state an update hands over to the renderer, written once and then only read.
+struct WorldSnapshot
+{
+	World world;
+	Camera camera;
+
+	/// the number of updates that were run before the snapshot was written
+	u64 update = 0;
+};
+
+/** Copy the meshes, instances and lights of a world to a snapshot.
+ * Mesh instances are copied by value so they can be changed while the snapshot is rendered, geoms and materials are shared.
+ * The instances of the snapshot are reused between copies.
+ */
+void copy_to_snapshot(const World& world, World* snapshot);
+
+/** Two snapshots, one that is being written by the update and the latest one that is read by the renderer.
+ * The writer only waits if it is about to overwrite the snapshot that is currently rendered.
+ */
+struct SnapshotBuffer
+{
+	/// Get the snapshot to write, waits if the renderer still uses it.
+	WorldSnapshot* begin_write();
+
+	/// Publish the snapshot returned by \ref begin_write as the latest.
+	void end_write();
+
+	/// Get the latest snapshot, or null if nothing has been written yet. Call \ref release when done with it.
+	const WorldSnapshot* acquire();
+
+	/// Hand back the snapshot returned by \ref acquire.
+	void release();
+
+	WorldSnapshot snapshots[2];
+
+	std::mutex mutex;
+	std::condition_variable is_released;
+
+	int latest = -1;
+	int writing = -1;
+	int reading = -1;
+};
+
+/**
+ * @}
+*/
+
+}  //  namespace klotter
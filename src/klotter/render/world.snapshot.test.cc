@@ -0,0 +1,108 @@
+#include "klotter/render/world.snapshot.h"
+
+#include "catch2/catch_test_macros.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+using namespace klotter;
+
+TEST_CASE("world_snapshot_copies_instances", "[world_snapshot]")
+{
+	World world;
+	world.meshes.emplace_back(std::make_shared<MeshInstance>());
+	world.meshes[0]->world_position = {1.0f, 2.0f, 3.0f};
+	world.lights.point_lights.emplace_back();
+	world.clear_color = colors::white;
+
+	World snapshot;
+	copy_to_snapshot(world, &snapshot);
+
+	REQUIRE(snapshot.meshes.size() == 1);
+	CHECK(snapshot.meshes[0] != world.meshes[0]);
+	CHECK(snapshot.meshes[0]->snapshot_of == world.meshes[0].get());
+	CHECK(snapshot.meshes[0]->world_position.y == 2.0f);
+	CHECK(snapshot.lights.point_lights.size() == 1);
+	CHECK(snapshot.clear_color.r == colors::white.r);
+
+	// changing the world doesn't change the snapshot, and the next copy reuses the instance
+	const auto* copied = snapshot.meshes[0].get();
+	world.meshes[0]->world_position.y = 5.0f;
+	CHECK(snapshot.meshes[0]->world_position.y == 2.0f);
+
+	copy_to_snapshot(world, &snapshot);
+	CHECK(snapshot.meshes[0].get() == copied);
+	CHECK(snapshot.meshes[0]->world_position.y == 5.0f);
+
+	// a copy of a copy refers to the original mesh
+	World second;
+	copy_to_snapshot(snapshot, &second);
+	CHECK(second.meshes[0]->snapshot_of == world.meshes[0].get());
+
+	world.meshes.clear();
+	copy_to_snapshot(world, &snapshot);
+	CHECK(snapshot.meshes.empty());
+}
+
+TEST_CASE("world_snapshot_buffer_alternates", "[world_snapshot]")
+{
+	SnapshotBuffer buffer;
+	CHECK(buffer.acquire() == nullptr);
+	buffer.release();
+
+	auto* first = buffer.begin_write();
+	first->update = 1;
+	buffer.end_write();
+
+	const auto* read = buffer.acquire();
+	REQUIRE(read == first);
+
+	// the snapshot that is read isn't written
+	auto* second = buffer.begin_write();
+	CHECK(second != first);
+	second->update = 2;
+	buffer.end_write();
+	CHECK(read->update == 1);
+	buffer.release();
+
+	read = buffer.acquire();
+	REQUIRE(read != nullptr);
+	CHECK(read->update == 2);
+	buffer.release();
+}
+
+TEST_CASE("world_snapshot_buffer_writer_waits_for_reader", "[world_snapshot]")
+{
+	SnapshotBuffer buffer;
+	buffer.begin_write()->update = 1;
+	buffer.end_write();
+	buffer.begin_write()->update = 2;
+	buffer.end_write();
+
+	// the reader holds 2 and the writer has written 3, the next write needs 2 back
+	const auto* read = buffer.acquire();
+	buffer.begin_write()->update = 3;
+	buffer.end_write();
+
+	std::atomic<bool> has_written = false;
+	std::thread writer{[&]()
+		{
+			buffer.begin_write()->update = 4;
+			buffer.end_write();
+			has_written = true;
+		}
+	};
+
+	std::this_thread::sleep_for(std::chrono::milliseconds{20});
+	CHECK(has_written == false);
+	CHECK(read->update == 2);
+	buffer.release();
+	writer.join();
+
+	CHECK(has_written);
+	read = buffer.acquire();
+	REQUIRE(read != nullptr);
+	CHECK(read->update == 4);
+	buffer.release();
+}
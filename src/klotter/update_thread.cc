@@ -0,0 +1,68 @@
+#include "klotter/update_thread.h"
+
+#include "klotter/klotter.h"
+#include "klotter/profiler.h"
+
+#include <chrono>
+
+namespace klotter
+{
+
+UpdateThread::UpdateThread(App* a)
+	: app(a)
+	, thread([this]() { run(); })
+{
+}
+
+UpdateThread::~UpdateThread()
+{
+	is_stopping = true;
+	thread.join();
+}
+
+void UpdateThread::run()
+{
+	set_profiler_thread_name("Update");
+	const auto step = 1.0f / app->updates_per_second;
+
+	u64 updates = 0;
+	float accumulated = 0.0f;
+	auto last = std::chrono::steady_clock::now();
+	while (is_stopping == false)
+	{
+		const auto now = std::chrono::steady_clock::now();
+		accumulated += std::chrono::duration<float>{now - last}.count();
+		last = now;
+
+		if (accumulated < step)
+		{
+			std::this_thread::sleep_for(std::chrono::duration<float>{step - accumulated});
+			continue;
+		}
+		accumulated = std::min(accumulated, step * static_cast<float>(max_catch_up_updates));
+
+		auto* snapshot = snapshots.begin_write();
+		{
+			std::scoped_lock lock{app_mutex};
+			while (accumulated >= step)
+			{
+				SCOPED_PROFILE_ZONE("Update App"sv);
+				app->on_update(step);
+				accumulated -= step;
+				updates += 1;
+			}
+
+			snapshot->camera = app->camera;
+			snapshot->update = updates;
+			app->on_write_snapshot(snapshot);
+		}
+		snapshots.end_write();
+	}
+}
+
+std::unique_lock<std::mutex> lock_app(UpdateThread* update)
+{
+	return update != nullptr ? std::unique_lock{update->app_mutex} : std::unique_lock<std::mutex>{};
+}
+
+}  //  namespace klotter
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "klotter/render/world.snapshot.h"
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+namespace klotter
+{
+
+struct App;
+
+/// the most updates that are run to catch up, if the updates are slower than the time step the simulation slows down instead
+constexpr int max_catch_up_updates = 5;
+
+/// Runs \ref App::on_update on its own thread and writes the snapshots, see \ref UpdateMode::pipelined
+struct UpdateThread
+{
+	App* app;
+
+	/// held while the app is updated, and while the gl thread uses the app
+	std::mutex app_mutex;
+
+	SnapshotBuffer snapshots;
+	std::atomic<bool> is_stopping = false;
+	std::thread thread;
+
+	/// Starts updating the app right away.
+	explicit UpdateThread(App* a);
+
+	/// Stops after the current update.
+	~UpdateThread();
+
+	UpdateThread(const UpdateThread&) = delete;
+	UpdateThread(UpdateThread&&) = delete;
+	void operator=(const UpdateThread&) = delete;
+	void operator=(UpdateThread&&) = delete;
+
+	void run();
+};
+
+/// In pipelined mode the app is shared with the update thread, lock it before using it on the gl thread.
+/// Returns a empty lock if there is no update thread.
+std::unique_lock<std::mutex> lock_app(UpdateThread* update);
+
+}  //  namespace klotter
@@ -0,0 +1,108 @@
+#include "klotter/update_thread.h"
+
+#include "klotter/klotter.h"
+
+#include "catch2/catch_test_macros.hpp"
+
+#include <chrono>
+
+using namespace klotter;
+
+namespace
+{
+	/// a headless app that only counts the updates
+	struct CountingApp : App
+	{
+		std::atomic<int> updates = 0;
+
+		CountingApp()
+		{
+			update_mode = UpdateMode::pipelined;
+			updates_per_second = 1000.0f;
+		}
+
+		void on_frame(Renderer*) override {}
+		void on_gui(Renderer*) override {}
+		void on_render(const glm::ivec2&, Renderer*, float) override {}
+
+		void on_update(float dt) override
+		{
+			CHECK(dt > 0.0f);
+			camera.position.x += 1.0f;
+			updates += 1;
+		}
+	};
+
+	/// waits for a snapshot newer than the given update like the gl thread does, fails if none is written in time
+	const WorldSnapshot* acquire_snapshot(UpdateThread* update, u64 newer_than = 0)
+	{
+		const auto end = std::chrono::steady_clock::now() + std::chrono::seconds{5};
+		while (std::chrono::steady_clock::now() < end)
+		{
+			if (const auto* snapshot = update->snapshots.acquire(); snapshot != nullptr && snapshot->update > newer_than)
+			{
+				return snapshot;
+			}
+			update->snapshots.release();
+			std::this_thread::sleep_for(std::chrono::milliseconds{1});
+		}
+		return nullptr;
+	}
+}  //  namespace
+
+TEST_CASE("update_thread_writes_snapshots", "[update_thread]")
+{
+	CountingApp app;
+	UpdateThread update{&app};
+
+	const auto* first = acquire_snapshot(&update);
+	REQUIRE(first != nullptr);
+	CHECK(first->update > 0);
+	{
+		// the camera in the snapshot is the camera after the last update
+		const auto lock = lock_app(&update);
+		CHECK(first->camera.position.x == static_cast<float>(first->update));
+		CHECK(static_cast<u64>(app.updates.load()) >= first->update);
+	}
+	const auto first_update = first->update;
+	update.snapshots.release();
+
+	// the thread keeps updating and writing
+	const auto* second = acquire_snapshot(&update, first_update);
+	REQUIRE(second != nullptr);
+	CHECK(second->camera.position.x == static_cast<float>(second->update));
+	update.snapshots.release();
+}
+
+TEST_CASE("update_thread_is_locked_out", "[update_thread]")
+{
+	CountingApp app;
+	UpdateThread update{&app};
+
+	REQUIRE(acquire_snapshot(&update) != nullptr);
+	update.snapshots.release();
+
+	{
+		const auto lock = lock_app(&update);
+		const int locked_updates = app.updates;
+		std::this_thread::sleep_for(std::chrono::milliseconds{20});
+		CHECK(app.updates == locked_updates);
+	}
+
+	CHECK(lock_app(nullptr).owns_lock() == false);
+}
+
+TEST_CASE("update_thread_stops", "[update_thread]")
+{
+	CountingApp app;
+	{
+		UpdateThread update{&app};
+		REQUIRE(acquire_snapshot(&update) != nullptr);
+		update.snapshots.release();
+	}
+
+	// no updates after the thread is destroyed
+	const int stopped_updates = app.updates;
+	std::this_thread::sleep_for(std::chrono::milliseconds{20});
+	CHECK(app.updates == stopped_updates);
+}